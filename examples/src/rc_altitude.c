@@ -3,7 +3,8 @@
  * @example    rc_altitude
  *
  * This serves as an example of how to read the barometer and IMU together to
- * estimate altitude
+ * estimate altitude. The barometer is sampled by its own background thread in
+ * the gaps between IMU reads so the DMP callback only copies the latest result.
  *
  * @author     James Strawson
  * @date       3/14/2018
@@ -27,11 +28,11 @@
 #define	DT		(1.0/SAMPLE_RATE)
 #define ACCEL_LP_TC	20*DT	// fast LP filter for accel
 #define PRINT_HZ	10
-#define BMP_RATE_DIV	10	// optionally sample bmp less frequently than mpu
+#define BMP_RATE_HZ	20	// sample bmp less frequently than mpu
 
 static int running = 0;
 static rc_mpu_data_t mpu_data;
-static rc_bmp_data_t bmp_data;
+static rc_bmp_sample_t bmp_sample;
 static rc_kalman_t kf = RC_KALMAN_INITIALIZER;
 static rc_vector_t u = RC_VECTOR_INITIALIZER;
 static rc_vector_t y = RC_VECTOR_INITIALIZER;
@@ -50,7 +51,9 @@ static void __dmp_handler(void)
 {
 	int i;
 	double accel_vec[3];
-	static int bmp_sample_counter = 0;
+
+	// grab the newest barometer result, this doesn't touch the i2c bus
+	rc_bmp_read_latest(&bmp_sample);
 
 	// make copy of acceleration reading before rotating
 	for(i=0;i<3;i++) accel_vec[i]=mpu_data.accel[i];
@@ -59,7 +62,7 @@ static void __dmp_handler(void)
 
 	// do first-run filter setup
 	if(kf.step==0){
-		kf.x_est.d[0] = bmp_data.alt_m;
+		kf.x_est.d[0] = bmp_sample.data.alt_m;
 		rc_filter_prefill_inputs(&acc_lp, accel_vec[2]-9.80665);
 		rc_filter_prefill_outputs(&acc_lp, accel_vec[2]-9.80665);
 	}
@@ -69,17 +72,9 @@ static void __dmp_handler(void)
 	u.d[0] = acc_lp.newest_output;
 
 	// don't bother filtering Barometer, kalman will deal with that
-	y.d[0] = bmp_data.alt_m;
+	y.d[0] = bmp_sample.data.alt_m;
 	if(rc_kalman_update_lin(&kf, u, y)) running=0;
 
-	// now check if we need to sample BMP this loop
-	bmp_sample_counter++;
-	if(bmp_sample_counter>=BMP_RATE_DIV){
-		// perform the i2c reads to the sensor, on bad read just try later
-		if(rc_bmp_read(&bmp_data)) return;
-		bmp_sample_counter=0;
-	}
-
 	return;
 }
 
@@ -88,6 +83,7 @@ static void __dmp_handler(void)
 int main(void)
 {
 	rc_mpu_config_t mpu_conf;
+	rc_bmp_config_t bmp_conf;
 	rc_matrix_t F = RC_MATRIX_INITIALIZER;
 	rc_matrix_t G = RC_MATRIX_INITIALIZER;
 	rc_matrix_t H = RC_MATRIX_INITIALIZER;
@@ -151,22 +147,30 @@ int main(void)
 	signal(SIGINT, __signal_handler);
 	running = 1;
 
-	// init barometer and read in first data
-	printf("initializing barometer\n");
-	if(rc_bmp_init(BMP_OVERSAMPLE_16, BMP_FILTER_16)) return -1;
-	if(rc_bmp_read(&bmp_data)) return -1;
-
-	// init DMP
+	// init DMP first so the barometer sampler can sync to it
 	printf("initializing DMP\n");
 	mpu_conf = rc_mpu_default_config();
 	mpu_conf.dmp_sample_rate = SAMPLE_RATE;
 	mpu_conf.dmp_fetch_accel_gyro = 1;
 	if(rc_mpu_initialize_dmp(&mpu_data, mpu_conf)) return -1;
 
+	// init barometer with its background sampler
+	printf("initializing barometer\n");
+	bmp_conf = rc_bmp_default_config();
+	bmp_conf.oversample = BMP_OVERSAMPLE_16;
+	bmp_conf.filter = BMP_FILTER_16;
+	bmp_conf.sampler_rate_hz = BMP_RATE_HZ;
+	bmp_conf.sampler_sync_mpu = 1;
+	if(rc_bmp_init_config(bmp_conf)) return -1;
+
 	// wait for dmp to settle then start filter callback
 	printf("waiting for sensors to settle");
 	fflush(stdout);
 	rc_usleep(3000000);
+	if(rc_bmp_read_latest(&bmp_sample)!=1){
+		fprintf(stderr,"ERROR: no data from barometer sampler\n");
+		return -1;
+	}
 	rc_mpu_set_dmp_callback(__dmp_handler);
 
 	// print a header
@@ -186,15 +190,15 @@ int main(void)
 		printf("%8.2fm |", kf.x_est.d[0]);
 		printf("%7.2fm/s |", kf.x_est.d[1]);
 		printf("%7.2fm/s^2|", kf.x_est.d[2]);
-		printf("%9.2fm |", bmp_data.alt_m);
+		printf("%9.2fm |", bmp_sample.data.alt_m);
 		printf("%7.2fm/s^2|", acc_lp.newest_output);
 
 		fflush(stdout);
 	}
 	printf("\n");
 
-	rc_mpu_power_off();
 	rc_bmp_power_off();
+	rc_mpu_power_off();
 	return 0;
 }
 
@@ -484,6 +484,7 @@ static void __balance_controller(void)
 {
 	static int inner_saturation_counter = 0;
 	double dutyL, dutyR;
+	double duty[4] = {0.0, 0.0, 0.0, 0.0};
 	/******************************************************************
 	* STATE_ESTIMATION
 	* read sensors and compute the state when either ARMED or DISARMED
@@ -577,8 +578,10 @@ static void __balance_controller(void)
 	***********************************************************/
 	dutyL = cstate.d1_u - cstate.d3_u;
 	dutyR = cstate.d1_u + cstate.d3_u;
-	rc_motor_set(MOTOR_CHANNEL_L, MOTOR_POLARITY_L * dutyL);
-	rc_motor_set(MOTOR_CHANNEL_R, MOTOR_POLARITY_R * dutyR);
+	// update both wheels together, the unused channels stay at 0
+	duty[MOTOR_CHANNEL_L-1] = MOTOR_POLARITY_L * dutyL;
+	duty[MOTOR_CHANNEL_R-1] = MOTOR_POLARITY_R * dutyR;
+	rc_motor_set_all(duty);
 
 	return;
 }
@@ -0,0 +1,181 @@
+/**
+ * @file rc_benchmark_kalman.c
+ * @example    rc_benchmark_kalman
+ *
+ * @brief      benchmarks the kalman filter update functions and counts heap
+ *             operations per update.
+ *
+ *             The malloc family is interposed in this program so every call
+ *             made by librobotcontrol is counted. After a few warmup steps
+ *             both rc_kalman_update_lin and rc_kalman_update_ekf should
+ *             report 0 heap operations per update since all of their scratch
+ *             space is preallocated in the rc_kalman_t struct.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <rc/time.h>
+#include <rc/math/kalman.h>
+
+#define Nx 4
+#define Ny 2
+#define Nu 2
+#define DT 0.005
+#define WARMUP_STEPS 10
+#define DEFAULT_STEPS 10000
+
+#define TIMER rc_nanos_thread_time()
+
+// glibc's real allocator, we wrap it below to count calls
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void  __libc_free(void* ptr);
+
+static volatile uint64_t heap_ops = 0;
+
+void* malloc(size_t size)
+{
+	heap_ops++;
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size)
+{
+	heap_ops++;
+	return __libc_calloc(nmemb, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+	heap_ops++;
+	return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr)
+{
+	if(ptr!=NULL) heap_ops++;
+	__libc_free(ptr);
+}
+
+
+static void __print_usage(void)
+{
+	printf("\n");
+	printf("-n {steps} number of updates to time, default %d\n", DEFAULT_STEPS);
+	printf("-h         print this help message\n");
+	printf("\n");
+}
+
+
+static void __print_result(const char* name, int steps, uint64_t ops, uint64_t ns)
+{
+	printf("%-22s %8.3f heap ops/update %10.3f us/update\n", name,
+			(double)ops/steps, (double)ns/(steps*1000.0));
+}
+
+
+int main(int argc, char *argv[])
+{
+	int c, i, steps = DEFAULT_STEPS;
+	uint64_t t1, t2, ops;
+
+	rc_kalman_t kf	= RC_KALMAN_INITIALIZER;
+	rc_matrix_t F	= RC_MATRIX_INITIALIZER;
+	rc_matrix_t G	= RC_MATRIX_INITIALIZER;
+	rc_matrix_t H	= RC_MATRIX_INITIALIZER;
+	rc_matrix_t Q	= RC_MATRIX_INITIALIZER;
+	rc_matrix_t R	= RC_MATRIX_INITIALIZER;
+	rc_matrix_t Pi	= RC_MATRIX_INITIALIZER;
+	rc_vector_t u	= RC_VECTOR_INITIALIZER;
+	rc_vector_t y	= RC_VECTOR_INITIALIZER;
+	rc_vector_t h	= RC_VECTOR_INITIALIZER;
+	rc_vector_t x	= RC_VECTOR_INITIALIZER;
+
+	// parse arguments
+	opterr = 0;
+	while ((c = getopt(argc, argv, "n:h")) != -1){
+		switch (c){
+		case 'n':
+			steps = atoi(optarg);
+			if(steps<1){
+				printf("number of steps must be >=1\n");
+				return -1;
+			}
+			break;
+		case 'h':
+			__print_usage();
+			return 0;
+		default:
+			__print_usage();
+			return -1;
+		}
+	}
+
+	// two decoupled double integrators, position measured on each axis
+	rc_matrix_identity(&F, Nx);
+	rc_matrix_zeros(&G, Nx, Nu);
+	rc_matrix_zeros(&H, Ny, Nx);
+	rc_matrix_identity(&Q, Nx);
+	rc_matrix_identity(&R, Ny);
+	rc_matrix_identity(&Pi, Nx);
+	rc_vector_ones(&u, Nu);
+	rc_vector_zeros(&y, Ny);
+	F.d[0][1] = DT;
+	F.d[2][3] = DT;
+	G.d[0][0] = 0.5*DT*DT;
+	G.d[1][0] = DT;
+	G.d[2][1] = 0.5*DT*DT;
+	G.d[3][1] = DT;
+	H.d[0][0] = 1.0;
+	H.d[1][2] = 1.0;
+	rc_matrix_times_scalar(&Q, 0.001);
+	rc_matrix_times_scalar(&Pi, 0.0001);
+
+	// linear filter
+	if(rc_kalman_alloc_lin(&kf,F,G,H,Q,R,Pi)==-1) return -1;
+	for(i=0;i<WARMUP_STEPS;i++) rc_kalman_update_lin(&kf, u, y);
+	ops = heap_ops;
+	t1 = TIMER;
+	for(i=0;i<steps;i++){
+		y.d[0] = 0.001*i;
+		if(rc_kalman_update_lin(&kf, u, y)) return -1;
+	}
+	t2 = TIMER;
+	__print_result("rc_kalman_update_lin", steps, heap_ops-ops, t2-t1);
+
+	// extended filter, same model but predictions are made out here
+	if(rc_kalman_alloc_ekf(&kf,Q,R,Pi)==-1) return -1;
+	rc_vector_zeros(&x, Nx);
+	rc_vector_zeros(&h, Ny);
+	for(i=0;i<WARMUP_STEPS;i++){
+		rc_matrix_times_col_vec(F, kf.x_est, &x);
+		rc_matrix_times_col_vec(H, x, &h);
+		rc_kalman_update_ekf(&kf, F, H, x, y, h);
+	}
+	ops = heap_ops;
+	t1 = TIMER;
+	for(i=0;i<steps;i++){
+		y.d[0] = 0.001*i;
+		rc_matrix_times_col_vec(F, kf.x_est, &x);
+		rc_matrix_times_col_vec(H, x, &h);
+		if(rc_kalman_update_ekf(&kf, F, H, x, y, h)) return -1;
+	}
+	t2 = TIMER;
+	__print_result("rc_kalman_update_ekf", steps, heap_ops-ops, t2-t1);
+
+	rc_matrix_free(&F);
+	rc_matrix_free(&G);
+	rc_matrix_free(&H);
+	rc_matrix_free(&Q);
+	rc_matrix_free(&R);
+	rc_matrix_free(&Pi);
+	rc_vector_free(&u);
+	rc_vector_free(&y);
+	rc_vector_free(&h);
+	rc_vector_free(&x);
+	rc_kalman_free(&kf);
+	return 0;
+}
@@ -0,0 +1,296 @@
+/**
+ * @file rc_test_adc_stream.c
+ * @example    rc_test_adc_stream
+ *
+ * @brief      Streams ADC channels through the IIO buffer.
+ *
+ *             By default this streams all 8 channels from the real ADC and
+ *             prints the frame rate along with the mean voltage of each
+ *             channel once per second.
+ *
+ *             With -f it instead builds a fake IIO device in /tmp with a named
+ *             pipe standing in for the character device, so it runs without
+ *             hardware. A writer thread feeds known frames through the pipe in
+ *             odd sized chunks and every value delivered to the callback is
+ *             checked, along with the channel order and the buffer
+ *             configuration written to the fake sysfs files.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <rc/adc.h>
+#include <rc/time.h>
+
+#define FAKE_FRAMES	100000
+#define FAKE_MASK	0xB5	// channels 0 2 4 5 7
+#define FAKE_CHUNK	1000	// bytes per write, not a whole number of frames
+
+static int running = 0;
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t frames, blocks, errors;
+static double sum[RC_ADC_CHANNELS];
+static char fake_dir[] = "/tmp/rc_test_adc_streamXXXXXX";
+static int fake_fd;
+
+// interrupt handler to catch ctrl-c
+static void __signal_handler(__attribute__ ((unused)) int dummy)
+{
+	running=0;
+	return;
+}
+
+static void __print_usage(void)
+{
+	printf("\n");
+	printf("-f    test against a fake device instead of the real ADC\n");
+	printf("-h    print this help message\n");
+	printf("\n");
+	return;
+}
+
+// value the fake device sends for a frame and channel, fits in 12 bits
+static uint16_t __fake_value(uint64_t frame, int ch)
+{
+	return (frame*RC_ADC_CHANNELS + ch) & 0xFFF;
+}
+
+// sums each channel for the real device, checks every value for the fake one
+static void __block_callback(const rc_adc_block_t* b)
+{
+	int f, c;
+	pthread_mutex_lock(&stats_mutex);
+	for(f=0;f<b->frames;f++){
+		for(c=0;c<b->channels;c++){
+			sum[b->channel[c]] += b->raw[f*b->channels+c];
+			if(fake_fd && b->raw[f*b->channels+c]!=__fake_value(b->first_frame+f, b->channel[c])) errors++;
+		}
+	}
+	frames += b->frames;
+	blocks++;
+	pthread_mutex_unlock(&stats_mutex);
+	return;
+}
+
+static int __write_file(const char* name, const char* val)
+{
+	char path[256];
+	FILE* f;
+	snprintf(path, sizeof(path), "%s/%s", fake_dir, name);
+	f = fopen(path, "w");
+	if(f==NULL){
+		perror("ERROR: failed to create fake device file");
+		return -1;
+	}
+	fputs(val, f);
+	fclose(f);
+	return 0;
+}
+
+static void __read_file(const char* name, char* buf, int len)
+{
+	char path[256];
+	FILE* f;
+	buf[0] = '\0';
+	snprintf(path, sizeof(path), "%s/%s", fake_dir, name);
+	f = fopen(path, "r");
+	if(f==NULL) return;
+	if(fgets(buf, len, f)==NULL) buf[0] = '\0';
+	fclose(f);
+	return;
+}
+
+// feeds frames of the enabled channels through the pipe in scan index order
+static void* __fake_writer(__attribute__ ((unused)) void* ptr)
+{
+	static uint8_t bytes[FAKE_FRAMES*RC_ADC_CHANNELS*2];
+	int n = 0, pos, len, ch;
+	uint64_t f;
+	uint16_t v;
+	for(f=0;f<FAKE_FRAMES;f++){
+		// scan index is 7-ch so frames go from channel 7 down to 0
+		for(ch=RC_ADC_CHANNELS-1;ch>=0;ch--){
+			if(!(FAKE_MASK&(1<<ch))) continue;
+			v = __fake_value(f, ch);
+			bytes[n++] = v&0xFF;
+			bytes[n++] = v>>8;
+		}
+	}
+	for(pos=0;pos<n;pos+=len){
+		len = (n-pos<FAKE_CHUNK) ? n-pos : FAKE_CHUNK;
+		if(write(fake_fd, bytes+pos, len)!=len){
+			perror("ERROR: fake writer failed");
+			return NULL;
+		}
+	}
+	return NULL;
+}
+
+static int __make_fake_device(rc_adc_stream_config_t* conf)
+{
+	char name[64], val[32];
+	static char dev[64];
+	int i;
+	if(mkdtemp(fake_dir)==NULL){
+		perror("ERROR: failed to make fake device directory");
+		return -1;
+	}
+	snprintf(name, sizeof(name), "%s/scan_elements", fake_dir);
+	mkdir(name, 0755);
+	snprintf(name, sizeof(name), "%s/buffer", fake_dir);
+	mkdir(name, 0755);
+	for(i=0;i<RC_ADC_CHANNELS;i++){
+		snprintf(name, sizeof(name), "scan_elements/in_voltage%d_en", i);
+		if(__write_file(name, "0")) return -1;
+		snprintf(name, sizeof(name), "scan_elements/in_voltage%d_index", i);
+		snprintf(val, sizeof(val), "%d\n", RC_ADC_CHANNELS-1-i);
+		if(__write_file(name, val)) return -1;
+		snprintf(name, sizeof(name), "scan_elements/in_voltage%d_type", i);
+		if(__write_file(name, "le:u12/16>>0\n")) return -1;
+	}
+	if(__write_file("buffer/enable", "0")) return -1;
+	if(__write_file("buffer/length", "0")) return -1;
+	if(__write_file("buffer/watermark", "1")) return -1;
+	snprintf(dev, sizeof(dev), "%s/dev", fake_dir);
+	if(mkfifo(dev, 0600)){
+		perror("ERROR: failed to make fake device pipe");
+		return -1;
+	}
+	// read-write so opening doesn't block and the reader never sees a hangup
+	fake_fd = open(dev, O_RDWR);
+	if(fake_fd==-1){
+		perror("ERROR: failed to open fake device pipe");
+		return -1;
+	}
+	conf->sysfs_dir = fake_dir;
+	conf->dev_path = dev;
+	conf->channel_mask = FAKE_MASK;
+	return 0;
+}
+
+static int __check_file(const char* name, const char* expected)
+{
+	char buf[32];
+	__read_file(name, buf, sizeof(buf));
+	if(strcmp(buf, expected)){
+		printf("FAIL %-30s is \"%s\", expected \"%s\"\n", name, buf, expected);
+		return 1;
+	}
+	printf("pass %-30s %s\n", name, buf);
+	return 0;
+}
+
+static int __run_fake(rc_adc_stream_config_t conf)
+{
+	int i, failures = 0;
+	uint64_t n;
+	pthread_t writer;
+	char name[64];
+
+	printf("Let's test ADC streaming on a fake device....\n\n");
+	if(__make_fake_device(&conf)) return -1;
+	if(rc_adc_stream_start(conf, __block_callback)){
+		fprintf(stderr,"ERROR: rc_adc_stream_start failed\n");
+		return -1;
+	}
+	failures += __check_file("buffer/enable", "1");
+	failures += __check_file("buffer/length", "1024");
+	failures += __check_file("buffer/watermark", "64");
+	for(i=0;i<RC_ADC_CHANNELS;i++){
+		snprintf(name, sizeof(name), "scan_elements/in_voltage%d_en", i);
+		failures += __check_file(name, (FAKE_MASK&(1<<i)) ? "1" : "0");
+	}
+
+	pthread_create(&writer, NULL, __fake_writer, NULL);
+	// wait up to 5 seconds for everything to come through
+	for(i=0;i<500;i++){
+		pthread_mutex_lock(&stats_mutex);
+		n = frames;
+		pthread_mutex_unlock(&stats_mutex);
+		if(n>=FAKE_FRAMES) break;
+		rc_usleep(10000);
+	}
+	pthread_join(writer, NULL);
+	rc_adc_stream_stop();
+	failures += __check_file("buffer/enable", "0");
+
+	if(frames!=FAKE_FRAMES){
+		printf("FAIL received %llu frames, expected %d\n", (unsigned long long)frames, FAKE_FRAMES);
+		failures++;
+	}
+	else printf("pass received %d frames in %llu blocks\n", FAKE_FRAMES, (unsigned long long)blocks);
+	if(errors){
+		printf("FAIL %llu values differ from what was sent\n", (unsigned long long)errors);
+		failures++;
+	}
+	else printf("pass every value matches what was sent\n");
+
+	close(fake_fd);
+	snprintf(name, sizeof(name), "rm -r %s", fake_dir);
+	if(system(name)) fprintf(stderr,"WARNING: failed to remove %s\n", fake_dir);
+
+	if(failures){
+		printf("\n%d tests FAILED\n", failures);
+		return -1;
+	}
+	printf("\nall tests passed\n");
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int c, ch, fake = 0;
+	uint64_t n;
+	double mean[RC_ADC_CHANNELS];
+	rc_adc_stream_config_t conf = rc_adc_stream_default_config();
+
+	// parse arguments
+	opterr = 0;
+	while((c=getopt(argc, argv, "fh"))!=-1){
+		switch(c){
+		case 'f':
+			fake = 1;
+			break;
+		case 'h':
+			__print_usage();
+			return 0;
+		default:
+			__print_usage();
+			return -1;
+		}
+	}
+	if(fake) return __run_fake(conf);
+
+	// set signal handler so the loop can exit cleanly
+	signal(SIGINT, __signal_handler);
+	running = 1;
+
+	if(rc_adc_stream_start(conf, __block_callback)){
+		fprintf(stderr,"ERROR: rc_adc_stream_start failed\n");
+		return -1;
+	}
+	printf(" frames/s | mean volts of each channel over the last second\n");
+	while(running){
+		rc_usleep(1000000);
+		pthread_mutex_lock(&stats_mutex);
+		n = frames;
+		for(ch=0;ch<RC_ADC_CHANNELS;ch++){
+			mean[ch] = n ? sum[ch]*1.8/4095.0/n : 0.0;
+			sum[ch] = 0.0;
+		}
+		frames = 0;
+		pthread_mutex_unlock(&stats_mutex);
+		printf("\r%9llu |", (unsigned long long)n);
+		for(ch=0;ch<RC_ADC_CHANNELS;ch++) printf(" %5.3f", mean[ch]);
+		fflush(stdout);
+	}
+	rc_adc_stream_stop();
+	printf("\n");
+	return 0;
+}
@@ -14,6 +14,8 @@
 
 int main()
 {
+	int i;
+	double rcond;
 	rc_matrix_t A	= RC_MATRIX_INITIALIZER;
 	rc_matrix_t Ainv= RC_MATRIX_INITIALIZER;
 	rc_matrix_t AA	= RC_MATRIX_INITIALIZER;
@@ -22,6 +24,7 @@ int main()
 	rc_matrix_t P	= RC_MATRIX_INITIALIZER;
 	rc_matrix_t Q	= RC_MATRIX_INITIALIZER;
 	rc_matrix_t R	= RC_MATRIX_INITIALIZER;
+	rc_matrix_t S	= RC_MATRIX_INITIALIZER;
 	rc_vector_t b	= RC_VECTOR_INITIALIZER;
 	rc_vector_t x	= RC_VECTOR_INITIALIZER;
 	rc_vector_t y	= RC_VECTOR_INITIALIZER;
@@ -49,6 +52,15 @@ int main()
 	rc_algebra_invert_matrix_inplace(&Ainv);
 	rc_matrix_print(Ainv);
 
+	// invert with a condition estimate, then try a nearly singular matrix
+	rc_algebra_invert_matrix_rcond(A,&Ainv,&rcond);
+	printf("\nreciprocal condition number of A: %g\n", rcond);
+	rc_matrix_duplicate(A,&AA);
+	for(i=0;i<DIM;i++) AA.d[DIM-1][i] = AA.d[0][i];
+	AA.d[DIM-1][0] += 1e-6;
+	rc_algebra_invert_matrix_rcond(AA,&Ainv,&rcond);
+	printf("reciprocal condition number with nearly repeated row: %g\n", rcond);
+
 	// do an LUP decomposition on A
 	printf("\nLUP decomposition of A\n");
 	rc_algebra_lup_decomp(A,&L,&U,&P);
@@ -80,6 +92,39 @@ int main()
 	rc_algebra_lin_system_solve_qr(A,b,&y);
 	rc_vector_print(y);
 
+	// make a symmetric positive-definite matrix S = A*A^T + I
+	printf("\nSymmetric positive-definite matrix S=A*A^T+I:\n");
+	rc_matrix_transpose(A,&AA);
+	rc_matrix_multiply(A,AA,&S);
+	for(i=0;i<DIM;i++) S.d[i][i] += 1.0;
+	rc_matrix_print(S);
+
+	// cholesky decomposition of S
+	printf("\nCholesky decomposition L of S:\n");
+	rc_algebra_cholesky_decomp(S,&L);
+	rc_matrix_print(L);
+	printf("L times L^T, should be S:\n");
+	rc_matrix_transpose(L,&AA);
+	rc_matrix_left_multiply_inplace(L,&AA);
+	rc_matrix_print(AA);
+
+	// solve with the cholesky factor, should match gaussian elimination
+	printf("\nCholesky solution x to the equation Sx=b:\n");
+	rc_algebra_cholesky_solve(L,b,&x);
+	rc_vector_print(x);
+	printf("Gaussian Elimination solution for comparison:\n");
+	rc_algebra_lin_system_solve(S,b,&y);
+	rc_vector_print(y);
+
+	// SPD inverse, should match LUP inverse
+	printf("\nS inverted in place with Cholesky method:\n");
+	rc_matrix_duplicate(S,&Ainv);
+	rc_algebra_invert_spd_inplace(&Ainv);
+	rc_matrix_print(Ainv);
+	printf("LUP inverse for comparison:\n");
+	rc_algebra_invert_matrix(S,&AA);
+	rc_matrix_print(AA);
+
 	// free memory
 	rc_matrix_free(&A);
 	rc_matrix_free(&Ainv);
@@ -89,6 +134,7 @@ int main()
 	rc_matrix_free(&P);
 	rc_matrix_free(&Q);
 	rc_matrix_free(&R);
+	rc_matrix_free(&S);
 	rc_vector_free(&b);
 	rc_vector_free(&x);
 	rc_vector_free(&y);
@@ -0,0 +1,220 @@
+/**
+ * @example    rc_test_biquad.c
+ *
+ * @brief      Tests the biquad cascade filters in rc/math/biquad.h against the
+ *             equivalent polynomial rc_filter_t filters and times both.
+ *
+ *             Butterworth designs are checked against the exact analytic
+ *             magnitude response of a prewarped Butterworth filter. The error
+ *             of the polynomial rc_filter_t version is printed alongside to
+ *             show how it degrades with order. Filters that are well
+ *             conditioned in polynomial form are also fed the same chirp as
+ *             their rc_filter_t equivalent and the largest difference between
+ *             the outputs is reported relative to the largest output.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <complex.h>
+#include <rc/math.h>
+#include <rc/time.h>
+
+#define DT		0.001	// 1khz like the IMU
+#define STEPS		20000
+#define TOL		1e-8	// maximum acceptable relative difference
+#define TIMING_STEPS	1000000
+
+static int failures = 0;
+
+// frequency response of a polynomial transfer function at z
+static double complex __poly_response(rc_filter_t f, double complex z)
+{
+	int i;
+	double complex n = 0.0, d = 0.0;
+	for(i=0;i<f.num.len;i++) n = n*z + f.num.d[i];
+	for(i=0;i<f.den.len;i++) d = d*z + f.den.d[i];
+	// line up the numerator with the denominator for proper filters
+	for(i=f.num.len;i<f.den.len;i++) n = n/z;
+	return f.gain*n/d;
+}
+
+// frequency response of a biquad cascade at z
+static double complex __biquad_response(rc_biquad_t b, double complex z)
+{
+	int i;
+	double complex h = 1.0;
+	double complex zi = 1.0/z;
+	for(i=0;i<b.sections;i++){
+		h *= (b.b0[i] + b.b1[i]*zi + b.b2[i]*zi*zi)/(1.0 + b.a1[i]*zi + b.a2[i]*zi*zi);
+	}
+	return h;
+}
+
+// checks the magnitude response of butterworth filters against the exact
+// response of a bilinear transformed butterworth prewarped at wc
+static void __check_butterworth(const char* name, rc_filter_t f, rc_biquad_t b, int order, double wc, int highpass, double tol)
+{
+	int i;
+	double w, r, ideal, err1 = 0.0, err2 = 0.0;
+	double complex z;
+	double K = tan(wc*DT/2.0);
+	for(i=1;i<500;i++){
+		w = i*M_PI/(500.0*DT);
+		z = cexp((double complex)I*w*DT);
+		r = tan(w*DT/2.0)/K;
+		if(highpass) r = 1.0/r;
+		ideal = 1.0/sqrt(1.0+pow(r,2*order));
+		if(fabs(cabs(__poly_response(f,z))-ideal)>err1) err1=fabs(cabs(__poly_response(f,z))-ideal);
+		if(fabs(cabs(__biquad_response(b,z))-ideal)>err2) err2=fabs(cabs(__biquad_response(b,z))-ideal);
+	}
+	if(err2>tol){
+		printf("FAIL %-34s biquad error %e polynomial error %e\n", name, err2, err1);
+		failures++;
+	}
+	else printf("pass %-34s biquad error %e polynomial error %e\n", name, err2, err1);
+}
+
+// input signal, chirp from 0 to 200hz with an offset
+static double __input(int i)
+{
+	double t = i*DT;
+	return 0.5 + sin(2.0*M_PI*(5.0*t*t)*200.0/(STEPS*DT*5.0));
+}
+
+// runs both filters over the same input and compares the outputs
+static void __check(const char* name, rc_filter_t* f, rc_biquad_t* b)
+{
+	int i;
+	double y1, y2, err = 0.0, max = 0.0;
+	rc_filter_reset(f);
+	rc_biquad_reset(b);
+	for(i=0;i<STEPS;i++){
+		y1 = rc_filter_march(f, __input(i));
+		y2 = rc_biquad_march(b, __input(i));
+		if(fabs(y1-y2)>err) err=fabs(y1-y2);
+		if(fabs(y1)>max) max=fabs(y1);
+	}
+	err = err/max;
+	if(err>TOL){
+		printf("FAIL %-34s relative error %e\n", name, err);
+		failures++;
+	}
+	else printf("pass %-34s relative error %e\n", name, err);
+}
+
+int main()
+{
+	int i, order;
+	double err;
+	char name[64];
+	uint64_t t1, t2, t3;
+	volatile double sink;
+	double wc = 2.0*M_PI*20.0;
+	rc_filter_t f	= RC_FILTER_INITIALIZER;
+	rc_filter_t f2	= RC_FILTER_INITIALIZER;
+	rc_biquad_t b	= RC_BIQUAD_INITIALIZER;
+	rc_biquad_t b2	= RC_BIQUAD_INITIALIZER;
+
+	printf("Let's test some biquad filters....\n\n");
+
+	// butterworth designed directly as sections vs the exact response
+	for(order=1;order<=8;order++){
+		rc_filter_butterworth_lowpass(&f, order, DT, wc);
+		rc_biquad_butterworth_lowpass(&b, order, DT, wc);
+		sprintf(name, "butterworth_lowpass order %d", order);
+		__check_butterworth(name, f, b, order, wc, 0, TOL);
+	}
+	// the polynomial highpass has a passband gain of wc^order
+	for(order=1;order<=8;order++){
+		rc_filter_butterworth_highpass(&f, order, DT, wc);
+		f.gain = 1.0/pow(wc, order);
+		rc_biquad_butterworth_highpass(&b, order, DT, wc);
+		sprintf(name, "butterworth_highpass order %d", order);
+		__check_butterworth(name, f, b, order, wc, 1, TOL);
+	}
+	// a converted filter can only be as good as the polynomial it came from,
+	// root finding amplifies its coefficient error a little further
+	rc_filter_butterworth_lowpass(&f, 8, DT, wc);
+	rc_biquad_from_filter(&b, f);
+	__check_butterworth("from_filter lowpass order 8", f, b, 8, wc, 0, 1e-5);
+	printf("\n");
+
+	// conversions from existing polynomial filters in the time domain
+	for(order=1;order<=5;order++){
+		rc_filter_butterworth_lowpass(&f, order, DT, wc);
+		rc_biquad_from_filter(&b, f);
+		sprintf(name, "from_filter lowpass order %d", order);
+		__check(name, &f, &b);
+	}
+	rc_filter_butterworth_highpass(&f, 3, DT, wc);
+	rc_biquad_from_filter(&b, f);
+	__check("from_filter highpass order 3", &f, &b);
+	rc_filter_first_order_lowpass(&f, DT, 0.05);
+	rc_biquad_from_filter(&b, f);
+	__check("from_filter first_order_lowpass", &f, &b);
+	rc_filter_moving_average(&f, 5, DT);
+	rc_biquad_from_filter(&b, f);
+	__check("from_filter moving_average", &f, &b);
+	rc_filter_integrator(&f, DT);
+	rc_biquad_from_filter(&b, f);
+	__check("from_filter integrator", &f, &b);
+	rc_filter_double_integrator(&f, DT);
+	rc_biquad_from_filter(&b, f);
+	__check("from_filter double_integrator", &f, &b);
+	rc_filter_pid(&f, 1.0, 0.5, 0.01, 0.01, DT);
+	rc_biquad_from_filter(&b, f);
+	__check("from_filter pid", &f, &b);
+
+	// complementary filters have a triple pole, check they still sum to 1
+	rc_filter_third_order_complement(&f, &f2, 2.0, 1.0, DT);
+	rc_biquad_from_filter(&b, f);
+	rc_biquad_from_filter(&b2, f2);
+	err = 0.0;
+	for(i=0;i<STEPS;i++){
+		sink = rc_biquad_march(&b, __input(i)) + rc_biquad_march(&b2, __input(i));
+		if(fabs(sink-__input(i))>err) err = fabs(sink-__input(i));
+	}
+	if(err>TOL){
+		printf("FAIL %-34s error %e\n", "from_filter third_order_complement", err);
+		failures++;
+	}
+	else printf("pass %-34s error %e\n", "from_filter third_order_complement", err);
+
+	// saturation must behave like the polynomial filter's
+	rc_filter_pid(&f, 1.0, 50.0, 0.0, DT, DT);
+	rc_filter_enable_saturation(&f, -0.7, 0.7);
+	rc_biquad_from_filter(&b, f);
+	__check("from_filter saturated pi", &f, &b);
+
+	// prefill should leave the lowpass sitting at the input
+	rc_biquad_butterworth_lowpass(&b, 6, DT, wc);
+	rc_biquad_prefill(&b, 3.0);
+	sink = rc_biquad_march(&b, 3.0);
+	if(fabs(sink-3.0)>1e-9){
+		printf("FAIL rc_biquad_prefill output %f instead of 3.0\n", sink);
+		failures++;
+	}
+	else printf("pass rc_biquad_prefill\n");
+
+	// time 6th order lowpass in both forms
+	rc_filter_butterworth_lowpass(&f, 6, DT, wc);
+	rc_biquad_butterworth_lowpass(&b2, 6, DT, wc);
+	t1 = rc_nanos_thread_time();
+	for(i=0;i<TIMING_STEPS;i++) sink = rc_filter_march(&f, __input(i));
+	t2 = rc_nanos_thread_time();
+	for(i=0;i<TIMING_STEPS;i++) sink = rc_biquad_march(&b2, __input(i));
+	t3 = rc_nanos_thread_time();
+	printf("\n6th order lowpass rc_filter_march: %6.1fns/step\n", (double)(t2-t1)/TIMING_STEPS);
+	printf("6th order lowpass rc_biquad_march: %6.1fns/step\n", (double)(t3-t2)/TIMING_STEPS);
+	(void)sink;
+
+	rc_filter_free(&f);
+	rc_filter_free(&f2);
+
+	if(failures){
+		printf("\n%d tests FAILED\n", failures);
+		return -1;
+	}
+	printf("\nall tests passed\n");
+	return 0;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file rc_test_encoder_speed.c
+ * @example    rc_test_encoder_speed
+ *
+ * @brief      Prints the position and estimated velocity of encoder channels
+ *             1-4 from the background speed estimator.
+ *
+ *             Turn an encoder slowly by hand to see the velocity stay smooth
+ *             where differencing the position every millisecond would only give
+ *             single count spikes. Run with -c as root to use the eQEP capture
+ *             unit for channels 1-3 at low speed.
+ */
+
+#include <stdio.h>
+#include <signal.h>
+#include <getopt.h>
+#include <rc/encoder.h>
+#include <rc/time.h>
+
+static int running = 0;
+
+// interrupt handler to catch ctrl-c
+static void __signal_handler(__attribute__ ((unused)) int dummy)
+{
+	running=0;
+	return;
+}
+
+static void __print_usage(void)
+{
+	printf("\n");
+	printf("-c    use the eQEP capture unit for channels 1-3, needs root\n");
+	printf("-h    print this help message\n");
+	printf("\n");
+	return;
+}
+
+int main(int argc, char *argv[])
+{
+	int c, i;
+	rc_encoder_speed_t speed;
+	rc_encoder_speed_config_t conf = rc_encoder_speed_default_config();
+
+	// parse arguments
+	opterr = 0;
+	while((c=getopt(argc, argv, "ch"))!=-1){
+		switch(c){
+		case 'c':
+			conf.eqep_capture = 1;
+			break;
+		case 'h':
+			__print_usage();
+			return 0;
+		default:
+			__print_usage();
+			return -1;
+		}
+	}
+
+	// initialize hardware first
+	if(rc_encoder_init()){
+		fprintf(stderr,"ERROR: failed to run rc_encoder_init\n");
+		return -1;
+	}
+	if(rc_encoder_speed_start(conf)){
+		fprintf(stderr,"ERROR: failed to run rc_encoder_speed_start\n");
+		rc_encoder_cleanup();
+		return -1;
+	}
+
+	// set signal handler so the loop can exit cleanly
+	signal(SIGINT, __signal_handler);
+	running=1;
+
+	printf("\nposition and velocity (counts/s) at %dhz\n", conf.rate_hz);
+	printf("           E1        |           E2        |");
+	printf("           E3        |           E4        |\n");
+
+	while(running){
+		if(rc_encoder_speed_read(&speed)==1){
+			printf("\r");
+			for(i=0;i<RC_ENCODER_CHANNELS;i++){
+				printf("%8d %10.1f |", speed.position[i], speed.velocity[i]);
+			}
+			fflush(stdout);
+		}
+		rc_usleep(50000);
+	}
+	printf("\n");
+
+	rc_encoder_speed_stop();
+	rc_encoder_cleanup();
+	return 0;
+}
@@ -0,0 +1,163 @@
+/**
+ * @file rc_test_encoders_eqep_mmap.c
+ * @example    rc_test_encoders_eqep_mmap
+ *
+ * @brief      Tests the memory mapped eQEP backend against a fake register
+ *             file so it can run without hardware.
+ *
+ *             A temporary file stands in for the 3 PWMSS register blocks.
+ *             Positions written to the fake QPOSCNT registers are read back
+ *             through rc_encoder_eqep_read and the other way around, then
+ *             latched positions and capture periods are planted to check both
+ *             hardware velocity measurements. Finally the time per
+ *             rc_encoder_eqep_read call is printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <rc/encoder_eqep.h>
+#include <rc/time.h>
+
+#define FILE_LEN	0x6000
+#define SS_STRIDE	0x2000
+#define EQEP		0x180
+#define QPOSCNT		(EQEP+0x00)
+#define QPOSLAT		(EQEP+0x18)
+#define QUPRD		(EQEP+0x20)
+#define QEPCTL		(EQEP+0x2A)
+#define QCAPCTL		(EQEP+0x2C)
+#define QFLG		(EQEP+0x32)
+#define QEPSTS		(EQEP+0x38)
+#define QCPRDLAT	(EQEP+0x40)
+#define UTO		(1<<11)
+#define QDF		(1<<5)
+#define COEF		(1<<3)
+#define TIMING_REPS	1000000
+
+static int fd;
+
+static uint32_t __read_reg(int ch, int reg, int bytes)
+{
+	uint32_t val = 0;
+	if(pread(fd, &val, bytes, (ch-1)*SS_STRIDE+reg)!=bytes) return 0xDEAD;
+	return val;
+}
+
+static void __write_reg(int ch, int reg, uint32_t val, int bytes)
+{
+	if(pwrite(fd, &val, bytes, (ch-1)*SS_STRIDE+reg)!=bytes) perror("pwrite");
+}
+
+static int __check_int(const char* name, int ch, long got, long expected)
+{
+	if(got!=expected){
+		printf("FAIL ch%d %-30s got %ld expected %ld\n", ch, name, got, expected);
+		return 1;
+	}
+	printf("pass ch%d %-30s %ld\n", ch, name, got);
+	return 0;
+}
+
+static int __check_double(const char* name, int ch, double got, double expected)
+{
+	if(fabs(got-expected)>1e-6*fabs(expected)+1e-9){
+		printf("FAIL ch%d %-30s got %f expected %f\n", ch, name, got, expected);
+		return 1;
+	}
+	printf("pass ch%d %-30s %f\n", ch, name, got);
+	return 0;
+}
+
+int main()
+{
+	int i, ch, failures = 0;
+	volatile int sink = 0;
+	uint64_t t1, t2;
+	char path[] = "/tmp/rc_test_eqep_mmapXXXXXX";
+	rc_encoder_eqep_velocity_t v;
+
+	printf("Let's test the mmap eQEP backend on a fake register file....\n\n");
+
+	fd = mkstemp(path);
+	if(fd==-1 || ftruncate(fd, FILE_LEN)){
+		perror("ERROR: failed to create register file");
+		return -1;
+	}
+	if(rc_encoder_eqep_set_mmap_file(path)) return -1;
+	if(rc_encoder_eqep_enable_mmap()){
+		fprintf(stderr,"ERROR: rc_encoder_eqep_enable_mmap failed\n");
+		return -1;
+	}
+
+	// positions in both directions
+	__write_reg(1, QPOSCNT, 12345, 4);
+	__write_reg(2, QPOSCNT, (uint32_t)-678, 4);
+	__write_reg(3, QPOSCNT, 0x7FFFFFFF, 4);
+	failures += __check_int("read positive", 1, rc_encoder_eqep_read(1), 12345);
+	failures += __check_int("read negative", 2, rc_encoder_eqep_read(2), -678);
+	failures += __check_int("read max", 3, rc_encoder_eqep_read(3), 0x7FFFFFFF);
+	rc_encoder_eqep_write(2, -5);
+	failures += __check_int("write", 2, (int)__read_reg(2, QPOSCNT, 4), -5);
+
+	// 1ms unit timer, 4 counts per capture, capture clock 100MHz/128
+	for(ch=1;ch<=3;ch++){
+		if(rc_encoder_eqep_config_velocity(ch, 1000, 2, 7)) failures++;
+	}
+	failures += __check_int("QUPRD", 1, __read_reg(1, QUPRD, 4), 100000);
+	failures += __check_int("QCAPCTL", 1, __read_reg(1, QCAPCTL, 2), 0x8000|(7<<4)|2);
+	failures += __check_int("QEPCTL UTE and QCLM", 1, __read_reg(1, QEPCTL, 2)&0x6, 0x6);
+
+	// no time out yet
+	rc_encoder_eqep_read_velocity(1, &v);
+	failures += __check_int("no latch yet", 1, v.new_latch, 0);
+
+	// two latches 100 counts apart moving forward, 4 counts took 7812 ticks
+	__write_reg(1, QFLG, UTO, 2);
+	__write_reg(1, QPOSLAT, 1000, 4);
+	__write_reg(1, QEPSTS, QDF, 2);
+	__write_reg(1, QCPRDLAT, 7812, 2);
+	rc_encoder_eqep_read_velocity(1, &v);
+	failures += __check_int("first latch", 1, v.new_latch, 1);
+	failures += __check_double("first unit_rate", 1, v.unit_rate, 0.0);
+	// a read writes 1s to the status flags to clear them, which a plain file
+	// keeps, so plant the status again before every read
+	__write_reg(1, QPOSLAT, 1100, 4);
+	__write_reg(1, QEPSTS, QDF, 2);
+	rc_encoder_eqep_read_velocity(1, &v);
+	failures += __check_int("latched position", 1, v.position, 1100);
+	failures += __check_double("unit_rate", 1, v.unit_rate, 100000.0);
+	failures += __check_int("period_valid", 1, v.period_valid, 1);
+	failures += __check_double("period_rate", 1, v.period_rate, 4.0*100e6/128/7812);
+
+	// moving backwards, then too slow for the capture timer
+	__write_reg(2, QFLG, UTO, 2);
+	__write_reg(2, QCPRDLAT, 500, 2);
+	__write_reg(2, QEPSTS, 0, 2);
+	rc_encoder_eqep_read_velocity(2, &v);
+	failures += __check_double("reverse period_rate", 2, v.period_rate, -4.0*100e6/128/500);
+	__write_reg(2, QEPSTS, COEF, 2);
+	rc_encoder_eqep_read_velocity(2, &v);
+	failures += __check_int("overflow period_valid", 2, v.period_valid, 0);
+	failures += __check_double("overflow period_rate", 2, v.period_rate, 0.0);
+
+	// time the mapped read
+	t1 = rc_nanos_thread_time();
+	for(i=0;i<TIMING_REPS;i++) sink += rc_encoder_eqep_read(1+i%3);
+	t2 = rc_nanos_thread_time();
+	printf("\nrc_encoder_eqep_read through mmap: %5.1fns/call\n", (double)(t2-t1)/TIMING_REPS);
+
+	rc_encoder_eqep_disable_mmap();
+	rc_encoder_eqep_set_mmap_file(NULL);
+	close(fd);
+	unlink(path);
+
+	if(failures){
+		printf("\n%d tests FAILED\n", failures);
+		return -1;
+	}
+	printf("\nall tests passed\n");
+	return 0;
+}
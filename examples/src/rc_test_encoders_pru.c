@@ -5,7 +5,8 @@
  *
  * Prints out current quadrature position for channel 4 which is counted
  * using the PRU. Channels 1-3 are counted by the eQEP modules, test those with
- * rc_test_encoders_eqep instead.
+ * rc_test_encoders_eqep instead. The rate column is worked out from the PRU
+ * timestamps of the edges seen in consecutive samples.
  */
 
 #include <stdio.h>
@@ -24,6 +25,9 @@ static void __signal_handler(__attribute__ ((unused)) int dummy)
 
 int main()
 {
+	double rate = 0.0;
+	rc_encoder_pru_sample_t s, last;
+
 	// initialize hardware first
 	if(rc_encoder_pru_init()){
 		fprintf(stderr,"ERROR: failed to run rc_encoder_pru_init\n");
@@ -35,11 +39,19 @@ int main()
 	running=1;
 
 	printf("\nRaw encoder position\n");
-	printf("      E4   |");
+	printf("      E4   | rate (counts/s) |");
 	printf(" \n");
 
+	if(rc_encoder_pru_read_sample(&last)) return -1;
 	while(running){
-		printf("\r%10d |", rc_encoder_pru_read());
+		if(rc_encoder_pru_read_sample(&s)) break;
+		// ticks are only subtracted as uint32_t so a timer wrap doesn't matter
+		if(s.generation!=last.generation && s.ticks!=last.ticks){
+			rate = (s.position-last.position)*(double)RC_ENCODER_PRU_TICKS_PER_SEC/(uint32_t)(s.ticks-last.ticks);
+		}
+		else rate = 0.0;
+		last = s;
+		printf("\r%10d | %15.1f |", s.position, rate);
 		fflush(stdout);
 		rc_usleep(50000);
 	}
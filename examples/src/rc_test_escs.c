@@ -25,6 +25,9 @@
  * described below. This also uses the rc_servo_send_pulse_normalized()
  * function.
  *
+ * With the -l option pulses are latched with the rc_servo_set_* functions
+ * instead and the PRU repeats them at the given frequency by itself. The main
+ * loop then only updates the widths.
  *
  *
  * @author     James Strawson
@@ -40,6 +43,7 @@
 #include <rc/servo.h>
 
 static int running = 0;
+static int latched_en = 0;	// set to 1 to let the PRU repeat pulses
 
 typedef enum test_mode_t{
 	DISABLED,
@@ -70,6 +74,7 @@ static void __print_usage(void)
 	printf("                default is 3.0,-0.1 if this option is not given.\n");
 	printf("                Use -p 3,0.0 for DJI ESCs.\n");
 	printf(" -d             Disable the wakeup period for ESCs which do not require it\n");
+	printf(" -l             Latch widths and let the PRU repeat pulses at -f {hz}\n");
 	printf("\n");
 	printf("sample use to control blheli ESC channel 2 with DSM radio channel 1:\n");
 	printf("   rc_test_escs -c 2 -r 1\n\n");
@@ -86,6 +91,17 @@ static void __signal_handler(__attribute__ ((unused)) int dummy)
 	return;
 }
 
+// sends or latches a throttle depending on the mode
+static int __throttle(int ch, double thr, int oneshot_en)
+{
+	if(latched_en){
+		if(oneshot_en) return rc_servo_set_oneshot_pulse_normalized(ch,thr);
+		return rc_servo_set_esc_pulse_normalized(ch,thr);
+	}
+	if(oneshot_en) return rc_servo_send_oneshot_pulse_normalized(ch,thr);
+	return rc_servo_send_esc_pulse_normalized(ch,thr);
+}
+
 int main(int argc, char *argv[])
 {
 	int c,i,ret;		// misc variables
@@ -110,7 +126,7 @@ int main(int argc, char *argv[])
 
 	// parse arguments
 	opterr = 0;
-	while ((c = getopt(argc, argv, "c:f:t:ow:s:r:hdp:m:")) != -1){
+	while ((c = getopt(argc, argv, "c:f:t:ow:s:r:hdp:m:l")) != -1){
 		switch(c){
 		// channel option
 		case 'c':
@@ -213,6 +229,11 @@ int main(int argc, char *argv[])
 			wakeup_en = 0;
 			break;
 
+		// latched continuous mode
+		case 'l':
+			latched_en = 1;
+			break;
+
 		// min/max option
 		case 'm':
 			ret = sscanf(optarg, "%d,%d", &min_us, &max_us);
@@ -262,6 +283,10 @@ int main(int argc, char *argv[])
 	if(rc_servo_init()) return -1;
 	if(rc_servo_set_esc_range(min_us,max_us)) return -1;
 	rc_servo_power_rail_en(0);
+	if(latched_en){
+		if(rc_servo_set_esc_pulse_normalized(ch,wakeup_en?wakeup_val:-0.1)) return -1;
+		if(rc_servo_start_continuous(frequency_hz)) return -1;
+	}
 
 	// wait for radio to start
 	if(mode==RADIO){
@@ -280,7 +305,9 @@ int main(int argc, char *argv[])
 		printf("waking ESC up from idle for 3 seconds\n");
 		for(i=0;i<=frequency_hz*wakeup_s;i++){
 			if(running==0) return 0;
-			if(rc_servo_send_esc_pulse_normalized(ch,wakeup_val)==-1) return -1;
+			if(latched_en) ret = rc_servo_set_esc_pulse_normalized(ch,wakeup_val);
+			else ret = rc_servo_send_esc_pulse_normalized(ch,wakeup_val);
+			if(ret==-1) return -1;
 			rc_usleep(1000000/frequency_hz);
 		}
 		printf("done with wakeup period\n");
@@ -292,12 +319,12 @@ int main(int argc, char *argv[])
 		switch(mode){
 
 		case NORM:
-			if(oneshot_en) rc_servo_send_oneshot_pulse_normalized(ch,thr);
-			else rc_servo_send_esc_pulse_normalized(ch,thr);
+			__throttle(ch,thr,oneshot_en);
 			break;
 
 		case WIDTH:
-			rc_servo_send_pulse_us(ch,width_us);
+			if(latched_en) rc_servo_set_pulse_us(ch,width_us);
+			else rc_servo_send_pulse_us(ch,width_us);
 			break;
 
 		case SWEEP:
@@ -315,15 +342,13 @@ int main(int argc, char *argv[])
 				dir = 1;
 			}
 			// send result
-			if(oneshot_en) rc_servo_send_oneshot_pulse_normalized(ch,thr);
-			else rc_servo_send_esc_pulse_normalized(ch,thr);
+			__throttle(ch,thr,oneshot_en);
 			break;
 
 		case RADIO:
 			dsm_nanos = rc_dsm_nanos_since_last_packet();
 			if(dsm_nanos > 200000000){
-				if(oneshot_en) rc_servo_send_oneshot_pulse_normalized(ch,0);
-				else rc_servo_send_esc_pulse_normalized(ch,0);
+				__throttle(ch,0,oneshot_en);
 				printf("\rSeconds since last DSM packet: %.2f              ", dsm_nanos/1000000000.0);
 			}
 			else{
@@ -333,8 +358,7 @@ int main(int argc, char *argv[])
 				if(thr > 1.0) thr=1.0;
 
 				// send pulse
-				if(oneshot_en) rc_servo_send_oneshot_pulse_normalized(ch,thr);
-				else rc_servo_send_esc_pulse_normalized(ch,thr);
+				__throttle(ch,thr,oneshot_en);
 
 				// print info
 				printf("\r");// keep printing on same line
@@ -359,9 +383,9 @@ int main(int argc, char *argv[])
 	}
 
 	// cleanup
-	if(oneshot_en) rc_servo_send_oneshot_pulse_normalized(ch,-0.1);
-	else rc_servo_send_esc_pulse_normalized(ch,-0.1);
+	__throttle(ch,-0.1,oneshot_en);
 	rc_usleep(50000);
+	if(latched_en) rc_servo_stop_continuous();
 	rc_servo_cleanup();
 	rc_dsm_cleanup();
 	printf("\n");
@@ -0,0 +1,104 @@
+/**
+ * @example    rc_test_filter_bank.c
+ *
+ * @brief      Tests rc_filter_bank_t against a set of individual rc_filter_t
+ *             filters with the same coefficients and times both.
+ *
+ *             The setup mimics a typical robot: 3 gyro, 3 accel and 3 mag axes
+ *             plus 4 motor currents all through the same lowpass filter. The
+ *             motor current channels are saturated and one channel is reset
+ *             halfway through to check channels stay independent.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <rc/math.h>
+#include <rc/time.h>
+
+#define CHANNELS	13
+#define DT		0.001	// 1khz like the IMU
+#define STEPS		10000
+#define TOL		1e-10	// maximum acceptable difference
+#define TIMING_STEPS	100000
+
+// different signal on each channel, motor currents have big steps
+static double __input(int ch, int i)
+{
+	double t = i*DT;
+	if(ch>=9) return ((i/500)%2) ? 2.0 : -2.0;
+	return 0.1*ch + sin(2.0*M_PI*(1.0+3.0*ch)*t);
+}
+
+int main()
+{
+	int i, ch, failures = 0;
+	double err, max_err = 0.0;
+	double in[CHANNELS], out[CHANNELS];
+	uint64_t t1, t2, t3;
+	rc_filter_t proto = RC_FILTER_INITIALIZER;
+	rc_filter_t f[CHANNELS];
+	rc_filter_bank_t bank = RC_FILTER_BANK_INITIALIZER;
+
+	printf("Let's test a bank of %d filters....\n\n", CHANNELS);
+
+	// one prototype filter provides the shared coefficients
+	rc_filter_butterworth_lowpass(&proto, 2, DT, 2.0*M_PI*30.0);
+	if(rc_filter_bank_alloc(&bank, CHANNELS, proto)){
+		fprintf(stderr,"ERROR: failed to allocate filter bank\n");
+		return -1;
+	}
+	for(ch=0;ch<CHANNELS;ch++){
+		f[ch] = rc_filter_empty();
+		rc_filter_duplicate(&f[ch], proto);
+	}
+	// saturate the motor current channels
+	for(ch=9;ch<CHANNELS;ch++){
+		rc_filter_enable_saturation(&f[ch], -1.5, 1.5);
+		rc_filter_bank_enable_saturation(&bank, ch, -1.5, 1.5);
+	}
+
+	for(i=0;i<STEPS;i++){
+		// reset one channel halfway through, the others must not notice
+		if(i==STEPS/2){
+			rc_filter_reset(&f[4]);
+			rc_filter_bank_reset_channel(&bank, 4);
+		}
+		for(ch=0;ch<CHANNELS;ch++) in[ch] = __input(ch,i);
+		rc_filter_bank_march(&bank, in, out);
+		for(ch=0;ch<CHANNELS;ch++){
+			err = fabs(rc_filter_march(&f[ch], in[ch]) - out[ch]);
+			if(err>max_err) max_err = err;
+			if(rc_filter_bank_get_saturation_flag(&bank,ch)!=f[ch].sat_flag){
+				printf("FAIL saturation flag mismatch channel %d step %d\n", ch, i);
+				failures++;
+			}
+		}
+	}
+	if(max_err>TOL){
+		printf("FAIL bank output differs from rc_filter_march by %e\n", max_err);
+		failures++;
+	}
+	else printf("pass bank output matches rc_filter_march, max error %e\n", max_err);
+
+	// time both ways of filtering all channels
+	t1 = rc_nanos_thread_time();
+	for(i=0;i<TIMING_STEPS;i++){
+		for(ch=0;ch<CHANNELS;ch++) out[ch] = rc_filter_march(&f[ch], in[ch]);
+	}
+	t2 = rc_nanos_thread_time();
+	for(i=0;i<TIMING_STEPS;i++) rc_filter_bank_march(&bank, in, out);
+	t3 = rc_nanos_thread_time();
+	printf("\n%d rc_filter_march calls: %6.1fns/step\n", CHANNELS, (double)(t2-t1)/TIMING_STEPS);
+	printf("rc_filter_bank_march:    %6.1fns/step\n", (double)(t3-t2)/TIMING_STEPS);
+
+	for(ch=0;ch<CHANNELS;ch++) rc_filter_free(&f[ch]);
+	rc_filter_free(&proto);
+	rc_filter_bank_free(&bank);
+
+	if(failures){
+		printf("\n%d tests FAILED\n", failures);
+		return -1;
+	}
+	printf("\nall tests passed\n");
+	return 0;
+}
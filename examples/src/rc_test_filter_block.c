@@ -0,0 +1,104 @@
+/**
+ * @example    rc_test_filter_block.c
+ *
+ * @brief      Tests rc_filter_march_block against rc_filter_march for bit-exact
+ *             equality and times both.
+ *
+ *             Each filter is duplicated, one copy is marched sample by sample
+ *             and the other is fed the same input in blocks of varying size.
+ *             Outputs are compared with memcmp so any difference at all is a
+ *             failure. Saturation and soft start are covered by a PID
+ *             controller.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <rc/math.h>
+#include <rc/time.h>
+
+#define DT		0.01
+#define SAMPLES		5000
+#define TIMING_REPS	100
+
+static double in[SAMPLES], out1[SAMPLES], out2[SAMPLES];
+
+// runs one copy of f per-sample and another in blocks, returns 0 if identical
+static int __check(const char* name, rc_filter_t* f)
+{
+	int i, pos, len;
+	rc_filter_t f2 = RC_FILTER_INITIALIZER;
+	rc_filter_duplicate(&f2, *f);
+	for(i=0;i<SAMPLES;i++) out1[i] = rc_filter_march(f, in[i]);
+	// blocks of 1 to 64 samples so block boundaries land everywhere
+	pos = 0;
+	len = 1;
+	while(pos<SAMPLES){
+		if(pos+len>SAMPLES) len = SAMPLES-pos;
+		rc_filter_march_block(&f2, in+pos, out2+pos, len);
+		pos += len;
+		len = (len*7)%64 + 1;
+	}
+	if(memcmp(out1, out2, sizeof(out1)) || f->step!=f2.step ||\
+			f->sat_flag!=f2.sat_flag){
+		printf("FAIL %-32s block output differs\n", name);
+		rc_filter_free(&f2);
+		return 1;
+	}
+	printf("pass %-32s bit-exact\n", name);
+	rc_filter_free(&f2);
+	return 0;
+}
+
+int main()
+{
+	int i, failures = 0;
+	uint64_t t1, t2, t3;
+	double num[] = {0.3, 0.2};
+	double den[] = {2.0, -1.0, 0.1};
+	rc_filter_t f = RC_FILTER_INITIALIZER;
+
+	printf("Let's test block filtering....\n\n");
+
+	// noisy chirp with steps to hit saturation
+	for(i=0;i<SAMPLES;i++){
+		in[i] = sin(0.001*i*i*DT) + ((i/700)%2 ? 3.0 : -3.0) + 0.1*cos(17.0*i);
+	}
+
+	rc_filter_butterworth_lowpass(&f, 4, DT, 2.0*M_PI*5.0);
+	failures += __check("butterworth_lowpass order 4", &f);
+	rc_filter_moving_average(&f, 20, DT);
+	failures += __check("moving_average", &f);
+	rc_filter_integrator(&f, DT);
+	rc_filter_enable_saturation(&f, -10.0, 10.0);
+	failures += __check("saturated integrator", &f);
+	rc_filter_pid(&f, 2.0, 1.0, 0.1, 4.0*DT, DT);
+	rc_filter_enable_saturation(&f, -2.0, 2.0);
+	rc_filter_enable_soft_start(&f, 5.0);
+	failures += __check("pid with soft start", &f);
+	// unnormalized denominator and extra gain take other code paths
+	rc_filter_alloc_from_arrays(&f, DT, num, 2, den, 3);
+	f.gain = 1.5;
+	failures += __check("unnormalized with gain", &f);
+
+	// time both on the 4th order lowpass
+	rc_filter_butterworth_lowpass(&f, 4, DT, 2.0*M_PI*5.0);
+	t1 = rc_nanos_thread_time();
+	for(i=0;i<TIMING_REPS*SAMPLES;i++) out1[i%SAMPLES] = rc_filter_march(&f, in[i%SAMPLES]);
+	t2 = rc_nanos_thread_time();
+	for(i=0;i<TIMING_REPS;i++) rc_filter_march_block(&f, in, out2, SAMPLES);
+	t3 = rc_nanos_thread_time();
+	printf("\n4th order lowpass rc_filter_march:       %5.1fns/sample\n",\
+				(double)(t2-t1)/(TIMING_REPS*SAMPLES));
+	printf("4th order lowpass rc_filter_march_block: %5.1fns/sample\n",\
+				(double)(t3-t2)/(TIMING_REPS*SAMPLES));
+
+	rc_filter_free(&f);
+
+	if(failures){
+		printf("\n%d tests FAILED\n", failures);
+		return -1;
+	}
+	printf("\nall tests passed\n");
+	return 0;
+}
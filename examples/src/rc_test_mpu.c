@@ -21,6 +21,9 @@
 // bus for Robotics Cape and BeagleboneBlue is 2
 // change this for your platform
 #define I2C_BUS 2
+// spi bus and auto slave select for breakout boards used with -s
+#define SPI_BUS 1
+#define SPI_SLAVE 0
 
 // possible modes, user selected with command line arguments
 typedef enum g_mode_t{
@@ -38,6 +41,8 @@ typedef enum a_mode_t{
 static int enable_magnetometer = 0;
 static int enable_thermometer = 0;
 static int enable_warnings = 0;
+static int enable_burst = 0;
+static int enable_spi = 0;
 static int running = 0;
 
 // printed if some invalid argument was given
@@ -50,6 +55,8 @@ static void __print_usage(void)
 	printf("-m	print magnetometer data as well as accel/gyro\n");
 	printf("-t	print thermometer data as well as accel/gyro\n");
 	printf("-w	print i2c warnings\n");
+	printf("-b	read all sensors in one i2c burst with rc_mpu_read_all\n");
+	printf("-s	talk to an MPU9250 wired to spi instead of i2c\n");
 	printf("-h	print this help message\n");
 	printf("\n");
 }
@@ -70,7 +77,7 @@ int main(int argc, char *argv[])
 
 	// parse arguments
 	opterr = 0;
-	while ((c = getopt(argc, argv, "argmtwh")) != -1){
+	while ((c = getopt(argc, argv, "argmtwbsh")) != -1){
 		switch (c){
 		case 'a':
 			g_mode = G_MODE_RAW;
@@ -92,6 +99,12 @@ int main(int argc, char *argv[])
 		case 'w':
 			enable_warnings = 1;
 			break;
+		case 'b':
+			enable_burst = 1;
+			break;
+		case 's':
+			enable_spi = 1;
+			break;
 		case 'h':
 			__print_usage();
 			return 0;
@@ -110,6 +123,14 @@ int main(int argc, char *argv[])
 	conf.i2c_bus = I2C_BUS;
 	conf.enable_magnetometer = enable_magnetometer;
 	conf.show_warnings = enable_warnings;
+	// in burst mode the MPU fetches the magnetometer so it arrives in the
+	// same read as everything else
+	conf.mag_ext_sens_read = enable_burst;
+	if(enable_spi){
+		conf.transport = MPU_TRANSPORT_SPI;
+		conf.spi_bus = SPI_BUS;
+		conf.spi_slave = SPI_SLAVE;
+	}
 
 	if(rc_mpu_initialize(&data, conf)){
 		fprintf(stderr,"rc_mpu_initialize_failed\n");
@@ -156,17 +177,24 @@ int main(int argc, char *argv[])
 		printf("\r");
 
 		// read sensor data
-		if(rc_mpu_read_accel(&data)<0){
-			printf("read accel data failed\n");
-		}
-		if(rc_mpu_read_gyro(&data)<0){
-			printf("read gyro data failed\n");
-		}
-		if(enable_magnetometer && rc_mpu_read_mag(&data)){
-			printf("read mag data failed\n");
+		if(enable_burst){
+			if(rc_mpu_read_all(&data)<0){
+				printf("read all sensor data failed\n");
+			}
 		}
-		if(enable_thermometer && rc_mpu_read_temp(&data)){
-			printf("read imu thermometer failed\n");
+		else{
+			if(rc_mpu_read_accel(&data)<0){
+				printf("read accel data failed\n");
+			}
+			if(rc_mpu_read_gyro(&data)<0){
+				printf("read gyro data failed\n");
+			}
+			if(enable_magnetometer && rc_mpu_read_mag(&data)){
+				printf("read mag data failed\n");
+			}
+			if(enable_thermometer && rc_mpu_read_temp(&data)){
+				printf("read imu thermometer failed\n");
+			}
 		}
 
 
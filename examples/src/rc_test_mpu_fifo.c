@@ -0,0 +1,114 @@
+/**
+ * @file rc_test_mpu_fifo.c
+ * @example    rc_test_mpu_fifo
+ *
+ * @brief      serves as an example of how to stream raw accel and gyro data
+ *             from the MPU's FIFO at high rate
+ *
+ *             The callback receives batches of timestamped samples and keeps
+ *             running sums so the main thread can print the sample rate
+ *             actually received along with the RMS vibration on each gyro and
+ *             accel axis over the last second.
+ */
+
+#include <stdio.h>
+#include <signal.h>
+#include <math.h>
+#include <pthread.h>
+#include <rc/mpu.h>
+#include <rc/time.h>
+
+// bus for Robotics Cape and BeagleboneBlue is 2, interrupt pin is on gpio3.21
+// change these for your platform
+#define I2C_BUS 2
+#define GPIO_INT_PIN_CHIP 3
+#define GPIO_INT_PIN_PIN  21
+
+#define SAMPLE_RATE	1000
+#define BATCH_LEN	10
+
+static int running = 0;
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t samples, batches;
+static double gyro_sq[3], accel_sum[3], accel_sq[3];
+
+// interrupt handler to catch ctrl-c
+static void __signal_handler(__attribute__ ((unused)) int dummy)
+{
+	running=0;
+	return;
+}
+
+// runs in the mpu handler thread, keep it short
+static void __batch_callback(const rc_mpu_raw_sample_t* s, int n)
+{
+	int i, j;
+	pthread_mutex_lock(&stats_mutex);
+	for(i=0;i<n;i++){
+		for(j=0;j<3;j++){
+			gyro_sq[j]   += s[i].gyro[j]*s[i].gyro[j];
+			accel_sum[j] += s[i].accel[j];
+			accel_sq[j]  += s[i].accel[j]*s[i].accel[j];
+		}
+	}
+	samples += n;
+	batches++;
+	pthread_mutex_unlock(&stats_mutex);
+	return;
+}
+
+int main()
+{
+	int j;
+	double mean, ac_rms[3], gyro_rms[3];
+	uint64_t n, b;
+	rc_mpu_data_t data;
+	rc_mpu_config_t conf = rc_mpu_default_config();
+	conf.i2c_bus = I2C_BUS;
+	conf.gpio_interrupt_pin_chip = GPIO_INT_PIN_CHIP;
+	conf.gpio_interrupt_pin = GPIO_INT_PIN_PIN;
+	conf.raw_fifo_sample_rate = SAMPLE_RATE;
+	conf.raw_fifo_batch_len = BATCH_LEN;
+
+	// set signal handler so the loop can exit cleanly
+	signal(SIGINT, __signal_handler);
+	running = 1;
+
+	if(rc_mpu_initialize_raw_fifo(&data, conf)){
+		fprintf(stderr,"rc_mpu_initialize_raw_fifo failed\n");
+		return -1;
+	}
+	rc_mpu_set_raw_fifo_callback(__batch_callback);
+
+	printf("streaming %dhz in batches of %d, vibration is RMS over the last second\n", SAMPLE_RATE, BATCH_LEN);
+	printf(" rate(hz) |batches| overflows |  gyro vibration (deg/s) | accel vibration (m/s^2)\n");
+	while(running){
+		rc_usleep(1000000);
+		// take the sums and start again
+		pthread_mutex_lock(&stats_mutex);
+		n = samples;
+		b = batches;
+		for(j=0;j<3;j++){
+			if(n){
+				mean = accel_sum[j]/n;
+				gyro_rms[j] = sqrt(gyro_sq[j]/n);
+				ac_rms[j] = sqrt(fmax(accel_sq[j]/n - mean*mean, 0.0));
+			}
+			else gyro_rms[j] = ac_rms[j] = 0.0;
+			gyro_sq[j] = accel_sum[j] = accel_sq[j] = 0.0;
+		}
+		samples = 0;
+		batches = 0;
+		pthread_mutex_unlock(&stats_mutex);
+		printf("\r%9llu |%6llu | %9llu | %7.2f %7.2f %7.2f | %6.3f %6.3f %6.3f",
+			(unsigned long long)n, (unsigned long long)b,
+			(unsigned long long)rc_mpu_raw_fifo_overflows(),
+			gyro_rms[0], gyro_rms[1], gyro_rms[2],
+			ac_rms[0], ac_rms[1], ac_rms[2]);
+		fflush(stdout);
+	}
+
+	rc_mpu_power_off();
+	printf("\n");
+	return 0;
+}
@@ -0,0 +1,107 @@
+/**
+ * @file rc_test_mpu_ring.c
+ * @example    rc_test_mpu_ring
+ *
+ * @brief      serves as an example of how to consume DMP samples from the
+ *             lock-free sample ring
+ *
+ *             Two consumer threads read the ring. The logger drains it as fast
+ *             as it can and should never miss a sample. The slow consumer only
+ *             wakes up every half second which is longer than the ring holds,
+ *             so it reports missed samples every time. The main thread prints
+ *             the latest sample and both consumers' counters. FIFO burst drain
+ *             is enabled so late interrupt wakeups don't drop samples either.
+ */
+
+#include <stdio.h>
+#include <signal.h>
+#include <pthread.h>
+#include <rc/mpu.h>
+#include <rc/time.h>
+
+// bus for Robotics Cape and BeagleboneBlue is 2, interrupt pin is on gpio3.21
+// change these for your platform
+#define I2C_BUS 2
+#define GPIO_INT_PIN_CHIP 3
+#define GPIO_INT_PIN_PIN  21
+
+#define SAMPLE_RATE	200
+#define RING_LEN	64
+
+typedef struct consumer_t{
+	int sleep_us;		// time to sleep after draining the ring
+	uint64_t samples;	// samples read
+	rc_mpu_ring_reader_t reader;
+} consumer_t;
+
+static int running = 0;
+
+// interrupt handler to catch ctrl-c
+static void __signal_handler(__attribute__ ((unused)) int dummy)
+{
+	running=0;
+	return;
+}
+
+// drains the ring, then sleeps
+static void* __consumer(void* ptr)
+{
+	consumer_t* c = (consumer_t*)ptr;
+	rc_mpu_sample_t sample;
+	rc_mpu_ring_reader_init(&c->reader);
+	while(running){
+		while(rc_mpu_ring_read(&c->reader, &sample)==1) c->samples++;
+		rc_usleep(c->sleep_us);
+	}
+	return NULL;
+}
+
+int main()
+{
+	rc_mpu_data_t data;
+	rc_mpu_sample_t latest;
+	pthread_t logger_thread, slow_thread;
+	consumer_t logger = {.sleep_us = 1000};
+	consumer_t slow = {.sleep_us = 500000};
+	rc_mpu_config_t conf = rc_mpu_default_config();
+	conf.i2c_bus = I2C_BUS;
+	conf.gpio_interrupt_pin_chip = GPIO_INT_PIN_CHIP;
+	conf.gpio_interrupt_pin = GPIO_INT_PIN_PIN;
+	conf.dmp_sample_rate = SAMPLE_RATE;
+	conf.dmp_fetch_accel_gyro = 1;
+	conf.dmp_sample_ring_len = RING_LEN;
+	// read the whole fifo backlog after a late wakeup so nothing is lost
+	conf.dmp_fifo_burst_drain = 1;
+
+	// set signal handler so the loop can exit cleanly
+	signal(SIGINT, __signal_handler);
+	running = 1;
+
+	if(rc_mpu_initialize_dmp(&data, conf)){
+		printf("rc_mpu_initialize_dmp failed\n");
+		return -1;
+	}
+	pthread_create(&logger_thread, NULL, __consumer, &logger);
+	pthread_create(&slow_thread, NULL, __consumer, &slow);
+
+	printf("   seq  | gyro Z (deg/s) | logger read/missed | slow read/missed\n");
+	while(running){
+		if(rc_mpu_ring_read_latest(&latest)==1){
+			printf("\r%7llu | %14.2f | %9llu/%-8llu | %8llu/%-8llu",
+				(unsigned long long)latest.seq, latest.data.gyro[2],
+				(unsigned long long)logger.samples,
+				(unsigned long long)logger.reader.missed,
+				(unsigned long long)slow.samples,
+				(unsigned long long)slow.reader.missed);
+			fflush(stdout);
+		}
+		rc_usleep(100000);
+	}
+
+	// consumers must be done with the ring before it's freed
+	pthread_join(logger_thread, NULL);
+	pthread_join(slow_thread, NULL);
+	rc_mpu_power_off();
+	printf("\n");
+	return 0;
+}
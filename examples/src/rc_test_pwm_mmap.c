@@ -0,0 +1,120 @@
+/**
+ * @file rc_test_pwm_mmap.c
+ * @example    rc_test_pwm_mmap
+ *
+ * @brief      Tests the memory mapped PWM backend against a fake register file
+ *             so it can run without hardware.
+ *
+ *             A temporary file stands in for the 3 PWMSS register blocks with a
+ *             different period and prescaler on each subsystem. Duty cycles are
+ *             set through the normal rc_pwm_set_duty and rc_pwm_set_duty_ns
+ *             calls and the compare registers are read back from the file.
+ *             Finally the time per rc_pwm_set_duty call is printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <rc/pwm.h>
+#include <rc/time.h>
+
+#define FILE_LEN	0x6000
+#define SS_STRIDE	0x2000
+#define TBCTL		0x200
+#define TBPRD		0x20A
+#define CMPA		0x212
+#define CMPB		0x214
+#define TIMING_REPS	1000000
+
+static int fd;
+
+static uint16_t __read_reg(int ss, int reg)
+{
+	uint16_t val = 0;
+	if(pread(fd, &val, 2, ss*SS_STRIDE+reg)!=2) return 0xDEAD;
+	return val;
+}
+
+static void __write_reg(int ss, int reg, uint16_t val)
+{
+	if(pwrite(fd, &val, 2, ss*SS_STRIDE+reg)!=2) perror("pwrite");
+}
+
+// checks one register against the expected value
+static int __check(const char* name, int ss, int reg, uint16_t expected)
+{
+	uint16_t val = __read_reg(ss, reg);
+	if(val!=expected){
+		printf("FAIL ss%d %-28s got %5d expected %5d\n", ss, name, val, expected);
+		return 1;
+	}
+	printf("pass ss%d %-28s %5d\n", ss, name, val);
+	return 0;
+}
+
+int main()
+{
+	int i, failures = 0;
+	uint64_t t1, t2;
+	char path[] = "/tmp/rc_test_pwm_mmapXXXXXX";
+
+	printf("Let's test the mmap pwm backend on a fake register file....\n\n");
+
+	fd = mkstemp(path);
+	if(fd==-1 || ftruncate(fd, FILE_LEN)){
+		perror("ERROR: failed to create register file");
+		return -1;
+	}
+	// 25khz, 20khz with CLKDIV=2, and the largest period with HSPCLKDIV=4
+	__write_reg(0, TBPRD, 3999);
+	__write_reg(1, TBPRD, 2499);
+	__write_reg(1, TBCTL, 1<<10);
+	__write_reg(2, TBPRD, 0xFFFF);
+	__write_reg(2, TBCTL, 2<<7);
+
+	if(rc_pwm_set_mmap_file(path)) return -1;
+	for(i=0;i<3;i++){
+		if(rc_pwm_enable_mmap(i)){
+			fprintf(stderr,"ERROR: rc_pwm_enable_mmap failed\n");
+			return -1;
+		}
+	}
+
+	rc_pwm_set_duty(0, 'A', 0.5);
+	rc_pwm_set_duty(0, 'B', 0.0);
+	failures += __check("duty 0.5 A", 0, CMPA, 2000);
+	failures += __check("duty 0.0 B", 0, CMPB, 0);
+	rc_pwm_set_duty(1, 'A', 1.0);
+	rc_pwm_set_duty_ns(1, 'B', 10000);	// 10us of a 50us period
+	failures += __check("duty 1.0 A", 1, CMPA, 2500);
+	failures += __check("duty_ns 10000 B", 1, CMPB, 500);
+	rc_pwm_set_duty(2, 'A', 1.0);
+	rc_pwm_set_duty(2, 'B', 0.25);
+	failures += __check("duty 1.0 A, clamped", 2, CMPA, 0xFFFF);
+	failures += __check("duty 0.25 B", 2, CMPB, 0x4000);
+	// out of range values must be rejected without touching the register
+	printf("\nexpect 2 errors:\n");
+	if(rc_pwm_set_duty(0, 'A', 1.5)==0) failures++;
+	if(rc_pwm_set_duty_ns(1, 'B', 50001)==0) failures++;
+	failures += __check("rejected duty", 0, CMPA, 2000);
+	failures += __check("rejected duty_ns", 1, CMPB, 500);
+
+	// time the mapped write
+	t1 = rc_nanos_thread_time();
+	for(i=0;i<TIMING_REPS;i++) rc_pwm_set_duty(0, 'A', (i&1023)/1024.0);
+	t2 = rc_nanos_thread_time();
+	printf("\nrc_pwm_set_duty through mmap: %5.1fns/call\n", (double)(t2-t1)/TIMING_REPS);
+
+	for(i=0;i<3;i++) rc_pwm_cleanup(i);
+	rc_pwm_set_mmap_file(NULL);
+	close(fd);
+	unlink(path);
+
+	if(failures){
+		printf("\n%d tests FAILED\n", failures);
+		return -1;
+	}
+	printf("\nall tests passed\n");
+	return 0;
+}
@@ -0,0 +1,211 @@
+/**
+ * @example    rc_test_small_matrix.c
+ *
+ * @brief      Tests the fixed-size matrices in rc/math/small_matrix.h against
+ *             the equivalent heap-allocated rc_matrix_t functions.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <rc/math.h>
+
+#define DIM 6		// dimension of generic small matrix to test
+#define TOL 1e-9	// maximum acceptable difference between results
+
+static int failures = 0;
+
+// compares a view of a small matrix against an rc_matrix_t
+static void __check(const char* name, rc_matrix_t small, rc_matrix_t ref)
+{
+	int i,j;
+	double err = 0.0;
+	if(small.rows!=ref.rows || small.cols!=ref.cols){
+		printf("FAIL %-24s dimension mismatch\n", name);
+		failures++;
+		return;
+	}
+	for(i=0;i<ref.rows;i++){
+		for(j=0;j<ref.cols;j++){
+			if(fabs(small.d[i][j]-ref.d[i][j])>err) err=fabs(small.d[i][j]-ref.d[i][j]);
+		}
+	}
+	if(err>TOL){
+		printf("FAIL %-24s max error %e\n", name, err);
+		failures++;
+	}
+	else printf("pass %-24s max error %e\n", name, err);
+}
+
+int main()
+{
+	int i,j;
+	double* rows[RC_SMALL_MATRIX_MAX_DIM];
+	double q[4] = {0.9, 0.1, -0.3, 0.2};
+	rc_mat3_t a3, b3, c3, *p3;
+	rc_mat4_t a4, b4, c4;
+	rc_vec3_t v3;
+	rc_small_matrix_t A, B, C;
+	rc_small_vector_t v;
+	rc_matrix_t view;	// only ever a view into a small matrix, never freed
+	rc_matrix_t M		= RC_MATRIX_INITIALIZER;
+	rc_matrix_t N		= RC_MATRIX_INITIALIZER;
+	rc_matrix_t R		= RC_MATRIX_INITIALIZER;
+	rc_vector_t x		= RC_VECTOR_INITIALIZER;
+	rc_vector_t y		= RC_VECTOR_INITIALIZER;
+	rc_vector_t qv		= RC_VECTOR_INITIALIZER;
+
+	printf("Let's test some small matrix functions....\n\n");
+
+	// 3x3 multiply, transpose, invert
+	rc_matrix_random(&M,3,3);
+	rc_matrix_random(&N,3,3);
+	a3 = *rc_mat3_from_matrix(M);
+	b3 = *rc_mat3_from_matrix(N);
+	rc_mat3_multiply(&a3,&b3,&c3);
+	rc_mat3_as_matrix(&c3,rows,&view);
+	rc_matrix_multiply(M,N,&R);
+	__check("rc_mat3_multiply", view, R);
+
+	rc_mat3_transpose(&a3,&c3);
+	rc_matrix_transpose(M,&R);
+	__check("rc_mat3_transpose", view, R);
+
+	rc_mat3_invert(&a3,&c3);
+	rc_algebra_invert_matrix(M,&R);
+	__check("rc_mat3_invert", view, R);
+
+	// 3x3 matrix times vector
+	rc_vector_random(&x,3);
+	for(i=0;i<3;i++) v3.d[i]=x.d[i];
+	rc_mat3_times_vec(&a3,&v3,&v3);
+	rc_matrix_times_col_vec(M,x,&y);
+	rc_matrix_zeros(&R,3,1);
+	for(i=0;i<3;i++) R.d[i][0]=y.d[i];
+	rc_matrix_alloc(&N,3,1);
+	for(i=0;i<3;i++) N.d[i][0]=v3.d[i];
+	__check("rc_mat3_times_vec", N, R);
+
+	// cholesky of SPD matrix M*M' + I, check that L*L' gets it back
+	rc_matrix_transpose(M,&N);
+	rc_matrix_right_multiply_inplace(&N,M);
+	for(i=0;i<3;i++) N.d[i][i]+=1.0;
+	b3 = *rc_mat3_from_matrix(N);
+	rc_mat3_cholesky(&b3,&c3);
+	rc_mat3_transpose(&c3,&a3);
+	rc_mat3_multiply(&c3,&a3,&c3);
+	rc_mat3_as_matrix(&c3,rows,&view);
+	__check("rc_mat3_cholesky", view, N);
+
+	// in-place view, writing through p3 must change M
+	p3 = rc_mat3_from_matrix(M);
+	rc_mat3_identity(p3);
+	rc_matrix_identity(&R,3);
+	__check("rc_mat3_from_matrix", M, R);
+
+	// quaternion to rotation matrix
+	rc_vector_from_array(&qv,q,4);
+	rc_normalize_quaternion(&qv);
+	rc_quaternion_to_rotation_matrix(qv,&R);
+	rc_quaternion_to_rotation_mat3(qv.d,&c3);
+	rc_mat3_as_matrix(&c3,rows,&view);
+	__check("rotation_mat3", view, R);
+
+	// 4x4
+	rc_matrix_random(&M,4,4);
+	rc_matrix_random(&N,4,4);
+	a4 = *rc_mat4_from_matrix(M);
+	b4 = *rc_mat4_from_matrix(N);
+	rc_mat4_multiply(&a4,&b4,&c4);
+	rc_mat4_as_matrix(&c4,rows,&view);
+	rc_matrix_multiply(M,N,&R);
+	__check("rc_mat4_multiply", view, R);
+
+	rc_mat4_invert(&a4,&c4);
+	rc_algebra_invert_matrix(M,&R);
+	__check("rc_mat4_invert", view, R);
+
+	// generic
+	rc_matrix_random(&M,DIM,DIM);
+	rc_matrix_random(&N,DIM,DIM-2);
+	rc_small_matrix_from_matrix(M,&A);
+	rc_small_matrix_from_matrix(N,&B);
+	rc_small_matrix_multiply(&A,&B,&C);
+	rc_small_matrix_as_matrix(&C,rows,&view);
+	rc_matrix_multiply(M,N,&R);
+	__check("rc_small_matrix_multiply", view, R);
+
+	rc_small_matrix_transpose(&B,&C);
+	rc_small_matrix_as_matrix(&C,rows,&view);
+	rc_matrix_transpose(N,&R);
+	__check("rc_small_matrix_transpose", view, R);
+
+	rc_small_matrix_invert(&A,&C);
+	rc_small_matrix_as_matrix(&C,rows,&view);
+	rc_algebra_invert_matrix(M,&R);
+	__check("rc_small_matrix_invert", view, R);
+
+	rc_vector_random(&x,DIM);
+	v.len = DIM;
+	for(i=0;i<DIM;i++) v.d[i]=x.d[i];
+	rc_small_matrix_times_vec(&A,&v,&v);
+	rc_matrix_times_col_vec(M,x,&y);
+	rc_small_matrix_zeros(&C,DIM,1);
+	rc_matrix_zeros(&R,DIM,1);
+	for(i=0;i<DIM;i++){
+		RC_SMALL_MATRIX_AT(C,i,0)=v.d[i];
+		R.d[i][0]=y.d[i];
+	}
+	rc_small_matrix_as_matrix(&C,rows,&view);
+	__check("rc_small_matrix_times_vec", view, R);
+
+	// cholesky of SPD matrix A*A' + I
+	rc_small_matrix_transpose(&A,&B);
+	rc_small_matrix_multiply(&A,&B,&B);
+	for(i=0;i<DIM;i++) RC_SMALL_MATRIX_AT(B,i,i)+=1.0;
+	rc_small_matrix_to_matrix(&B,&R);
+	rc_small_matrix_cholesky(&B,&C);
+	rc_small_matrix_transpose(&C,&A);
+	rc_small_matrix_multiply(&C,&A,&C);
+	rc_small_matrix_as_matrix(&C,rows,&view);
+	__check("rc_small_matrix_cholesky", view, R);
+
+	// non-SPD matrix must be rejected
+	rc_small_matrix_identity(&A,DIM);
+	RC_SMALL_MATRIX_AT(A,DIM-1,DIM-1) = -1.0;
+	if(rc_small_matrix_cholesky(&A,&C)==0){
+		printf("FAIL rc_small_matrix_cholesky accepted non-SPD matrix\n");
+		failures++;
+	}
+	for(i=0;i<DIM;i++){
+		for(j=0;j<DIM;j++) RC_SMALL_MATRIX_AT(A,i,j)=1.0;
+	}
+	if(rc_small_matrix_invert(&A,&C)==0){
+		printf("FAIL rc_small_matrix_invert accepted singular matrix\n");
+		failures++;
+	}
+	// out of range dimensions must be rejected before touching any data
+	A.rows = RC_SMALL_MATRIX_MAX_DIM+1;
+	if(rc_small_matrix_multiply(&A,&A,&C)==0 || rc_small_matrix_transpose(&A,&C)==0){
+		printf("FAIL rc_small_matrix accepted out of range dimensions\n");
+		failures++;
+	}
+	A.rows = 0;
+	if(rc_small_matrix_times_vec(&A,&v,&v)==0){
+		printf("FAIL rc_small_matrix_times_vec accepted zero rows\n");
+		failures++;
+	}
+
+	rc_matrix_free(&M);
+	rc_matrix_free(&N);
+	rc_matrix_free(&R);
+	rc_vector_free(&x);
+	rc_vector_free(&y);
+	rc_vector_free(&qv);
+
+	if(failures){
+		printf("\n%d tests FAILED\n", failures);
+		return -1;
+	}
+	printf("\nall tests passed\n");
+	return 0;
+}
@@ -38,6 +38,8 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+
 /**
  * @brief      initializes the analog to digital converter for reading
  *
@@ -87,6 +89,80 @@ double rc_adc_batt(void);
 double rc_adc_dc_jack(void);
 
 
+#define RC_ADC_CHANNELS	8	///< number of channels on the Sitara ADC
+
+
+/**
+ * Configuration for rc_adc_stream_start. Get the defaults with
+ * rc_adc_stream_default_config() and modify from there.
+ */
+typedef struct rc_adc_stream_config_t{
+	int channel_mask;	///< bit n enables channel n, default 0xFF for all 8
+	int buffer_len;		///< frames held by the kernel buffer, default 1024
+	int block_len;		///< most frames delivered per callback, default 64
+	int sched_policy;	///< SCHED_FIFO, SCHED_RR or SCHED_OTHER (default) for the reader thread
+	int priority;		///< reader thread priority, default 0
+	const char* sysfs_dir;	///< IIO device directory, default /sys/bus/iio/devices/iio:device0
+	const char* dev_path;	///< IIO character device, default /dev/iio:device0
+} rc_adc_stream_config_t;
+
+
+/**
+ * A block of consecutive frames passed to the stream callback. Each frame holds
+ * one raw sample of every enabled channel. The data is only valid until the
+ * callback returns.
+ */
+typedef struct rc_adc_block_t{
+	uint64_t timestamp_ns;		///< rc_nanos_since_epoch() when the block was read, close to the time of the newest frame
+	uint64_t first_frame;		///< number of frames delivered before this block since the stream started
+	int frames;			///< number of frames in the block
+	int channels;			///< number of enabled channels, values per frame
+	int channel[RC_ADC_CHANNELS];	///< ADC channel of each value within a frame
+	const uint16_t* raw;		///< frames*channels raw 12-bit values, frame after frame
+} rc_adc_block_t;
+
+
+/**
+ * @brief      Returns an rc_adc_stream_config_t with default settings.
+ *
+ * @return     rc_adc_stream_config_t with default settings
+ */
+rc_adc_stream_config_t rc_adc_stream_default_config(void);
+
+
+/**
+ * @brief      Starts continuous capture through the IIO buffer.
+ *
+ * Instead of reading a sysfs file per sample, this enables the kernel's IIO
+ * buffer for the channels in conf.channel_mask and lets the ADC sample them
+ * continuously at its own rate. A background thread reads binary frames in bulk
+ * from the character device and passes them to func in blocks of up to
+ * conf.block_len frames. rc_adc_init isn't needed and the single channel read
+ * functions fail while the stream is running since the driver owns the ADC.
+ *
+ * func runs in the reader thread and must return quickly or the kernel buffer
+ * will overflow and drop frames.
+ *
+ * For testing without hardware, sysfs_dir and dev_path can point to a fake
+ * device, see the rc_test_adc_stream example.
+ *
+ * @param[in]  conf  configuration struct
+ * @param[in]  func  callback for each block
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_adc_stream_start(rc_adc_stream_config_t conf, void (*func)(const rc_adc_block_t* block));
+
+
+/**
+ * @brief      Stops the stream, disables the IIO buffer and joins the reader
+ * thread.
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_adc_stream_stop(void);
+
+
 
 #ifdef __cplusplus
 }
@@ -14,6 +14,8 @@
 #ifndef RC_BMP_H
 #define RC_BMP_H
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -50,6 +52,42 @@ typedef enum rc_bmp_filter_t{
 }rc_bmp_filter_t;
 
 
+/**
+ * Setting in rc_bmp_config_t selecting which of the two integer compensation
+ * formulas from the BMP280 datasheet turns raw readings into pressure. Both
+ * give the same temperature.
+ */
+typedef enum rc_bmp_compensation_t{
+	BMP_COMPENSATION_INT64,	///< 64-bit reference, 1/256 Pa resolution, default
+	BMP_COMPENSATION_INT32	///< 32-bit reference, 1 Pa resolution and within 5 Pa of the 64-bit result, avoids 64-bit multiply and divide
+} rc_bmp_compensation_t;
+
+
+/**
+ * Setting in rc_bmp_config_t selecting how pressure is converted to altitude.
+ */
+typedef enum rc_bmp_altitude_t{
+	BMP_ALTITUDE_POW,	///< exact barometric formula using pow(), default
+	BMP_ALTITUDE_LUT	///< linear interpolation in a table built at init, within 2cm of BMP_ALTITUDE_POW over the sensor's 300-1100hPa range
+} rc_bmp_altitude_t;
+
+
+/**
+ * Configuration passed to rc_bmp_init_config. Get the defaults with
+ * rc_bmp_default_config() and modify from there.
+ */
+typedef struct rc_bmp_config_t{
+	rc_bmp_oversample_t oversample;		///< default BMP_OVERSAMPLE_16
+	rc_bmp_filter_t filter;			///< default BMP_FILTER_OFF
+	rc_bmp_compensation_t compensation;	///< default BMP_COMPENSATION_INT64
+	rc_bmp_altitude_t altitude;		///< default BMP_ALTITUDE_POW
+	int sampler_rate_hz;			///< background sampler rate, 0 (default) disables it, see rc_bmp_read_latest
+	int sampler_sync_mpu;			///< set to 1 to place sampler bus transactions right after each MPU interrupt read, default 0
+	int sampler_sched_policy;		///< SCHED_FIFO, SCHED_RR or SCHED_OTHER (default) for the sampler thread
+	int sampler_priority;			///< sampler thread priority, default 0
+} rc_bmp_config_t;
+
+
 /**
  * struct to hold the data retreived during one read of the barometer.
  */
@@ -60,6 +98,16 @@ typedef struct rc_bmp_data_t{
 } rc_bmp_data_t;
 
 
+/**
+ * One result published by the background sampler, see rc_bmp_read_latest.
+ */
+typedef struct rc_bmp_sample_t{
+	uint64_t seq;		///< increments by one with each new result, starting at 1
+	uint64_t timestamp_ns;	///< rc_nanos_since_epoch() at the middle of the conversion
+	rc_bmp_data_t data;	///< converted data
+} rc_bmp_sample_t;
+
+
 /**
  * @brief      powers on the barometer and initializes it with the given
  * oversample and filter settings.
@@ -75,6 +123,37 @@ typedef struct rc_bmp_data_t{
 int rc_bmp_init(rc_bmp_oversample_t oversample, rc_bmp_filter_t filter);
 
 
+/**
+ * @brief      Returns an rc_bmp_config_t struct with default settings.
+ *
+ * @return     rc_bmp_config_t struct with default settings
+ */
+rc_bmp_config_t rc_bmp_default_config(void);
+
+
+/**
+ * @brief      Same as rc_bmp_init but also selects the pressure compensation
+ * and altitude conversion used by rc_bmp_read.
+ *
+ * rc_bmp_init uses the default compensation and altitude settings. On the
+ * 32-bit BeagleBone BMP_COMPENSATION_INT32 avoids the software 64-bit divide
+ * at the cost of pressure resolution, 1 Pa is about 8cm of altitude.
+ * BMP_ALTITUDE_LUT replaces the pow() call with a table lookup.
+ *
+ * A nonzero sampler_rate_hz starts a background thread which puts the
+ * barometer in forced mode, triggers one conversion per period and publishes
+ * the results for rc_bmp_read_latest. The rate can't exceed what the chosen
+ * oversample allows, about 24hz for BMP_OVERSAMPLE_16 and 150hz for
+ * BMP_OVERSAMPLE_1. With sampler_sync_mpu the sampler also waits for the next
+ * MPU interrupt sample so its short bus transactions don't delay the IMU reads.
+ *
+ * @param[in]  conf  configuration struct
+ *
+ * @return     0 on success, otherwise -1.
+ */
+int rc_bmp_init_config(rc_bmp_config_t conf);
+
+
 /**
  * @brief      If you know the current sea level pressure for your region and
  * weather, you can use this to correct the altititude reading.
@@ -109,6 +188,23 @@ int rc_bmp_power_off(void);
 int rc_bmp_read(rc_bmp_data_t* data);
 
 
+/**
+ * @brief      Copies the newest result published by the background sampler.
+ *
+ * Doesn't touch the I2C bus and never waits on the sampler thread, even if it
+ * was preempted while publishing, so it's safe to call from the MPU interrupt
+ * callback. Compare sample->seq with the previous call to tell if the
+ * result is new. Only available when rc_bmp_init_config was called with a
+ * nonzero sampler_rate_hz.
+ *
+ * @param      sample  pointer to write the result to
+ *
+ * @return     1 if a result was copied, 0 if none has been published yet, -1 on
+ * error or if the sampler published several results during the copy.
+ */
+int rc_bmp_read_latest(rc_bmp_sample_t* sample);
+
+
 
 #ifdef __cplusplus
 }
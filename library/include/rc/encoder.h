@@ -24,6 +24,8 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+
 
 /**
  * @brief      Initializes counters for channels 1-4
@@ -69,6 +71,90 @@ int rc_encoder_read(int ch);
 int rc_encoder_write(int ch, int pos);
 
 
+#define RC_ENCODER_CHANNELS	4	///< channels 1-3 on the eQEP and 4 on the PRU
+
+
+/**
+ * Configuration for rc_encoder_speed_start. Get the defaults with
+ * rc_encoder_speed_default_config() and modify from there.
+ */
+typedef struct rc_encoder_speed_config_t{
+	int rate_hz;		///< how often all channels are sampled, default 1000
+	double filter_tc;	///< time constant in seconds of the velocity and acceleration lowpass filters, default 0.02
+	int eqep_capture;	///< set to 1 to use the eQEP capture unit for channels 1-3 at low speed, needs root, default 0
+	int capture_counts;	///< below this many counts per sample the capture period is used when eqep_capture is set, default 4
+	int sched_policy;	///< SCHED_FIFO, SCHED_RR or SCHED_OTHER (default) for the sampler thread
+	int priority;		///< sampler thread priority, default 0
+} rc_encoder_speed_config_t;
+
+
+/**
+ * A consistent snapshot of every channel from one sample of the speed
+ * estimator, see rc_encoder_speed_read.
+ */
+typedef struct rc_encoder_speed_t{
+	uint64_t seq;					///< increments by one with each sample, starting at 1
+	uint64_t timestamp_ns;				///< rc_nanos_since_epoch() when the channels were read
+	int position[RC_ENCODER_CHANNELS];		///< position of each channel, index 0 is channel 1
+	double velocity[RC_ENCODER_CHANNELS];		///< filtered velocity in counts/s
+	double acceleration[RC_ENCODER_CHANNELS];	///< filtered acceleration in counts/s^2
+} rc_encoder_speed_t;
+
+
+/**
+ * @brief      Returns an rc_encoder_speed_config_t with default settings.
+ *
+ * @return     rc_encoder_speed_config_t with default settings
+ */
+rc_encoder_speed_config_t rc_encoder_speed_default_config(void);
+
+
+/**
+ * @brief      Starts a background thread which samples all 4 encoder channels
+ * at a fixed rate and estimates their velocity and acceleration.
+ *
+ * Differencing positions at a fixed rate only resolves 1 count per sample, so
+ * at low speed it gives bursts of a single count and zeros. Instead, whenever a
+ * channel's position changes its velocity is the change divided by the time
+ * since the position last changed, which is the same as differencing at high
+ * speed and measures the period between counts at low speed. While a channel
+ * doesn't move its velocity decays no slower than 1 count over the time since
+ * its last change. With eqep_capture the eQEP hardware measures that period
+ * exactly for channels 1-3 instead. Velocity is then lowpass filtered and
+ * differentiated and filtered again for acceleration.
+ *
+ * Call rc_encoder_init first. Only one estimator can run at a time.
+ *
+ * @param[in]  conf  configuration struct
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_encoder_speed_start(rc_encoder_speed_config_t conf);
+
+
+/**
+ * @brief      Stops the speed estimator thread.
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_encoder_speed_stop(void);
+
+
+/**
+ * @brief      Copies the newest snapshot from the speed estimator.
+ *
+ * Never waits on the estimator thread, even if it was preempted while
+ * publishing, and doesn't touch hardware, so it's cheap enough to call from any
+ * control loop.
+ *
+ * @param[out] speed  pointer to write the snapshot to
+ *
+ * @return     1 if a snapshot was copied, 0 if none is available yet, -1 on
+ * error or if the estimator published several snapshots during the copy
+ */
+int rc_encoder_speed_read(rc_encoder_speed_t* speed);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -24,6 +24,8 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+
 
 /**
  * @brief      Initializes the eQEP encoder counters for channels 1-3
@@ -70,6 +72,104 @@ int rc_encoder_eqep_read(int ch);
 int rc_encoder_eqep_write(int ch, int pos);
 
 
+/**
+ * @brief      Switches rc_encoder_eqep_read and rc_encoder_eqep_write to the
+ * eQEP registers mapped through /dev/mem.
+ *
+ * The sysfs driver costs a seek and a read system call plus a string parse for
+ * every position read. After this call the position counter register QPOSCNT is
+ * read directly which takes well under a microsecond and no system calls. Call
+ * rc_encoder_eqep_init first so the kernel driver enables the modules and their
+ * clocks. Requires root. Also required for the velocity functions below.
+ *
+ * @return     0 on success or -1 on failure
+ */
+int rc_encoder_eqep_enable_mmap(void);
+
+
+/**
+ * @brief      Switches reads and writes back to the sysfs driver and unmaps the
+ * registers. Also called by rc_encoder_eqep_cleanup.
+ *
+ * @return     0 on success or -1 on failure
+ */
+int rc_encoder_eqep_disable_mmap(void);
+
+
+/**
+ * @brief      Checks if the eQEP registers are currently mapped.
+ *
+ * @return     1 if mapped, 0 if reads and writes go through sysfs
+ */
+int rc_encoder_eqep_mmap_enabled(void);
+
+
+/**
+ * @brief      Makes rc_encoder_eqep_enable_mmap map a regular file instead of
+ * /dev/mem, for testing without hardware.
+ *
+ * The file stands in for the 3 PWMSS register blocks and must be at least
+ * 0x6000 bytes long. Channel ch lives at offset (ch-1)*0x2000 with the eQEP
+ * registers 0x180 further in, the same as in the AM335x memory map. In this
+ * mode rc_encoder_eqep_init isn't needed. Pass NULL to go back to /dev/mem.
+ *
+ * @param[in]  path  path to the file or NULL
+ *
+ * @return     0 on success or -1 on failure
+ */
+int rc_encoder_eqep_set_mmap_file(const char* path);
+
+
+/**
+ * Hardware speed measurement of one eQEP channel, filled in by
+ * rc_encoder_eqep_read_velocity.
+ */
+typedef struct rc_encoder_eqep_velocity_t{
+	int position;		///< position latched at the most recent unit time out
+	int new_latch;		///< 1 if the unit timer expired since the previous call
+	double unit_rate;	///< counts/s from the position change over the last unit time (fixed time), good at high speed
+	double period_rate;	///< counts/s from the time taken by the last 2^upps counts (fixed position), good at low speed
+	int period_valid;	///< 0 if the capture timer overflowed (too slow) or the direction changed during the capture
+	uint64_t timestamp_ns;	///< rc_nanos_since_epoch() when the latch was first seen
+} rc_encoder_eqep_velocity_t;
+
+
+/**
+ * @brief      Sets up the unit timer and capture unit of one channel for
+ * hardware speed measurement.
+ *
+ * Every unit_period_us the unit timer latches the position counter into
+ * QPOSLAT and the most recent capture period into QCPRDLAT so both
+ * measurements describe the same instant. The capture unit times how long the
+ * encoder takes to move 2^upps counts with a timer clocked at 100MHz/2^ccps.
+ * Larger ccps measures slower speeds before the 16-bit timer overflows, at
+ * 100MHz/128 it overflows after 84ms. Requires rc_encoder_eqep_enable_mmap.
+ *
+ * @param[in]  ch              channel 1-3
+ * @param[in]  unit_period_us  unit timer period in microseconds, 1 to 42,000,000
+ * @param[in]  upps            log2 of counts per capture, 0-11
+ * @param[in]  ccps            log2 of the capture timer prescaler, 0-7
+ *
+ * @return     0 on success or -1 on failure
+ */
+int rc_encoder_eqep_config_velocity(int ch, int unit_period_us, int upps, int ccps);
+
+
+/**
+ * @brief      Reads the hardware speed measurements of one channel.
+ *
+ * The fixed time rate compares consecutive latches, so call this at least once
+ * per unit period. If latches are missed the difference is divided over the
+ * number of periods that passed according to the system clock.
+ *
+ * @param[in]  ch    channel 1-3
+ * @param[out] v     pointer to write the result to
+ *
+ * @return     0 on success or -1 on failure
+ */
+int rc_encoder_eqep_read_velocity(int ch, rc_encoder_eqep_velocity_t* v);
+
+
 #ifdef __cplusplus
 }
 #endif
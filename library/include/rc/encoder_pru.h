@@ -20,10 +20,27 @@
 #ifndef RC_ENCODER_PRU_H
 #define RC_ENCODER_PRU_H
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define RC_ENCODER_PRU_TICKS_PER_SEC	200000000 ///< rate of the PRU timestamp
+
+/**
+ * @brief      Consistent snapshot of the PRU encoder counter.
+ *
+ * The PRU writes the count and timestamp into one of two banks in shared
+ * memory and then bumps a generation counter, so the position and ticks in
+ * here always belong to the same encoder edge.
+ */
+typedef struct rc_encoder_pru_sample_t{
+	int position;		///< encoder count
+	uint32_t ticks;		///< PRU timer when position last changed, wraps every ~21s
+	uint32_t generation;	///< increments each time the PRU publishes a new count
+} rc_encoder_pru_sample_t;
+
 
 /**
  * @brief      Initializes the pru encoder counter for channel 4
@@ -55,10 +72,28 @@ void rc_encoder_pru_cleanup(void);
  */
 int rc_encoder_pru_read(void);
 
+/**
+ * @brief      Reads the position of encoder channel 4 along with the PRU
+ * timestamp of the edge that produced it.
+ *
+ * Timestamps come from the free-running PRU IEP timer which counts at
+ * RC_ENCODER_PRU_TICKS_PER_SEC. Take the difference between two samples as a
+ * uint32_t to get the time between edges even across a wrap. Comparing the
+ * generation of two samples tells if anything changed in between.
+ *
+ * @param[out] s     sample to fill in
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_encoder_pru_read_sample(rc_encoder_pru_sample_t* s);
+
 /**
  * @brief      Sets the current position of encoder channel 4. Usually for
  * resetting a counter to 0 but can set an arbitrary position if desired.
  *
+ * The new position is handed to the PRU as a command which it acknowledges
+ * once applied so no edges counted at the same time are lost or overwritten.
+ *
  * @param[in]  pos   The new position
  *
  * @return     0 on success, -1 on failure
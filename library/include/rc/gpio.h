@@ -152,6 +152,92 @@ int rc_gpio_poll(int chip, int pin, int timeout_ms, uint64_t* event_time_ns);
 void rc_gpio_cleanup(int chip, int pin);
 
 
+#define RC_GPIO_GROUP_MAX	64	///< most lines one handle can hold
+
+
+/**
+ * A set of lines on one gpio chip requested together through a single
+ * multi-line handle so they can all be read or written with one system call.
+ * Initialize with RC_GPIO_GROUP_INITIALIZER or rc_gpio_group_empty() before
+ * use.
+ */
+typedef struct rc_gpio_group_t{
+	int chip;			///< chip number, /dev/gpiochipX
+	int lines;			///< number of lines in the group
+	int pins[RC_GPIO_GROUP_MAX];	///< pin ID of each line
+	int fd;				///< line handle file descriptor
+	int initialized;		///< set to 1 by rc_gpio_group_init
+} rc_gpio_group_t;
+
+#define RC_GPIO_GROUP_INITIALIZER {\
+	.chip = 0,\
+	.lines = 0,\
+	.pins = {0},\
+	.fd = -1,\
+	.initialized = 0}
+
+
+/**
+ * @brief      Returns an rc_gpio_group_t with no lines requested.
+ *
+ * @return     empty rc_gpio_group_t
+ */
+rc_gpio_group_t rc_gpio_group_empty(void);
+
+
+/**
+ * @brief      Requests a set of pins on one chip as a single handle.
+ *
+ * Takes the same handle flags as rc_gpio_init and they apply to every line. A
+ * pin can't be in a group and also be initialized with rc_gpio_init. If the
+ * group was already initialized it is cleaned up first.
+ *
+ * @param      group         pointer to the group
+ * @param[in]  chip          The chip number, /dev/gpiochipX
+ * @param[in]  pins          array of n pin IDs
+ * @param[in]  n             number of pins, 1 to RC_GPIO_GROUP_MAX
+ * @param[in]  handle_flags  The handle flags
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_gpio_group_init(rc_gpio_group_t* group, int chip, const int* pins, int n, int handle_flags);
+
+
+/**
+ * @brief      Sets every line of an output group with one system call.
+ *
+ * @param      group   pointer to the group
+ * @param[in]  values  array of group->lines values in the same order as the
+ * pins given to rc_gpio_group_init, 0 for off (inactive), nonzero for on
+ * (active)
+ *
+ * @return     0 on success or -1 on failure
+ */
+int rc_gpio_group_set_values(rc_gpio_group_t* group, const int* values);
+
+
+/**
+ * @brief      Reads every line of a group with one system call.
+ *
+ * @param      group   pointer to the group
+ * @param[out] values  array of group->lines values to fill, 1 for high and 0
+ * for low
+ *
+ * @return     0 on success or -1 on failure
+ */
+int rc_gpio_group_get_values(rc_gpio_group_t* group, int* values);
+
+
+/**
+ * @brief      Releases the lines of a group.
+ *
+ * @param      group  pointer to the group
+ *
+ * @return     0 on success or -1 on failure
+ */
+int rc_gpio_group_cleanup(rc_gpio_group_t* group);
+
+
 
 
 #ifdef __cplusplus
@@ -38,6 +38,26 @@ extern "C" {
  */
 #define I2C_BUFFER_SIZE 128
 
+/**
+ * @brief      Maximum number of messages in one call to rc_i2c_transfer, this
+ *             is the limit imposed by the Linux I2C_RDWR ioctl.
+ */
+#define RC_I2C_MAX_MSGS 42
+
+/**
+ * @brief      One segment of a combined transfer for rc_i2c_transfer.
+ *
+ *             Each message carries its own device address so one transfer can
+ *             talk to several devices without changing the bus's configured
+ *             device address.
+ */
+typedef struct rc_i2c_msg_t{
+	uint8_t addr;	///< 7-bit device address
+	int read;	///< 1 to read from the device, 0 to write to it
+	uint16_t len;	///< number of bytes to read or write
+	uint8_t* buf;	///< data to write or buffer to read into
+} rc_i2c_msg_t;
+
 /**
  * @brief      Initializes a bus and sets it to talk to a particular device
  *             address.
@@ -94,6 +114,9 @@ int rc_i2c_read_byte(int bus, uint8_t regAddr, uint8_t *data);
  *
  *             This sends the device address and register address to be read
  *             from before reading the response, works for most i2c devices.
+ *             If the adapter supports it the register address write and the
+ *             read happen in one transfer with a repeated start between them,
+ *             otherwise they are two separate transfers.
  *
  * @param[in]  bus      The bus
  * @param[in]  regAddr  The register address
@@ -232,50 +255,96 @@ int rc_i2c_send_bytes(int bus, size_t count, uint8_t* data);
 int rc_i2c_send_byte(int bus, uint8_t data);
 
 /**
- * @brief      Locks the bus so other threads in the process know the bus is in
- *             use.
- *
- *             Locking a bus is similar to locking a mutex, it is a way for
- *             threads to communicate within one process when sharing a bus.
- *             This, however, is not a hard lock in the sense that it does not
- *             block and does not stop any of the other functions in this API
- *             from being called. It only serves as a flag that can be checked
- *             between threads if the user chooses to do so. This is encouraged
- *             in multithraded applications to prevent timing-sensitive i2c
- *             communication from being interrupted but is not enforced.
- *
- *             All read/write functions in this API will lock the bus during the
- *             transaction and return the lockstate to what it was at the
- *             beginning of the transaction. Ideally the user should lock the
- *             bus themselves before a sequence of transactions and unlock it
- *             afterwards.
+ * @brief      Performs several reads and writes as one combined transfer.
+ *
+ *             All messages are sent in order in a single system call. Each one
+ *             starts with a (repeated) START and only the last is followed by
+ *             a STOP, so no other bus master can get in between. A typical use
+ *             is a 1-byte write of a register address followed by a read, or
+ *             several of those pairs for different devices at once.
+ *
+ *             This does not use or change the device address set with
+ *             rc_i2c_init or rc_i2c_set_device_address. Not all I2C adapters
+ *             support this, in which case -1 is returned.
+ *
+ * @param[in]  bus   The bus
+ * @param      msgs  Array of messages, read buffers are written to
+ * @param[in]  n     Number of messages, between 1 and RC_I2C_MAX_MSGS
+ *
+ * @return     0 on success or -1 on failure
+ */
+int rc_i2c_transfer(int bus, rc_i2c_msg_t* msgs, int n);
+
+/**
+ * @brief      Reads multiple bytes from a register of a specific device
+ *             without changing the bus's configured device address.
+ *
+ *             Same as rc_i2c_read_bytes but with the device address given as
+ *             an argument, which saves the system calls to switch device
+ *             address back and forth when reading secondary devices such as
+ *             the magnetometer inside the MPU9250.
+ *
+ * @param[in]  bus      The bus
+ * @param[in]  devAddr  The device address
+ * @param[in]  regAddr  The register address
+ * @param[in]  count    number of bytes to read
+ * @param[out] data     The data pointer to write response to.
+ *
+ * @return     returns number of bytes read or -1 on failure
+ */
+int rc_i2c_read_device_bytes(int bus, uint8_t devAddr, uint8_t regAddr, size_t count, uint8_t* data);
+
+/**
+ * @brief      Claims the bus for the calling thread, blocking until any other
+ *             thread in the process has released it.
+ *
+ *             Each bus is arbitrated by a mutex with priority inheritance.
+ *             Threads waiting for the bus are queued in order of their
+ *             scheduling priority, so a high priority thread such as the IMU
+ *             interrupt handler is always next in line and a low priority
+ *             thread holding the bus is boosted until it releases it. This
+ *             keeps the wait of the highest priority thread bounded by one
+ *             transaction sequence and means lower priority reads queue up
+ *             instead of being dropped.
+ *
+ *             All read/write functions in this API claim the bus for the
+ *             duration of the transaction. Claims nest, so the user can claim
+ *             the bus before a sequence of transactions that must not be
+ *             interleaved with other threads, such as setting the device
+ *             address and then reading from it, and release it afterwards.
+ *             Every call must be matched with a call to rc_i2c_unlock_bus from
+ *             the same thread.
  *
  * @param[in]  bus   The bus ID
  *
- * @return     Returns the lock state (0 or 1) when this function is called, or -1 on
- *             error.
+ * @return     Returns 1 if the calling thread already held the bus, 0 if it was
+ *             just acquired, or -1 on error.
  */
 int rc_i2c_lock_bus(int bus);
 
 /**
- * @brief      Unlocks a bus to indicate to other threads in the process that
- *             the bus is now free.
+ * @brief      Releases one claim on the bus made by rc_i2c_lock_bus. The bus is
+ *             handed to the highest priority waiting thread once the calling
+ *             thread has released all of its claims.
  *
- *             see rc_i2c_lock_bus for further description.
+ *             Does nothing if the calling thread doesn't hold the bus.
  *
  * @param[in]  bus   The bus ID
  *
- * @return     Returns the lock state (0 or 1) when this function is called, or -1 on
- *             error.
+ * @return     Returns 1 if the calling thread held the bus when this function
+ *             was called, 0 if it didn't, or -1 on error.
  */
 int rc_i2c_unlock_bus(int bus);
 
 /**
  * @brief      Fetches the current lock state of the bus.
  *
+ *             This is only a snapshot, to wait for the bus use
+ *             rc_i2c_lock_bus.
+ *
  * @param[in]  bus   The bus ID
  *
- * @return     Returns 0 if unlocked, 1 if locked, or -1 on error.
+ * @return     Returns 0 if unlocked, 1 if held by any thread, or -1 on error.
  */
 int rc_i2c_get_lock(int bus);
 
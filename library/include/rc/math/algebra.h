@@ -61,10 +61,34 @@ int rc_algebra_qr_decomp(rc_matrix_t A, rc_matrix_t* Q, rc_matrix_t* R);
  */
 int rc_algebra_invert_matrix(rc_matrix_t A, rc_matrix_t* Ainv);
 
+/**
+ * @brief      Inverts matrix A and estimates its reciprocal condition number.
+ *
+ * Same as rc_algebra_invert_matrix but also writes the reciprocal of the
+ * 1-norm condition number 1/(||A||*||A^-1||) to rcond. This is close to 1 for
+ * a well conditioned matrix and approaches 0 as A approaches singularity. A
+ * value near machine epsilon (~2.2e-16) means the inverse is meaningless
+ * even though no pivot was exactly zero. rcond may be NULL if not needed.
+ *
+ * Singularity is detected from the LU pivots so no determinant is calculated.
+ * Ainv may be the same matrix as A to invert in place, and no memory is
+ * allocated if Ainv is already the same size as A. On failure rcond is set to
+ * 0.
+ *
+ * @param[in]  A      input matrix
+ * @param[out] Ainv   resulting inverted matrix
+ * @param[out] rcond  reciprocal condition number estimate, may be NULL
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_algebra_invert_matrix_rcond(rc_matrix_t A, rc_matrix_t* Ainv, double* rcond);
+
 /**
  * @brief      Inverts matrix A in place.
  *
- * The original contents of A are lost. Returns -1 if A is not invertible.
+ * The original contents of A are replaced by its inverse. Returns -1 and
+ * leaves A untouched if it is not invertible. The factorization is done in a
+ * temporary copy of A which is freed before returning.
  *
  * @param      A     matrix to be inverted
  *
@@ -86,20 +110,84 @@ int rc_algebra_invert_matrix_inplace(rc_matrix_t* A);
  */
 int rc_algebra_lin_system_solve(rc_matrix_t A, rc_vector_t b, rc_vector_t* x);
 
+/**
+ * @brief      Calculates the Cholesky decomposition A=L*L^T of a symmetric
+ * positive-definite matrix A.
+ *
+ * Only the lower triangle of A is read, the strictly upper triangle of L is
+ * set to zero. L may be the same matrix as A to decompose in place. If L is
+ * already allocated with the same dimensions as A then no memory is
+ * allocated. Returns -1 if A is not positive-definite.
+ *
+ * This is about half the work of an LUP decomposition and is the preferred
+ * way to solve systems involving covariance matrices.
+ *
+ * @param[in]  A     symmetric positive-definite input matrix
+ * @param[out] L     lower triangular output
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_algebra_cholesky_decomp(rc_matrix_t A, rc_matrix_t* L);
+
+/**
+ * @brief      Solves Ax=b given the Cholesky factor L of A.
+ *
+ * L must come from rc_algebra_cholesky_decomp. The system is solved with one
+ * forward and one backward triangular substitution. x may be the same vector
+ * as b, and no memory is allocated if x is already the right length.
+ *
+ * @param[in]  L     lower triangular Cholesky factor of A
+ * @param[in]  b     column vector b
+ * @param[out] x     solution column vector
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_algebra_cholesky_solve(rc_matrix_t L, rc_vector_t b, rc_vector_t* x);
+
+/**
+ * @brief      Solves AX=B for matrix X given the Cholesky factor L of A.
+ *
+ * Same as rc_algebra_cholesky_solve but for every column of B at once. X may
+ * be the same matrix as B, and no memory is allocated if X is already the
+ * same size as B.
+ *
+ * @param[in]  L     lower triangular Cholesky factor of A
+ * @param[in]  B     right hand side matrix
+ * @param[out] X     solution matrix
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_algebra_cholesky_solve_matrix(rc_matrix_t L, rc_matrix_t B, rc_matrix_t* X);
+
+/**
+ * @brief      Inverts a symmetric positive-definite matrix A in place.
+ *
+ * Uses Cholesky decomposition instead of LUP and never allocates memory. The
+ * original contents of A are lost. Returns -1 and leaves A in an undefined
+ * state if A is not positive-definite.
+ *
+ * @param      A     symmetric positive-definite matrix to be inverted
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_algebra_invert_spd_inplace(rc_matrix_t* A);
+
 /**
  * @brief      Sets the zero tolerance for detecting singular matrices.
  *
- * When inverting matrices or solving a linear system, this library first checks
- * that the determinant of the matrix is non-zero. Due to the rounding errors
- * that come from float-point math, we cannot check if the determinant is
- * exactly zero. Instead, it is checked to be smaller in magnitude than the
+ * When inverting matrices or solving a linear system, this library checks
+ * that every pivot of the elimination is non-zero. Due to the rounding errors
+ * that come from float-point math, we cannot check if a pivot is exactly
+ * zero. Instead, it is checked to be smaller in magnitude than the
  * zero-tolerance.
  *
  * The default value is 10^-8 but it can be changed here if the user is dealing
  * with unusually small or large floating point values.
  *
  * This only effects the operation of rc_algebra_invert_matrix,
- * rc_algebra_invert_matrix_inplace, and rc_algebra_lin_system_solve.
+ * rc_algebra_invert_matrix_rcond, rc_algebra_invert_matrix_inplace, and
+ * rc_algebra_lin_system_solve. Use rc_algebra_invert_matrix_rcond for a scale
+ * independent measure of how close a matrix is to singular.
  *
  * @param[in]  tol   The zero-tolerance
  */
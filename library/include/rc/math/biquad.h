@@ -0,0 +1,267 @@
+/**
+ * <rc/math/biquad.h>
+ *
+ * @brief      Cascaded second-order-section (biquad) filters.
+ *
+ * An rc_biquad_t implements the same discrete SISO transfer functions as
+ * rc_filter_t, but factored into a cascade of first and second order sections
+ * each evaluated in transposed direct form II. High order filters such as 4th
+ * to 8th order Butterworth filters are numerically fragile when their
+ * polynomial coefficients are used directly. The factored form keeps each
+ * section's poles accurate and is also cheaper to march since there are no
+ * ring buffers to index, just two state variables per section.
+ *
+ * All coefficients and state live inside the struct in contiguous arrays, so
+ * nothing needs to be freed and the struct can be copied freely. Biquads can
+ * be designed directly with rc_biquad_butterworth_lowpass() and
+ * rc_biquad_butterworth_highpass(), converted from any existing rc_filter_t
+ * with rc_biquad_from_filter(), or loaded from a table of sections with
+ * rc_biquad_from_sections().
+ *
+ * Each section k evaluates
+ *
+ * ```
+ * y     = b0[k]*x + s1[k]
+ * s1[k] = b1[k]*x - a1[k]*y + s2[k]
+ * s2[k] = b2[k]*x - a2[k]*y
+ * ```
+ *
+ * and feeds y to the next section as its input x.
+ *
+ * See the rc_test_biquad.c example for use case.
+ *
+ * @addtogroup Biquad
+ * @ingroup    Math
+ * @{
+ */
+
+#ifndef RC_BIQUAD_H
+#define RC_BIQUAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <rc/math/filter.h>
+
+/**
+ * Maximum number of sections in an rc_biquad_t, this allows filters up to
+ * order 16.
+ */
+#define RC_BIQUAD_MAX_SECTIONS	8
+
+/**
+ * @brief      Struct containing coefficients and state of a biquad cascade.
+ *
+ * Coefficients are normalized so that the leading denominator coefficient a0
+ * of every section is 1. The user can read values directly from this struct
+ * but should use the functions in this API to change them.
+ */
+typedef struct rc_biquad_t{
+	/** @name transfer function properties */
+	///@{
+	int order;		///< total order of the cascade
+	int sections;		///< number of sections in use
+	double dt;		///< timestep in seconds
+	double b0[RC_BIQUAD_MAX_SECTIONS]; ///< numerator coefficients
+	double b1[RC_BIQUAD_MAX_SECTIONS];
+	double b2[RC_BIQUAD_MAX_SECTIONS];
+	double a1[RC_BIQUAD_MAX_SECTIONS]; ///< denominator coefficients
+	double a2[RC_BIQUAD_MAX_SECTIONS];
+	///@}
+
+	/** @name transposed direct form II state */
+	///@{
+	double s1[RC_BIQUAD_MAX_SECTIONS];
+	double s2[RC_BIQUAD_MAX_SECTIONS];
+	///@}
+
+	/** @name saturation settings */
+	///@{
+	int sat_en;		///< set to 1 by rc_biquad_enable_saturation()
+	double sat_min;		///< lower saturation limit
+	double sat_max;		///< upper saturation limit
+	int sat_flag;		///< 1 if saturated on the last step
+	///@}
+
+	/** @name other */
+	///@{
+	double newest_input;	///< shortcut for the most recent input
+	double newest_output;	///< shortcut for the most recent output
+	uint64_t step;		///< steps since last reset
+	int initialized;	///< initialization flag
+	///@}
+} rc_biquad_t;
+
+#define RC_BIQUAD_INITIALIZER {\
+	.order		= 0,\
+	.sections	= 0,\
+	.dt		= 0.0,\
+	.b0		= {0.0},\
+	.b1		= {0.0},\
+	.b2		= {0.0},\
+	.a1		= {0.0},\
+	.a2		= {0.0},\
+	.s1		= {0.0},\
+	.s2		= {0.0},\
+	.sat_en		= 0,\
+	.sat_min	= 0.0,\
+	.sat_max	= 0.0,\
+	.sat_flag	= 0,\
+	.newest_input	= 0.0,\
+	.newest_output	= 0.0,\
+	.step		= 0,\
+	.initialized	= 0}
+
+/**
+ * @brief      Returns an rc_biquad_t struct which is known to be empty.
+ *
+ * Serves the same purpose as rc_filter_empty.
+ *
+ * @return     Empty zero-filled rc_biquad_t struct
+ */
+rc_biquad_t rc_biquad_empty(void);
+
+/**
+ * @brief      Populates a biquad cascade from a table of sections.
+ *
+ * Each row of sos contains the coefficients {b0, b1, b2, a0, a1, a2} of one
+ * section in the same order used by MATLAB's sos matrices. Each row is
+ * normalized by its own a0 which must be nonzero. A section with a2 and b2
+ * both zero is treated as first order when counting the filter's order.
+ *
+ * @param[out] b         Pointer to user's rc_biquad_t struct
+ * @param[in]  dt        Timestep in seconds
+ * @param[in]  sos       Table of section coefficients
+ * @param[in]  sections  Number of sections, between 1 and
+ *                       RC_BIQUAD_MAX_SECTIONS
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_biquad_from_sections(rc_biquad_t* b, double dt, const double sos[][6], int sections);
+
+/**
+ * @brief      Factors an existing polynomial rc_filter_t into a biquad
+ * cascade.
+ *
+ * The roots of the numerator and denominator are found numerically and
+ * grouped into sections, pairing each pole pair with the nearest zeros. Pole
+ * pairs closest to the unit circle are placed last in the cascade. The gain
+ * and saturation settings of f are carried over, soft start is not. The filter
+ * state is not copied, the biquad starts at rest.
+ *
+ * This works for any filter in rc/math/filter.h up to order
+ * 2*RC_BIQUAD_MAX_SECTIONS. For Butterworth filters prefer
+ * rc_biquad_butterworth_lowpass() and rc_biquad_butterworth_highpass() which
+ * compute the sections directly without ever forming the polynomial.
+ *
+ * @param[out] b     Pointer to user's rc_biquad_t struct
+ * @param[in]  f     Initialized filter to convert
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_biquad_from_filter(rc_biquad_t* b, rc_filter_t f);
+
+/**
+ * @brief      Creates a Butterworth lowpass filter of specified order and
+ * cutoff frequency as a biquad cascade.
+ *
+ * Produces the same transfer function as rc_filter_butterworth_lowpass(),
+ * including frequency prewarping at wc, but the sections are calculated
+ * directly from the analog pole locations.
+ *
+ * @param[out] b      Pointer to user's rc_biquad_t struct
+ * @param[in]  order  The order, between 1 and 2*RC_BIQUAD_MAX_SECTIONS
+ * @param[in]  dt     Timestep in seconds
+ * @param[in]  wc     Cutoff frequency in rad/s
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_biquad_butterworth_lowpass(rc_biquad_t* b, int order, double dt, double wc);
+
+/**
+ * @brief      Creates a Butterworth highpass filter of specified order and
+ * cutoff frequency as a biquad cascade.
+ *
+ * The passband gain is 1. Note that rc_filter_butterworth_highpass() instead
+ * has a passband gain of wc^order, so the two only match after scaling.
+ *
+ * @param[out] b      Pointer to user's rc_biquad_t struct
+ * @param[in]  order  The order, between 1 and 2*RC_BIQUAD_MAX_SECTIONS
+ * @param[in]  dt     Timestep in seconds
+ * @param[in]  wc     Cutoff frequency in rad/s
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_biquad_butterworth_highpass(rc_biquad_t* b, int order, double dt, double wc);
+
+/**
+ * @brief      March a biquad cascade forward one step with new input.
+ *
+ * Behaves like rc_filter_march(). If saturation is enabled the output is
+ * bound and the saturation flag set accordingly. Like rc_filter_march() the
+ * saturated output is what gets fed back into the state of the last section,
+ * which limits integrator windup. The loop over the other sections has no
+ * branches.
+ *
+ * @param      b          Pointer to user's rc_biquad_t struct
+ * @param[in]  new_input  The new input
+ *
+ * @return     Returns the new output. Could be -1.0 if an error occurred.
+ */
+double rc_biquad_march(rc_biquad_t* b, double new_input);
+
+/**
+ * @brief      Resets the state of the cascade to 0 without touching the
+ * coefficients or saturation settings.
+ *
+ * @param      b     Pointer to user's rc_biquad_t struct
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_biquad_reset(rc_biquad_t* b);
+
+/**
+ * @brief      Sets the state of the cascade to the steady state it would reach
+ * after a long constant input.
+ *
+ * Useful for starting a lowpass filter at the current sensor reading instead
+ * of ramping up from 0. Sections with a pole at z=1 have no steady state and
+ * are left at rest.
+ *
+ * @param      b     Pointer to user's rc_biquad_t struct
+ * @param[in]  in    The constant input to settle at
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_biquad_prefill(rc_biquad_t* b, double in);
+
+/**
+ * @brief      Enables saturation between bounds min and max.
+ *
+ * @param      b     Pointer to user's rc_biquad_t struct
+ * @param[in]  min   The lower bound
+ * @param[in]  max   The upper bound
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_biquad_enable_saturation(rc_biquad_t* b, double min, double max);
+
+/**
+ * @brief      Prints the coefficients of each section to the screen.
+ *
+ * @param[in]  b     The biquad cascade to print
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_biquad_print(rc_biquad_t b);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_BIQUAD_H
+
+/** @} end group math*/
@@ -30,6 +30,7 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include <stddef.h>
 #include <rc/math/vector.h>
 #include <rc/math/ring_buffer.h>
 
@@ -209,6 +210,25 @@ int rc_filter_print(rc_filter_t f);
  */
 double rc_filter_march(rc_filter_t* f, double new_input);
 
+/**
+ * @brief      March a filter forward over a whole array of inputs.
+ *
+ * Equivalent to calling rc_filter_march() on every element of in and writing
+ * each return value to out, and produces bit-identical results including
+ * saturation, soft start, the step counter and the ring buffers. The filter is
+ * only checked once instead of once per sample which makes this the faster
+ * choice for processing logs or collecting calibration data. in and out may
+ * point to the same array to filter in place.
+ *
+ * @param      f     Pointer to user's rc_filter_t struct
+ * @param[in]  in    Array of n inputs
+ * @param[out] out   Array to write the n outputs to
+ * @param[in]  n     Number of samples
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_filter_march_block(rc_filter_t* f, const double* in, double* out, size_t n);
+
 /**
  * @brief      Resets all previous inputs and outputs to 0. Also resets the step
  * counter & saturation flag.
@@ -0,0 +1,208 @@
+/**
+ * <rc/math/filter_bank.h>
+ *
+ * @brief      Banks of identical SISO filters marched together.
+ *
+ * It is common to run the same filter on many signals, for example the same
+ * lowpass on all 3 axes of the gyro, accelerometer and magnetometer. Instead of
+ * keeping one rc_filter_t per signal, an rc_filter_bank_t holds one copy of
+ * the transfer function coefficients shared by N channels and stores the state
+ * of every channel in a structure-of-arrays layout. rc_filter_bank_march()
+ * then steps every channel at once with loops over the channel index that the
+ * compiler can vectorize.
+ *
+ * The coefficients are taken from an existing rc_filter_t so any of the filter
+ * design functions in rc/math/filter.h can be used to create them. Each
+ * channel is evaluated in transposed direct form II which only needs one state
+ * variable per order per channel, so there are no ring buffers to index.
+ * Saturation limits are set per channel.
+ *
+ * See the rc_test_filter_bank.c example for use case.
+ *
+ * @addtogroup Filter_Bank
+ * @ingroup    Math
+ * @{
+ */
+
+#ifndef RC_FILTER_BANK_H
+#define RC_FILTER_BANK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <rc/math/filter.h>
+
+/**
+ * @brief      Struct containing shared coefficients and per-channel state of a
+ * filter bank.
+ *
+ * Points to dynamically allocated memory which make it necessary to use the
+ * allocation and free function in this API for proper use. The user can read
+ * values directly from this struct but should use the functions in this API
+ * to change them.
+ */
+typedef struct rc_filter_bank_t{
+	/** @name transfer function properties */
+	///@{
+	int channels;		///< number of channels
+	int order;		///< transfer function order
+	double dt;		///< timestep in seconds
+	double* b;		///< order+1 numerator coefficients, gain included
+	double* a;		///< order+1 denominator coefficients, a[0]=1
+	///@}
+
+	/** @name state, element k of channel ch is at state[k*channels+ch] */
+	///@{
+	double* state;
+	///@}
+
+	/** @name per-channel saturation settings */
+	///@{
+	int* sat_en;		///< set to 1 by rc_filter_bank_enable_saturation()
+	double* sat_min;	///< lower saturation limit
+	double* sat_max;	///< upper saturation limit
+	int* sat_flag;		///< 1 if saturated on the last step
+	///@}
+
+	/** @name other */
+	///@{
+	uint64_t step;		///< steps since last reset
+	int initialized;	///< initialization flag
+	///@}
+} rc_filter_bank_t;
+
+#define RC_FILTER_BANK_INITIALIZER {\
+	.channels	= 0,\
+	.order		= 0,\
+	.dt		= 0.0,\
+	.b		= NULL,\
+	.a		= NULL,\
+	.state		= NULL,\
+	.sat_en		= NULL,\
+	.sat_min	= NULL,\
+	.sat_max	= NULL,\
+	.sat_flag	= NULL,\
+	.step		= 0,\
+	.initialized	= 0}
+
+/**
+ * @brief      Returns an rc_filter_bank_t struct which is known to be empty.
+ *
+ * Serves the same purpose as rc_filter_empty and must be used to initialize
+ * a filter bank before calling rc_filter_bank_alloc.
+ *
+ * @return     Empty zero-filled rc_filter_bank_t struct
+ */
+rc_filter_bank_t rc_filter_bank_empty(void);
+
+/**
+ * @brief      Allocates memory for a bank of channels all sharing the transfer
+ * function of filter f.
+ *
+ * The numerator, denominator and gain of f are copied and normalized so the
+ * leading denominator coefficient is 1. If f has saturation enabled then every
+ * channel starts with the same limits. Soft start and the current state of f
+ * are not copied, all channels start at rest. Any memory previously allocated
+ * by the bank is freed first.
+ *
+ * @param[out] bank      Pointer to user's rc_filter_bank_t struct
+ * @param[in]  channels  The number of channels, must be >=1
+ * @param[in]  f         Initialized filter to take the coefficients from
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_filter_bank_alloc(rc_filter_bank_t* bank, int channels, rc_filter_t f);
+
+/**
+ * @brief      Frees the memory allocated by a filter bank and zeros out the
+ * struct.
+ *
+ * @param      bank  Pointer to user's rc_filter_bank_t struct
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_filter_bank_free(rc_filter_bank_t* bank);
+
+/**
+ * @brief      March every channel of the bank forward one step.
+ *
+ * Reads one new input per channel from in and writes one new output per
+ * channel to out. Both arrays must be at least bank->channels long and must
+ * not overlap. Channels with saturation enabled are bound to their limits and
+ * their saturation flags set accordingly. Like rc_filter_march() the saturated
+ * output is what gets fed back into the state.
+ *
+ * @param      bank  Pointer to user's rc_filter_bank_t struct
+ * @param[in]  in    Array of new inputs, one per channel
+ * @param[out] out   Array to write the new outputs to, one per channel
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_filter_bank_march(rc_filter_bank_t* bank, const double* in, double* out);
+
+/**
+ * @brief      Resets the state of every channel to 0.
+ *
+ * Saturation settings are kept.
+ *
+ * @param      bank  Pointer to user's rc_filter_bank_t struct
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_filter_bank_reset(rc_filter_bank_t* bank);
+
+/**
+ * @brief      Resets the state of one channel to 0 without affecting the
+ * others.
+ *
+ * @param      bank  Pointer to user's rc_filter_bank_t struct
+ * @param[in]  ch    The channel to reset, starting at 0
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_filter_bank_reset_channel(rc_filter_bank_t* bank, int ch);
+
+/**
+ * @brief      Enables saturation of one channel between bounds min and max.
+ *
+ * @param      bank  Pointer to user's rc_filter_bank_t struct
+ * @param[in]  ch    The channel, starting at 0
+ * @param[in]  min   The lower bound
+ * @param[in]  max   The upper bound
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_filter_bank_enable_saturation(rc_filter_bank_t* bank, int ch, double min, double max);
+
+/**
+ * @brief      Disables saturation of one channel.
+ *
+ * @param      bank  Pointer to user's rc_filter_bank_t struct
+ * @param[in]  ch    The channel, starting at 0
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_filter_bank_disable_saturation(rc_filter_bank_t* bank, int ch);
+
+/**
+ * @brief      Checks if one channel saturated the last time
+ * rc_filter_bank_march() was called.
+ *
+ * @param      bank  Pointer to user's rc_filter_bank_t struct
+ * @param[in]  ch    The channel, starting at 0
+ *
+ * @return     Returns 1 if the channel saturated, 0 if it didn't, or -1 on
+ * error.
+ */
+int rc_filter_bank_get_saturation_flag(rc_filter_bank_t* bank, int ch);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_FILTER_BANK_H
+
+/** @} end group math*/
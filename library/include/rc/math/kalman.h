@@ -11,6 +11,12 @@
  * rc_kalman_update_lin to calculate the predicted state x_pre and predicted
  * sensor measurements h internally each step.
  *
+ * All intermediate matrices and vectors used by the update functions are kept
+ * in the rc_kalman_t struct and sized once by rc_kalman_alloc_lin() or
+ * rc_kalman_alloc_ekf(). Therefore the update functions do not touch the heap
+ * in steady state and are safe to call from time-critical loops such as the
+ * IMU interrupt callback.
+ *
  *
  * Basic loop structure for Linear case:
  *
@@ -101,6 +107,22 @@ typedef struct rc_kalman_t {
 	rc_vector_t x_pre;	///< Predicted state x[k|k-1] = f(x[k-1],u[k])
 	///@}
 
+	/** @name Workspace preallocated by rc_kalman_alloc for the update functions */
+	///@{
+	rc_matrix_t FT;		///< F transposed
+	rc_matrix_t HT;		///< H transposed
+	rc_matrix_t newP;	///< scratch covariance while P is updated
+	rc_matrix_t S;		///< innovation covariance H*P*H^T + R, then its Cholesky factor
+	rc_matrix_t L;		///< Kalman gain
+	rc_matrix_t LT;		///< Kalman gain transposed, solved as S^-1*H*P
+	rc_matrix_t tmpxx;	///< Nx by Nx scratch matrix
+	rc_matrix_t tmpyx;	///< Ny by Nx scratch matrix
+	rc_vector_t h;		///< predicted measurement in linear case
+	rc_vector_t z;		///< innovation y-h
+	rc_vector_t tmp1;	///< state-length scratch vector
+	rc_vector_t tmp2;	///< state-length scratch vector
+	///@}
+
 	/** @name other */
 	///@{
 	int initialized;	///< set to 1 once initialized with rc_kalman_alloc
@@ -118,6 +140,18 @@ typedef struct rc_kalman_t {
 	.Pi = RC_MATRIX_INITIALIZER,\
 	.x_est = RC_VECTOR_INITIALIZER,\
 	.x_pre = RC_VECTOR_INITIALIZER,\
+	.FT = RC_MATRIX_INITIALIZER,\
+	.HT = RC_MATRIX_INITIALIZER,\
+	.newP = RC_MATRIX_INITIALIZER,\
+	.S = RC_MATRIX_INITIALIZER,\
+	.L = RC_MATRIX_INITIALIZER,\
+	.LT = RC_MATRIX_INITIALIZER,\
+	.tmpxx = RC_MATRIX_INITIALIZER,\
+	.tmpyx = RC_MATRIX_INITIALIZER,\
+	.h = RC_VECTOR_INITIALIZER,\
+	.z = RC_VECTOR_INITIALIZER,\
+	.tmp1 = RC_VECTOR_INITIALIZER,\
+	.tmp2 = RC_VECTOR_INITIALIZER,\
 	.initialized = 0,\
 	.step = 0}
 
@@ -26,6 +26,7 @@ extern "C" {
 
 #include <rc/math/vector.h>
 #include <rc/math/matrix.h>
+#include <rc/math/small_matrix.h>
 
 /**
  * @brief      Returns the length of a quaternion vector by finding its 2-norm.
@@ -283,6 +284,20 @@ int  rc_quaternion_rotate_vector_array(double v[3], double q[4]);
  */
 int   rc_quaternion_to_rotation_matrix(rc_vector_t q, rc_matrix_t* m);
 
+/**
+ * @brief      Converts a normalized quaternion to a stack-allocated 3x3
+ * orthogonal rotation matrix.
+ *
+ * Identical to rc_quaternion_to_rotation_matrix() but never touches the heap
+ * which makes it suitable for use in estimator and control loops.
+ *
+ * @param[in]  q     The quarternion in form of an array of length 4
+ * @param[out] m     output 3x3 rotation matrix
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int  rc_quaternion_to_rotation_mat3(double q[4], rc_mat3_t* m);
+
 
 
 #ifdef __cplusplus
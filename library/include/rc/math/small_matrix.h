@@ -0,0 +1,395 @@
+/**
+ * <rc/math/small_matrix.h>
+ *
+ * @brief      Fixed-size matrices that live on the stack.
+ *
+ * rc_matrix_t keeps its data on the heap behind an array of row pointers which
+ * is flexible but means every new matrix costs two calls to malloc. The types
+ * in this header instead hold their data inline in contiguous row-major
+ * storage so they can be declared as local variables in a control loop and
+ * passed around without ever touching the allocator.
+ *
+ * There are dedicated 3x3 and 4x4 types rc_mat3_t and rc_mat4_t with matching
+ * vectors rc_vec3_t and rc_vec4_t, plus a generic rc_small_matrix_t and
+ * rc_small_vector_t which hold any dimension up to RC_SMALL_MATRIX_MAX_DIM.
+ *
+ * Since rc_matrix_t also stores its data contiguously in row-major order,
+ * conversion between the two can be done without copying. The *_as_matrix()
+ * functions fill in an rc_matrix_t whose rows point into the small matrix and
+ * rc_mat3_from_matrix()/rc_mat4_from_matrix() return a pointer into the data
+ * of an existing rc_matrix_t. Matrices produced by *_as_matrix() do not own
+ * their memory and must NEVER be passed to rc_matrix_free() or to any function
+ * that would resize them.
+ *
+ * All functions that produce a result allow the output to be the same object
+ * as one of the inputs.
+ *
+ * @addtogroup Small_Matrix
+ * @ingroup    Math
+ * @{
+ */
+
+
+#ifndef RC_SMALL_MATRIX_H
+#define RC_SMALL_MATRIX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <rc/math/vector.h>
+#include <rc/math/matrix.h>
+
+/** largest number of rows or columns a rc_small_matrix_t can hold */
+#define RC_SMALL_MATRIX_MAX_DIM 12
+
+/** 3x3 matrix, access elements with m.d[row][col] */
+typedef struct rc_mat3_t{
+	double d[3][3];
+} rc_mat3_t;
+
+/** 4x4 matrix, access elements with m.d[row][col] */
+typedef struct rc_mat4_t{
+	double d[4][4];
+} rc_mat4_t;
+
+/** vector of length 3 */
+typedef struct rc_vec3_t{
+	double d[3];
+} rc_vec3_t;
+
+/** vector of length 4 */
+typedef struct rc_vec4_t{
+	double d[4];
+} rc_vec4_t;
+
+/**
+ * @brief      Generic matrix with up to RC_SMALL_MATRIX_MAX_DIM rows and
+ * columns.
+ *
+ * Data is stored contiguously in row-major order with a row stride equal to
+ * cols, exactly like the data block of an rc_matrix_t. Use the
+ * RC_SMALL_MATRIX_AT macro to access elements.
+ */
+typedef struct rc_small_matrix_t{
+	int rows;	///< number of rows in the matrix
+	int cols;	///< number of columns in the matrix
+	double d[RC_SMALL_MATRIX_MAX_DIM*RC_SMALL_MATRIX_MAX_DIM]; ///< row-major data
+} rc_small_matrix_t;
+
+/** Generic vector with up to RC_SMALL_MATRIX_MAX_DIM elements */
+typedef struct rc_small_vector_t{
+	int len;	///< number of elements in the vector
+	double d[RC_SMALL_MATRIX_MAX_DIM]; ///< vector data
+} rc_small_vector_t;
+
+/** Access element at row i and column j of rc_small_matrix_t A */
+#define RC_SMALL_MATRIX_AT(A,i,j) ((A).d[(i)*(A).cols+(j)])
+
+
+/**
+ * @brief      Sets a 3x3 matrix to identity.
+ *
+ * @param[out] A     matrix to set
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_mat3_identity(rc_mat3_t* A);
+
+/**
+ * @brief      Multiplies C=A*B for 3x3 matrices.
+ *
+ * @param[in]  A     left matrix
+ * @param[in]  B     right matrix
+ * @param[out] C     result, may be the same as A or B
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_mat3_multiply(const rc_mat3_t* A, const rc_mat3_t* B, rc_mat3_t* C);
+
+/**
+ * @brief      Transposes a 3x3 matrix.
+ *
+ * @param[in]  A     input matrix
+ * @param[out] T     transpose of A, may be the same as A
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_mat3_transpose(const rc_mat3_t* A, rc_mat3_t* T);
+
+/**
+ * @brief      Inverts a 3x3 matrix using its adjugate.
+ *
+ * @param[in]  A     input matrix
+ * @param[out] Ainv  inverse of A, may be the same as A
+ *
+ * @return     0 on success, -1 if A is singular
+ */
+int rc_mat3_invert(const rc_mat3_t* A, rc_mat3_t* Ainv);
+
+/**
+ * @brief      Cholesky decomposition A=L*L^T of a symmetric positive definite
+ * 3x3 matrix.
+ *
+ * Only the lower triangle of A is read. The upper triangle of L is zeroed.
+ *
+ * @param[in]  A     symmetric positive definite matrix
+ * @param[out] L     lower triangular factor, may be the same as A
+ *
+ * @return     0 on success, -1 if A is not positive definite
+ */
+int rc_mat3_cholesky(const rc_mat3_t* A, rc_mat3_t* L);
+
+/**
+ * @brief      Multiplies a 3x3 matrix by a column vector, c=A*v.
+ *
+ * @param[in]  A     matrix
+ * @param[in]  v     column vector
+ * @param[out] c     result, may be the same as v
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_mat3_times_vec(const rc_mat3_t* A, const rc_vec3_t* v, rc_vec3_t* c);
+
+/**
+ * @brief      Views a rc_mat3_t as an rc_matrix_t without copying.
+ *
+ * The caller provides storage for the 3 row pointers which must outlive the
+ * view. Do not call rc_matrix_free() on the resulting view.
+ *
+ * @param      A     matrix whose data will be viewed
+ * @param      rows  caller-provided array of 3 row pointers
+ * @param[out] view  rc_matrix_t that shares its data with A
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_mat3_as_matrix(rc_mat3_t* A, double* rows[3], rc_matrix_t* view);
+
+/**
+ * @brief      Views the data of a 3x3 rc_matrix_t as a rc_mat3_t without
+ * copying.
+ *
+ * @param[in]  A     3x3 rc_matrix_t
+ *
+ * @return     pointer into A's data, or NULL if A is not an initialized 3x3
+ * matrix
+ */
+rc_mat3_t* rc_mat3_from_matrix(rc_matrix_t A);
+
+
+/**
+ * @brief      Sets a 4x4 matrix to identity.
+ *
+ * @param[out] A     matrix to set
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_mat4_identity(rc_mat4_t* A);
+
+/**
+ * @brief      Multiplies C=A*B for 4x4 matrices.
+ *
+ * @param[in]  A     left matrix
+ * @param[in]  B     right matrix
+ * @param[out] C     result, may be the same as A or B
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_mat4_multiply(const rc_mat4_t* A, const rc_mat4_t* B, rc_mat4_t* C);
+
+/**
+ * @brief      Transposes a 4x4 matrix.
+ *
+ * @param[in]  A     input matrix
+ * @param[out] T     transpose of A, may be the same as A
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_mat4_transpose(const rc_mat4_t* A, rc_mat4_t* T);
+
+/**
+ * @brief      Inverts a 4x4 matrix with Gauss-Jordan elimination and partial
+ * pivoting.
+ *
+ * @param[in]  A     input matrix
+ * @param[out] Ainv  inverse of A, may be the same as A
+ *
+ * @return     0 on success, -1 if A is singular
+ */
+int rc_mat4_invert(const rc_mat4_t* A, rc_mat4_t* Ainv);
+
+/**
+ * @brief      Cholesky decomposition A=L*L^T of a symmetric positive definite
+ * 4x4 matrix.
+ *
+ * Only the lower triangle of A is read. The upper triangle of L is zeroed.
+ *
+ * @param[in]  A     symmetric positive definite matrix
+ * @param[out] L     lower triangular factor, may be the same as A
+ *
+ * @return     0 on success, -1 if A is not positive definite
+ */
+int rc_mat4_cholesky(const rc_mat4_t* A, rc_mat4_t* L);
+
+/**
+ * @brief      Multiplies a 4x4 matrix by a column vector, c=A*v.
+ *
+ * @param[in]  A     matrix
+ * @param[in]  v     column vector
+ * @param[out] c     result, may be the same as v
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_mat4_times_vec(const rc_mat4_t* A, const rc_vec4_t* v, rc_vec4_t* c);
+
+/**
+ * @brief      Views a rc_mat4_t as an rc_matrix_t without copying.
+ *
+ * The caller provides storage for the 4 row pointers which must outlive the
+ * view. Do not call rc_matrix_free() on the resulting view.
+ *
+ * @param      A     matrix whose data will be viewed
+ * @param      rows  caller-provided array of 4 row pointers
+ * @param[out] view  rc_matrix_t that shares its data with A
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_mat4_as_matrix(rc_mat4_t* A, double* rows[4], rc_matrix_t* view);
+
+/**
+ * @brief      Views the data of a 4x4 rc_matrix_t as a rc_mat4_t without
+ * copying.
+ *
+ * @param[in]  A     4x4 rc_matrix_t
+ *
+ * @return     pointer into A's data, or NULL if A is not an initialized 4x4
+ * matrix
+ */
+rc_mat4_t* rc_mat4_from_matrix(rc_matrix_t A);
+
+
+/**
+ * @brief      Sets the dimensions of a generic small matrix and fills it with
+ * zeros.
+ *
+ * @param[out] A     matrix to set up
+ * @param[in]  rows  number of rows, 1 to RC_SMALL_MATRIX_MAX_DIM
+ * @param[in]  cols  number of columns, 1 to RC_SMALL_MATRIX_MAX_DIM
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_small_matrix_zeros(rc_small_matrix_t* A, int rows, int cols);
+
+/**
+ * @brief      Sets a generic small matrix to a dim-by-dim identity matrix.
+ *
+ * @param[out] A     matrix to set up
+ * @param[in]  dim   number of rows and columns, 1 to RC_SMALL_MATRIX_MAX_DIM
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_small_matrix_identity(rc_small_matrix_t* A, int dim);
+
+/**
+ * @brief      Multiplies C=A*B.
+ *
+ * @param[in]  A     left matrix
+ * @param[in]  B     right matrix, must have as many rows as A has columns
+ * @param[out] C     result, may be the same as A or B
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_small_matrix_multiply(const rc_small_matrix_t* A, const rc_small_matrix_t* B, rc_small_matrix_t* C);
+
+/**
+ * @brief      Transposes a small matrix.
+ *
+ * @param[in]  A     input matrix
+ * @param[out] T     transpose of A, may be the same as A
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_small_matrix_transpose(const rc_small_matrix_t* A, rc_small_matrix_t* T);
+
+/**
+ * @brief      Inverts a square small matrix with Gauss-Jordan elimination and
+ * partial pivoting.
+ *
+ * @param[in]  A     input matrix
+ * @param[out] Ainv  inverse of A, may be the same as A
+ *
+ * @return     0 on success, -1 if A is singular or not square
+ */
+int rc_small_matrix_invert(const rc_small_matrix_t* A, rc_small_matrix_t* Ainv);
+
+/**
+ * @brief      Cholesky decomposition A=L*L^T of a symmetric positive definite
+ * small matrix.
+ *
+ * Only the lower triangle of A is read. The upper triangle of L is zeroed.
+ *
+ * @param[in]  A     symmetric positive definite matrix
+ * @param[out] L     lower triangular factor, may be the same as A
+ *
+ * @return     0 on success, -1 if A is not square or positive definite
+ */
+int rc_small_matrix_cholesky(const rc_small_matrix_t* A, rc_small_matrix_t* L);
+
+/**
+ * @brief      Multiplies a small matrix by a column vector, c=A*v.
+ *
+ * @param[in]  A     matrix
+ * @param[in]  v     column vector with length equal to A's columns
+ * @param[out] c     result, may be the same as v
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_small_matrix_times_vec(const rc_small_matrix_t* A, const rc_small_vector_t* v, rc_small_vector_t* c);
+
+/**
+ * @brief      Views a rc_small_matrix_t as an rc_matrix_t without copying.
+ *
+ * The caller provides storage for the row pointers which must outlive the
+ * view. Do not call rc_matrix_free() on the resulting view.
+ *
+ * @param      A     matrix whose data will be viewed
+ * @param      rows  caller-provided array of at least A->rows row pointers
+ * @param[out] view  rc_matrix_t that shares its data with A
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_small_matrix_as_matrix(rc_small_matrix_t* A, double* rows[], rc_matrix_t* view);
+
+/**
+ * @brief      Copies an rc_matrix_t into a rc_small_matrix_t.
+ *
+ * Since both store their data contiguously this is a single memcpy.
+ *
+ * @param[in]  A     input matrix, no larger than RC_SMALL_MATRIX_MAX_DIM in
+ * either dimension
+ * @param[out] S     small matrix copy
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_small_matrix_from_matrix(rc_matrix_t A, rc_small_matrix_t* S);
+
+/**
+ * @brief      Copies a rc_small_matrix_t into an rc_matrix_t.
+ *
+ * A is only reallocated if it is not already the right size.
+ *
+ * @param[in]  S     small matrix
+ * @param[out] A     rc_matrix_t copy
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_small_matrix_to_matrix(const rc_small_matrix_t* S, rc_matrix_t* A);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_SMALL_MATRIX_H
+
+/** @} end group math*/
@@ -102,6 +102,23 @@ int rc_motor_standby(int standby_en);
 int rc_motor_set(int ch, double duty);
 
 
+/**
+ * @brief      Sets the bidirectional duty cycle of every motor at once.
+ *
+ * Unlike calling rc_motor_set for each motor, the direction pins of all motors
+ * are written with one system call per gpio chip and the PWM duty cycles are
+ * then written back to back, so the motors change together instead of one
+ * after the other. Use rc_pwm_enable_mmap on the PWM subsystems as well to make
+ * the PWM writes themselves nearly simultaneous.
+ *
+ * @param[in]  duty  array of duty cycles from -1.0 to 1.0, one for each motor
+ * (4 values, 2 on the PocketBeagle), duty[0] is motor 1
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_motor_set_all(const double duty[]);
+
+
 /**
  * @brief      Puts a motor into a zero-throttle state allowing it to spin
  * freely.
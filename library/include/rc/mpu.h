@@ -46,6 +46,8 @@ extern "C" {
 
 
 // defines for index location within TaitBryan and quaternion vectors
+#define RC_MPU_RAW_FIFO_MAX_BATCH 40 ///< most samples delivered to the raw FIFO callback at once
+
 #define TB_PITCH_X	0 ///< Index of the dmp_TaitBryan[] array corresponding to the Pitch (X) axis.
 #define TB_ROLL_Y	1 ///< Index of the dmp_TaitBryan[] array corresponding to the Roll (Y) axis.
 #define TB_YAW_Z	2 ///< Index of the dmp_TaitBryan[] array corresponding to the Yaw (Z) axis.
@@ -145,6 +147,20 @@ typedef enum rc_mpu_orientation_t{
 	ORIENTATION_X_BACK	= 161
 } rc_mpu_orientation_t;
 
+/**
+ * @brief      Bus used to talk to the MPU9250.
+ *
+ * The Robotics Cape and BeagleBone Blue wire the IMU to I2C which is the
+ * default. Breakout boards can instead be wired to SPI which runs at up to
+ * 20mhz for sensor reads instead of 400khz. Over SPI there is no auxiliary
+ * bus bypass so the magnetometer is always reached through the MPU's internal
+ * I2C master. Only automatic slave select is supported.
+ */
+typedef enum rc_mpu_transport_t{
+	MPU_TRANSPORT_I2C,
+	MPU_TRANSPORT_SPI
+} rc_mpu_transport_t;
+
 /**
  * @brief      configuration of the mpu sensor
  *
@@ -160,6 +176,10 @@ typedef struct rc_mpu_config_t{
 	int i2c_bus;			///< which bus to use, default 2 on Robotics Cape and BB Blue
 	uint8_t i2c_addr;		///< default is 0x68, pull pin ad0 high to make it 0x69
 	int show_warnings;		///< set to 1 to print i2c_bus warnings for debug
+	rc_mpu_transport_t transport;	///< MPU_TRANSPORT_I2C (default) or MPU_TRANSPORT_SPI
+	int spi_bus;			///< spi bus when using MPU_TRANSPORT_SPI, default 1
+	int spi_slave;			///< spi slave select when using MPU_TRANSPORT_SPI, must be an auto slave, default 0
+	int spi_speed_hz;		///< spi clock for sensor reads, register access always runs at 1mhz, default 20000000
 	///@}
 
 	/** @name accelerometer, gyroscope, and magnetometer configuration */
@@ -169,6 +189,7 @@ typedef struct rc_mpu_config_t{
 	rc_mpu_accel_dlpf_t accel_dlpf;	///< internal low pass filter cutoff, default ACCEL_DLPF_184
 	rc_mpu_gyro_dlpf_t gyro_dlpf;	///< internal low pass filter cutoff, default GYRO_DLPF_184
 	int enable_magnetometer;	///< magnetometer use is optional, set to 1 to enable, default 0 (off)
+	int mag_ext_sens_read;		///< set to 1 to have the MPU's internal I2C master copy magnetometer data into its external sensor registers so rc_mpu_read_all() gets it in the same burst as accel/gyro. Random read mode only, default 0 (off)
 	///@}
 
 	/** @name DMP settings, only used with DMP mode */
@@ -183,6 +204,14 @@ typedef struct rc_mpu_config_t{
 	int read_mag_after_callback;	///< reads magnetometer after DMP callback function to improve latency, default 1 (true)
 	int mag_sample_rate_div;	///< magnetometer_sample_rate = dmp_sample_rate/mag_sample_rate_div, default: 4
 	int tap_threshold;		///< threshold impulse for triggering a tap in units of mg/ms
+	int dmp_fifo_burst_drain;	///< set to 1 to read every packet backed up in the FIFO in one burst instead of keeping only the newest. Each packet is then published and passes through the callbacks in order with a timestamp interpolated at the sample period, default: 0 (off)
+	int dmp_sample_ring_len;	///< number of samples kept in the lock-free sample ring, rounded up to a power of 2, default: 0 (ring disabled)
+	///@}
+
+	/** @name raw FIFO settings, only used with raw FIFO mode. The handler thread uses dmp_interrupt_sched_policy and dmp_interrupt_priority */
+	///@{
+	int raw_fifo_sample_rate;	///< sample rate in hertz, 1000,500,250,200,125,100,50,40,25,20,10,8,5,4 or 4000,2000 over SPI only, default 1000
+	int raw_fifo_batch_len;		///< samples read from the FIFO and passed to the callback at once, 1 to RC_MPU_RAW_FIFO_MAX_BATCH, default 10
 	///@}
 
 } rc_mpu_config_t;
@@ -232,6 +261,47 @@ typedef struct rc_mpu_data_t{
 } rc_mpu_data_t;
 
 
+/**
+ * @brief      One timestamped DMP sample as stored in the lock-free sample ring.
+ *
+ * Sequence numbers start at 1 and increase by one for every sample the DMP
+ * interrupt thread reads successfully, so a gap between two consecutive
+ * samples read by a consumer means samples were missed.
+ */
+typedef struct rc_mpu_sample_t{
+	uint64_t seq;		///< sequence number of this sample, starting at 1
+	uint64_t timestamp_ns;	///< time of the IMU interrupt, see rc_nanos_since_epoch()
+	rc_mpu_data_t data;	///< copy of the data struct taken right after the read
+} rc_mpu_sample_t;
+
+/**
+ * @brief      One timestamped accel and gyro sample read from the FIFO in raw
+ * FIFO mode.
+ */
+typedef struct rc_mpu_raw_sample_t{
+	uint64_t timestamp_ns;	///< estimated time the sample was taken, see rc_nanos_since_epoch()
+	double accel[3];	///< accelerometer (XYZ) in units of m/s^2
+	double gyro[3];		///< gyroscope (XYZ) in units of degrees/s
+	int16_t raw_accel[3];	///< raw accelerometer (XYZ) from 16-bit ADC
+	int16_t raw_gyro[3];	///< raw gyroscope (XYZ) from 16-bit ADC
+} rc_mpu_raw_sample_t;
+
+/**
+ * @brief      Per-consumer read position in the lock-free sample ring.
+ *
+ * Each consumer thread keeps its own reader. A reader initialized with
+ * RC_MPU_RING_READER_INITIALIZER starts at the oldest sample still in the
+ * ring, use rc_mpu_ring_reader_init() to start at the next new sample instead.
+ */
+typedef struct rc_mpu_ring_reader_t{
+	uint64_t next;		///< sequence number this reader wants next
+	uint64_t missed;	///< samples overwritten before this reader got to them
+} rc_mpu_ring_reader_t;
+
+#define RC_MPU_RING_READER_INITIALIZER {\
+	.next	= 0,\
+	.missed	= 0}
+
 /** @name common functions */
 ///@{
 
@@ -345,6 +415,29 @@ int rc_mpu_read_temp(rc_mpu_data_t* data);
  * @return     0 on success or -1 on failure.
  */
 int rc_mpu_read_mag(rc_mpu_data_t* data);
+
+
+/**
+ * @brief      Reads accelerometer, thermometer and gyroscope data from the MPU
+ * in one burst.
+ *
+ * These registers are contiguous in the MPU so all 14 bytes are fetched in a
+ * single I2C transaction instead of one per sensor. The values are converted
+ * the same way as rc_mpu_read_accel(), rc_mpu_read_temp() and
+ * rc_mpu_read_gyro() but all come from the same sample.
+ *
+ * If mag_ext_sens_read was set in the config passed to rc_mpu_initialize()
+ * along with enable_magnetometer, the magnetometer registers copied into the
+ * MPU by its I2C master are read in the same burst and data->mag is updated
+ * whenever there is a new unsaturated reading. Otherwise the magnetometer must
+ * still be read separately with rc_mpu_read_mag().
+ *
+ * @param      data  Pointer to user's data struct where new data will be
+ * written
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_mpu_read_all(rc_mpu_data_t* data);
 ///@} end normal one-shot sampling functions
 
 
@@ -426,6 +519,126 @@ int64_t rc_mpu_nanos_since_last_tap(void);
 ///@} end interrupt-driven DMP mode functions
 
 
+/** @name lock-free DMP sample ring */
+///@{
+
+/**
+ * @brief      Starts a reader at the next sample the DMP thread will publish.
+ *
+ * The sample ring is an opt-in alternative to rc_mpu_block_until_dmp_data()
+ * and the user's data struct. Set dmp_sample_ring_len in the config struct
+ * before calling rc_mpu_initialize_dmp() and the interrupt thread will copy
+ * every successful read into a ring of timestamped samples. Any number of
+ * consumer threads can then read every sample without taking a lock and
+ * without ever blocking the interrupt thread. A consumer that falls more than
+ * dmp_sample_ring_len-1 samples behind has the oldest samples overwritten,
+ * which is counted in the reader's missed field. When dmp_fifo_burst_drain is
+ * also enabled one interrupt can publish up to 25 samples at once, so make the
+ * ring comfortably longer than that.
+ *
+ * @param[out] r     Pointer to the consumer's reader
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_mpu_ring_reader_init(rc_mpu_ring_reader_t* r);
+
+
+/**
+ * @brief      Copies the next unread sample out of the ring without blocking.
+ *
+ * If the reader fell behind far enough for its next sample to be overwritten
+ * it skips ahead to the oldest sample still available and adds the number of
+ * skipped samples to r->missed. Must not be called after rc_mpu_power_off().
+ *
+ * @param      r       Pointer to the consumer's reader
+ * @param[out] sample  Pointer to where the sample will be copied
+ *
+ * @return     1 if a sample was copied, 0 if there is no new sample yet, or -1
+ * on error such as the ring not being enabled.
+ */
+int rc_mpu_ring_read(rc_mpu_ring_reader_t* r, rc_mpu_sample_t* sample);
+
+
+/**
+ * @brief      Copies the most recent sample out of the ring without blocking.
+ *
+ * Useful for consumers such as telemetry that only care about the latest
+ * state and don't need a reader of their own.
+ *
+ * @param[out] sample  Pointer to where the sample will be copied
+ *
+ * @return     1 if a sample was copied, 0 if no sample has been published yet,
+ * or -1 on error such as the ring not being enabled.
+ */
+int rc_mpu_ring_read_latest(rc_mpu_sample_t* sample);
+///@} end lock-free DMP sample ring
+
+
+/** @name interrupt-driven raw FIFO mode functions */
+///@{
+
+/**
+ * @brief      Initializes the MPU in raw FIFO mode for streaming accel and gyro
+ * data at up to 1khz, or 4khz over SPI, see rc_test_mpu_fifo example.
+ *
+ * The DMP is not used. Instead the hardware FIFO collects raw accel and gyro
+ * samples at raw_fifo_sample_rate and a handler thread reads
+ * raw_fifo_batch_len of them at a time in one burst, converts them, and passes
+ * the whole batch to the callback set with rc_mpu_set_raw_fifo_callback().
+ *
+ * The MPU9250 has no FIFO watermark interrupt so the handler waits for the
+ * data ready interrupt of the first sample in a batch, sleeps until the rest
+ * should have arrived, then drains every whole sample in the FIFO. Samples are
+ * timestamped backwards from the time of the read at the sample period so
+ * their spacing is exact but their absolute time may be up to one sample
+ * period late.
+ *
+ * Up to 1khz the gyro DLPF must be 184hz or lower as the sample rate divider
+ * doesn't work otherwise. The 4000 and 2000hz rates are only available with
+ * MPU_TRANSPORT_SPI, I2C is too slow to drain the FIFO. They turn the accel
+ * and gyro DLPFs off (gyro_dlpf may also be GYRO_DLPF_250) so the FIFO fills
+ * at 8khz with the accel updating at 4khz, and each sample is the average of
+ * 2 or 4 FIFO packets. raw_fifo_batch_len is then limited to 21 or 10 so the
+ * batch only takes half the FIFO. The newest sample is also copied into the user's data struct so
+ * rc_mpu_block_until_dmp_data() can be used to wait for each batch. If
+ * enable_magnetometer is set it can be read with rc_mpu_read_mag() like in
+ * one-shot mode.
+ *
+ * @param      data  Pointer to user's data struct where the newest sample will
+ * be written
+ * @param[in]  conf  User's configuration struct
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_mpu_initialize_raw_fifo(rc_mpu_data_t* data, rc_mpu_config_t conf);
+
+
+/**
+ * @brief      Sets the callback function that receives each batch of samples
+ * in raw FIFO mode.
+ *
+ * The callback runs in the handler thread and should return well within
+ * raw_fifo_batch_len sample periods or the FIFO will back up. The samples
+ * array is only valid until the callback returns.
+ *
+ * @param[in]  func  user's callback function, receives the samples oldest
+ * first and the number of samples n
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_mpu_set_raw_fifo_callback(void (*func)(const rc_mpu_raw_sample_t* samples, int n));
+
+
+/**
+ * @brief      Returns the number of times the FIFO overflowed or lost
+ * alignment in raw FIFO mode and had to be reset, losing samples.
+ *
+ * @return     number of FIFO resets since rc_mpu_initialize_raw_fifo()
+ */
+uint64_t rc_mpu_raw_fifo_overflows(void);
+///@} end interrupt-driven raw FIFO mode functions
+
+
 
 /** @name calibration functions */
 ///@{
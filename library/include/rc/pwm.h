@@ -81,6 +81,58 @@ int rc_pwm_set_duty(int ss, char ch, double duty);
 int rc_pwm_set_duty_ns(int ss, char ch, unsigned int duty_ns);
 
 
+/**
+ * @brief      Switches a subsystem to writing its duty cycle registers directly
+ * instead of going through the sysfs driver.
+ *
+ * rc_pwm_set_duty() and rc_pwm_set_duty_ns() normally format the duty as text
+ * and write it to a sysfs file which costs a system call and kernel string
+ * parsing every time. After this call they write the EHRPWM CMPA/CMPB registers
+ * through a memory map of /dev/mem instead, which takes a few hundred
+ * nanoseconds. The kernel driver still owns everything else so call
+ * rc_pwm_init() first to set the frequency and enable the clocks. Calling
+ * rc_pwm_init() or rc_pwm_cleanup() again switches the subsystem back to sysfs.
+ * Requires root. The compare registers are shadowed by the hardware and only
+ * load at the end of each period so a write never produces a partial pulse.
+ *
+ * @param[in]  ss    subsystem 0,1,2
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_pwm_enable_mmap(int ss);
+
+
+/**
+ * @brief      Switches a subsystem back to the sysfs driver after
+ * rc_pwm_enable_mmap().
+ *
+ * The sysfs driver doesn't know about duty cycles written through the map, so
+ * set the duty again after switching back.
+ *
+ * @param[in]  ss    subsystem 0,1,2
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_pwm_disable_mmap(int ss);
+
+
+/**
+ * @brief      Makes rc_pwm_enable_mmap() map a regular file instead of
+ * /dev/mem, for testing without hardware.
+ *
+ * The file stands in for the 3 PWMSS register blocks and must be at least
+ * 0x6000 bytes long. Subsystem ss lives at offset ss*0x2000 with the EHRPWM
+ * registers 0x200 further in, the same as in the AM335x memory map. The period
+ * is read from TBPRD at offset 0x20A so write that before enabling the map. In
+ * this mode rc_pwm_init() isn't needed. Pass NULL to go back to /dev/mem.
+ *
+ * @param[in]  path  path to the file or NULL
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_pwm_set_mmap_file(const char* path);
+
+
 #ifdef __cplusplus
 }
 #endif
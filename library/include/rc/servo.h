@@ -92,6 +92,7 @@ extern "C" {
 #define RC_SERVO_CH_MIN	1 ///< servo channels range from 1-8
 #define RC_SERVO_CH_MAX	8 ///< servo channels range from 1-8
 #define RC_SERVO_CH_ALL	0 ///< providing this as an argument writes the same pulse to all channels
+#define RC_SERVO_MAX_FRAME_HZ	1000 ///< fastest frame rate allowed in continuous mode
 
 
 
@@ -257,6 +258,120 @@ int rc_servo_send_esc_pulse_normalized(int ch, double input);
 int rc_servo_send_oneshot_pulse_normalized(int ch, double input);
 
 
+/**
+ * @brief      Starts continuous mode where the PRU repeats the latched pulse
+ * widths on its own at a fixed frame rate.
+ *
+ * Instead of sending every pulse from a userspace loop, widths are latched
+ * with the rc_servo_set_* functions below and the PRU restarts each pulse at
+ * the beginning of every frame. Widths can be changed at any time and take
+ * effect on the next frame, so no real-time thread is needed to keep ESCs fed
+ * and there is no way to start a pulse amidst another.
+ *
+ * Channels with no latched width (or a width of 0) stay low. While continuous
+ * mode is running rc_servo_send_pulse_us and friends return an error. Every
+ * latched pulse must be shorter than the frame period.
+ *
+ * @param[in]  hz    Frame rate from 1 to RC_SERVO_MAX_FRAME_HZ
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_servo_start_continuous(int hz);
+
+
+/**
+ * @brief      Stops continuous mode, pulses in progress still finish.
+ *
+ * Latched widths are kept and will be used again if continuous mode is
+ * restarted.
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_servo_stop_continuous(void);
+
+
+/**
+ * @brief      Latches the pulse width in microseconds for one or all channels
+ * to be repeated in continuous mode.
+ *
+ * This can be called before or after rc_servo_start_continuous. A width of 0
+ * stops pulses on that channel.
+ *
+ * @param[in]  ch    Channel to latch (1-8) or 0 for all channels.
+ * @param[in]  us    Pulse Width in microseconds
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_servo_set_pulse_us(int ch, int us);
+
+
+/**
+ * @brief      Latches a different pulse width for each of the 8 channels at
+ * once.
+ *
+ * All 8 widths are handed to the PRU together and take effect at the start of
+ * the same frame, which matters for multirotors where ESCs updated in
+ * different frames would briefly see an unbalanced set of throttles. The
+ * single channel rc_servo_set_* functions go through the same path so they are
+ * never torn either.
+ *
+ * @param[in]  us    array of RC_SERVO_CH_MAX widths in microseconds for
+ * channels 1-8, 0 stops pulses on that channel.
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_servo_set_all_pulse_us(const int us[]);
+
+
+/**
+ * @brief      Checks if the PRU has latched the most recent update.
+ *
+ * Updates are double-buffered in PRU shared memory with a generation counter
+ * which the PRU acknowledges when it copies a new set of widths at the start
+ * of a frame. While continuous mode is stopped the PRU still checks for
+ * updates every quarter millisecond.
+ *
+ * @return     1 if the latest update has been latched, 0 if it's still
+ * pending, -1 on error.
+ */
+int rc_servo_is_latched(void);
+
+
+/**
+ * @brief      Continuous mode equivalent of rc_servo_send_pulse_normalized.
+ *
+ * @param[in]  ch     Channel to latch (1-8) or 0 for all channels.
+ * @param[in]  input  normalized position from -1.5 to 1.5
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_servo_set_pulse_normalized(int ch, double input);
+
+
+/**
+ * @brief      Continuous mode equivalent of
+ * rc_servo_send_esc_pulse_normalized.
+ *
+ * @param[in]  ch     Channel to latch (1-8) or 0 for all channels.
+ * @param[in]  input  normalized throttle from -0.1 to 1.0
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_servo_set_esc_pulse_normalized(int ch, double input);
+
+
+/**
+ * @brief      Continuous mode equivalent of
+ * rc_servo_send_oneshot_pulse_normalized.
+ *
+ * @param[in]  ch     Channel to latch (1-8) or 0 for all channels.
+ * @param[in]  input  normalized throttle from -0.1 to 1.0
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_servo_set_oneshot_pulse_normalized(int ch, double input);
+
+
 #ifdef __cplusplus
 }
 #endif
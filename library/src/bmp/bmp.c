@@ -8,13 +8,25 @@
 #include <stdio.h>
 #include <math.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <rc/i2c.h>
 #include <rc/bmp.h>
+#include <rc/mpu.h>
 #include <rc/time.h>
+#include <rc/pthread.h>
 #include "bmp_defs.h"
+#include "../seqlock.h"
 
 #define BMP_BUS 2
 
+// altitude lookup table covers pressure/sea_level_pressure ratios from 0.25 to
+// 1.4 which includes 300-1100hPa at any allowed sea level pressure
+#define ALT_EXPONENT	0.1903
+#define ALT_LUT_LEN	1024
+#define ALT_LUT_MIN	0.25
+#define ALT_LUT_MAX	1.4
+
 // local struct for calibration data
 typedef struct bmp280_cal_t{
 	uint16_t dig_T1;
@@ -30,36 +42,283 @@ typedef struct bmp280_cal_t{
 	int16_t  dig_P8;
 	int16_t  dig_P9;
 	double sea_level_pa;
+	// constant terms of the compensation formulas, precomputed at init
+	int32_t t1_x2;		// dig_T1<<1
+	int64_t p4_35;		// dig_P4<<35 for 64-bit compensation
+	int32_t p4_16;		// dig_P4<<16 for 32-bit compensation
+	int64_t p7_4;		// dig_P7<<4 for 64-bit compensation
+	double inv_sea_level_pa;
 }bmp280_cal_t;
 
 // global variables
 static bmp280_cal_t rc_bmp280_cal;
 static int rc_bmp280_init_flag = 0;
+static rc_bmp_config_t rc_bmp280_conf;
+static double alt_lut[ALT_LUT_LEN+1];
+
+// background sampler and the two slots it publishes the latest value to,
+// latest_count says which one is current, see seqlock.h
+static pthread_t sampler_thread;
+static int sampler_running = 0;
+static volatile int sampler_shutdown = 0;
+static uint8_t ctrl_meas;	// oversampling bits, mode is added on top
+static int conversion_us;	// worst case forced conversion time
+static _Atomic uint64_t latest_count = 0;
+static rc_bmp_sample_t latest[2];
+
+
+// temperature in 0.01 degC and t_fine which pressure compensation needs, this
+// is the 32-bit formula from the datasheet which the 64-bit version also uses
+static int32_t __compensate_T(int32_t adc_T, int32_t* t_fine)
+{
+	int32_t var1, var2;
+	var1 = (((adc_T>>3) - rc_bmp280_cal.t1_x2) * ((int32_t)rc_bmp280_cal.dig_T2)) >> 11;
+	var2 = (((((adc_T>>4) - ((int32_t)rc_bmp280_cal.dig_T1)) *
+		((adc_T>>4) - ((int32_t)rc_bmp280_cal.dig_T1))) >> 12) *
+		((int32_t)rc_bmp280_cal.dig_T3)) >> 14;
+	*t_fine = var1 + var2;
+	return (*t_fine * 5 + 128) >> 8;
+}
+
+
+// pressure in Pa as Q24.8 fixed point, 64-bit formula from the datasheet.
+// returns 0 on invalid data to avoid dividing by zero
+static uint32_t __compensate_P_int64(int32_t adc_P, int32_t t_fine)
+{
+	int64_t var1, var2, p;
+	var1 = ((int64_t)t_fine) - 128000;
+	var2 = var1 * var1 * (int64_t)rc_bmp280_cal.dig_P6;
+	var2 = var2 + ((var1*(int64_t)rc_bmp280_cal.dig_P5)<<17);
+	var2 = var2 + rc_bmp280_cal.p4_35;
+	var1 = ((var1 * var1 * (int64_t)rc_bmp280_cal.dig_P3)>>8) +
+		((var1 * (int64_t)rc_bmp280_cal.dig_P2)<<12);
+	var1 = (((((int64_t)1)<<47)+var1))*((int64_t)rc_bmp280_cal.dig_P1)>>33;
+	if(var1==0) return 0;
+	p = 1048576 - adc_P;
+	p = (((p<<31) - var2)*3125) / var1;
+	var1 = (((int64_t)rc_bmp280_cal.dig_P9) * (p >> 13) * (p >> 13)) >> 25;
+	var2 = (((int64_t)rc_bmp280_cal.dig_P8) * p) >> 19;
+	return (uint32_t)(((p + var1 + var2) >> 8) + rc_bmp280_cal.p7_4);
+}
+
+
+// pressure in Pa, 32-bit formula from the datasheet. returns 0 on invalid data
+// to avoid dividing by zero
+static uint32_t __compensate_P_int32(int32_t adc_P, int32_t t_fine)
+{
+	int32_t var1, var2;
+	uint32_t p;
+	var1 = (t_fine>>1) - 64000;
+	var2 = (((var1>>2) * (var1>>2)) >> 11) * ((int32_t)rc_bmp280_cal.dig_P6);
+	var2 = var2 + ((var1*((int32_t)rc_bmp280_cal.dig_P5))<<1);
+	var2 = (var2>>2) + rc_bmp280_cal.p4_16;
+	var1 = (((rc_bmp280_cal.dig_P3 * (((var1>>2) * (var1>>2)) >> 13)) >> 3) +
+		((((int32_t)rc_bmp280_cal.dig_P2) * var1)>>1))>>18;
+	var1 = ((32768+var1)*((int32_t)rc_bmp280_cal.dig_P1))>>15;
+	if(var1==0) return 0;
+	p = (((uint32_t)(1048576-adc_P)) - (var2>>12))*3125;
+	if(p<0x80000000) p = (p<<1) / ((uint32_t)var1);
+	else p = (p / (uint32_t)var1) * 2;
+	var1 = (((int32_t)rc_bmp280_cal.dig_P9) * ((int32_t)(((p>>3) * (p>>3))>>13)))>>12;
+	var2 = (((int32_t)(p>>2)) * ((int32_t)rc_bmp280_cal.dig_P8))>>13;
+	return (uint32_t)((int32_t)p + ((var1 + var2 + rc_bmp280_cal.dig_P7) >> 4));
+}
+
+
+// fill the altitude table, entry i is the altitude at a pressure ratio of
+// ALT_LUT_MIN + i*step
+static void __build_alt_lut(void)
+{
+	int i;
+	double step = (ALT_LUT_MAX-ALT_LUT_MIN)/ALT_LUT_LEN;
+	for(i=0;i<=ALT_LUT_LEN;i++){
+		alt_lut[i] = 44330.0*(1.0 - pow(ALT_LUT_MIN + i*step, ALT_EXPONENT));
+	}
+}
+
+
+static double __altitude(double pressure_pa)
+{
+	int i;
+	double x, u;
+	x = pressure_pa*rc_bmp280_cal.inv_sea_level_pa;
+	if(rc_bmp280_conf.altitude==BMP_ALTITUDE_POW || x<ALT_LUT_MIN || x>=ALT_LUT_MAX){
+		return 44330.0*(1.0 - pow(x, ALT_EXPONENT));
+	}
+	u = (x-ALT_LUT_MIN)*(ALT_LUT_LEN/(ALT_LUT_MAX-ALT_LUT_MIN));
+	i = (int)u;
+	return alt_lut[i] + (u-i)*(alt_lut[i+1]-alt_lut[i]);
+}
+
+
+// converts the 6 bytes read from BMP280_PRESSURE_MSB onwards
+static int __convert(uint8_t* raw, rc_bmp_data_t* data)
+{
+	int32_t adc_P, adc_T, t_fine;
+	uint32_t p;
+
+	// run the numbers, thanks to Bosch for putting this code in their datasheet
+	adc_P = (raw[0] << 12)|
+			(raw[1] << 4)|(raw[2] >> 4);
+	adc_T = (raw[3] << 12)|
+			(raw[4] << 4)|(raw[5] >> 4);
+
+	data->temp_c = __compensate_T(adc_T, &t_fine)/100.0;
+
+	// both return 0 instead of dividing by zero on invalid data
+	if(rc_bmp280_conf.compensation==BMP_COMPENSATION_INT32){
+		p = __compensate_P_int32(adc_P, t_fine);
+	}
+	else p = __compensate_P_int64(adc_P, t_fine);
+	if(p==0) return -1;
+	if(rc_bmp280_conf.compensation==BMP_COMPENSATION_INT32) data->pressure_pa = p;
+	else data->pressure_pa = p/256.0;
+
+	data->alt_m = __altitude(data->pressure_pa);
+	return 0;
+}
+
+
+// worst case conversion time in microseconds from the datasheet for 1x
+// temperature oversampling and the configured pressure oversampling
+static int __measurement_time_us(rc_bmp_oversample_t oversample)
+{
+	int osrs_p = 1<<((oversample>>2)-1);
+	return 1250 + 2300 + 2300*osrs_p + 575;
+}
+
+
+// starts a forced mode conversion, the BMP280 goes back to sleep when done
+static int __trigger_forced(void)
+{
+	int ret;
+	rc_i2c_lock_bus(BMP_BUS);
+	ret = rc_i2c_set_device_address(BMP_BUS, BMP280_ADDR);
+	if(ret==0) ret = rc_i2c_write_byte(BMP_BUS, BMP280_CTRL_MEAS, ctrl_meas|BMP_MODE_FORCED);
+	rc_i2c_unlock_bus(BMP_BUS);
+	return ret;
+}
+
+
+// publishes data as the latest result, only called by the sampler thread
+static void __publish(uint64_t timestamp_ns, rc_bmp_data_t* data)
+{
+	uint64_t n;
+	rc_bmp_sample_t* slot = __seqlock_latest_begin(&latest_count, latest, sizeof(latest[0]), &n);
+	slot->seq = n;
+	slot->timestamp_ns = timestamp_ns;
+	slot->data = *data;
+	__seqlock_latest_end(&latest_count);
+}
+
+
+/**
+ * Each cycle reads the conversion triggered last cycle and triggers the next
+ * one in the same short bus window, so the conversion itself runs while the
+ * bus is free for the IMU. With sampler_sync_mpu the window is placed right
+ * after the MPU thread delivers a sample, which is when the bus is idle for
+ * longest.
+ */
+static void* __sampler_func(__attribute__ ((unused)) void* ptr)
+{
+	uint8_t raw[6];
+	int triggered = 0;
+	int sync = rc_bmp280_conf.sampler_sync_mpu;
+	uint64_t period_ns, next_ns, trigger_ns = 0, now;
+	rc_bmp_data_t data;
+
+	period_ns = 1000000000/rc_bmp280_conf.sampler_rate_hz;
+	next_ns = rc_nanos_since_epoch();
+	while(!sampler_shutdown){
+		// wait for the next cycle, then for the gap after an IMU sample
+		now = rc_nanos_since_epoch();
+		if(next_ns>now) rc_usleep((next_ns-now)/1000);
+		// fall back to the timer alone if the MPU isn't delivering interrupts
+		if(sync && rc_mpu_block_until_dmp_data()<0) sync = 0;
+		if(sampler_shutdown) break;
+		next_ns += period_ns;
+		// fell behind by more than a cycle, don't try to catch up
+		now = rc_nanos_since_epoch();
+		if(next_ns<now) next_ns = now + period_ns;
+
+		if(triggered && rc_i2c_read_device_bytes(BMP_BUS, BMP280_ADDR, BMP280_PRESSURE_MSB, 6, raw)==6){
+			if(__convert(raw, &data)==0){
+				// timestamp the middle of the conversion
+				__publish(trigger_ns + conversion_us*500ull, &data);
+			}
+		}
+		trigger_ns = rc_nanos_since_epoch();
+		triggered = (__trigger_forced()==0);
+	}
+	return NULL;
+}
+
+
+rc_bmp_config_t rc_bmp_default_config(void)
+{
+	rc_bmp_config_t conf;
+	conf.oversample = BMP_OVERSAMPLE_16;
+	conf.filter = BMP_FILTER_OFF;
+	conf.compensation = BMP_COMPENSATION_INT64;
+	conf.altitude = BMP_ALTITUDE_POW;
+	conf.sampler_rate_hz = 0;
+	conf.sampler_sync_mpu = 0;
+	conf.sampler_sched_policy = SCHED_OTHER;
+	conf.sampler_priority = 0;
+	return conf;
+}
+
 
 int rc_bmp_init(rc_bmp_oversample_t oversample, rc_bmp_filter_t filter)
+{
+	rc_bmp_config_t conf = rc_bmp_default_config();
+	conf.oversample = oversample;
+	conf.filter = filter;
+	return rc_bmp_init_config(conf);
+}
+
+int rc_bmp_init_config(rc_bmp_config_t conf)
 {
 	uint8_t buf[24];
 	uint8_t c;
 	int i;
 
-	// make sure the bus is not currently in use by another thread
-	// do not proceed to prevent interfering with that process
-	if(rc_i2c_get_lock(BMP_BUS)){
-		fprintf(stderr,"WARNING in rc_bmp_init, i2c bus claimed by another thread\n");
-		fprintf(stderr,"Continuing anyway.\n");
+	// sanity checks
+	if(conf.compensation!=BMP_COMPENSATION_INT64 && conf.compensation!=BMP_COMPENSATION_INT32){
+		fprintf(stderr,"ERROR: in rc_bmp_init_config, invalid compensation\n");
+		return -1;
+	}
+	if(conf.altitude!=BMP_ALTITUDE_POW && conf.altitude!=BMP_ALTITUDE_LUT){
+		fprintf(stderr,"ERROR: in rc_bmp_init_config, invalid altitude\n");
+		return -1;
+	}
+	if(conf.oversample<BMP_OVERSAMPLE_1 || conf.oversample>BMP_OVERSAMPLE_16){
+		fprintf(stderr,"ERROR: in rc_bmp_init_config, invalid oversample\n");
+		return -1;
+	}
+	// a forced conversion has to finish within one sampler period
+	conversion_us = __measurement_time_us(conf.oversample);
+	if(conf.sampler_rate_hz<0 || conf.sampler_rate_hz*conversion_us>1000000){
+		fprintf(stderr,"ERROR: in rc_bmp_init_config, sampler_rate_hz must be between 0 & %d with this oversample\n",
+						1000000/conversion_us);
+		return -1;
+	}
+	if(sampler_running){
+		fprintf(stderr,"ERROR: in rc_bmp_init_config, sampler already running, call rc_bmp_power_off first\n");
+		return -1;
 	}
 
+	// claim the bus for the whole setup sequence, this waits for any other
+	// thread such as the IMU to finish with it first
+	rc_i2c_lock_bus(BMP_BUS);
+
 	// initialize the bus
 	if(rc_i2c_init(BMP_BUS, BMP280_ADDR)<0){
 		fprintf(stderr,"ERROR: in rc_bmp_init failed to initialize i2c bus\n");
+		rc_i2c_unlock_bus(BMP_BUS);
 		return -1;
 	}
 
-	// claiming the bus does no guarantee other code will not interfere
-	// with this process, but best to claim it so other code can check
-	// like we did above
-	rc_i2c_lock_bus(BMP_BUS);
-
 	// reset the barometer
 	if(rc_i2c_write_byte(BMP_BUS, BMP280_RESET_REG, BMP280_RESET_WORD)<0){
 		fprintf(stderr,"ERROR: in rc_bmp_init failed to send reset byte to barometer\n");
@@ -81,10 +340,11 @@ int rc_bmp_init(rc_bmp_oversample_t oversample, rc_bmp_filter_t filter)
 	}
 
 	// set up the bmp measurement control register settings
-	// no temperature oversampling,  normal continuous read mode
-	c = BMP_MODE_NORMAL;
-	c |= BMP_TEMP_OVERSAMPLE_1;
-	c |= oversample;
+	// no temperature oversampling, normal continuous read mode unless the
+	// sampler is going to trigger forced conversions itself
+	ctrl_meas = BMP_TEMP_OVERSAMPLE_1 | conf.oversample;
+	if(conf.sampler_rate_hz) c = ctrl_meas | BMP_MODE_SLEEP;
+	else c = ctrl_meas | BMP_MODE_NORMAL;
 
 	// write the measurement control register
 	if(rc_i2c_write_byte(BMP_BUS,BMP280_CTRL_MEAS,c)<0){
@@ -95,7 +355,7 @@ int rc_bmp_init(rc_bmp_oversample_t oversample, rc_bmp_filter_t filter)
 
 	// set up the filter config register
 	c = BMP280_TSB_0;	// minimal sleep delay between samples
-	c |= filter;		// user selectable filter coefficient
+	c |= conf.filter;	// user selectable filter coefficient
 	if(rc_i2c_write_byte(BMP_BUS,BMP280_CONFIG,c)<0){
 		fprintf(stderr,"ERROR: in rc_bmp_init, failed to write to bmp_config register\n");
 		rc_i2c_unlock_bus(BMP_BUS);
@@ -141,9 +401,16 @@ int rc_bmp_init(rc_bmp_oversample_t oversample, rc_bmp_filter_t filter)
 	rc_bmp280_cal.dig_P7 = (uint16_t) ((buf[19] << 8) | buf [18]);
 	rc_bmp280_cal.dig_P8 = (uint16_t) ((buf[21] << 8) | buf [20]);
 	rc_bmp280_cal.dig_P9 = (uint16_t) ((buf[23] << 8) | buf [22]);
+	rc_bmp280_cal.t1_x2 = ((int32_t)rc_bmp280_cal.dig_T1)<<1;
+	rc_bmp280_cal.p4_35 = ((int64_t)rc_bmp280_cal.dig_P4)<<35;
+	rc_bmp280_cal.p4_16 = ((int32_t)rc_bmp280_cal.dig_P4)<<16;
+	rc_bmp280_cal.p7_4  = ((int64_t)rc_bmp280_cal.dig_P7)<<4;
 
 	// use default pressure for now unless user sets it otherwise
 	rc_bmp280_cal.sea_level_pa = DEFAULT_SEA_LEVEL_PA;
+	rc_bmp280_cal.inv_sea_level_pa = 1.0/DEFAULT_SEA_LEVEL_PA;
+	rc_bmp280_conf = conf;
+	if(conf.altitude==BMP_ALTITUDE_LUT) __build_alt_lut();
 
 	// release control of the bus
 	rc_i2c_unlock_bus(BMP_BUS);
@@ -151,6 +418,18 @@ int rc_bmp_init(rc_bmp_oversample_t oversample, rc_bmp_filter_t filter)
 	// wait for bmp to finish it's internal initialization
 	rc_usleep(50000);
 	rc_bmp280_init_flag=1;
+
+	// start the background sampler if requested
+	if(conf.sampler_rate_hz){
+		atomic_store(&latest_count, 0);
+		sampler_shutdown = 0;
+		if(rc_pthread_create(&sampler_thread, __sampler_func, NULL,
+				conf.sampler_sched_policy, conf.sampler_priority)<0){
+			fprintf(stderr,"ERROR: in rc_bmp_init_config, failed to start sampler thread\n");
+			return -1;
+		}
+		sampler_running = 1;
+	}
 	return 0;
 }
 
@@ -158,12 +437,16 @@ int rc_bmp_init(rc_bmp_oversample_t oversample, rc_bmp_filter_t filter)
 
 int rc_bmp_power_off(void)
 {
-	// make sure the bus is not currently in use by another thread
-	// do not proceed to prevent interfering with that process
-	if(rc_i2c_get_lock(BMP_BUS)){
-		fprintf(stderr,"WARNING: in rc_bmp_power_off i2c bus claimed by another thread\n");
-		fprintf(stderr,"Continuing anyway.\n");
+	// stop the sampler first so it doesn't trigger another conversion
+	if(sampler_running){
+		sampler_shutdown = 1;
+		if(rc_pthread_timed_join(sampler_thread, NULL, 1.0)==1){
+			fprintf(stderr,"WARNING: in rc_bmp_power_off, sampler thread exit timeout\n");
+		}
+		sampler_running = 0;
 	}
+	// wait for the bus to be free then claim it
+	rc_i2c_lock_bus(BMP_BUS);
 	// set the i2c address
 	if(rc_i2c_set_device_address(BMP_BUS, BMP280_ADDR)<0){
 		fprintf(stderr,"ERROR: in rc_bmp_power_off failed to set the i2c device address\n");
@@ -186,9 +469,7 @@ int rc_bmp_power_off(void)
 
 int rc_bmp_read(rc_bmp_data_t* data)
 {
-	int64_t var1, var2, var3, var4, t_fine, T, p;
 	uint8_t raw[6];
-	int32_t adc_P, adc_T;
 
 	// sanity checks
 	if(rc_bmp280_init_flag==0){
@@ -199,13 +480,8 @@ int rc_bmp_read(rc_bmp_data_t* data)
 		fprintf(stderr, "ERROR in rc_bmp_read, received NULL pointer\n");
 		return -1;
 	}
-	// check claim bus state to avoid stepping on IMU reads
-	if(rc_i2c_get_lock(BMP_BUS)){
-		fprintf(stderr,"WARNING: in rc_bmp_read, i2c bus is claimed by another thread, aborting\n");
-		return -1;
-	}
-
-	// claim bus for ourselves and set the device address
+	// claim bus for ourselves and set the device address, this queues behind
+	// the IMU if it's using the bus instead of dropping the reading
 	rc_i2c_lock_bus(BMP_BUS);
 	if(rc_i2c_set_device_address(BMP_BUS, BMP280_ADDR)<0){
 		fprintf(stderr,"ERROR: in rc_bmp_read, failed to set the i2c device address\n");
@@ -221,47 +497,10 @@ int rc_bmp_read(rc_bmp_data_t* data)
 	}
 	rc_i2c_unlock_bus(BMP_BUS);
 
-	// run the numbers, thanks to Bosch for putting this code in their datasheet
-	adc_P = (raw[0] << 12)|
-			(raw[1] << 4)|(raw[2] >> 4);
-	adc_T = (raw[3] << 12)|
-			(raw[4] << 4)|(raw[5] >> 4);
-
-	var1  = ((((adc_T>>3) - ((int32_t)rc_bmp280_cal.dig_T1 <<1))) *
-			((int32_t)rc_bmp280_cal.dig_T2)) >> 11;
-	var2  = (((((adc_T>>4) - ((int32_t)rc_bmp280_cal.dig_T1)) *
-			((adc_T>>4) - ((int32_t)rc_bmp280_cal.dig_T1))) >> 12) *
-			((int32_t)rc_bmp280_cal.dig_T3)) >> 14;
-
-	t_fine = var1 + var2;
-
-	T  = (t_fine * 5 + 128) >> 8;
-	data->temp_c =  T/100.0;
-
-	var3 = ((int64_t)t_fine) - 128000;
-	var4 = var3 * var3 * (int64_t)rc_bmp280_cal.dig_P6;
-	var4 = var4 + ((var3*(int64_t)rc_bmp280_cal.dig_P5)<<17);
-	var4 = var4 + (((int64_t)rc_bmp280_cal.dig_P4)<<35);
-	var3 = ((var3 * var3 * (int64_t)rc_bmp280_cal.dig_P3)>>8) +
-		   ((var3 * (int64_t)rc_bmp280_cal.dig_P2)<<12);
-	var3 = (((((int64_t)1)<<47)+var3))*((int64_t)rc_bmp280_cal.dig_P1)>>33;
-
-	// avoid exception caused by division by zero
-	if(var3==0){
+	if(__convert(raw, data)){
 		fprintf(stderr,"ERROR in rc_bmp_read, invalid data read\n");
 		return -1;
 	}
-
-	p = 1048576 - adc_P;
-	p = (((p<<31) - var4)*3125) / var3;
-	var3 = (((int64_t)rc_bmp280_cal.dig_P9) * (p >> 13) * (p >> 13)) >> 25;
-	var4 = (((int64_t)rc_bmp280_cal.dig_P8) * p) >> 19;
-
-	p = ((p + var3 + var4) >> 8) + (((int64_t)rc_bmp280_cal.dig_P7) << 4);
-	data->pressure_pa = p/256.0;
-
-	data->alt_m = 44330.0*(1.0 - pow((data->pressure_pa/rc_bmp280_cal.sea_level_pa), 0.1903));
-
 	return 0;
 }
 
@@ -279,7 +518,25 @@ int rc_bmp_set_sea_level_pressure_pa(double pa)
 		return -1;
 	}
 	rc_bmp280_cal.sea_level_pa = pa;
+	rc_bmp280_cal.inv_sea_level_pa = 1.0/pa;
 	return 0;
 }
 
 
+int rc_bmp_read_latest(rc_bmp_sample_t* sample)
+{
+	int ret;
+	if(sample==NULL){
+		fprintf(stderr,"ERROR in rc_bmp_read_latest, received NULL pointer\n");
+		return -1;
+	}
+	if(!sampler_running){
+		fprintf(stderr,"ERROR in rc_bmp_read_latest, sampler not running\n");
+		return -1;
+	}
+	ret = __seqlock_latest_read(&latest_count, sample, latest, sizeof(latest[0]));
+	if(ret<0){
+		fprintf(stderr,"ERROR in rc_bmp_read_latest, sampler kept overwriting the result\n");
+	}
+	return ret;
+}
@@ -3,9 +3,34 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h> // for abs
+#include <pthread.h>
+#include <stdatomic.h>
 #include <rc/encoder.h>
 #include <rc/encoder_pru.h>
 #include <rc/encoder_eqep.h>
+#include <rc/math/filter_bank.h>
+#include <rc/model.h>
+#include <rc/time.h>
+#include <rc/pthread.h>
+#include "seqlock.h"
+
+#define EQEP_CHANNELS		3
+#define CAPTURE_CCPS		7	// capture clock 100MHz/128, overflows after 84ms
+
+// speed estimator state, only touched by the sampler thread once started
+static rc_encoder_speed_config_t speed_conf;
+static pthread_t speed_thread;
+static int speed_running = 0;
+static volatile int speed_shutdown = 0;
+static int speed_mapped_eqep = 0;	// 1 if the estimator enabled the eQEP map itself
+static rc_filter_bank_t vel_lp = RC_FILTER_BANK_INITIALIZER;
+static rc_filter_bank_t acc_lp = RC_FILTER_BANK_INITIALIZER;
+
+// two slots for the latest snapshot, speed_count says which one is current,
+// see seqlock.h
+static _Atomic uint64_t speed_count = 0;
+static rc_encoder_speed_t speed_latest[2];
 
 
 int rc_encoder_init(void)
@@ -52,3 +77,203 @@ int rc_encoder_write(int ch, int value)
 	return rc_encoder_eqep_write(ch,value);
 }
 
+
+// publishes a snapshot as the latest one, only called by the sampler
+static void __speed_publish(rc_encoder_speed_t* snap)
+{
+	rc_encoder_speed_t* slot = __seqlock_latest_begin(&speed_count, speed_latest, sizeof(speed_latest[0]), &snap->seq);
+	*slot = *snap;
+	__seqlock_latest_end(&speed_count);
+}
+
+
+/**
+ * Samples every channel once per period. A channel's raw velocity is the
+ * position change divided by the time since the position last changed, so one
+ * count that took 30 samples to arrive reads as 1/30th of a count per sample
+ * rather than a spike of 1 and 29 zeros. While a channel is still the raw
+ * velocity is limited to one count over the time since it last moved so it
+ * decays to zero when the encoder stops.
+ */
+static void* __speed_func(__attribute__ ((unused)) void* ptr)
+{
+	int ch, dp, pos, first = 1;
+	int last_pos[RC_ENCODER_CHANNELS];
+	uint64_t last_change_ns[RC_ENCODER_CHANNELS];
+	double raw[RC_ENCODER_CHANNELS], vel[RC_ENCODER_CHANNELS], dvel[RC_ENCODER_CHANNELS];
+	double prev_vel[RC_ENCODER_CHANNELS], bound, dt;
+	uint64_t period_ns, next_ns, now;
+	rc_encoder_speed_t snap;
+	rc_encoder_eqep_velocity_t hw;
+
+	period_ns = 1000000000/speed_conf.rate_hz;
+	dt = 1.0/speed_conf.rate_hz;
+	next_ns = rc_nanos_since_epoch();
+	for(ch=0;ch<RC_ENCODER_CHANNELS;ch++){
+		if(ch==1 && rc_model()==MODEL_BB_POCKET) last_pos[ch] = 0;
+		else last_pos[ch] = rc_encoder_read(ch+1);
+		last_change_ns[ch] = next_ns;
+		raw[ch] = 0.0;
+		prev_vel[ch] = 0.0;
+	}
+	while(!speed_shutdown){
+		now = rc_nanos_since_epoch();
+		if(next_ns>now) rc_usleep((next_ns-now)/1000);
+		next_ns += period_ns;
+		now = rc_nanos_since_epoch();
+		// fell behind by more than a period, don't try to catch up
+		if(next_ns<now) next_ns = now + period_ns;
+
+		for(ch=0;ch<RC_ENCODER_CHANNELS;ch++){
+			// channel 2 isn't enabled on the pocketbeagle
+			if(ch==1 && rc_model()==MODEL_BB_POCKET) pos = 0;
+			else pos = rc_encoder_read(ch+1);
+			dp = pos - last_pos[ch];
+			if(speed_conf.eqep_capture && ch<EQEP_CHANNELS && abs(dp)<speed_conf.capture_counts &&
+					rc_encoder_eqep_read_velocity(ch+1, &hw)==0 && hw.period_valid){
+				raw[ch] = hw.period_rate;
+				if(dp!=0) last_change_ns[ch] = now;
+			}
+			else if(dp!=0){
+				raw[ch] = dp*1e9/(now - last_change_ns[ch]);
+				last_change_ns[ch] = now;
+			}
+			else{
+				bound = 1e9/(now - last_change_ns[ch]);
+				if(raw[ch]>bound) raw[ch] = bound;
+				else if(raw[ch]<-bound) raw[ch] = -bound;
+			}
+			last_pos[ch] = pos;
+			snap.position[ch] = pos;
+		}
+
+		// filter velocity, then differentiate and filter again for acceleration
+		rc_filter_bank_march(&vel_lp, raw, vel);
+		for(ch=0;ch<RC_ENCODER_CHANNELS;ch++){
+			dvel[ch] = first ? 0.0 : (vel[ch]-prev_vel[ch])/dt;
+			prev_vel[ch] = vel[ch];
+			snap.velocity[ch] = vel[ch];
+		}
+		first = 0;
+		rc_filter_bank_march(&acc_lp, dvel, snap.acceleration);
+		snap.timestamp_ns = now;
+		__speed_publish(&snap);
+	}
+	return NULL;
+}
+
+
+rc_encoder_speed_config_t rc_encoder_speed_default_config(void)
+{
+	rc_encoder_speed_config_t conf;
+	conf.rate_hz = 1000;
+	conf.filter_tc = 0.02;
+	conf.eqep_capture = 0;
+	conf.capture_counts = 4;
+	conf.sched_policy = SCHED_OTHER;
+	conf.priority = 0;
+	return conf;
+}
+
+
+int rc_encoder_speed_start(rc_encoder_speed_config_t conf)
+{
+	int ch;
+	double dt;
+	rc_filter_t proto = RC_FILTER_INITIALIZER;
+
+	// sanity checks
+	if(speed_running){
+		fprintf(stderr,"ERROR in rc_encoder_speed_start, already running\n");
+		return -1;
+	}
+	if(conf.rate_hz<1 || conf.rate_hz>100000){
+		fprintf(stderr,"ERROR in rc_encoder_speed_start, rate_hz must be between 1 & 100000\n");
+		return -1;
+	}
+	dt = 1.0/conf.rate_hz;
+	if(conf.filter_tc<2.0*dt){
+		fprintf(stderr,"ERROR in rc_encoder_speed_start, filter_tc must be at least 2 sample periods\n");
+		return -1;
+	}
+	speed_conf = conf;
+
+	// one lowpass shared by every channel
+	if(rc_filter_first_order_lowpass(&proto, dt, conf.filter_tc)) return -1;
+	if(rc_filter_bank_alloc(&vel_lp, RC_ENCODER_CHANNELS, proto) ||
+			rc_filter_bank_alloc(&acc_lp, RC_ENCODER_CHANNELS, proto)){
+		rc_filter_free(&proto);
+		rc_filter_bank_free(&vel_lp);
+		return -1;
+	}
+	rc_filter_free(&proto);
+
+	// eQEP capture measures the period of a single count, latched once per sample
+	speed_mapped_eqep = 0;
+	if(conf.eqep_capture){
+		// leave the map alone at stop if the user had already enabled it
+		speed_mapped_eqep = !rc_encoder_eqep_mmap_enabled();
+		if(rc_encoder_eqep_enable_mmap()){
+			fprintf(stderr,"ERROR in rc_encoder_speed_start, eqep_capture needs the eQEP registers\n");
+			speed_mapped_eqep = 0;
+			goto fail;
+		}
+		for(ch=1;ch<=EQEP_CHANNELS;ch++){
+			if(ch==2 && rc_model()==MODEL_BB_POCKET) continue;
+			if(rc_encoder_eqep_config_velocity(ch, 1000000/conf.rate_hz, 0, CAPTURE_CCPS)) goto fail;
+		}
+	}
+
+	atomic_store(&speed_count, 0);
+	speed_shutdown = 0;
+	if(rc_pthread_create(&speed_thread, __speed_func, NULL, conf.sched_policy, conf.priority)<0){
+		fprintf(stderr,"ERROR in rc_encoder_speed_start, failed to start thread\n");
+		goto fail;
+	}
+	speed_running = 1;
+	return 0;
+
+fail:
+	if(speed_mapped_eqep) rc_encoder_eqep_disable_mmap();
+	speed_mapped_eqep = 0;
+	rc_filter_bank_free(&vel_lp);
+	rc_filter_bank_free(&acc_lp);
+	return -1;
+}
+
+
+int rc_encoder_speed_stop(void)
+{
+	int ret = 0;
+	if(!speed_running) return 0;
+	speed_shutdown = 1;
+	if(rc_pthread_timed_join(speed_thread, NULL, 1.0)==1){
+		fprintf(stderr,"WARNING in rc_encoder_speed_stop, thread exit timeout\n");
+		ret = -1;
+	}
+	if(speed_mapped_eqep) rc_encoder_eqep_disable_mmap();
+	speed_mapped_eqep = 0;
+	rc_filter_bank_free(&vel_lp);
+	rc_filter_bank_free(&acc_lp);
+	speed_running = 0;
+	return ret;
+}
+
+
+int rc_encoder_speed_read(rc_encoder_speed_t* speed)
+{
+	int ret;
+	if(speed==NULL){
+		fprintf(stderr,"ERROR in rc_encoder_speed_read, received NULL pointer\n");
+		return -1;
+	}
+	if(!speed_running){
+		fprintf(stderr,"ERROR in rc_encoder_speed_read, estimator not running\n");
+		return -1;
+	}
+	ret = __seqlock_latest_read(&speed_count, speed, speed_latest, sizeof(speed_latest[0]));
+	if(ret<0){
+		fprintf(stderr,"ERROR in rc_encoder_speed_read, estimator kept overwriting the snapshot\n");
+	}
+	return ret;
+}
@@ -9,10 +9,15 @@
 
 #include <stdio.h>
 #include <stdlib.h> // for atoi
+#include <string.h>
 #include <errno.h>
 #include <fcntl.h> // for open
 #include <unistd.h> // for close
+#include <poll.h>
+#include <pthread.h>
 #include <rc/adc.h>
+#include <rc/time.h>
+#include <rc/pthread.h>
 
 // preposessor macros
 #define unlikely(x)	__builtin_expect (!!(x), 0)
@@ -30,10 +35,27 @@
 #define RAW_MAX 4095
 #define RAW_MIN 0
 #define MAX_BUF 64
+#define DEV_PATH "/dev/iio:device0"
+#define PATH_BUF 256
+#define POLL_TIMEOUT_MS 100	// how often the reader checks for shutdown
 
 static int init_flag = 0; // boolean to check if mem mapped
 static int fd[CHANNELS]; // file descriptors for 8 channels
 
+// buffered streaming state
+static int stream_running = 0;
+static volatile int stream_shutdown = 0;
+static pthread_t stream_thread;
+static int stream_fd = -1;
+static char stream_dir[PATH_BUF];
+static rc_adc_stream_config_t stream_conf;
+static void (*stream_func)(const rc_adc_block_t* block) = NULL;
+static rc_adc_block_t block;
+static int storage_bytes[CHANNELS];	// bytes per value, in frame order
+static int value_shift[CHANNELS];
+static uint32_t value_mask[CHANNELS];
+static int frame_bytes;
+
 
 int rc_adc_init(void)
 {
@@ -121,5 +143,274 @@ double rc_adc_dc_jack(void)
 }
 
 
+// writes a string to a file in the stream's sysfs directory
+static int __write_attr(const char* attr, const char* val)
+{
+	char path[2*PATH_BUF];
+	int f, ret;
+	snprintf(path, sizeof(path), "%s/%s", stream_dir, attr);
+	f = open(path, O_WRONLY);
+	if(unlikely(f==-1)){
+		fprintf(stderr,"ERROR in rc_adc_stream, failed to open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	ret = write(f, val, strlen(val));
+	close(f);
+	if(unlikely(ret==-1)){
+		fprintf(stderr,"ERROR in rc_adc_stream, failed to write %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+
+// reads a file in the stream's sysfs directory into buf
+static int __read_attr(const char* attr, char* buf, int len)
+{
+	char path[2*PATH_BUF];
+	int f, ret;
+	snprintf(path, sizeof(path), "%s/%s", stream_dir, attr);
+	f = open(path, O_RDONLY);
+	if(unlikely(f==-1)){
+		fprintf(stderr,"ERROR in rc_adc_stream, failed to open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	ret = read(f, buf, len-1);
+	close(f);
+	if(unlikely(ret<=0)){
+		fprintf(stderr,"ERROR in rc_adc_stream, failed to read %s\n", path);
+		return -1;
+	}
+	buf[ret] = '\0';
+	return 0;
+}
+
+
+/**
+ * @brief      Works out the frame layout from the scan_elements directory.
+ *
+ * Enabled channels appear in a frame in order of their scan index, each stored
+ * as described by its type attribute such as "le:u12/16>>0".
+ *
+ * @return     0 on success, -1 on failure
+ */
+static int __parse_scan_elements(void)
+{
+	int i, j, n, tmp, index[CHANNELS];
+	int realbits, storagebits, shift;
+	char sign, buf[MAX_BUF], attr[MAX_BUF];
+
+	n = 0;
+	for(i=0;i<CHANNELS;i++){
+		if(!(stream_conf.channel_mask&(1<<i))) continue;
+		snprintf(attr, sizeof(attr), "scan_elements/in_voltage%d_index", i);
+		if(__read_attr(attr, buf, sizeof(buf))) return -1;
+		index[n] = atoi(buf);
+		snprintf(attr, sizeof(attr), "scan_elements/in_voltage%d_type", i);
+		if(__read_attr(attr, buf, sizeof(buf))) return -1;
+		if(sscanf(buf, "le:%c%d/%d>>%d", &sign, &realbits, &storagebits, &shift)!=4 ||
+				(storagebits!=16 && storagebits!=32) || realbits>16){
+			fprintf(stderr,"ERROR in rc_adc_stream_start, unsupported type for channel %d: %s\n", i, buf);
+			return -1;
+		}
+		block.channel[n] = i;
+		storage_bytes[n] = storagebits/8;
+		value_shift[n] = shift;
+		value_mask[n] = (1u<<realbits)-1;
+		n++;
+	}
+	// sort into scan index order, there are only 8 at most
+	for(i=1;i<n;i++){
+		for(j=i;j>0 && index[j-1]>index[j];j--){
+			tmp=index[j]; index[j]=index[j-1]; index[j-1]=tmp;
+			tmp=block.channel[j]; block.channel[j]=block.channel[j-1]; block.channel[j-1]=tmp;
+			tmp=storage_bytes[j]; storage_bytes[j]=storage_bytes[j-1]; storage_bytes[j-1]=tmp;
+			tmp=value_shift[j]; value_shift[j]=value_shift[j-1]; value_shift[j-1]=tmp;
+			tmp=value_mask[j]; value_mask[j]=value_mask[j-1]; value_mask[j-1]=tmp;
+		}
+	}
+	block.channels = n;
+	// every value is the same size here so no padding between them
+	frame_bytes = 0;
+	for(i=0;i<n;i++) frame_bytes += storage_bytes[i];
+	return 0;
+}
+
+
+// unpacks little endian frames into raw values
+static void __unpack(const uint8_t* in, uint16_t* out, int frames)
+{
+	int f, c;
+	uint32_t v;
+	for(f=0;f<frames;f++){
+		for(c=0;c<block.channels;c++){
+			if(storage_bytes[c]==2) v = in[0] | (in[1]<<8);
+			else v = in[0] | (in[1]<<8) | (in[2]<<16) | ((uint32_t)in[3]<<24);
+			*out++ = (v>>value_shift[c]) & value_mask[c];
+			in += storage_bytes[c];
+		}
+	}
+	return;
+}
 
 
+static void* __stream_func(__attribute__ ((unused)) void* ptr)
+{
+	int ret, frames, have = 0;
+	uint8_t* bytes;
+	uint16_t* raw;
+	struct pollfd pfd;
+	uint64_t total = 0;
+
+	bytes = (uint8_t*)malloc(stream_conf.block_len*frame_bytes);
+	raw = (uint16_t*)malloc(stream_conf.block_len*block.channels*sizeof(uint16_t));
+	if(unlikely(bytes==NULL || raw==NULL)){
+		fprintf(stderr,"ERROR in rc_adc_stream, failed to allocate memory\n");
+		free(bytes);
+		free(raw);
+		return NULL;
+	}
+	block.raw = raw;
+	pfd.fd = stream_fd;
+	pfd.events = POLLIN;
+
+	while(!stream_shutdown){
+		ret = poll(&pfd, 1, POLL_TIMEOUT_MS);
+		if(ret==0) continue;
+		if(unlikely(ret==-1)){
+			if(errno==EINTR) continue;
+			perror("ERROR in rc_adc_stream, poll failed");
+			break;
+		}
+		// read as many whole frames as fit, a partial frame is kept for next time
+		ret = read(stream_fd, bytes+have, stream_conf.block_len*frame_bytes-have);
+		if(ret<=0){
+			if(ret==-1 && errno!=EAGAIN && errno!=EINTR){
+				perror("ERROR in rc_adc_stream, read failed");
+				break;
+			}
+			// nothing there despite poll, don't spin on a hung up device
+			if(pfd.revents&POLLHUP) rc_usleep(1000);
+			continue;
+		}
+		have += ret;
+		frames = have/frame_bytes;
+		if(frames==0) continue;
+
+		block.timestamp_ns = rc_nanos_since_epoch();
+		__unpack(bytes, raw, frames);
+		block.first_frame = total;
+		block.frames = frames;
+		if(stream_func!=NULL) stream_func(&block);
+		total += frames;
+
+		have -= frames*frame_bytes;
+		memmove(bytes, bytes+frames*frame_bytes, have);
+	}
+	free(bytes);
+	free(raw);
+	block.raw = NULL;
+	return NULL;
+}
+
+
+rc_adc_stream_config_t rc_adc_stream_default_config(void)
+{
+	rc_adc_stream_config_t conf;
+	conf.channel_mask = (1<<CHANNELS)-1;
+	conf.buffer_len = 1024;
+	conf.block_len = 64;
+	conf.sched_policy = SCHED_OTHER;
+	conf.priority = 0;
+	conf.sysfs_dir = IIO_DIR;
+	conf.dev_path = DEV_PATH;
+	return conf;
+}
+
+
+int rc_adc_stream_start(rc_adc_stream_config_t conf, void (*func)(const rc_adc_block_t* block))
+{
+	int i;
+	char attr[MAX_BUF], val[MAX_BUF], path[2*PATH_BUF];
+
+	// sanity checks
+	if(unlikely(stream_running)){
+		fprintf(stderr,"ERROR in rc_adc_stream_start, stream already running\n");
+		return -1;
+	}
+	if(unlikely(func==NULL || conf.sysfs_dir==NULL || conf.dev_path==NULL)){
+		fprintf(stderr,"ERROR in rc_adc_stream_start, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(conf.channel_mask<=0 || conf.channel_mask>=(1<<CHANNELS))){
+		fprintf(stderr,"ERROR in rc_adc_stream_start, channel_mask must enable 1 to %d channels\n", CHANNELS);
+		return -1;
+	}
+	if(unlikely(conf.block_len<1 || conf.buffer_len<conf.block_len)){
+		fprintf(stderr,"ERROR in rc_adc_stream_start, need 1 <= block_len <= buffer_len\n");
+		return -1;
+	}
+	if(unlikely(strlen(conf.sysfs_dir)>=PATH_BUF)){
+		fprintf(stderr,"ERROR in rc_adc_stream_start, sysfs_dir too long\n");
+		return -1;
+	}
+	strcpy(stream_dir, conf.sysfs_dir);
+	stream_conf = conf;
+	stream_func = func;
+
+	// buffer must be off while it's configured
+	if(__write_attr("buffer/enable", "0")) return -1;
+	for(i=0;i<CHANNELS;i++){
+		snprintf(attr, sizeof(attr), "scan_elements/in_voltage%d_en", i);
+		if(__write_attr(attr, (conf.channel_mask&(1<<i)) ? "1" : "0")) return -1;
+	}
+	if(__parse_scan_elements()) return -1;
+	snprintf(val, sizeof(val), "%d", conf.buffer_len);
+	if(__write_attr("buffer/length", val)) return -1;
+	// wake the reader once per block, older kernels don't have a watermark
+	snprintf(path, sizeof(path), "%s/buffer/watermark", stream_dir);
+	if(access(path, F_OK)==0){
+		snprintf(val, sizeof(val), "%d", conf.block_len);
+		if(__write_attr("buffer/watermark", val)) return -1;
+	}
+
+	// open the character device before enabling so no frames are lost
+	stream_fd = open(conf.dev_path, O_RDONLY | O_NONBLOCK);
+	if(unlikely(stream_fd==-1)){
+		perror("ERROR in rc_adc_stream_start, failed to open iio device");
+		return -1;
+	}
+	if(__write_attr("buffer/enable", "1")){
+		close(stream_fd);
+		stream_fd = -1;
+		return -1;
+	}
+
+	stream_shutdown = 0;
+	if(rc_pthread_create(&stream_thread, __stream_func, NULL, conf.sched_policy, conf.priority)<0){
+		fprintf(stderr,"ERROR in rc_adc_stream_start, failed to start reader thread\n");
+		__write_attr("buffer/enable", "0");
+		close(stream_fd);
+		stream_fd = -1;
+		return -1;
+	}
+	stream_running = 1;
+	return 0;
+}
+
+
+int rc_adc_stream_stop(void)
+{
+	int ret = 0;
+	if(!stream_running) return 0;
+	stream_shutdown = 1;
+	if(rc_pthread_timed_join(stream_thread, NULL, 1.0)==1){
+		fprintf(stderr,"WARNING in rc_adc_stream_stop, reader thread exit timeout\n");
+		ret = -1;
+	}
+	if(__write_attr("buffer/enable", "0")) ret = -1;
+	close(stream_fd);
+	stream_fd = -1;
+	stream_running = 0;
+	return ret;
+}
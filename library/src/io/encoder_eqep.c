@@ -11,8 +11,11 @@
 #include <errno.h>
 #include <fcntl.h> // for open
 #include <unistd.h> // for close
+#include <string.h>
+#include <sys/mman.h>	// mmap
 
 #include <rc/model.h>
+#include <rc/time.h>
 #include <rc/encoder_eqep.h>
 
 // preposessor macros
@@ -25,9 +28,54 @@
 #define EQEP_BASE2 "/sys/devices/platform/ocp/48304000.epwmss/48304180.eqep"
 
 
+// register map, page 184 of the am335x TRM and the eQEP chapter
+#define PWMSS0_ADDR	0x48300000	// start of PWMSS0, 1 and 2 follow
+#define PWMSS_STRIDE	0x2000		// distance between subsystems
+#define PWMSS_LEN	0x1000		// one page covers the eQEP registers
+#define EQEP_OFFSET	0x180		// eQEP module within the subsystem
+#define MMAP_FILE_LEN	(3*PWMSS_STRIDE)
+#define SYSCLK_HZ	100000000
+// byte offsets of the registers used here
+#define QPOSCNT		0x00	// 32-bit position counter
+#define QPOSLAT		0x18	// 32-bit position latched on unit time out
+#define QUPRD		0x20	// 32-bit unit timer period
+#define QEPCTL		0x2A	// 16-bit control
+#define QCAPCTL		0x2C	// 16-bit capture control
+#define QFLG		0x32	// 16-bit interrupt flags
+#define QCLR		0x34	// 16-bit interrupt flag clear
+#define QEPSTS		0x38	// 16-bit status
+#define QCPRDLAT	0x40	// 16-bit capture period latched on unit time out
+// bits
+#define QEPCTL_QCLM	(1<<2)	// latch capture registers on unit time out
+#define QEPCTL_UTE	(1<<1)	// unit timer enable
+#define QCAPCTL_CEN	(1<<15)	// capture unit enable
+#define QFLG_UTO	(1<<11)	// unit time out
+#define QEPSTS_COEF	(1<<3)	// capture timer overflowed
+#define QEPSTS_CDEF	(1<<2)	// direction changed between captures
+#define QEPSTS_QDF	(1<<5)	// counting up
+
+#define REG32(ch,off)	(*(volatile uint32_t*)(regs[ch]+(off)))
+#define REG16(ch,off)	(*(volatile uint16_t*)(regs[ch]+(off)))
+
 static int fd[3]; //store file descriptors for 3 position files
 static int init_flag = 0; // boolean to check if mem mapped
 
+// direct register access, regs[ch-1] is NULL while a channel uses sysfs
+static volatile char* regs[3] = {NULL,NULL,NULL};
+static char mmap_file[MAX_BUF*2];	// empty string for /dev/mem
+
+// per channel velocity state
+typedef struct velocity_state_t{
+	int configured;
+	uint64_t unit_period_ns;
+	double counts_per_capture;	// 2^upps
+	double capture_clk_hz;		// 100MHz/2^ccps
+	int last_latch;
+	uint64_t last_latch_ns;		// 0 until the first latch is seen
+	rc_encoder_eqep_velocity_t v;	// last result, returned again if no new latch
+} velocity_state_t;
+static velocity_state_t vel[3];
+
 
 
 int rc_encoder_eqep_init(void)
@@ -119,6 +167,7 @@ int rc_encoder_eqep_init(void)
 int rc_encoder_eqep_cleanup(void)
 {
 	int i;
+	rc_encoder_eqep_disable_mmap();
 	for(i=0;i<3;i++){
 		close(fd[i]);
 	}
@@ -132,7 +181,7 @@ int rc_encoder_eqep_read(int ch)
 	char buf[12];
 
 	//sanity checks
-	if(unlikely(!init_flag)){
+	if(unlikely(!init_flag && regs[0]==NULL)){
 		fprintf(stderr,"ERROR in rc_encoder_eqep_read, please initialize with rc_encoder_eqep_init() first\n");
 		return -1;
 	}
@@ -144,6 +193,8 @@ int rc_encoder_eqep_read(int ch)
 		fprintf(stderr,"ERROR: in rc_encoder_eqep_read, encoder channel must be between 1 & 3 inclusive\n");
 		return -1;
 	}
+	// read the counter register directly if mapped
+	if(regs[ch-1]!=NULL) return (int)REG32(ch-1,QPOSCNT);
 	// seek to beginning of file and read
 	if(unlikely(lseek(fd[ch-1],0,SEEK_SET)<0)){
 		perror("ERROR: in rc_encoder_eqep_read, failed to seek to beginning of fd");
@@ -162,7 +213,7 @@ int rc_encoder_eqep_write(int ch, int pos)
 {
 	char buf[12];
 	//sanity checks
-	if(unlikely(!init_flag)){
+	if(unlikely(!init_flag && regs[0]==NULL)){
 		fprintf(stderr,"ERROR in rc_encoder_eqep_write, please initialize with rc_encoder_eqep_init() first\n");
 		return -1;
 	}
@@ -174,6 +225,10 @@ int rc_encoder_eqep_write(int ch, int pos)
 		fprintf(stderr,"ERROR: in rc_encoder_eqep_write, encoder channel must be between 1 & 3 inclusive\n");
 		return -1;
 	}
+	if(regs[ch-1]!=NULL){
+		REG32(ch-1,QPOSCNT) = (uint32_t)pos;
+		return 0;
+	}
 	if(unlikely(lseek(fd[ch-1],0,SEEK_SET)<0)){
 		perror("ERROR: in rc_encoder_eqep_write, failed to seek to beginning of fd");
 		return -1;
@@ -187,3 +242,195 @@ int rc_encoder_eqep_write(int ch, int pos)
 }
 
 
+int rc_encoder_eqep_enable_mmap(void)
+{
+	int i, mfd;
+	off_t base;
+	void* map;
+
+	if(regs[0]!=NULL) return 0;
+	// the kernel driver enables the module clocks, registers can't be touched without it
+	if(mmap_file[0]=='\0' && !init_flag){
+		fprintf(stderr,"ERROR in rc_encoder_eqep_enable_mmap, call rc_encoder_eqep_init first\n");
+		return -1;
+	}
+	if(mmap_file[0]=='\0') mfd = open("/dev/mem", O_RDWR | O_SYNC);
+	else mfd = open(mmap_file, O_RDWR);
+	if(unlikely(mfd==-1)){
+		perror("ERROR in rc_encoder_eqep_enable_mmap, failed to open memory file");
+		if(mmap_file[0]=='\0') fprintf(stderr,"Need to be root to map eQEP registers\n");
+		return -1;
+	}
+	for(i=0;i<3;i++){
+		// subsystem 1 isn't enabled on the pocketbeagle
+		if(mmap_file[0]=='\0' && i==1 && rc_model()==MODEL_BB_POCKET) continue;
+		base = i*PWMSS_STRIDE;
+		if(mmap_file[0]=='\0') base += PWMSS0_ADDR;
+		map = mmap(0, PWMSS_LEN, PROT_READ | PROT_WRITE, MAP_SHARED, mfd, base);
+		if(unlikely(map==MAP_FAILED)){
+			perror("ERROR in rc_encoder_eqep_enable_mmap, failed to map memory");
+			close(mfd);
+			rc_encoder_eqep_disable_mmap();
+			return -1;
+		}
+		regs[i] = (volatile char*)map + EQEP_OFFSET;
+		memset(&vel[i], 0, sizeof(velocity_state_t));
+	}
+	close(mfd);
+	return 0;
+}
+
+
+int rc_encoder_eqep_disable_mmap(void)
+{
+	int i;
+	for(i=0;i<3;i++){
+		if(regs[i]==NULL) continue;
+		munmap((char*)regs[i]-EQEP_OFFSET, PWMSS_LEN);
+		regs[i] = NULL;
+		vel[i].configured = 0;
+	}
+	return 0;
+}
+
+
+int rc_encoder_eqep_mmap_enabled(void)
+{
+	return regs[0]!=NULL;
+}
+
+
+int rc_encoder_eqep_set_mmap_file(const char* path)
+{
+	int f;
+	off_t len;
+	if(path==NULL){
+		mmap_file[0] = '\0';
+		return 0;
+	}
+	if(unlikely(strlen(path)>=sizeof(mmap_file))){
+		fprintf(stderr,"ERROR in rc_encoder_eqep_set_mmap_file, path too long\n");
+		return -1;
+	}
+	// check it's big enough now rather than faulting on access later
+	f = open(path, O_RDONLY);
+	if(unlikely(f==-1)){
+		perror("ERROR in rc_encoder_eqep_set_mmap_file, failed to open file");
+		return -1;
+	}
+	len = lseek(f, 0, SEEK_END);
+	close(f);
+	if(unlikely(len<MMAP_FILE_LEN)){
+		fprintf(stderr,"ERROR in rc_encoder_eqep_set_mmap_file, file must be at least %d bytes\n", MMAP_FILE_LEN);
+		return -1;
+	}
+	strcpy(mmap_file, path);
+	return 0;
+}
+
+
+int rc_encoder_eqep_config_velocity(int ch, int unit_period_us, int upps, int ccps)
+{
+	int i = ch-1;
+
+	// sanity checks
+	if(unlikely(ch<1 || ch>3)){
+		fprintf(stderr,"ERROR: in rc_encoder_eqep_config_velocity, encoder channel must be between 1 & 3 inclusive\n");
+		return -1;
+	}
+	if(unlikely(regs[i]==NULL)){
+		fprintf(stderr,"ERROR in rc_encoder_eqep_config_velocity, call rc_encoder_eqep_enable_mmap first\n");
+		return -1;
+	}
+	if(unlikely(unit_period_us<1 || unit_period_us>42000000)){
+		fprintf(stderr,"ERROR in rc_encoder_eqep_config_velocity, unit_period_us must be between 1 & 42000000\n");
+		return -1;
+	}
+	if(unlikely(upps<0 || upps>11 || ccps<0 || ccps>7)){
+		fprintf(stderr,"ERROR in rc_encoder_eqep_config_velocity, upps must be 0-11 and ccps 0-7\n");
+		return -1;
+	}
+
+	// prescalers can only change while the capture unit is off
+	REG16(i,QCAPCTL) = 0;
+	REG16(i,QCAPCTL) = (ccps<<4) | upps;
+	REG16(i,QCAPCTL) = QCAPCTL_CEN | (ccps<<4) | upps;
+	// timer counts sysclk cycles, latch position and capture on time out
+	REG32(i,QUPRD) = (uint32_t)((uint64_t)unit_period_us*(SYSCLK_HZ/1000000));
+	REG16(i,QEPCTL) = REG16(i,QEPCTL) | QEPCTL_UTE | QEPCTL_QCLM;
+	REG16(i,QCLR) = QFLG_UTO;
+	REG16(i,QEPSTS) = QEPSTS_COEF | QEPSTS_CDEF;
+
+	memset(&vel[i], 0, sizeof(velocity_state_t));
+	vel[i].unit_period_ns = (uint64_t)unit_period_us*1000;
+	vel[i].counts_per_capture = 1<<upps;
+	vel[i].capture_clk_hz = SYSCLK_HZ/(double)(1<<ccps);
+	vel[i].configured = 1;
+	return 0;
+}
+
+
+int rc_encoder_eqep_read_velocity(int ch, rc_encoder_eqep_velocity_t* v)
+{
+	int i = ch-1;
+	int pos;
+	uint16_t sts, prd;
+	uint64_t now, periods;
+	velocity_state_t* st;
+
+	// sanity checks
+	if(unlikely(ch<1 || ch>3)){
+		fprintf(stderr,"ERROR: in rc_encoder_eqep_read_velocity, encoder channel must be between 1 & 3 inclusive\n");
+		return -1;
+	}
+	if(unlikely(v==NULL)){
+		fprintf(stderr,"ERROR in rc_encoder_eqep_read_velocity, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(regs[i]==NULL || !vel[i].configured)){
+		fprintf(stderr,"ERROR in rc_encoder_eqep_read_velocity, call rc_encoder_eqep_config_velocity first\n");
+		return -1;
+	}
+	st = &vel[i];
+
+	// nothing new since the last call, return the previous result
+	if(!(REG16(i,QFLG)&QFLG_UTO)){
+		*v = st->v;
+		v->new_latch = 0;
+		return 0;
+	}
+	// read the latches and status, then clear them for the next period
+	now = rc_nanos_since_epoch();
+	pos = (int)REG32(i,QPOSLAT);
+	prd = REG16(i,QCPRDLAT);
+	sts = REG16(i,QEPSTS);
+	REG16(i,QCLR) = QFLG_UTO;
+	REG16(i,QEPSTS) = QEPSTS_COEF | QEPSTS_CDEF;
+
+	// fixed time, spread the change over however many periods passed
+	if(st->last_latch_ns){
+		periods = (now - st->last_latch_ns + st->unit_period_ns/2)/st->unit_period_ns;
+		if(periods<1) periods = 1;
+		st->v.unit_rate = (double)(pos - st->last_latch)*1e9/(periods*st->unit_period_ns);
+	}
+	else st->v.unit_rate = 0.0;
+	st->last_latch = pos;
+	st->last_latch_ns = now;
+
+	// fixed position, only meaningful if the timer didn't overflow and the
+	// encoder kept going one way
+	if((sts&(QEPSTS_COEF|QEPSTS_CDEF)) || prd==0){
+		st->v.period_rate = 0.0;
+		st->v.period_valid = 0;
+	}
+	else{
+		st->v.period_rate = st->counts_per_capture*st->capture_clk_hz/prd;
+		if(!(sts&QEPSTS_QDF)) st->v.period_rate = -st->v.period_rate;
+		st->v.period_valid = 1;
+	}
+	st->v.position = pos;
+	st->v.timestamp_ns = now;
+	st->v.new_latch = 1;
+	*v = st->v;
+	return 0;
+}
@@ -270,3 +270,124 @@ void rc_gpio_cleanup(int chip, int pin)
 	}
 	return;
 }
+
+
+rc_gpio_group_t rc_gpio_group_empty(void)
+{
+	rc_gpio_group_t out = RC_GPIO_GROUP_INITIALIZER;
+	return out;
+}
+
+
+int rc_gpio_group_init(rc_gpio_group_t* group, int chip, const int* pins, int n, int handle_flags)
+{
+	int i, ret;
+	struct gpiohandle_request req;
+
+	// sanity checks
+	if(unlikely(group==NULL || pins==NULL)){
+		fprintf(stderr,"ERROR in rc_gpio_group_init, received NULL pointer\n");
+		return -1;
+	}
+	if(chip<0 || chip>=CHIPS_MAX){
+		fprintf(stderr,"ERROR in rc_gpio_group_init, chip out of bounds\n");
+		return -1;
+	}
+	if(n<1 || n>RC_GPIO_GROUP_MAX || n>GPIOHANDLES_MAX){
+		fprintf(stderr,"ERROR in rc_gpio_group_init, number of pins must be between 1 & %d\n", RC_GPIO_GROUP_MAX);
+		return -1;
+	}
+	for(i=0;i<n;i++){
+		if(pins[i]<0 || pins[i]>=GPIOHANDLES_MAX){
+			fprintf(stderr,"ERROR in rc_gpio_group_init, pin out of bounds\n");
+			return -1;
+		}
+	}
+	if(group->initialized) rc_gpio_group_cleanup(group);
+
+	// open chip if not opened already
+	if(chip_fd[chip]==0){
+		if(unlikely(__open_gpiochip(chip))) return -1;
+	}
+
+	// request all pins in one handle
+	memset(&req,0,sizeof(req));
+	for(i=0;i<n;i++) req.lineoffsets[i] = pins[i];
+	req.lines = n;
+	req.flags = handle_flags;
+	errno=0;
+	ret = ioctl(chip_fd[chip], GPIO_GET_LINEHANDLE_IOCTL, &req);
+	if(unlikely(ret==-1)){
+		perror("ERROR in rc_gpio_group_init");
+		return -1;
+	}
+	group->chip = chip;
+	group->lines = n;
+	for(i=0;i<n;i++) group->pins[i] = pins[i];
+	group->fd = req.fd;
+	group->initialized = 1;
+	return 0;
+}
+
+
+int rc_gpio_group_set_values(rc_gpio_group_t* group, const int* values)
+{
+	int i, ret;
+	struct gpiohandle_data data;
+
+	// sanity checks
+	if(unlikely(group==NULL || values==NULL)){
+		fprintf(stderr,"ERROR in rc_gpio_group_set_values, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!group->initialized)){
+		fprintf(stderr,"ERROR in rc_gpio_group_set_values, group not initialized yet\n");
+		return -1;
+	}
+
+	for(i=0;i<group->lines;i++) data.values[i] = values[i] ? 1 : 0;
+	ret = ioctl(group->fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data);
+	if(unlikely(ret==-1)){
+		perror("ERROR in rc_gpio_group_set_values");
+		return -1;
+	}
+	return 0;
+}
+
+
+int rc_gpio_group_get_values(rc_gpio_group_t* group, int* values)
+{
+	int i, ret;
+	struct gpiohandle_data data;
+
+	// sanity checks
+	if(unlikely(group==NULL || values==NULL)){
+		fprintf(stderr,"ERROR in rc_gpio_group_get_values, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!group->initialized)){
+		fprintf(stderr,"ERROR in rc_gpio_group_get_values, group not initialized yet\n");
+		return -1;
+	}
+
+	ret = ioctl(group->fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data);
+	if(unlikely(ret==-1)){
+		perror("ERROR in rc_gpio_group_get_values");
+		return -1;
+	}
+	for(i=0;i<group->lines;i++) values[i] = data.values[i];
+	return 0;
+}
+
+
+int rc_gpio_group_cleanup(rc_gpio_group_t* group)
+{
+	rc_gpio_group_t new = RC_GPIO_GROUP_INITIALIZER;
+	if(unlikely(group==NULL)){
+		fprintf(stderr,"ERROR in rc_gpio_group_cleanup, received NULL pointer\n");
+		return -1;
+	}
+	if(group->initialized && group->fd>=0) close(group->fd);
+	*group = new;
+	return 0;
+}
@@ -7,10 +7,13 @@
 #include <stdint.h> // for uint8_t types etc
 #include <stdlib.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <linux/i2c-dev.h> //for IOCTL defs
+#include <linux/i2c.h> // for struct i2c_msg and I2C_FUNC_I2C
 
 #include <rc/i2c.h>
 
@@ -28,10 +31,16 @@ typedef struct rc_i2c_state_t {
 	uint8_t devAddr;
 	int fd;
 	int initialized;
-	int lock;
+	atomic_int lock;	// 1 while any thread holds the bus mutex
+	int rdwr;	// adapter supports combined I2C_RDWR transfers
+	pthread_mutex_t mutex;	// priority inheritance bus arbiter
 } rc_i2c_state_t;
 
 static rc_i2c_state_t i2c[I2C_MAX_BUS+1];
+static pthread_once_t mutex_once = PTHREAD_ONCE_INIT;
+// how many times the calling thread has claimed each bus, only the owner of a
+// bus ever touches its own counter so this needs no locking
+static __thread int claims[I2C_MAX_BUS+1];
 
 
 // local function
@@ -45,6 +54,69 @@ static int __check_bus_range(int bus)
 }
 
 
+// set up every bus mutex once with priority inheritance. Threads blocked on a
+// PI mutex are queued by the kernel in priority order, so a SCHED_FIFO thread
+// such as the IMU interrupt handler gets the bus ahead of lower priority
+// waiters and boosts whichever thread currently holds it.
+static void __init_mutexes(void)
+{
+	int i;
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	if(pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT)){
+		fprintf(stderr,"WARNING: i2c bus mutex priority inheritance not supported\n");
+	}
+	for(i=0;i<=I2C_MAX_BUS;i++) pthread_mutex_init(&i2c[i].mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+	return;
+}
+
+
+// blocks until the calling thread holds the bus, claims nest so a thread that
+// already holds the bus returns straight away. returns the previous claim state
+static int __bus_lock(int bus)
+{
+	if(claims[bus]++) return 1;
+	pthread_once(&mutex_once, __init_mutexes);
+	pthread_mutex_lock(&i2c[bus].mutex);
+	atomic_store(&i2c[bus].lock, 1);
+	return 0;
+}
+
+
+// releases one claim, the bus is handed to the next waiter when the last claim
+// is released. does nothing if the calling thread doesn't hold the bus
+static int __bus_unlock(int bus)
+{
+	if(claims[bus]==0) return 0;
+	if(--claims[bus]) return 1;
+	atomic_store(&i2c[bus].lock, 0);
+	pthread_mutex_unlock(&i2c[bus].mutex);
+	return 1;
+}
+
+
+// write register address then read count bytes from devAddr in one combined
+// transfer with a repeated start in between, no STOP and only one syscall
+static int __read_combined(int bus, uint8_t devAddr, uint8_t regAddr, size_t count, uint8_t* data)
+{
+	struct i2c_msg msgs[2];
+	struct i2c_rdwr_ioctl_data xfer;
+	msgs[0].addr	= devAddr;
+	msgs[0].flags	= 0;
+	msgs[0].len	= 1;
+	msgs[0].buf	= &regAddr;
+	msgs[1].addr	= devAddr;
+	msgs[1].flags	= I2C_M_RD;
+	msgs[1].len	= count;
+	msgs[1].buf	= data;
+	xfer.msgs	= msgs;
+	xfer.nmsgs	= 2;
+	if(unlikely(ioctl(i2c[bus].fd, I2C_RDWR, &xfer)!=2)) return -1;
+	return 0;
+}
+
+
 int rc_i2c_init(int bus, uint8_t devAddr)
 {
 	// sanity check
@@ -56,7 +128,7 @@ int rc_i2c_init(int bus, uint8_t devAddr)
 	}
 
 	// lock the bus during this operation
-	i2c[bus].lock = 1;
+	__bus_lock(bus);
 	i2c[bus].initialized = 0;
 
 	// open file descriptor
@@ -65,18 +137,28 @@ int rc_i2c_init(int bus, uint8_t devAddr)
 	i2c[bus].fd = open(str, O_RDWR);
 	if(i2c[bus].fd==-1){
 		fprintf(stderr,"ERROR: in rc_i2c_init, failed to open /dev/i2c\n");
+		__bus_unlock(bus);
 		return -1;
 	}
 
 	// set device adress
 	if(unlikely(ioctl(i2c[bus].fd, I2C_SLAVE, devAddr)<0)){
 		fprintf(stderr,"ERROR: in rc_i2c_init, ioctl slave address change failed\n");
+		close(i2c[bus].fd);
+		__bus_unlock(bus);
 		return -1;
 	}
 	i2c[bus].devAddr = devAddr;
-	// return the lock state to previous state.
-	i2c[bus].lock = 0;
+	// check if combined transfers are available, otherwise reads fall back to
+	// a separate write and read
+	unsigned long funcs;
+	if(ioctl(i2c[bus].fd, I2C_FUNCS, &funcs)==0 && (funcs&I2C_FUNC_I2C)){
+		i2c[bus].rdwr = 1;
+	}
+	else i2c[bus].rdwr = 0;
 	i2c[bus].initialized = 1;
+	// release the bus
+	__bus_unlock(bus);
 	return 0;
 }
 
@@ -84,10 +166,13 @@ int rc_i2c_init(int bus, uint8_t devAddr)
 int rc_i2c_close(int bus)
 {
 	if(unlikely(__check_bus_range(bus))) return -1;
+	// wait for any transaction in progress to finish
+	__bus_lock(bus);
 	close(i2c[bus].fd);
 	i2c[bus].devAddr = 0;
 	i2c[bus].initialized = 0;
-	i2c[bus].lock=0;
+	i2c[bus].rdwr=0;
+	__bus_unlock(bus);
 	return 0;
 }
 
@@ -106,11 +191,14 @@ int rc_i2c_set_device_address(int bus, uint8_t devAddr)
 		return 0;
 	}
 	// if not, change it with ioctl
+	__bus_lock(bus);
 	if(unlikely(ioctl(i2c[bus].fd, I2C_SLAVE, devAddr)<0)){
 		fprintf(stderr,"ERROR: in rc_i2c_set_device_address, ioctl slave address change failed\n");
+		__bus_unlock(bus);
 		return -1;
 	}
 	i2c[bus].devAddr = devAddr;
+	__bus_unlock(bus);
 	return 0;
 }
 
@@ -123,7 +211,7 @@ int rc_i2c_read_byte(int bus, uint8_t regAddr, uint8_t *data)
 
 int rc_i2c_read_bytes(int bus, uint8_t regAddr, size_t count, uint8_t *data)
 {
-	int ret, old_lock;
+	int ret;
 
 	// sanity check
 	if(unlikely(__check_bus_range(bus))) return -1;
@@ -132,15 +220,25 @@ int rc_i2c_read_bytes(int bus, uint8_t regAddr, size_t count, uint8_t *data)
 		return -1;
 	}
 
-	// lock the bus during this operation, preserving old state to return to
-	old_lock = i2c[bus].lock;
-	i2c[bus].lock = 1;
+	// lock the bus during this operation
+	__bus_lock(bus);
+
+	// one repeated-start transfer if the adapter can
+	if(likely(i2c[bus].rdwr)){
+		ret = __read_combined(bus, i2c[bus].devAddr, regAddr, count, data);
+		__bus_unlock(bus);
+		if(unlikely(ret)){
+			fprintf(stderr,"ERROR: in rc_i2c_read_bytes, combined transfer failed\n");
+			return -1;
+		}
+		return count;
+	}
 
 	// write register to device
 	ret = write(i2c[bus].fd, &regAddr, 1);
 	if(unlikely(ret!=1)){
 		fprintf(stderr,"ERROR: in rc_i2c_read_bytes, failed to write to bus\n");
-		i2c[bus].lock = old_lock;
+		__bus_unlock(bus);
 		return -1;
 	}
 
@@ -148,12 +246,12 @@ int rc_i2c_read_bytes(int bus, uint8_t regAddr, size_t count, uint8_t *data)
 	ret = read(i2c[bus].fd, data, count);
 	if(unlikely((size_t)ret!=count)){
 		fprintf(stderr,"ERROR: in rc_i2c_read_bytes, received %d bytes from device, expected %d\n", ret, (int)count);
-		i2c[bus].lock = old_lock;
+		__bus_unlock(bus);
 		return -1;
 	}
 
-	// return the lock state to previous state.
-	i2c[bus].lock = old_lock;
+	// release the bus
+	__bus_unlock(bus);
 	return ret;
 
 
@@ -168,7 +266,7 @@ int rc_i2c_read_word(int bus, uint8_t regAddr, uint16_t *data)
 
 int rc_i2c_read_words(int bus, uint8_t regAddr, size_t count, uint16_t *data)
 {
-	int ret, old_lock;
+	int ret;
 	size_t i;
 	char buf[count*2];
 
@@ -180,23 +278,32 @@ int rc_i2c_read_words(int bus, uint8_t regAddr, size_t count, uint16_t *data)
 	}
 
 	// lock the bus during this operation
-	old_lock = i2c[bus].lock;
-	i2c[bus].lock = 1;
-
-	// write register to device
-	ret = write(i2c[bus].fd, &regAddr, 1);
-	if(unlikely(ret!=1)){
-		fprintf(stderr,"ERROR: in rc_i2c_read_words, failed to write to bus\n");
-		i2c[bus].lock = old_lock;
-		return -1;
+	__bus_lock(bus);
+
+	// one repeated-start transfer if the adapter can
+	if(likely(i2c[bus].rdwr)){
+		if(unlikely(__read_combined(bus, i2c[bus].devAddr, regAddr, count*2, (uint8_t*)buf))){
+			fprintf(stderr,"ERROR: in rc_i2c_read_words, combined transfer failed\n");
+			__bus_unlock(bus);
+			return -1;
+		}
 	}
-
-	// then read the response
-	ret = read(i2c[bus].fd, buf, count*2);
-	if(ret!=(signed)(count*2)){
-		fprintf(stderr,"ERROR: in rc_i2c_read_words, received %d bytes, expected %zu\n", ret, count*2);
-		i2c[bus].lock = old_lock;
-		return -1;
+	else{
+		// write register to device
+		ret = write(i2c[bus].fd, &regAddr, 1);
+		if(unlikely(ret!=1)){
+			fprintf(stderr,"ERROR: in rc_i2c_read_words, failed to write to bus\n");
+			__bus_unlock(bus);
+			return -1;
+		}
+
+		// then read the response
+		ret = read(i2c[bus].fd, buf, count*2);
+		if(ret!=(signed)(count*2)){
+			fprintf(stderr,"ERROR: in rc_i2c_read_words, received %d bytes, expected %zu\n", ret, count*2);
+			__bus_unlock(bus);
+			return -1;
+		}
 	}
 
 	// form words from bytes and put into user's data array
@@ -204,8 +311,8 @@ int rc_i2c_read_words(int bus, uint8_t regAddr, size_t count, uint16_t *data)
 		data[i] = (((uint16_t)buf[i*2])<<8 | buf[(i*2)+1]);
 	}
 
-	// return the lock state to previous state.
-	i2c[bus].lock = old_lock;
+	// release the bus
+	__bus_unlock(bus);
 	return 0;
 }
 
@@ -215,7 +322,7 @@ int rc_i2c_read_words(int bus, uint8_t regAddr, size_t count, uint16_t *data)
 
 int rc_i2c_write_bytes(int bus, uint8_t regAddr, size_t count, uint8_t* data)
 {
-	int ret, old_lock;
+	int ret;
 	size_t i;
 	uint8_t writeData[count+1];
 
@@ -227,8 +334,7 @@ int rc_i2c_write_bytes(int bus, uint8_t regAddr, size_t count, uint8_t* data)
 	}
 
 	// lock the bus during this operation
-	old_lock = i2c[bus].lock;
-	i2c[bus].lock = 1;
+	__bus_lock(bus);
 
 	// assemble array to send, starting with the register address
 	writeData[0] = regAddr;
@@ -239,18 +345,18 @@ int rc_i2c_write_bytes(int bus, uint8_t regAddr, size_t count, uint8_t* data)
 	// write should have returned the correct # bytes written
 	if(unlikely(ret!=(signed)(count+1))){
 		fprintf(stderr,"ERROR in rc_i2c_write_bytes, bus wrote %d bytes, expected %zu\n", ret, count+1);
-		i2c[bus].lock = old_lock;
+		__bus_unlock(bus);
 		return -1;
 	}
-	// return the lock state to previous state.
-	i2c[bus].lock = old_lock;
+	// release the bus
+	__bus_unlock(bus);
 	return 0;
 }
 
 
 int rc_i2c_write_byte(int bus, uint8_t regAddr, uint8_t data)
 {
-	int ret, old_lock;
+	int ret;
 	uint8_t writeData[2];
 
 	// sanity check
@@ -261,8 +367,7 @@ int rc_i2c_write_byte(int bus, uint8_t regAddr, uint8_t data)
 	}
 
 	// lock the bus during this operation
-	old_lock = i2c[bus].lock;
-	i2c[bus].lock = 1;
+	__bus_lock(bus);
 
 	// assemble array to send, starting with the register address
 	writeData[0] = regAddr;
@@ -274,18 +379,18 @@ int rc_i2c_write_byte(int bus, uint8_t regAddr, uint8_t data)
 	// write should have returned the correct # bytes written
 	if(unlikely(ret!=2)){
 		fprintf(stderr,"ERROR: in rc_i2c_write_byte, system write returned %d, expected 2\n", ret);
-		i2c[bus].lock = old_lock;
+		__bus_unlock(bus);
 		return -1;
 	}
-	// return the lock state to previous state.
-	i2c[bus].lock = old_lock;
+	// release the bus
+	__bus_unlock(bus);
 	return 0;
 }
 
 
 int rc_i2c_write_words(int bus, uint8_t regAddr, size_t count, uint16_t* data)
 {
-	int ret,old_lock;
+	int ret;
 	size_t i;
 	uint8_t writeData[(count*2)+1];
 
@@ -297,8 +402,7 @@ int rc_i2c_write_words(int bus, uint8_t regAddr, size_t count, uint16_t* data)
 	}
 
 	// lock the bus during this operation
-	old_lock = i2c[bus].lock;
-	i2c[bus].lock = 1;
+	__bus_lock(bus);
 
 	// assemble bytes to send
 	writeData[0] = regAddr;
@@ -310,18 +414,18 @@ int rc_i2c_write_words(int bus, uint8_t regAddr, size_t count, uint16_t* data)
 	ret = write(i2c[bus].fd, writeData, (count*2)+1);
 	if(unlikely(ret!=(signed)(count*2)+1)){
 		fprintf(stderr,"ERROR: in rc_i2c_write_words, system write returned %d, expected %zu\n", ret, (count*2)+1);
-		i2c[bus].lock = old_lock;
+		__bus_unlock(bus);
 		return -1;
 	}
-	// return the lock state to previous state.
-	i2c[bus].lock = old_lock;
+	// release the bus
+	__bus_unlock(bus);
 	return 0;
 }
 
 
 int rc_i2c_write_word(int bus, uint8_t regAddr, uint16_t data)
 {
-	int ret,old_lock;
+	int ret;
 	uint8_t writeData[3];
 
 	// sanity check
@@ -332,8 +436,7 @@ int rc_i2c_write_word(int bus, uint8_t regAddr, uint16_t data)
 	}
 
 	// lock the bus during this operation
-	old_lock = i2c[bus].lock;
-	i2c[bus].lock = 1;
+	__bus_lock(bus);
 
 	// assemble bytes to send from data casted as uint8_t*
 	writeData[0] = regAddr;
@@ -343,11 +446,11 @@ int rc_i2c_write_word(int bus, uint8_t regAddr, uint16_t data)
 	ret = write(i2c[bus].fd, writeData, 3);
 	if(unlikely(ret!=3)){
 		fprintf(stderr,"ERROR: in rc_i2c_write_word, system write returned %d, expected 3\n", ret);
-		i2c[bus].lock = old_lock;
+		__bus_unlock(bus);
 		return -1;
 	}
-	// return the lock state to previous state.
-	i2c[bus].lock = old_lock;
+	// release the bus
+	__bus_unlock(bus);
 	return 0;
 }
 
@@ -370,51 +473,133 @@ int rc_i2c_send_bytes(int bus, size_t count, uint8_t* data)
 	}
 
 	// lock the bus during this operation
-	int old_lock= i2c[bus].lock;
-	i2c[bus].lock = 1;
+	__bus_lock(bus);
 
 	// send the bytes
 	ret = write(i2c[bus].fd, data, count);
 	// write should have returned the correct # bytes written
 	if(ret!=(signed)count){
 		fprintf(stderr,"ERROR: in rc_i2c_send_bytes, system write returned %d, expected %zu\n", ret, count);
-		i2c[bus].lock = old_lock;
+		__bus_unlock(bus);
+		return -1;
+	}
+
+	// release the bus
+	__bus_unlock(bus);
+
+	return 0;
+}
+
+
+
+
+
+
+int rc_i2c_transfer(int bus, rc_i2c_msg_t* msgs, int n)
+{
+	int i, ret;
+	struct i2c_msg kmsgs[RC_I2C_MAX_MSGS];
+	struct i2c_rdwr_ioctl_data xfer;
+
+	// sanity check
+	if(unlikely(__check_bus_range(bus))) return -1;
+	if(unlikely(i2c[bus].initialized==0)){
+		fprintf(stderr,"ERROR: in rc_i2c_transfer, bus not initialized yet\n");
+		return -1;
+	}
+	if(unlikely(msgs==NULL)){
+		fprintf(stderr,"ERROR: in rc_i2c_transfer, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(n<1 || n>RC_I2C_MAX_MSGS)){
+		fprintf(stderr,"ERROR: in rc_i2c_transfer, number of messages must be between 1 & %d\n", RC_I2C_MAX_MSGS);
+		return -1;
+	}
+	if(unlikely(!i2c[bus].rdwr)){
+		fprintf(stderr,"ERROR: in rc_i2c_transfer, adapter does not support combined transfers\n");
 		return -1;
 	}
 
-	// return the lock state to previous state.
-	i2c[bus].lock = old_lock;
+	// translate to the kernel's message format
+	for(i=0;i<n;i++){
+		kmsgs[i].addr	= msgs[i].addr;
+		kmsgs[i].flags	= msgs[i].read ? I2C_M_RD : 0;
+		kmsgs[i].len	= msgs[i].len;
+		kmsgs[i].buf	= msgs[i].buf;
+	}
+	xfer.msgs	= kmsgs;
+	xfer.nmsgs	= n;
 
+	// lock the bus during this operation
+	__bus_lock(bus);
+	ret = ioctl(i2c[bus].fd, I2C_RDWR, &xfer);
+	__bus_unlock(bus);
+	if(unlikely(ret!=n)){
+		fprintf(stderr,"ERROR: in rc_i2c_transfer, transferred %d of %d messages\n", ret, n);
+		return -1;
+	}
 	return 0;
 }
 
 
+int rc_i2c_read_device_bytes(int bus, uint8_t devAddr, uint8_t regAddr, size_t count, uint8_t* data)
+{
+	int ret;
+	uint8_t old_addr;
 
+	// sanity check
+	if(unlikely(__check_bus_range(bus))) return -1;
+	if(unlikely(i2c[bus].initialized==0)){
+		fprintf(stderr,"ERROR: in rc_i2c_read_device_bytes, bus not initialized yet\n");
+		return -1;
+	}
 
+	// fall back to switching address and back if there are no combined
+	// transfers so the bus is left as the caller set it either way
+	// hold the bus throughout so nobody else sees the temporary address
+	if(unlikely(!i2c[bus].rdwr)){
+		__bus_lock(bus);
+		old_addr = i2c[bus].devAddr;
+		if(rc_i2c_set_device_address(bus, devAddr)){
+			__bus_unlock(bus);
+			return -1;
+		}
+		ret = rc_i2c_read_bytes(bus, regAddr, count, data);
+		if(rc_i2c_set_device_address(bus, old_addr)) ret = -1;
+		__bus_unlock(bus);
+		return ret;
+	}
+
+	// lock the bus during this operation
+	__bus_lock(bus);
+	ret = __read_combined(bus, devAddr, regAddr, count, data);
+	__bus_unlock(bus);
+	if(unlikely(ret)){
+		fprintf(stderr,"ERROR: in rc_i2c_read_device_bytes, combined transfer failed\n");
+		return -1;
+	}
+	return count;
+}
 
 
 int rc_i2c_lock_bus(int bus)
 {
 	if(unlikely(__check_bus_range(bus))) return -1;
-	int ret=i2c[bus].lock;
-	i2c[bus].lock=1;
-	return ret;
+	return __bus_lock(bus);
 }
 
 
 int rc_i2c_unlock_bus(int bus)
 {
 	if(unlikely(__check_bus_range(bus))) return -1;
-	int ret=i2c[bus].lock;
-	i2c[bus].lock=0;
-	return ret;
+	return __bus_unlock(bus);
 }
 
 
 int rc_i2c_get_lock(int bus)
 {
 	if(unlikely(__check_bus_range(bus))) return -1;
-	return i2c[bus].lock;
+	return atomic_load(&i2c[bus].lock);
 }
 
 
@@ -13,6 +13,8 @@
 #include <string.h>
 #include <errno.h>
 #include <glob.h>
+#include <stdint.h>
+#include <sys/mman.h>	// mmap
 #include <rc/pwm.h>
 #include <rc/time.h>
 
@@ -26,6 +28,19 @@
 #define OCP_DIR "/sys/devices/platform/ocp/4830%d000.epwmss/4830%d200.pwm/pwm"
 #define OCP_OFFSET	66
 
+// register map, page 184 of the am335x TRM and the EHRPWM chapter
+#define PWMSS0_ADDR	0x48300000	// start of PWMSS0, 1 and 2 follow
+#define PWMSS_STRIDE	0x2000		// distance between subsystems
+#define PWMSS_LEN	0x1000		// one page covers the EHRPWM registers
+#define EPWM_OFFSET	0x200		// EHRPWM module within the subsystem
+#define MMAP_FILE_LEN	(3*PWMSS_STRIDE)
+#define TBCLK_HZ	100000000	// time base clock before prescalers
+// 16-bit register indices within the EHRPWM module
+#define TBCTL		(0x00/2)
+#define TBPRD		(0x0A/2)
+#define CMPA		(0x12/2)
+#define CMPB		(0x14/2)
+
 // preposessor macros
 #define unlikely(x)	__builtin_expect (!!(x), 0)
 
@@ -35,6 +50,11 @@ static int dutyB_fd[3];			// pointers to duty cycle file descriptor
 static unsigned int period_ns[3];	// one period per subsystem
 static int init_flag[3] = {0,0,0};
 
+// direct register access, regs is NULL while a subsystem is using sysfs
+static volatile uint16_t* regs[3] = {NULL,NULL,NULL};
+static unsigned int period_counts[3];	// TBPRD+1, a duty of 1.0 in counts
+static char mmap_file[MAXBUF];		// empty string for /dev/mem
+
 // The ti pwm driver has gone through several revisions and it presents devices
 // in the file system differently every version. For example, subsytem 2 channel A
 // showed up as the following files:
@@ -192,6 +212,33 @@ static int __unexport_channels(int ss)
 }
 
 
+/**
+ * @brief      writes a duty cycle in time base counts to a mapped subsystem
+ *
+ * @param[in]  ss      subsystem, must be mapped
+ * @param[in]  ch      channel 'A' or 'B'
+ * @param[in]  counts  between 0 and period_counts[ss]
+ *
+ * @return     0 on succcess, -1 on failure
+ */
+static int __set_counts(int ss, char ch, unsigned int counts)
+{
+	// a 16-bit TBPRD of 0xFFFF gives 0x10000 counts for full duty
+	if(counts>0xFFFF) counts = 0xFFFF;
+	switch(ch){
+	case 'A':
+		regs[ss][CMPA] = counts;
+		return 0;
+	case 'B':
+		regs[ss][CMPB] = counts;
+		return 0;
+	default:
+		fprintf(stderr,"ERROR in rc_pwm_set_duty, pwm channel must be 'A' or 'B'\n");
+		return -1;
+	}
+}
+
+
 int rc_pwm_init(int ss, int frequency)
 {
 	int periodA_fd; // pointers to frequency file descriptor
@@ -213,6 +260,9 @@ int rc_pwm_init(int ss, int frequency)
 		return -1;
 	}
 
+	// the kernel driver is about to rewrite the registers, stop bypassing it
+	if(regs[ss]!=NULL) rc_pwm_disable_mmap(ss);
+
 	// unexport then export channels first
 	if(__unexport_channels(ss)==-1) return -1;
 	if(__export_channels(ss)==-1) return -1;
@@ -369,6 +419,7 @@ int rc_pwm_cleanup(int ss)
 		fprintf(stderr,"ERROR in rc_pwm_close, subsystem must be between 0 and 2\n");
 		return -1;
 	}
+	if(regs[ss]!=NULL) rc_pwm_disable_mmap(ss);
 	if(init_flag[ss]==0){
 		return 0;
 	}
@@ -435,7 +486,7 @@ int rc_pwm_set_duty(int ss, char ch, double duty)
 		fprintf(stderr,"ERROR in rc_pwm_set_duty, PWM subsystem must be between 0 and 2\n");
 		return -1;
 	}
-	if(unlikely(init_flag[ss]==0)){
+	if(unlikely(init_flag[ss]==0 && regs[ss]==NULL)){
 		fprintf(stderr, "ERROR in rc_pwm_set_duty, subsystem %d not initialized yet\n", ss);
 		return -1;
 	}
@@ -444,6 +495,9 @@ int rc_pwm_set_duty(int ss, char ch, double duty)
 		return -1;
 	}
 
+	// write straight to the compare register if mapped
+	if(regs[ss]!=NULL) return __set_counts(ss, ch, duty*period_counts[ss]);
+
 	// set the duty
 	duty_ns = duty*period_ns[ss];
 	len = snprintf(buf, sizeof(buf), "%d", duty_ns);
@@ -478,7 +532,7 @@ int rc_pwm_set_duty_ns(int ss, char ch, unsigned int duty_ns)
 		fprintf(stderr,"ERROR in rc_pwm_set_duty_ns, PWM subsystem must be between 0 and 2\n");
 		return -1;
 	}
-	if(unlikely(init_flag[ss]==0)){
+	if(unlikely(init_flag[ss]==0 && regs[ss]==NULL)){
 		fprintf(stderr, "ERROR in rc_pwm_set_duty_ns, subsystem %d not initialized yet\n", ss);
 		return -1;
 	}
@@ -487,6 +541,11 @@ int rc_pwm_set_duty_ns(int ss, char ch, unsigned int duty_ns)
 		return -1;
 	}
 
+	// write straight to the compare register if mapped
+	if(regs[ss]!=NULL){
+		return __set_counts(ss, ch, (uint64_t)duty_ns*period_counts[ss]/period_ns[ss]);
+	}
+
 	// set the duty
 	len = snprintf(buf, sizeof(buf), "%d", duty_ns);
 	switch(ch){
@@ -508,3 +567,107 @@ int rc_pwm_set_duty_ns(int ss, char ch, unsigned int duty_ns)
 	}
 	return 0;
 }
+
+
+int rc_pwm_enable_mmap(int ss)
+{
+	int fd;
+	off_t base;
+	void* map;
+	unsigned int tbctl, prescale, clkdiv, hspclkdiv;
+
+	// sanity checks
+	if(unlikely(ss<0 || ss>2)){
+		fprintf(stderr,"ERROR in rc_pwm_enable_mmap, PWM subsystem must be between 0 and 2\n");
+		return -1;
+	}
+	if(regs[ss]!=NULL) return 0;
+	// the kernel driver enables the subsystem clock, registers can't be touched without it
+	if(mmap_file[0]=='\0' && init_flag[ss]==0){
+		fprintf(stderr,"ERROR in rc_pwm_enable_mmap, call rc_pwm_init first\n");
+		return -1;
+	}
+
+	// map the subsystem's register page
+	if(mmap_file[0]=='\0'){
+		fd = open("/dev/mem", O_RDWR | O_SYNC);
+		base = PWMSS0_ADDR + ss*PWMSS_STRIDE;
+	}
+	else{
+		fd = open(mmap_file, O_RDWR);
+		base = ss*PWMSS_STRIDE;
+	}
+	if(unlikely(fd==-1)){
+		perror("ERROR in rc_pwm_enable_mmap, failed to open memory file");
+		if(mmap_file[0]=='\0') fprintf(stderr,"Need to be root to map PWM registers\n");
+		return -1;
+	}
+	map = mmap(0, PWMSS_LEN, PROT_READ | PROT_WRITE, MAP_SHARED, fd, base);
+	close(fd);
+	if(unlikely(map==MAP_FAILED)){
+		perror("ERROR in rc_pwm_enable_mmap, failed to map memory");
+		return -1;
+	}
+	regs[ss] = (volatile uint16_t*)((char*)map + EPWM_OFFSET);
+
+	// the kernel set the period so read it back rather than recomputing
+	period_counts[ss] = regs[ss][TBPRD] + 1;
+	if(unlikely(period_counts[ss]<2)){
+		fprintf(stderr,"ERROR in rc_pwm_enable_mmap, subsystem %d period not set\n", ss);
+		rc_pwm_disable_mmap(ss);
+		return -1;
+	}
+	// without rc_pwm_init there is no period in ns, work it out from the
+	// time base clock prescalers
+	if(init_flag[ss]==0){
+		tbctl = regs[ss][TBCTL];
+		clkdiv = (tbctl>>10)&0x7;
+		hspclkdiv = (tbctl>>7)&0x7;
+		prescale = (1<<clkdiv) * (hspclkdiv ? 2*hspclkdiv : 1);
+		period_ns[ss] = (uint64_t)period_counts[ss]*prescale*1000000000/TBCLK_HZ;
+	}
+	return 0;
+}
+
+
+int rc_pwm_disable_mmap(int ss)
+{
+	// sanity checks
+	if(unlikely(ss<0 || ss>2)){
+		fprintf(stderr,"ERROR in rc_pwm_disable_mmap, PWM subsystem must be between 0 and 2\n");
+		return -1;
+	}
+	if(regs[ss]==NULL) return 0;
+	munmap((char*)regs[ss]-EPWM_OFFSET, PWMSS_LEN);
+	regs[ss] = NULL;
+	return 0;
+}
+
+
+int rc_pwm_set_mmap_file(const char* path)
+{
+	int fd;
+	off_t len;
+	if(path==NULL){
+		mmap_file[0] = '\0';
+		return 0;
+	}
+	if(unlikely(strlen(path)>=sizeof(mmap_file))){
+		fprintf(stderr,"ERROR in rc_pwm_set_mmap_file, path too long\n");
+		return -1;
+	}
+	// check it's big enough now rather than faulting on access later
+	fd = open(path, O_RDONLY);
+	if(unlikely(fd==-1)){
+		perror("ERROR in rc_pwm_set_mmap_file, failed to open file");
+		return -1;
+	}
+	len = lseek(fd, 0, SEEK_END);
+	close(fd);
+	if(unlikely(len<MMAP_FILE_LEN)){
+		fprintf(stderr,"ERROR in rc_pwm_set_mmap_file, file must be at least %d bytes\n", MMAP_FILE_LEN);
+		return -1;
+	}
+	strcpy(mmap_file, path);
+	return 0;
+}
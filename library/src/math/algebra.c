@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <stdlib.h>	// for malloc,calloc,free
 #include <math.h>	// for sqrt, pow, etc
+#include <float.h>	// for DBL_EPSILON
 #include <string.h>	// for memcpy
 
 #include <rc/math/vector.h>
@@ -260,88 +261,139 @@ int rc_algebra_lup_decomp(rc_matrix_t A, rc_matrix_t* L, rc_matrix_t* U, rc_matr
 	return 0;
 }
 
-int rc_algebra_invert_matrix(rc_matrix_t A, rc_matrix_t* Ainv)
+int rc_algebra_invert_matrix_rcond(rc_matrix_t A, rc_matrix_t* Ainv, double* rcond)
 {
-	int i,j,k;
-	rc_matrix_t L = RC_MATRIX_INITIALIZER;
-	rc_matrix_t U = RC_MATRIX_INITIALIZER;
-	rc_matrix_t P = RC_MATRIX_INITIALIZER;
-	rc_matrix_t D = RC_MATRIX_INITIALIZER;
-	rc_matrix_t tmp = RC_MATRIX_INITIALIZER;
+	int i,j,k,p,n;
+	double tmp, normA, normAinv;
+	int* piv;
+	double* work;
 	// sanity checks
+	if(rcond!=NULL) *rcond = 0.0;
 	if(unlikely(!A.initialized)){
-		fprintf(stderr,"ERROR in rc_matrix_inverse, matrix uninitialized\n");
+		fprintf(stderr,"ERROR in rc_algebra_invert_matrix_rcond, matrix uninitialized\n");
 		return -1;
 	}
 	if(unlikely(A.cols!=A.rows)){
-		fprintf(stderr,"ERROR in rc_matrix_inverse, nonsquare matrix\n");
-		return -1;
-	}
-	if(fabs(rc_matrix_determinant(A)) < zero_tolerance){
-		fprintf(stderr,"ERROR in rc_matrix_inverse, matrix is singular\n");
+		fprintf(stderr,"ERROR in rc_algebra_invert_matrix_rcond, nonsquare matrix\n");
 		return -1;
 	}
-	// allocate memory
-	if(unlikely(rc_matrix_identity(&D,A.cols))){
-		fprintf(stderr,"ERROR in rc_matrix_inverse, failed to alloc identity\n");
+	n = A.rows;
+	// pivot record and scratch column live on the stack
+	piv = alloca(n*sizeof(int));
+	work = alloca(n*sizeof(double));
+	if(unlikely(piv==NULL || work==NULL)){
+		fprintf(stderr,"ERROR in rc_algebra_invert_matrix_rcond, alloca failed, stack overflow\n");
 		return -1;
 	}
-	if(unlikely(rc_matrix_alloc(&tmp,A.rows,A.rows))){
-		fprintf(stderr,"ERROR in rc_matrix_inverse, failed to alloc matrix\n");
-		rc_matrix_free(&D);
-		return -1;
+	// 1-norm of A must be taken before A is overwritten in the in-place case
+	normA = 0.0;
+	for(j=0;j<n;j++){
+		tmp = 0.0;
+		for(i=0;i<n;i++) tmp += fabs(A.d[i][j]);
+		if(tmp>normA) normA = tmp;
 	}
-	// do LUP
-	if(unlikely(rc_algebra_lup_decomp(A,&L,&U,&P))){
-		fprintf(stderr,"ERROR in rc_matrix_inverse, failed to LUP decomp\n");
-		rc_matrix_free(&D);
-		rc_matrix_free(&tmp);
+	// no-op if Ainv is already the right size, including when Ainv is A
+	if(unlikely(rc_matrix_alloc(Ainv,n,n))){
+		fprintf(stderr,"ERROR in rc_algebra_invert_matrix_rcond, failed to alloc matrix\n");
 		return -1;
 	}
-	// solve for Inv
-	for(j=0;j<A.cols;j++){
-		for(i=0;i<A.cols;i++){
-			for(k=0;k<i;k++){
-				D.d[i][j] -= L.d[i][k] * D.d[k][j];
-			}
+	if(Ainv->d[0]!=A.d[0]) memcpy(Ainv->d[0],A.d[0],n*n*sizeof(double));
+
+	// LU decomposition in place with partial pivoting. Rows are swapped
+	// element by element since matrix memory is freed through d[0].
+	for(k=0;k<n;k++){
+		p = k;
+		for(i=k+1;i<n;i++){
+			if(fabs(Ainv->d[i][k])>fabs(Ainv->d[p][k])) p=i;
+		}
+		piv[k] = p;
+		// a small pivot is what makes the matrix singular, no need for a
+		// separate determinant calculation
+		if(unlikely(fabs(Ainv->d[p][k])<zero_tolerance)){
+			fprintf(stderr,"ERROR in rc_algebra_invert_matrix_rcond, matrix is singular\n");
+			return -1;
 		}
-		// backwards.. last to first
-		for(i=A.cols-1;i>=0;i--){
-			tmp.d[i][j] = D.d[i][j];
-			for(k=i+1;k<A.cols;k++){
-				tmp.d[i][j] -= U.d[i][k] * tmp.d[k][j];
+		if(p!=k){
+			for(j=0;j<n;j++){
+				tmp=Ainv->d[k][j]; Ainv->d[k][j]=Ainv->d[p][j]; Ainv->d[p][j]=tmp;
 			}
-			tmp.d[i][j] = tmp.d[i][j] / U.d[i][i];
+		}
+		for(i=k+1;i<n;i++){
+			Ainv->d[i][k] /= Ainv->d[k][k];
+			tmp = Ainv->d[i][k];
+			for(j=k+1;j<n;j++) Ainv->d[i][j] -= tmp*Ainv->d[k][j];
 		}
 	}
-	// free up some memory
-	rc_matrix_free(&L);
-	rc_matrix_free(&U);
-	rc_matrix_free(&D);
-	// use i as new return value
-	i=0;
-	// multiply by permutation matrix
-	if(unlikely(rc_matrix_multiply(tmp, P, Ainv))){
-		fprintf(stderr,"ERROR in rc_matrix_inverse, failed to multiply matrix\n");
-		i=-1;
-	}
-	// free allocation
-	rc_matrix_free(&tmp);
-	rc_matrix_free(&P);
-	return i;
+	// invert U in place, column j of U^-1 only needs the columns left of it
+	for(j=0;j<n;j++){
+		Ainv->d[j][j] = 1.0/Ainv->d[j][j];
+		tmp = -Ainv->d[j][j];
+		for(i=0;i<j;i++){
+			work[i] = 0.0;
+			for(k=i;k<j;k++) work[i] += Ainv->d[i][k]*Ainv->d[k][j];
+		}
+		for(i=0;i<j;i++) Ainv->d[i][j] = tmp*work[i];
+	}
+	// solve Ainv*L = U^-1 for Ainv, right to left
+	for(j=n-2;j>=0;j--){
+		for(i=j+1;i<n;i++){
+			work[i] = Ainv->d[i][j];
+			Ainv->d[i][j] = 0.0;
+		}
+		for(i=0;i<n;i++){
+			tmp = 0.0;
+			for(k=j+1;k<n;k++) tmp += Ainv->d[i][k]*work[k];
+			Ainv->d[i][j] -= tmp;
+		}
+	}
+	// undo the row pivoting with column swaps in reverse order
+	for(j=n-2;j>=0;j--){
+		p = piv[j];
+		if(p==j) continue;
+		for(i=0;i<n;i++){
+			tmp=Ainv->d[i][j]; Ainv->d[i][j]=Ainv->d[i][p]; Ainv->d[i][p]=tmp;
+		}
+	}
+	// rcond = 1/(||A||*||A^-1||) in the 1-norm, exact and cheap since the
+	// inverse is already known
+	if(rcond!=NULL){
+		normAinv = 0.0;
+		for(j=0;j<n;j++){
+			tmp = 0.0;
+			for(i=0;i<n;i++) tmp += fabs(Ainv->d[i][j]);
+			if(tmp>normAinv) normAinv = tmp;
+		}
+		*rcond = 1.0/(normA*normAinv);
+	}
+	return 0;
+}
+
+
+int rc_algebra_invert_matrix(rc_matrix_t A, rc_matrix_t* Ainv)
+{
+	if(unlikely(rc_algebra_invert_matrix_rcond(A,Ainv,NULL))){
+		fprintf(stderr,"ERROR in rc_algebra_invert_matrix, failed to invert\n");
+		return -1;
+	}
+	return 0;
 }
 
 
 int rc_algebra_invert_matrix_inplace(rc_matrix_t* A)
 {
-	rc_matrix_t Atmp = RC_MATRIX_INITIALIZER;
-	if(unlikely(rc_algebra_invert_matrix(*A,&Atmp))){
+	rc_matrix_t tmp = RC_MATRIX_INITIALIZER;
+	if(unlikely(A==NULL)){
+		fprintf(stderr,"ERROR in rc_algebra_invert_matrix_inplace, received NULL pointer\n");
+		return -1;
+	}
+	// factor into a scratch copy so A is left untouched if it's singular
+	if(unlikely(rc_algebra_invert_matrix_rcond(*A,&tmp,NULL))){
 		fprintf(stderr, "ERROR in rc_algebra_invert_matrix_inplace, failed to invert\n");
+		rc_matrix_free(&tmp);
 		return -1;
 	}
-	// free original memory and copy new matrix into place
-	rc_matrix_free(A);
-	*A = Atmp;
+	memcpy(A->d[0],tmp.d[0],A->rows*A->cols*sizeof(double));
+	rc_matrix_free(&tmp);
 	return 0;
 }
 
@@ -434,6 +486,168 @@ int rc_algebra_lin_system_solve(rc_matrix_t A, rc_vector_t b, rc_vector_t* x)
 	return 0;
 }
 
+
+int rc_algebra_cholesky_decomp(rc_matrix_t A, rc_matrix_t* L)
+{
+	int i,j,k;
+	double sum;
+	// sanity checks
+	if(unlikely(!A.initialized)){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_decomp, matrix uninitialized\n");
+		return -1;
+	}
+	if(unlikely(A.cols!=A.rows)){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_decomp, nonsquare matrix\n");
+		return -1;
+	}
+	// no-op if L is already the right size, including when L is A itself
+	if(unlikely(rc_matrix_alloc(L,A.rows,A.cols))){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_decomp, failed to alloc matrix\n");
+		return -1;
+	}
+	// Cholesky-Banachiewicz, row by row. Each element of A is read before the
+	// same element of L is written so this also works in place.
+	for(i=0;i<A.rows;i++){
+		for(j=0;j<=i;j++){
+			sum = A.d[i][j];
+			for(k=0;k<j;k++) sum -= L->d[i][k]*L->d[j][k];
+			if(i==j){
+				if(unlikely(sum<=0.0)){
+					fprintf(stderr,"ERROR in rc_algebra_cholesky_decomp, matrix not positive-definite\n");
+					return -1;
+				}
+				L->d[i][i] = sqrt(sum);
+			}
+			else L->d[i][j] = sum/L->d[j][j];
+		}
+		for(j=i+1;j<A.cols;j++) L->d[i][j] = 0.0;
+	}
+	return 0;
+}
+
+
+int rc_algebra_cholesky_solve(rc_matrix_t L, rc_vector_t b, rc_vector_t* x)
+{
+	int i,k;
+	double sum;
+	// sanity checks
+	if(unlikely(!L.initialized || !b.initialized)){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_solve, matrix or vector uninitialized\n");
+		return -1;
+	}
+	if(unlikely(L.cols!=L.rows || L.cols!=b.len)){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_solve, dimension mismatch\n");
+		return -1;
+	}
+	if(unlikely(rc_vector_alloc(x,b.len))){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_solve, failed to alloc vector\n");
+		return -1;
+	}
+	// forward substitution L*y=b
+	for(i=0;i<L.rows;i++){
+		sum = b.d[i];
+		for(k=0;k<i;k++) sum -= L.d[i][k]*x->d[k];
+		x->d[i] = sum/L.d[i][i];
+	}
+	// backward substitution L^T*x=y
+	for(i=L.rows-1;i>=0;i--){
+		sum = x->d[i];
+		for(k=i+1;k<L.rows;k++) sum -= L.d[k][i]*x->d[k];
+		x->d[i] = sum/L.d[i][i];
+	}
+	return 0;
+}
+
+
+int rc_algebra_cholesky_solve_matrix(rc_matrix_t L, rc_matrix_t B, rc_matrix_t* X)
+{
+	int i,j,k;
+	double l;
+	// sanity checks
+	if(unlikely(!L.initialized || !B.initialized)){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_solve_matrix, matrix uninitialized\n");
+		return -1;
+	}
+	if(unlikely(L.cols!=L.rows || L.cols!=B.rows)){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_solve_matrix, dimension mismatch\n");
+		return -1;
+	}
+	if(unlikely(rc_matrix_alloc(X,B.rows,B.cols))){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_solve_matrix, failed to alloc matrix\n");
+		return -1;
+	}
+	// work on whole rows of X at a time so the inner loops run along
+	// contiguous memory, forward substitution L*Y=B first
+	for(i=0;i<L.rows;i++){
+		if(X->d[i]!=B.d[i]){
+			for(j=0;j<B.cols;j++) X->d[i][j] = B.d[i][j];
+		}
+		for(k=0;k<i;k++){
+			l = L.d[i][k];
+			for(j=0;j<B.cols;j++) X->d[i][j] -= l*X->d[k][j];
+		}
+		l = L.d[i][i];
+		for(j=0;j<B.cols;j++) X->d[i][j] /= l;
+	}
+	// backward substitution L^T*X=Y
+	for(i=L.rows-1;i>=0;i--){
+		for(k=i+1;k<L.rows;k++){
+			l = L.d[k][i];
+			for(j=0;j<B.cols;j++) X->d[i][j] -= l*X->d[k][j];
+		}
+		l = L.d[i][i];
+		for(j=0;j<B.cols;j++) X->d[i][j] /= l;
+	}
+	return 0;
+}
+
+
+int rc_algebra_invert_spd_inplace(rc_matrix_t* A)
+{
+	int i,j,k,n;
+	double sum, d;
+	// sanity checks
+	if(unlikely(A==NULL)){
+		fprintf(stderr,"ERROR in rc_algebra_invert_spd_inplace, received NULL pointer\n");
+		return -1;
+	}
+	// lower triangle of A becomes L, checks dimensions too
+	if(unlikely(rc_algebra_cholesky_decomp(*A,A))){
+		fprintf(stderr,"ERROR in rc_algebra_invert_spd_inplace, failed to decompose\n");
+		return -1;
+	}
+	n = A->rows;
+	// invert L in place, row i of L^-1 only depends on rows above it and on
+	// elements of row i to the right of the one being written
+	for(i=0;i<n;i++){
+		d = 1.0/A->d[i][i];
+		A->d[i][i] = d;
+		for(j=0;j<i;j++){
+			sum = 0.0;
+			for(k=j;k<i;k++) sum += A->d[i][k]*A->d[k][j];
+			A->d[i][j] = -d*sum;
+		}
+	}
+	// A^-1 = L^-T * L^-1, element (i,j) only needs rows k>=i of L^-1 so fill
+	// the lower triangle top to bottom, diagonal last in each row
+	for(i=0;i<n;i++){
+		for(j=0;j<i;j++){
+			sum = 0.0;
+			for(k=i;k<n;k++) sum += A->d[k][i]*A->d[k][j];
+			A->d[i][j] = sum;
+		}
+		sum = 0.0;
+		for(k=i;k<n;k++) sum += A->d[k][i]*A->d[k][i];
+		A->d[i][i] = sum;
+	}
+	// mirror into the upper triangle
+	for(i=0;i<n;i++){
+		for(j=i+1;j<n;j++) A->d[i][j] = A->d[j][i];
+	}
+	return 0;
+}
+
+
 void rc_algebra_set_zero_tolerance(double tol){
 	zero_tolerance=tol;
 	return;
@@ -491,6 +705,7 @@ int rc_algebra_lin_system_solve_qr(rc_matrix_t A, rc_vector_t b, rc_vector_t* x)
 int rc_algebra_fit_ellipsoid(rc_matrix_t pts, rc_vector_t* ctr, rc_vector_t* lens)
 {
 	int i,p;
+	double rcond;
 	rc_matrix_t A = RC_MATRIX_INITIALIZER;
 	rc_vector_t b = RC_VECTOR_INITIALIZER;
 	rc_vector_t f = RC_VECTOR_INITIALIZER;
@@ -573,9 +788,24 @@ int rc_algebra_fit_ellipsoid(rc_matrix_t pts, rc_vector_t* ctr, rc_vector_t* len
 	b.d[0] = f.d[0];
 	b.d[1] = f.d[2];
 	b.d[2] = f.d[4];
-	// solve for lengths
-	if(unlikely(rc_algebra_lin_system_solve(A,b,lens))){
-		fprintf(stderr,"ERROR in rc_fit_ellipsoid, failed to solve linear system\n");
+	// solve for lengths, reject the fit if the system is singular to working
+	// precision which happens when the points don't span all 3 axes
+	if(unlikely(rc_algebra_invert_matrix_rcond(A,&A,&rcond))){
+		fprintf(stderr,"ERROR in rc_fit_ellipsoid, failed to invert matrix\n");
+		rc_matrix_free(&A);
+		rc_vector_free(&b);
+		rc_vector_free(&f);
+		return -1;
+	}
+	if(unlikely(rcond<DBL_EPSILON)){
+		fprintf(stderr,"ERROR in rc_fit_ellipsoid, matrix is ill-conditioned, rcond=%g\n", rcond);
+		rc_matrix_free(&A);
+		rc_vector_free(&b);
+		rc_vector_free(&f);
+		return -1;
+	}
+	if(unlikely(rc_matrix_times_col_vec(A,b,lens))){
+		fprintf(stderr,"ERROR in rc_fit_ellipsoid, failed to multiply matrix by vector\n");
 		rc_matrix_free(&A);
 		rc_vector_free(&b);
 		rc_vector_free(&f);
@@ -35,4 +35,13 @@ double __vectorized_mult_accumulate(double * __restrict__ a, double * __restrict
  */
 double __vectorized_square_accumulate(double * __restrict__ a, int n);
 
+/*
+ * Cache-blocked general matrix multiply C=A*B on contiguous row-major data.
+ *
+ * A is mxk, B is kxn and C is mxn with row strides lda, ldb, and ldc. C must
+ * not overlap A or B. Uses the SIMD micro-kernel selected at build time in
+ * gemm.c. Only for internal use, no sanity checks are performed.
+ */
+void __gemm(int m, int n, int k, const double* A, int lda, const double* B, int ldb, double* C, int ldc);
+
 #endif // RC_ALGEBRA_COMMON_H
@@ -0,0 +1,665 @@
+/**
+ * @file biquad.c
+ * @brief      Cascaded second-order-section filters evaluated in transposed
+ *             direct form II.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <complex.h>
+
+#include <rc/math/biquad.h>
+
+#include "algebra_common.h"
+
+#define MAX_ORDER	(2*RC_BIQUAD_MAX_SECTIONS)
+#define ROOT_MAX_ITER	500	// Aberth iterations before giving up
+#define ROOT_TOL	1e-10	// relative residual to consider 0,1,-1 exact roots
+#define IMAG_TOL	1e-8	// relative imaginary part below which a root is real
+#define CLUSTER_TOL	1e-3	// relative distance below which roots are one multiple root
+#define J		((double complex)I) // I alone is complex float
+
+// one section's worth of poles or zeros, z^2 + c1*z + c2 or z + c1
+typedef struct root_group_t{
+	int n;		// number of roots in the group, 1 or 2
+	double c1;
+	double c2;
+	double complex r; // representative root used for pairing
+	double mag;	// magnitude of the largest root in the group
+} root_group_t;
+
+
+// evaluates polynomial p of degree n and its derivative at z, coefficients
+// are highest power first like everywhere else in the library
+static void __poly_eval(const double* p, int n, double complex z, double complex* val, double complex* der)
+{
+	int i;
+	double complex v = p[0];
+	double complex d = 0.0;
+	for(i=1;i<=n;i++){
+		d = d*z + v;
+		v = v*z + p[i];
+	}
+	*val = v;
+	*der = d;
+}
+
+
+// checks if real r is a root of p, only used for the exact roots 0,1,-1 that
+// show up in integrators, differentiators, and tustin discretizations
+static int __is_root(const double* p, int n, double r)
+{
+	int i;
+	double v = p[0];
+	double scale = fabs(p[0]);
+	for(i=1;i<=n;i++){
+		v = v*r + p[i];
+		scale = scale*fabs(r) + fabs(p[i]);
+	}
+	return fabs(v) <= ROOT_TOL*scale;
+}
+
+
+// divides p by (z-r) in place, the remainder is dropped
+static void __deflate(double* p, int n, double r)
+{
+	int i;
+	for(i=1;i<n;i++) p[i] += r*p[i-1];
+}
+
+
+// finds all n roots of p with the Aberth-Ehrlich method. p must not have a
+// root at 0 so the geometric mean of the roots gives a good starting radius.
+static int __aberth(const double* p, int n, double complex* z)
+{
+	int i,j,k;
+	double radius, corr, maxcorr;
+	double complex v, d, ratio, sum;
+
+	radius = pow(fabs(p[n]/p[0]), 1.0/n);
+	for(k=0;k<n;k++) z[k] = radius*cexp(J*(2.0*M_PI*k/n + 0.4));
+
+	for(i=0;i<ROOT_MAX_ITER;i++){
+		maxcorr = 0.0;
+		for(k=0;k<n;k++){
+			__poly_eval(p,n,z[k],&v,&d);
+			if(!(cabs(v)>0.0)) continue;
+			if(!(cabs(d)>0.0)){
+				z[k] *= 1.0 + 1e-6*J; // nudge off a stationary point
+				maxcorr = 1.0;
+				continue;
+			}
+			ratio = v/d;
+			sum = 0.0;
+			for(j=0;j<n;j++){
+				if(j!=k) sum += 1.0/(z[k]-z[j]);
+			}
+			ratio = ratio/(1.0 - ratio*sum);
+			z[k] -= ratio;
+			corr = cabs(ratio)/(1.0 + cabs(z[k]));
+			if(corr>maxcorr) maxcorr = corr;
+		}
+		if(maxcorr<1e-15) return 0;
+	}
+	// without full convergence the roots are still as accurate as the
+	// polynomial coefficients allow, which is the best we can do anyway
+	return 0;
+}
+
+
+// refines a root of multiplicity k with newton's method on the (k-1)th
+// derivative of p where it is a simple root
+static double complex __polish_multiple(const double* p, int n, int k, double complex z)
+{
+	int i,j,d;
+	double q[MAX_ORDER+1];
+	double complex v, der;
+	// coefficients of the (k-1)th derivative
+	d = n-k+1;
+	for(i=0;i<=d;i++){
+		q[i] = p[i];
+		for(j=0;j<k-1;j++) q[i] *= n-i-j;
+	}
+	for(i=0;i<10;i++){
+		__poly_eval(q,d,z,&v,&der);
+		if(!(cabs(der)>0.0)) break;
+		z -= v/der;
+	}
+	return z;
+}
+
+
+// factors polynomial p of degree n into groups of at most 2 real-coefficient
+// roots. Complex conjugate pairs always form one group. Real roots are left
+// ungrouped in real[] so they can be paired later as needed.
+static int __factor(const double* poly, int n, root_group_t* pairs, int* npairs, double* real, int* nreal)
+{
+	int i,j,k,best,m;
+	double tol;
+	double complex mean;
+	double p[MAX_ORDER+1];
+	double complex z[MAX_ORDER];
+	int used[MAX_ORDER];
+
+	*npairs = 0;
+	*nreal = 0;
+	m = n;
+	for(i=0;i<=n;i++) p[i] = poly[i];
+
+	// pull out exact roots first, these are often repeated which the
+	// iterative solver handles poorly
+	while(m>0 && !(fabs(p[m])>0.0)){
+		real[(*nreal)++] = 0.0;
+		m--;
+	}
+	while(m>0 && __is_root(p,m,1.0)){
+		__deflate(p,m,1.0);
+		real[(*nreal)++] = 1.0;
+		m--;
+	}
+	while(m>0 && __is_root(p,m,-1.0)){
+		__deflate(p,m,-1.0);
+		real[(*nreal)++] = -1.0;
+		m--;
+	}
+	if(m==0) return 0;
+	if(m==1){
+		real[(*nreal)++] = -p[1]/p[0];
+		return 0;
+	}
+	__aberth(p,m,z);
+
+	// a root of multiplicity k comes back as a ring of k roots only accurate
+	// to eps^(1/k). It is a simple root of the (k-1)th derivative though, so
+	// polish the mean of the ring against that instead.
+	for(i=0;i<m;i++) used[i]=0;
+	for(i=0;i<m;i++){
+		if(used[i]) continue;
+		mean = z[i];
+		k = 1;
+		for(j=i+1;j<m;j++){
+			if(!used[j] && cabs(z[j]-z[i])<CLUSTER_TOL*(1.0+cabs(z[i]))){
+				used[j] = 1;
+				mean += z[j];
+				k++;
+			}
+		}
+		if(k==1) continue;
+		mean = __polish_multiple(p,m,k,mean/k);
+		z[i] = mean;
+		for(j=i+1;j<m;j++){
+			if(used[j]==1){
+				z[j] = mean;
+				used[j] = 2;
+			}
+		}
+	}
+
+	// match conjugate pairs, anything left over is real
+	for(i=0;i<m;i++) used[i]=0;
+	for(i=0;i<m;i++){
+		if(used[i]) continue;
+		tol = IMAG_TOL*(1.0+cabs(z[i]));
+		if(cimag(z[i])>tol){
+			best = -1;
+			for(j=0;j<m;j++){
+				if(used[j] || j==i || cimag(z[j])>=-tol) continue;
+				if(best<0 || cabs(z[j]-conj(z[i]))<cabs(z[best]-conj(z[i]))) best=j;
+			}
+			if(best>=0){
+				used[i] = used[best] = 1;
+				pairs[*npairs].n = 2;
+				pairs[*npairs].c1 = -2.0*creal(z[i]);
+				pairs[*npairs].c2 = creal(z[i])*creal(z[i]) + cimag(z[i])*cimag(z[i]);
+				pairs[*npairs].r = z[i];
+				pairs[*npairs].mag = cabs(z[i]);
+				(*npairs)++;
+			}
+		}
+	}
+	for(i=0;i<m;i++){
+		if(!used[i]) real[(*nreal)++] = creal(z[i]);
+	}
+	return 0;
+}
+
+
+// sorts real roots by decreasing magnitude
+static void __sort_real(double* r, int n)
+{
+	int i,j;
+	double tmp;
+	for(i=1;i<n;i++){
+		tmp = r[i];
+		for(j=i;j>0 && fabs(r[j-1])<fabs(tmp);j--) r[j]=r[j-1];
+		r[j] = tmp;
+	}
+}
+
+
+static void __start(rc_biquad_t* b, double dt, int sections)
+{
+	rc_biquad_t new = RC_BIQUAD_INITIALIZER;
+	*b = new;
+	b->dt = dt;
+	b->sections = sections;
+	b->initialized = 1;
+}
+
+
+rc_biquad_t rc_biquad_empty(void)
+{
+	rc_biquad_t b = RC_BIQUAD_INITIALIZER;
+	return b;
+}
+
+
+int rc_biquad_from_sections(rc_biquad_t* b, double dt, const double sos[][6], int sections)
+{
+	int i;
+	// sanity checks
+	if(unlikely(b==NULL || sos==NULL)){
+		fprintf(stderr,"ERROR in rc_biquad_from_sections, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(sections<1 || sections>RC_BIQUAD_MAX_SECTIONS)){
+		fprintf(stderr,"ERROR in rc_biquad_from_sections, sections must be between 1 and %d\n", RC_BIQUAD_MAX_SECTIONS);
+		return -1;
+	}
+	if(unlikely(dt<=0.0)){
+		fprintf(stderr,"ERROR in rc_biquad_from_sections, dt must be >0\n");
+		return -1;
+	}
+	for(i=0;i<sections;i++){
+		if(unlikely(fabs(sos[i][3])<zero_tolerance)){
+			fprintf(stderr,"ERROR in rc_biquad_from_sections, a0 of section %d is 0\n", i);
+			return -1;
+		}
+	}
+	__start(b,dt,sections);
+	for(i=0;i<sections;i++){
+		b->b0[i] = sos[i][0]/sos[i][3];
+		b->b1[i] = sos[i][1]/sos[i][3];
+		b->b2[i] = sos[i][2]/sos[i][3];
+		b->a1[i] = sos[i][4]/sos[i][3];
+		b->a2[i] = sos[i][5]/sos[i][3];
+		if(fabs(sos[i][2])>0.0 || fabs(sos[i][5])>0.0) b->order += 2;
+		else b->order += 1;
+	}
+	return 0;
+}
+
+
+int rc_biquad_from_filter(rc_biquad_t* b, rc_filter_t f)
+{
+	int i,j,k,n,m,best,nq;
+	int np, nrp, nz, nrz;
+	double gain, d;
+	double bestd = 0.0;
+	double q[2];
+	const double* num;
+	root_group_t poles[RC_BIQUAD_MAX_SECTIONS];
+	root_group_t zeros[RC_BIQUAD_MAX_SECTIONS];
+	root_group_t tmp;
+	double rp[MAX_ORDER], rz[MAX_ORDER];
+	int pairused[RC_BIQUAD_MAX_SECTIONS], realused[MAX_ORDER];
+
+	// sanity checks
+	if(unlikely(b==NULL)){
+		fprintf(stderr,"ERROR in rc_biquad_from_filter, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!f.initialized)){
+		fprintf(stderr,"ERROR in rc_biquad_from_filter, filter uninitialized\n");
+		return -1;
+	}
+	n = f.den.len-1;
+	if(unlikely(n>MAX_ORDER)){
+		fprintf(stderr,"ERROR in rc_biquad_from_filter, filter order must be <=%d\n", MAX_ORDER);
+		return -1;
+	}
+	// skip leading zeros in the numerator, they just add delay
+	num = f.num.d;
+	m = f.num.len-1;
+	while(m>0 && !(fabs(num[0])>0.0)){
+		num++;
+		m--;
+	}
+	gain = f.gain*num[0]/f.den.d[0];
+
+	// pure gain, a single section passes the input straight through
+	if(n==0){
+		__start(b,f.dt,1);
+		b->b0[0] = gain;
+		b->sat_en = f.sat_en;
+		b->sat_min = f.sat_min;
+		b->sat_max = f.sat_max;
+		return 0;
+	}
+
+	__factor(f.den.d,n,poles,&np,rp,&nrp);
+	__factor(num,m,zeros,&nz,rz,&nrz);
+
+	// pair up real poles by magnitude, the smallest is left over for a first
+	// order section when the order is odd
+	__sort_real(rp,nrp);
+	for(i=0;i<nrp;i+=2){
+		poles[np].r = rp[i];
+		poles[np].mag = fabs(rp[i]);
+		if(i+1<nrp){
+			poles[np].n = 2;
+			poles[np].c1 = -(rp[i]+rp[i+1]);
+			poles[np].c2 = rp[i]*rp[i+1];
+		}
+		else{
+			poles[np].n = 1;
+			poles[np].c1 = -rp[i];
+			poles[np].c2 = 0.0;
+		}
+		np++;
+	}
+
+	// order sections by increasing pole magnitude so the most resonant
+	// sections come last
+	for(i=1;i<np;i++){
+		tmp = poles[i];
+		for(j=i;j>0 && poles[j-1].mag>tmp.mag;j--) poles[j]=poles[j-1];
+		poles[j] = tmp;
+	}
+
+	__start(b,f.dt,np);
+	b->order = n;
+	for(i=0;i<nz;i++) pairused[i]=0;
+	for(i=0;i<nrz;i++) realused[i]=0;
+
+	// assign zeros starting from the most resonant section. Complex zero
+	// pairs can only go in second order sections so they are placed first,
+	// there are never more of them than there are second order sections.
+	for(k=np-1;k>=0;k--){
+		b->a1[k] = poles[k].c1;
+		b->a2[k] = poles[k].c2;
+
+		// nearest complex zero pair
+		best = -1;
+		if(poles[k].n==2){
+			for(i=0;i<nz;i++){
+				if(pairused[i]) continue;
+				d = cabs(zeros[i].r-poles[k].r);
+				if(best<0 || d<bestd){
+					best = i;
+					bestd = d;
+				}
+			}
+		}
+		if(best>=0){
+			pairused[best] = 1;
+			b->b0[k] = 1.0;
+			b->b1[k] = zeros[best].c1;
+			b->b2[k] = zeros[best].c2;
+			continue;
+		}
+
+		// otherwise up to one real zero per pole, nearest first
+		for(nq=0;nq<poles[k].n;nq++){
+			best = -1;
+			for(i=0;i<nrz;i++){
+				if(realused[i]) continue;
+				d = cabs(rz[i]-poles[k].r);
+				if(best<0 || d<bestd){
+					best = i;
+					bestd = d;
+				}
+			}
+			if(best<0) break;
+			realused[best] = 1;
+			q[nq] = rz[best];
+		}
+
+		// missing zeros become delays, shifting the numerator to the right
+		if(poles[k].n==2){
+			if(nq==2){
+				b->b0[k] = 1.0;
+				b->b1[k] = -(q[0]+q[1]);
+				b->b2[k] = q[0]*q[1];
+			}
+			else if(nq==1){
+				b->b1[k] = 1.0;
+				b->b2[k] = -q[0];
+			}
+			else b->b2[k] = 1.0;
+		}
+		else{
+			if(nq==1){
+				b->b0[k] = 1.0;
+				b->b1[k] = -q[0];
+			}
+			else b->b1[k] = 1.0;
+		}
+	}
+	// put the overall gain on the first section
+	b->b0[0] *= gain;
+	b->b1[0] *= gain;
+	b->b2[0] *= gain;
+	b->sat_en = f.sat_en;
+	b->sat_min = f.sat_min;
+	b->sat_max = f.sat_max;
+	return 0;
+}
+
+
+// fills in the sections of a butterworth filter, prewarped at wc the same way
+// rc_filter_c2d_tustin does it. Analog section wc^2/(s^2 + 2*sin(phi)*wc*s +
+// wc^2) maps to z with s=(wc/K)*(z-1)/(z+1) where K=tan(wc*dt/2)
+static void __butterworth(rc_biquad_t* b, int order, double dt, double wc, int highpass)
+{
+	int i,k;
+	double K, K2, zeta2, a0;
+
+	K = tan(wc*dt/2.0);
+	K2 = K*K;
+	__start(b,dt,(order+1)/2);
+	b->order = order;
+	k = 0;
+	// real pole first for odd orders
+	if(order%2){
+		a0 = 1.0 + K;
+		b->a1[k] = (K-1.0)/a0;
+		b->a2[k] = 0.0;
+		b->b0[k] = (highpass ? 1.0 : K)/a0;
+		b->b1[k] = (highpass ? -1.0 : K)/a0;
+		b->b2[k] = 0.0;
+		k++;
+	}
+	// then pole pairs from least to most resonant
+	for(i=order/2;i>=1;i--){
+		zeta2 = 2.0*sin((2*i-1)*M_PI/(2.0*order));
+		a0 = 1.0 + zeta2*K + K2;
+		b->a1[k] = 2.0*(K2-1.0)/a0;
+		b->a2[k] = (1.0 - zeta2*K + K2)/a0;
+		if(highpass){
+			b->b0[k] = 1.0/a0;
+			b->b1[k] = -2.0/a0;
+			b->b2[k] = 1.0/a0;
+		}
+		else{
+			b->b0[k] = K2/a0;
+			b->b1[k] = 2.0*K2/a0;
+			b->b2[k] = K2/a0;
+		}
+		k++;
+	}
+}
+
+
+int rc_biquad_butterworth_lowpass(rc_biquad_t* b, int order, double dt, double wc)
+{
+	// sanity checks
+	if(unlikely(b==NULL)){
+		fprintf(stderr,"ERROR in rc_biquad_butterworth_lowpass, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(order<1 || order>MAX_ORDER)){
+		fprintf(stderr,"ERROR in rc_biquad_butterworth_lowpass, order must be between 1 and %d\n", MAX_ORDER);
+		return -1;
+	}
+	if(unlikely(dt<=0.0 || wc<=0.0)){
+		fprintf(stderr,"ERROR in rc_biquad_butterworth_lowpass, dt and wc must be >0\n");
+		return -1;
+	}
+	if(unlikely(wc>=(M_PI/dt))){
+		fprintf(stderr,"ERROR in rc_biquad_butterworth_lowpass, wc larger than nyquist frequency\n");
+		return -1;
+	}
+	__butterworth(b,order,dt,wc,0);
+	return 0;
+}
+
+
+int rc_biquad_butterworth_highpass(rc_biquad_t* b, int order, double dt, double wc)
+{
+	// sanity checks
+	if(unlikely(b==NULL)){
+		fprintf(stderr,"ERROR in rc_biquad_butterworth_highpass, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(order<1 || order>MAX_ORDER)){
+		fprintf(stderr,"ERROR in rc_biquad_butterworth_highpass, order must be between 1 and %d\n", MAX_ORDER);
+		return -1;
+	}
+	if(unlikely(dt<=0.0 || wc<=0.0)){
+		fprintf(stderr,"ERROR in rc_biquad_butterworth_highpass, dt and wc must be >0\n");
+		return -1;
+	}
+	if(unlikely(wc>=(M_PI/dt))){
+		fprintf(stderr,"ERROR in rc_biquad_butterworth_highpass, wc larger than nyquist frequency\n");
+		return -1;
+	}
+	__butterworth(b,order,dt,wc,1);
+	return 0;
+}
+
+
+double rc_biquad_march(rc_biquad_t* b, double new_input)
+{
+	int i, last;
+	double x, y;
+	// sanity checks
+	if(unlikely(!b->initialized)){
+		fprintf(stderr,"ERROR in rc_biquad_march, biquad uninitialized\n");
+		return -1.0;
+	}
+	b->newest_input = new_input;
+	x = new_input;
+	last = b->sections-1;
+	// all but the last section, straight line code per section
+	for(i=0;i<last;i++){
+		y = b->b0[i]*x + b->s1[i];
+		b->s1[i] = b->b1[i]*x - b->a1[i]*y + b->s2[i];
+		b->s2[i] = b->b2[i]*x - b->a2[i]*y;
+		x = y;
+	}
+	// last section output is saturated before it updates the state so the
+	// saturated value is fed back the same way rc_filter_march does it
+	y = b->b0[last]*x + b->s1[last];
+	if(b->sat_en){
+		if(y>b->sat_max){
+			y=b->sat_max;
+			b->sat_flag=1;
+		}
+		else if(y<b->sat_min){
+			y=b->sat_min;
+			b->sat_flag=1;
+		}
+		else b->sat_flag=0;
+	}
+	b->s1[last] = b->b1[last]*x - b->a1[last]*y + b->s2[last];
+	b->s2[last] = b->b2[last]*x - b->a2[last]*y;
+	b->newest_output = y;
+	b->step++;
+	return y;
+}
+
+
+int rc_biquad_reset(rc_biquad_t* b)
+{
+	int i;
+	if(unlikely(!b->initialized)){
+		fprintf(stderr,"ERROR in rc_biquad_reset, biquad uninitialized\n");
+		return -1;
+	}
+	for(i=0;i<RC_BIQUAD_MAX_SECTIONS;i++){
+		b->s1[i] = 0.0;
+		b->s2[i] = 0.0;
+	}
+	b->newest_input = 0.0;
+	b->newest_output = 0.0;
+	b->sat_flag = 0;
+	b->step = 0;
+	return 0;
+}
+
+
+int rc_biquad_prefill(rc_biquad_t* b, double in)
+{
+	int i;
+	double x, y, den;
+	if(unlikely(!b->initialized)){
+		fprintf(stderr,"ERROR in rc_biquad_prefill, biquad uninitialized\n");
+		return -1;
+	}
+	b->newest_input = in;
+	x = in;
+	for(i=0;i<b->sections;i++){
+		den = 1.0 + b->a1[i] + b->a2[i];
+		if(fabs(den)<zero_tolerance){
+			// pole at z=1 has no steady state
+			b->s1[i] = 0.0;
+			b->s2[i] = 0.0;
+			y = b->b0[i]*x;
+		}
+		else{
+			y = x*(b->b0[i] + b->b1[i] + b->b2[i])/den;
+			b->s2[i] = b->b2[i]*x - b->a2[i]*y;
+			b->s1[i] = b->b1[i]*x - b->a1[i]*y + b->s2[i];
+		}
+		x = y;
+	}
+	b->newest_output = x;
+	return 0;
+}
+
+
+int rc_biquad_enable_saturation(rc_biquad_t* b, double min, double max)
+{
+	if(unlikely(!b->initialized)){
+		fprintf(stderr,"ERROR in rc_biquad_enable_saturation, biquad uninitialized\n");
+		return -1;
+	}
+	if(unlikely(min>max)){
+		fprintf(stderr,"ERROR in rc_biquad_enable_saturation, max must be >= min\n");
+		return -1;
+	}
+	b->sat_en	= 1;
+	b->sat_min	= min;
+	b->sat_max	= max;
+	return 0;
+}
+
+
+int rc_biquad_print(rc_biquad_t b)
+{
+	int i;
+	if(unlikely(!b.initialized)){
+		fprintf(stderr,"ERROR in rc_biquad_print, biquad not initialized yet\n");
+		return -1;
+	}
+	printf("order: %d\n", b.order);
+	printf("sections: %d\n", b.sections);
+	printf("timestep dt: %0.4f\n", b.dt);
+	printf("        b0          b1          b2          a1          a2\n");
+	for(i=0;i<b.sections;i++){
+		printf("%2d %11.4e %11.4e %11.4e %11.4e %11.4e\n", i, b.b0[i],\
+				b.b1[i], b.b2[i], b.a1[i], b.a2[i]);
+	}
+	return 0;
+}
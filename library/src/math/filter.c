@@ -191,30 +191,41 @@ int rc_filter_free(rc_filter_t* f)
 }
 
 
-double rc_filter_march(rc_filter_t* f, double new_input)
+// evaluates one step of the difference equation with no sanity checks, shared
+// by rc_filter_march and rc_filter_march_block so both produce bit-identical
+// results. Ring buffers are indexed directly here instead of going through
+// rc_ringbuf_insert and rc_ringbuf_get_value which check their arguments on
+// every single access.
+static inline double __march_unchecked(rc_filter_t* f, double new_input)
 {
-	int i, rel_deg;
+	int i, j, rel_deg;
 	double tmp1 = 0.0;
 	double tmp2 = 0.0;
 	double new_out;
-	// sanity checks
-	if(unlikely(!f->initialized)){
-		printf("ERROR in rc_filter_march, filter uninitialized\n");
-		return -1.0;
-	}
+	rc_ringbuf_t* in = &f->in_buf;
+	rc_ringbuf_t* out = &f->out_buf;
 	// log new input
-	rc_ringbuf_insert(&f->in_buf, new_input);
+	in->index++;
+	if(in->index>=in->size) in->index=0;
+	in->d[in->index] = new_input;
 	f->newest_input = new_input;
 	// relative degree should never be negative as rc_filter_alloc checks
 	// for improper transfer functions
 	rel_deg = f->den.len - f->num.len;
 	// evaluate the difference equation
+	j = in->index - rel_deg;
+	if(j<0) j+=in->size;
 	for(i=0; i<(f->num.len); i++){
-		tmp1+=f->num.d[i]*rc_ringbuf_get_value(&f->in_buf, i+rel_deg);
+		tmp1+=f->num.d[i]*in->d[j];
+		j--;
+		if(j<0) j+=in->size;
 	}
 	if(fabs(f->gain - 1.0) > zero_tolerance) tmp1=tmp1*f->gain;
+	j = out->index;
 	for(i=0; i<(f->order); i++){
-		tmp2-=f->den.d[i+1]*rc_ringbuf_get_value(&f->out_buf, i);
+		tmp2-=f->den.d[i+1]*out->d[j];
+		j--;
+		if(j<0) j+=out->size;
 	}
 	new_out=tmp2+tmp1;
 	// scale in case denominator doesn't have a leading 1
@@ -240,13 +251,43 @@ double rc_filter_march(rc_filter_t* f, double new_input)
 	}
 	// record the output to filter struct and ring buffer
 	f->newest_output = new_out;
-	rc_ringbuf_insert(&f->out_buf, new_out);
+	out->index++;
+	if(out->index>=out->size) out->index=0;
+	out->d[out->index] = new_out;
 	// increment steps
 	f->step++;
 	return new_out;
 }
 
 
+double rc_filter_march(rc_filter_t* f, double new_input)
+{
+	// sanity checks
+	if(unlikely(!f->initialized)){
+		printf("ERROR in rc_filter_march, filter uninitialized\n");
+		return -1.0;
+	}
+	return __march_unchecked(f, new_input);
+}
+
+
+int rc_filter_march_block(rc_filter_t* f, const double* in, double* out, size_t n)
+{
+	size_t i;
+	// sanity checks
+	if(unlikely(f==NULL || in==NULL || out==NULL)){
+		fprintf(stderr,"ERROR in rc_filter_march_block, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!f->initialized)){
+		fprintf(stderr,"ERROR in rc_filter_march_block, filter uninitialized\n");
+		return -1;
+	}
+	for(i=0;i<n;i++) out[i] = __march_unchecked(f, in[i]);
+	return 0;
+}
+
+
 int rc_filter_reset(rc_filter_t* f)
 {
 	if(unlikely(!f->initialized)){
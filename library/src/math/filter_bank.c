@@ -0,0 +1,235 @@
+/**
+ * @file filter_bank.c
+ * @brief      Banks of identical SISO filters sharing one set of coefficients,
+ *             marched together in transposed direct form II.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <float.h>	// for DBL_MAX
+#include <stdlib.h>	// for malloc,calloc,free
+#include <string.h>	// for memset
+
+#include <rc/math/filter_bank.h>
+
+#include "algebra_common.h"
+
+
+rc_filter_bank_t rc_filter_bank_empty(void)
+{
+	rc_filter_bank_t bank = RC_FILTER_BANK_INITIALIZER;
+	return bank;
+}
+
+
+int rc_filter_bank_alloc(rc_filter_bank_t* bank, int channels, rc_filter_t f)
+{
+	int i, ch, n, rel_deg, slen;
+	// sanity checks
+	if(unlikely(bank==NULL)){
+		fprintf(stderr,"ERROR in rc_filter_bank_alloc, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(channels<1)){
+		fprintf(stderr,"ERROR in rc_filter_bank_alloc, channels must be >=1\n");
+		return -1;
+	}
+	if(unlikely(!f.initialized)){
+		fprintf(stderr,"ERROR in rc_filter_bank_alloc, filter not initialized\n");
+		return -1;
+	}
+	// free existing memory, this also zeros out all fields
+	rc_filter_bank_free(bank);
+	n = f.order;
+	// state must have at least one element to keep calloc happy
+	slen = n*channels;
+	if(slen<1) slen=1;
+	bank->b		= (double*)malloc((n+1)*sizeof(double));
+	bank->a		= (double*)malloc((n+1)*sizeof(double));
+	bank->state	= (double*)calloc(slen,sizeof(double));
+	bank->sat_en	= (int*)calloc(channels,sizeof(int));
+	bank->sat_min	= (double*)malloc(channels*sizeof(double));
+	bank->sat_max	= (double*)malloc(channels*sizeof(double));
+	bank->sat_flag	= (int*)calloc(channels,sizeof(int));
+	if(unlikely(bank->b==NULL || bank->a==NULL || bank->state==NULL ||\
+			bank->sat_en==NULL || bank->sat_min==NULL ||\
+			bank->sat_max==NULL || bank->sat_flag==NULL)){
+		fprintf(stderr,"ERROR in rc_filter_bank_alloc, failed to allocate memory\n");
+		rc_filter_bank_free(bank);
+		return -1;
+	}
+	// normalize by the leading denominator coefficient and fold in the gain,
+	// numerator is padded with leading zeros up to the length of denominator
+	rel_deg = f.den.len - f.num.len;
+	for(i=0;i<=n;i++){
+		bank->a[i] = f.den.d[i]/f.den.d[0];
+		if(i<rel_deg) bank->b[i] = 0.0;
+		else bank->b[i] = f.gain*f.num.d[i-rel_deg]/f.den.d[0];
+	}
+	// channels without saturation are clamped to the whole double range so
+	// the march loop needs no branches, infinity is avoided for -ffast-math
+	for(ch=0;ch<channels;ch++){
+		bank->sat_en[ch]  = f.sat_en;
+		bank->sat_min[ch] = f.sat_en ? f.sat_min : -DBL_MAX;
+		bank->sat_max[ch] = f.sat_en ? f.sat_max :  DBL_MAX;
+	}
+	bank->channels	= channels;
+	bank->order	= n;
+	bank->dt	= f.dt;
+	bank->initialized = 1;
+	return 0;
+}
+
+
+int rc_filter_bank_free(rc_filter_bank_t* bank)
+{
+	rc_filter_bank_t new = RC_FILTER_BANK_INITIALIZER;
+	if(unlikely(bank==NULL)){
+		fprintf(stderr,"ERROR in rc_filter_bank_free, received NULL pointer\n");
+		return -1;
+	}
+	free(bank->b);
+	free(bank->a);
+	free(bank->state);
+	free(bank->sat_en);
+	free(bank->sat_min);
+	free(bank->sat_max);
+	free(bank->sat_flag);
+	*bank = new;
+	return 0;
+}
+
+
+int rc_filter_bank_march(rc_filter_bank_t* bank, const double* in, double* out)
+{
+	int k, ch, n, nch;
+	const double* __restrict__ x = in;
+	double* __restrict__ y = out;
+	const double* __restrict__ b;
+	const double* __restrict__ a;
+	double* __restrict__ s;
+	double* __restrict__ s_next;
+	// sanity checks
+	if(unlikely(bank==NULL || in==NULL || out==NULL)){
+		fprintf(stderr,"ERROR in rc_filter_bank_march, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!bank->initialized)){
+		fprintf(stderr,"ERROR in rc_filter_bank_march, filter bank uninitialized\n");
+		return -1;
+	}
+	n = bank->order;
+	nch = bank->channels;
+	b = bank->b;
+	a = bank->a;
+
+	// new outputs, a 0th order filter is just a gain
+	if(n==0){
+		for(ch=0;ch<nch;ch++) y[ch] = b[0]*x[ch];
+	}
+	else{
+		s = bank->state;
+		for(ch=0;ch<nch;ch++) y[ch] = b[0]*x[ch] + s[ch];
+	}
+	// saturate, disabled channels have limits of +-DBL_MAX and never trigger
+	for(ch=0;ch<nch;ch++){
+		bank->sat_flag[ch] = (y[ch]>bank->sat_max[ch]) | (y[ch]<bank->sat_min[ch]);
+		y[ch] = fmin(fmax(y[ch],bank->sat_min[ch]),bank->sat_max[ch]);
+	}
+	// update the state with the saturated output, one pass over all channels
+	// per state element keeps every loop contiguous
+	for(k=0;k<n-1;k++){
+		s = bank->state + k*nch;
+		s_next = s + nch;
+		for(ch=0;ch<nch;ch++) s[ch] = b[k+1]*x[ch] - a[k+1]*y[ch] + s_next[ch];
+	}
+	if(n>0){
+		s = bank->state + (n-1)*nch;
+		for(ch=0;ch<nch;ch++) s[ch] = b[n]*x[ch] - a[n]*y[ch];
+	}
+	bank->step++;
+	return 0;
+}
+
+
+int rc_filter_bank_reset(rc_filter_bank_t* bank)
+{
+	if(unlikely(bank==NULL || !bank->initialized)){
+		fprintf(stderr,"ERROR in rc_filter_bank_reset, filter bank uninitialized\n");
+		return -1;
+	}
+	memset(bank->state, 0, bank->order*bank->channels*sizeof(double));
+	memset(bank->sat_flag, 0, bank->channels*sizeof(int));
+	bank->step = 0;
+	return 0;
+}
+
+
+int rc_filter_bank_reset_channel(rc_filter_bank_t* bank, int ch)
+{
+	int k;
+	if(unlikely(bank==NULL || !bank->initialized)){
+		fprintf(stderr,"ERROR in rc_filter_bank_reset_channel, filter bank uninitialized\n");
+		return -1;
+	}
+	if(unlikely(ch<0 || ch>=bank->channels)){
+		fprintf(stderr,"ERROR in rc_filter_bank_reset_channel, channel out of bounds\n");
+		return -1;
+	}
+	for(k=0;k<bank->order;k++) bank->state[k*bank->channels+ch] = 0.0;
+	bank->sat_flag[ch] = 0;
+	return 0;
+}
+
+
+int rc_filter_bank_enable_saturation(rc_filter_bank_t* bank, int ch, double min, double max)
+{
+	if(unlikely(bank==NULL || !bank->initialized)){
+		fprintf(stderr,"ERROR in rc_filter_bank_enable_saturation, filter bank uninitialized\n");
+		return -1;
+	}
+	if(unlikely(ch<0 || ch>=bank->channels)){
+		fprintf(stderr,"ERROR in rc_filter_bank_enable_saturation, channel out of bounds\n");
+		return -1;
+	}
+	if(unlikely(min>max)){
+		fprintf(stderr,"ERROR in rc_filter_bank_enable_saturation, max must be >= min\n");
+		return -1;
+	}
+	bank->sat_en[ch]  = 1;
+	bank->sat_min[ch] = min;
+	bank->sat_max[ch] = max;
+	return 0;
+}
+
+
+int rc_filter_bank_disable_saturation(rc_filter_bank_t* bank, int ch)
+{
+	if(unlikely(bank==NULL || !bank->initialized)){
+		fprintf(stderr,"ERROR in rc_filter_bank_disable_saturation, filter bank uninitialized\n");
+		return -1;
+	}
+	if(unlikely(ch<0 || ch>=bank->channels)){
+		fprintf(stderr,"ERROR in rc_filter_bank_disable_saturation, channel out of bounds\n");
+		return -1;
+	}
+	bank->sat_en[ch]   = 0;
+	bank->sat_min[ch]  = -DBL_MAX;
+	bank->sat_max[ch]  =  DBL_MAX;
+	bank->sat_flag[ch] = 0;
+	return 0;
+}
+
+
+int rc_filter_bank_get_saturation_flag(rc_filter_bank_t* bank, int ch)
+{
+	if(unlikely(bank==NULL || !bank->initialized)){
+		fprintf(stderr,"ERROR in rc_filter_bank_get_saturation_flag, filter bank uninitialized\n");
+		return -1;
+	}
+	if(unlikely(ch<0 || ch>=bank->channels)){
+		fprintf(stderr,"ERROR in rc_filter_bank_get_saturation_flag, channel out of bounds\n");
+		return -1;
+	}
+	return bank->sat_flag[ch];
+}
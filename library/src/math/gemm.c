@@ -0,0 +1,330 @@
+/**
+ * @file math/gemm.c
+ *
+ * @brief      Cache-blocked general matrix multiply used by rc_matrix_multiply
+ *
+ * Follows the usual packed GEMM structure. Panels of A and B are copied into
+ * contiguous per-thread buffers sized to stay in cache, then a register-blocked
+ * micro-kernel computes an MR x NR block of C at a time by streaming through
+ * the packed panels.
+ *
+ * The micro-kernel is picked at build time from the instruction sets the
+ * compiler has been told it may use:
+ *
+ * - AVX2 + FMA on x86 (4x8), e.g. when built with -march=native on a desktop
+ * - SSE2 on x86 (4x4), always available on x86_64
+ * - NEON on 64-bit ARM (4x4). 32-bit ARMv7 NEON such as on the BeagleBone has
+ *   no double precision lanes, so it uses the portable kernel with VFP.
+ * - portable C (4x4) on everything else
+ */
+
+#include <stdint.h>
+#include <stdlib.h>	// for posix_memalign
+#include <string.h>	// for memset
+#include <pthread.h>
+
+#if defined(__AVX2__) && defined(__FMA__)
+	#include <immintrin.h>
+	#define MR 4
+	#define NR 8
+#elif defined(__SSE2__)
+	#include <emmintrin.h>
+	#define MR 4
+	#define NR 4
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	#include <arm_neon.h>
+	#define MR 4
+	#define NR 4
+#else
+	#define MR 4
+	#define NR 4
+#endif
+
+#include "algebra_common.h"
+
+// cache blocking sizes, must be multiples of MR and NR. Packed buffers take
+// (MC+NC)*KC*8 bytes, about 112kB, too much for the stack of a small thread.
+#define KC 128
+#define MC 48
+#define NC 64
+
+// products smaller than this many multiply-adds skip packing entirely
+#define SMALL_GEMM_FLOPS (24*24*24)
+
+// packed buffers are malloc'd the first time a thread needs them and freed by
+// the key destructor when it exits, so threads that never multiply large
+// matrices don't pay for them
+static pthread_key_t pack_key;
+static pthread_once_t pack_once = PTHREAD_ONCE_INIT;
+static int pack_key_ok = 0;
+
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+static inline void __micro_kernel(int kc, const double* __restrict__ a, const double* __restrict__ b, double* __restrict__ c, int ldc)
+{
+	int p;
+	__m256d a0, a1, a2, a3, b0, b1;
+	__m256d c00 = _mm256_setzero_pd();
+	__m256d c01 = _mm256_setzero_pd();
+	__m256d c10 = _mm256_setzero_pd();
+	__m256d c11 = _mm256_setzero_pd();
+	__m256d c20 = _mm256_setzero_pd();
+	__m256d c21 = _mm256_setzero_pd();
+	__m256d c30 = _mm256_setzero_pd();
+	__m256d c31 = _mm256_setzero_pd();
+
+	for(p=0;p<kc;p++){
+		b0 = _mm256_load_pd(b);
+		b1 = _mm256_load_pd(b+4);
+		a0 = _mm256_broadcast_sd(a);
+		a1 = _mm256_broadcast_sd(a+1);
+		a2 = _mm256_broadcast_sd(a+2);
+		a3 = _mm256_broadcast_sd(a+3);
+		c00 = _mm256_fmadd_pd(a0, b0, c00);
+		c01 = _mm256_fmadd_pd(a0, b1, c01);
+		c10 = _mm256_fmadd_pd(a1, b0, c10);
+		c11 = _mm256_fmadd_pd(a1, b1, c11);
+		c20 = _mm256_fmadd_pd(a2, b0, c20);
+		c21 = _mm256_fmadd_pd(a2, b1, c21);
+		c30 = _mm256_fmadd_pd(a3, b0, c30);
+		c31 = _mm256_fmadd_pd(a3, b1, c31);
+		a += MR;
+		b += NR;
+	}
+	_mm256_storeu_pd(c,         _mm256_add_pd(_mm256_loadu_pd(c),         c00));
+	_mm256_storeu_pd(c+4,       _mm256_add_pd(_mm256_loadu_pd(c+4),       c01));
+	_mm256_storeu_pd(c+ldc,     _mm256_add_pd(_mm256_loadu_pd(c+ldc),     c10));
+	_mm256_storeu_pd(c+ldc+4,   _mm256_add_pd(_mm256_loadu_pd(c+ldc+4),   c11));
+	_mm256_storeu_pd(c+2*ldc,   _mm256_add_pd(_mm256_loadu_pd(c+2*ldc),   c20));
+	_mm256_storeu_pd(c+2*ldc+4, _mm256_add_pd(_mm256_loadu_pd(c+2*ldc+4), c21));
+	_mm256_storeu_pd(c+3*ldc,   _mm256_add_pd(_mm256_loadu_pd(c+3*ldc),   c30));
+	_mm256_storeu_pd(c+3*ldc+4, _mm256_add_pd(_mm256_loadu_pd(c+3*ldc+4), c31));
+}
+
+#elif defined(__SSE2__)
+
+static inline void __micro_kernel(int kc, const double* __restrict__ a, const double* __restrict__ b, double* __restrict__ c, int ldc)
+{
+	int p;
+	__m128d a0, a1, a2, a3, b0, b1;
+	__m128d c00 = _mm_setzero_pd();
+	__m128d c01 = _mm_setzero_pd();
+	__m128d c10 = _mm_setzero_pd();
+	__m128d c11 = _mm_setzero_pd();
+	__m128d c20 = _mm_setzero_pd();
+	__m128d c21 = _mm_setzero_pd();
+	__m128d c30 = _mm_setzero_pd();
+	__m128d c31 = _mm_setzero_pd();
+
+	for(p=0;p<kc;p++){
+		b0 = _mm_load_pd(b);
+		b1 = _mm_load_pd(b+2);
+		a0 = _mm_load1_pd(a);
+		a1 = _mm_load1_pd(a+1);
+		a2 = _mm_load1_pd(a+2);
+		a3 = _mm_load1_pd(a+3);
+		c00 = _mm_add_pd(c00, _mm_mul_pd(a0, b0));
+		c01 = _mm_add_pd(c01, _mm_mul_pd(a0, b1));
+		c10 = _mm_add_pd(c10, _mm_mul_pd(a1, b0));
+		c11 = _mm_add_pd(c11, _mm_mul_pd(a1, b1));
+		c20 = _mm_add_pd(c20, _mm_mul_pd(a2, b0));
+		c21 = _mm_add_pd(c21, _mm_mul_pd(a2, b1));
+		c30 = _mm_add_pd(c30, _mm_mul_pd(a3, b0));
+		c31 = _mm_add_pd(c31, _mm_mul_pd(a3, b1));
+		a += MR;
+		b += NR;
+	}
+	_mm_storeu_pd(c,         _mm_add_pd(_mm_loadu_pd(c),         c00));
+	_mm_storeu_pd(c+2,       _mm_add_pd(_mm_loadu_pd(c+2),       c01));
+	_mm_storeu_pd(c+ldc,     _mm_add_pd(_mm_loadu_pd(c+ldc),     c10));
+	_mm_storeu_pd(c+ldc+2,   _mm_add_pd(_mm_loadu_pd(c+ldc+2),   c11));
+	_mm_storeu_pd(c+2*ldc,   _mm_add_pd(_mm_loadu_pd(c+2*ldc),   c20));
+	_mm_storeu_pd(c+2*ldc+2, _mm_add_pd(_mm_loadu_pd(c+2*ldc+2), c21));
+	_mm_storeu_pd(c+3*ldc,   _mm_add_pd(_mm_loadu_pd(c+3*ldc),   c30));
+	_mm_storeu_pd(c+3*ldc+2, _mm_add_pd(_mm_loadu_pd(c+3*ldc+2), c31));
+}
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+
+static inline void __micro_kernel(int kc, const double* __restrict__ a, const double* __restrict__ b, double* __restrict__ c, int ldc)
+{
+	int p;
+	float64x2_t b0, b1;
+	float64x2_t c00 = vdupq_n_f64(0.0);
+	float64x2_t c01 = vdupq_n_f64(0.0);
+	float64x2_t c10 = vdupq_n_f64(0.0);
+	float64x2_t c11 = vdupq_n_f64(0.0);
+	float64x2_t c20 = vdupq_n_f64(0.0);
+	float64x2_t c21 = vdupq_n_f64(0.0);
+	float64x2_t c30 = vdupq_n_f64(0.0);
+	float64x2_t c31 = vdupq_n_f64(0.0);
+
+	for(p=0;p<kc;p++){
+		b0 = vld1q_f64(b);
+		b1 = vld1q_f64(b+2);
+		c00 = vfmaq_n_f64(c00, b0, a[0]);
+		c01 = vfmaq_n_f64(c01, b1, a[0]);
+		c10 = vfmaq_n_f64(c10, b0, a[1]);
+		c11 = vfmaq_n_f64(c11, b1, a[1]);
+		c20 = vfmaq_n_f64(c20, b0, a[2]);
+		c21 = vfmaq_n_f64(c21, b1, a[2]);
+		c30 = vfmaq_n_f64(c30, b0, a[3]);
+		c31 = vfmaq_n_f64(c31, b1, a[3]);
+		a += MR;
+		b += NR;
+	}
+	vst1q_f64(c,         vaddq_f64(vld1q_f64(c),         c00));
+	vst1q_f64(c+2,       vaddq_f64(vld1q_f64(c+2),       c01));
+	vst1q_f64(c+ldc,     vaddq_f64(vld1q_f64(c+ldc),     c10));
+	vst1q_f64(c+ldc+2,   vaddq_f64(vld1q_f64(c+ldc+2),   c11));
+	vst1q_f64(c+2*ldc,   vaddq_f64(vld1q_f64(c+2*ldc),   c20));
+	vst1q_f64(c+2*ldc+2, vaddq_f64(vld1q_f64(c+2*ldc+2), c21));
+	vst1q_f64(c+3*ldc,   vaddq_f64(vld1q_f64(c+3*ldc),   c30));
+	vst1q_f64(c+3*ldc+2, vaddq_f64(vld1q_f64(c+3*ldc+2), c31));
+}
+
+#else
+
+static inline void __micro_kernel(int kc, const double* __restrict__ a, const double* __restrict__ b, double* __restrict__ c, int ldc)
+{
+	int p,i,j;
+	double acc[MR][NR] = {{0.0}};
+	for(p=0;p<kc;p++){
+		for(i=0;i<MR;i++){
+			for(j=0;j<NR;j++) acc[i][j] += a[i]*b[j];
+		}
+		a += MR;
+		b += NR;
+	}
+	for(i=0;i<MR;i++){
+		for(j=0;j<NR;j++) c[i*ldc+j] += acc[i][j];
+	}
+}
+
+#endif
+
+
+// copy a kc x nc block of B into panels NR columns wide, zero padding the
+// last panel so the micro-kernel never needs to handle a partial panel
+static void __pack_B(int kc, int nc, const double* B, int ldb, double* Bp)
+{
+	int i,j,p,w;
+	for(j=0;j<nc;j+=NR){
+		w = nc-j < NR ? nc-j : NR;
+		for(p=0;p<kc;p++){
+			for(i=0;i<w;i++)  Bp[i] = B[p*ldb+j+i];
+			for(;i<NR;i++)    Bp[i] = 0.0;
+			Bp += NR;
+		}
+	}
+}
+
+
+// copy an mc x kc block of A into panels MR rows tall, zero padding the last
+// panel so the micro-kernel never needs to handle a partial panel
+static void __pack_A(int mc, int kc, const double* A, int lda, double* Ap)
+{
+	int i,p,r,h;
+	for(i=0;i<mc;i+=MR){
+		h = mc-i < MR ? mc-i : MR;
+		for(p=0;p<kc;p++){
+			for(r=0;r<h;r++)  Ap[r] = A[(i+r)*lda+p];
+			for(;r<MR;r++)    Ap[r] = 0.0;
+			Ap += MR;
+		}
+	}
+}
+
+
+// straightforward i-k-j loop, vectorizes well and avoids the packing overhead
+// for the tiny matrices typical of filters and estimators
+static void __gemm_small(int m, int n, int k, const double* __restrict__ A, int lda, const double* __restrict__ B, int ldb, double* __restrict__ C, int ldc)
+{
+	int i,j,p;
+	double aip;
+	for(i=0;i<m;i++){
+		for(p=0;p<k;p++){
+			aip = A[i*lda+p];
+			for(j=0;j<n;j++) C[i*ldc+j] += aip*B[p*ldb+j];
+		}
+	}
+}
+
+
+static void __init_pack_key(void)
+{
+	if(pthread_key_create(&pack_key, free)==0) pack_key_ok = 1;
+}
+
+
+// returns the calling thread's packed buffers, Ap followed by Bp, or NULL if
+// they couldn't be allocated
+static double* __get_pack_buf(void)
+{
+	void* buf;
+	pthread_once(&pack_once, __init_pack_key);
+	if(unlikely(!pack_key_ok)) return NULL;
+	buf = pthread_getspecific(pack_key);
+	if(buf!=NULL) return buf;
+	if(unlikely(posix_memalign(&buf, 32, (MC+NC)*KC*sizeof(double)))) return NULL;
+	if(unlikely(pthread_setspecific(pack_key, buf))){
+		free(buf);
+		return NULL;
+	}
+	return buf;
+}
+
+
+void __gemm(int m, int n, int k, const double* A, int lda, const double* B, int ldb, double* C, int ldc)
+{
+	int ic,jc,pc,ir,jr,mc,nc,kc,i,j;
+	double *c, *Ap, *Bp;
+	double edge[MR*NR] __attribute__((aligned(32)));
+
+	// C is accumulated into so start with zeros
+	for(i=0;i<m;i++) memset(C+i*ldc, 0, n*sizeof(double));
+
+	if((int64_t)m*n*k < SMALL_GEMM_FLOPS){
+		__gemm_small(m, n, k, A, lda, B, ldb, C, ldc);
+		return;
+	}
+	// one set per thread so concurrent multiplies don't share panels. Without
+	// them the unpacked loop still gives the right answer, just slower.
+	Ap = __get_pack_buf();
+	if(unlikely(Ap==NULL)){
+		__gemm_small(m, n, k, A, lda, B, ldb, C, ldc);
+		return;
+	}
+	Bp = Ap + MC*KC; // MC*KC*8 bytes is a multiple of 32 so Bp stays aligned
+
+	for(jc=0;jc<n;jc+=NC){
+		nc = n-jc < NC ? n-jc : NC;
+		for(pc=0;pc<k;pc+=KC){
+			kc = k-pc < KC ? k-pc : KC;
+			__pack_B(kc, nc, B+pc*ldb+jc, ldb, Bp);
+			for(ic=0;ic<m;ic+=MC){
+				mc = m-ic < MC ? m-ic : MC;
+				__pack_A(mc, kc, A+ic*lda+pc, lda, Ap);
+				for(jr=0;jr<nc;jr+=NR){
+					for(ir=0;ir<mc;ir+=MR){
+						c = C+(ic+ir)*ldc+jc+jr;
+						// full block goes straight to C
+						if(mc-ir>=MR && nc-jr>=NR){
+							__micro_kernel(kc, Ap+ir*kc, Bp+jr*kc, c, ldc);
+							continue;
+						}
+						// partial block at the bottom or right edge
+						memset(edge, 0, sizeof(edge));
+						__micro_kernel(kc, Ap+ir*kc, Bp+jr*kc, edge, NR);
+						for(i=0;i<MR && ir+i<mc;i++){
+							for(j=0;j<NR && jr+j<nc;j++){
+								c[i*ldc+j] += edge[i*NR+j];
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
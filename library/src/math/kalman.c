@@ -18,6 +18,26 @@ rc_kalman_t rc_kalman_empty(void)
 }
 
 
+// allocates all the workspace used by the update functions so that they never
+// need to touch the heap during normal operation
+static int __alloc_workspace(rc_kalman_t* kf, int Nx, int Ny)
+{
+	if(rc_matrix_alloc(&kf->FT, Nx, Nx)==-1) return -1;
+	if(rc_matrix_alloc(&kf->HT, Nx, Ny)==-1) return -1;
+	if(rc_matrix_alloc(&kf->newP, Nx, Nx)==-1) return -1;
+	if(rc_matrix_alloc(&kf->S, Ny, Ny)==-1) return -1;
+	if(rc_matrix_alloc(&kf->L, Nx, Ny)==-1) return -1;
+	if(rc_matrix_alloc(&kf->LT, Ny, Nx)==-1) return -1;
+	if(rc_matrix_alloc(&kf->tmpxx, Nx, Nx)==-1) return -1;
+	if(rc_matrix_alloc(&kf->tmpyx, Ny, Nx)==-1) return -1;
+	if(rc_vector_alloc(&kf->h, Ny)==-1) return -1;
+	if(rc_vector_alloc(&kf->z, Ny)==-1) return -1;
+	if(rc_vector_alloc(&kf->tmp1, Nx)==-1) return -1;
+	if(rc_vector_alloc(&kf->tmp2, Nx)==-1) return -1;
+	return 0;
+}
+
+
 int rc_kalman_alloc_lin(rc_kalman_t* kf, rc_matrix_t F, rc_matrix_t G, rc_matrix_t H, rc_matrix_t Q, rc_matrix_t R, rc_matrix_t Pi)
 {
 	int Nx;
@@ -73,6 +93,11 @@ int rc_kalman_alloc_lin(rc_kalman_t* kf, rc_matrix_t F, rc_matrix_t G, rc_matrix
 
 	if(rc_vector_zeros(&kf->x_est, Nx)==-1) return -1;
 	if(rc_vector_zeros(&kf->x_pre, Nx)==-1) return -1;
+	if(__alloc_workspace(kf, Nx, H.rows)==-1) return -1;
+
+	// F and H are constant in the linear case so transpose them only once
+	rc_matrix_transpose(kf->F, &kf->FT);
+	rc_matrix_transpose(kf->H, &kf->HT);
 	kf->initialized = 1;
 	return 0;
 }
@@ -107,6 +132,7 @@ int rc_kalman_alloc_ekf(rc_kalman_t* kf, rc_matrix_t Q, rc_matrix_t R, rc_matrix
 	rc_matrix_duplicate(Pi, &kf->P);
 	rc_vector_zeros(&kf->x_est, Q.rows);
 	rc_vector_zeros(&kf->x_pre, Q.rows);
+	if(__alloc_workspace(kf, Q.rows, R.rows)==-1) return -1;
 	kf->initialized = 1;
 	return 0;
 }
@@ -132,6 +158,19 @@ int rc_kalman_free(rc_kalman_t* kf)
 	rc_vector_free(&kf->x_est);
 	rc_vector_free(&kf->x_pre);
 
+	rc_matrix_free(&kf->FT);
+	rc_matrix_free(&kf->HT);
+	rc_matrix_free(&kf->newP);
+	rc_matrix_free(&kf->S);
+	rc_matrix_free(&kf->L);
+	rc_matrix_free(&kf->LT);
+	rc_matrix_free(&kf->tmpxx);
+	rc_matrix_free(&kf->tmpyx);
+	rc_vector_free(&kf->h);
+	rc_vector_free(&kf->z);
+	rc_vector_free(&kf->tmp1);
+	rc_vector_free(&kf->tmp2);
+
 	*kf = new;
 	return 0;
 }
@@ -158,15 +197,6 @@ int rc_kalman_reset(rc_kalman_t* kf)
 
 int rc_kalman_update_lin(rc_kalman_t* kf, rc_vector_t u, rc_vector_t y)
 {
-	rc_matrix_t L = RC_MATRIX_INITIALIZER;
-	rc_matrix_t newP = RC_MATRIX_INITIALIZER;
-	rc_matrix_t S = RC_MATRIX_INITIALIZER;
-	rc_matrix_t FT = RC_MATRIX_INITIALIZER;
-	rc_vector_t h = RC_VECTOR_INITIALIZER;
-	rc_vector_t z = RC_VECTOR_INITIALIZER;
-	rc_vector_t tmp1 = RC_VECTOR_INITIALIZER;
-	rc_vector_t tmp2 = RC_VECTOR_INITIALIZER;
-
 	// sanity checks
 	if(unlikely(kf==NULL)){
 		fprintf(stderr, "ERROR in rc_kalman_lin_update, received NULL pointer\n");
@@ -189,58 +219,50 @@ int rc_kalman_update_lin(rc_kalman_t* kf, rc_vector_t u, rc_vector_t y)
 		return -1;
 	}
 
+	// all matrices and vectors below were sized by rc_kalman_alloc_lin so
+	// none of these calls allocate memory.
+
 	// for linear case only, calculate x_pre from linear system model
 	// x_pre = x[k|k-1] = F*x[k-1|k-1] +  G*u[k-1]
-	rc_matrix_times_col_vec(kf->F, kf->x_est, &tmp1);
-	rc_matrix_times_col_vec(kf->G, u, &tmp2);
-	rc_vector_sum(tmp1, tmp2, &kf->x_pre);
+	rc_matrix_times_col_vec(kf->F, kf->x_est, &kf->tmp1);
+	rc_matrix_times_col_vec(kf->G, u, &kf->tmp2);
+	rc_vector_sum(kf->tmp1, kf->tmp2, &kf->x_pre);
 
-	// F is constant in this linear case
+	// F is constant in this linear case, FT was calculated during alloc
 	// P[k|k-1] = F*P[k-1|k-1]*F^T + Q
-	rc_matrix_multiply(kf->F, kf->P, &newP);	// newP = F*P_old
-	rc_matrix_transpose(kf->F, &FT);
-	rc_matrix_right_multiply_inplace(&newP, FT);	// P = F*P*F^T
-	rc_matrix_add_inplace(&newP, kf->Q);		// P = F*P*F^T + Q
-	rc_matrix_symmetrize(&newP);			// Force symmetric P
+	rc_matrix_multiply(kf->F, kf->P, &kf->tmpxx);		// tmp = F*P_old
+	rc_matrix_multiply(kf->tmpxx, kf->FT, &kf->newP);	// P = F*P*F^T
+	rc_matrix_add_inplace(&kf->newP, kf->Q);		// P = F*P*F^T + Q
+	rc_matrix_symmetrize(&kf->newP);			// Force symmetric P
 
 	// h[k] = H * x_pre[k]
-	rc_matrix_times_col_vec(kf->H,kf->x_pre,&h);
+	rc_matrix_times_col_vec(kf->H, kf->x_pre, &kf->h);
 
-	// H is constant in the linear case
+	// H is constant in the linear case, HT was calculated during alloc
 	// S = H*P*H^T + R
-	// Calculate H^T, borrow S for H^T
-	rc_matrix_transpose(kf->H, &S);			// S = H^T
-	// Calculate a part of L in advance before we modify S = H^T
-	rc_matrix_multiply(newP, S, &L);		// K = P*(H^T)
-	rc_matrix_left_multiply_inplace(newP, &S);	// S = P*H^T
-	rc_matrix_left_multiply_inplace(kf->H, &S);	// S = H*(P*H^T)
-	rc_matrix_add_inplace(&S, kf->R);		// S = H*P*H^T + R
-
-	// L = P*(H^T)*(S^-1)
-	rc_algebra_invert_matrix_inplace(&S);		// S2^(-1) = S^(-1)
-	rc_matrix_right_multiply_inplace(&L, S);	// L = (P*H^T)*(S^-1)
-
-	// x[k|k] = x[k|k-1] + K[k]*(y[k]-h[k])
-	rc_vector_subtract(y,h,&z);			// z = k-h
-	rc_matrix_times_col_vec(L, z, &tmp1);		// temp = L*z
-	rc_vector_sum(kf->x_pre, tmp1, &kf->x_est);	// x_est = x + K*y
-
-	// P[k|k] = (I - L*H)*P = P[k|k-1] - L*H*P[k|k-1], reuse the matrix S.
-	rc_matrix_multiply(kf->H, newP, &S);		// S = H*P
-	rc_matrix_left_multiply_inplace(L, &S);		// S = L*(H*P)
-	rc_matrix_subtract_inplace(&newP, S);		// P = P - K*H*P
-	rc_matrix_symmetrize(&newP);			// Force symmetric P
-	rc_matrix_duplicate(newP,&kf->P);
-
-	// cleanup
-	rc_matrix_free(&L);
-	rc_matrix_free(&newP);
-	rc_matrix_free(&S);
-	rc_matrix_free(&FT);
-	rc_vector_free(&h);
-	rc_vector_free(&z);
-	rc_vector_free(&tmp1);
-	rc_vector_free(&tmp2);
+	rc_matrix_multiply(kf->H, kf->newP, &kf->tmpyx);	// tmp = H*P
+	rc_matrix_multiply(kf->tmpyx, kf->HT, &kf->S);		// S = (H*P)*H^T
+	rc_matrix_add_inplace(&kf->S, kf->R);			// S = H*P*H^T + R
+
+	// L = P*(H^T)*(S^-1), S is SPD so rather than inverting it solve
+	// S*L^T = H*P with its Cholesky factor
+	if(unlikely(rc_algebra_cholesky_decomp(kf->S, &kf->S))){
+		fprintf(stderr, "ERROR in rc_kalman_lin_update, S is not positive-definite\n");
+		return -1;
+	}
+	rc_algebra_cholesky_solve_matrix(kf->S, kf->tmpyx, &kf->LT); // L^T = S^-1*H*P
+	rc_matrix_transpose(kf->LT, &kf->L);
+
+	// x[k|k] = x[k|k-1] + L[k]*(y[k]-h[k])
+	rc_vector_subtract(y, kf->h, &kf->z);			// z = y-h
+	rc_matrix_times_col_vec(kf->L, kf->z, &kf->tmp1);	// tmp = L*z
+	rc_vector_sum(kf->x_pre, kf->tmp1, &kf->x_est);		// x_est = x + L*z
+
+	// P[k|k] = (I - L*H)*P = P[k|k-1] - L*H*P[k|k-1]
+	rc_matrix_multiply(kf->L, kf->tmpyx, &kf->tmpxx);	// tmp = L*(H*P)
+	rc_matrix_subtract_inplace(&kf->newP, kf->tmpxx);	// P = P - L*H*P
+	rc_matrix_symmetrize(&kf->newP);			// Force symmetric P
+	rc_matrix_duplicate(kf->newP, &kf->P);
 
 	kf->step++;
 	return 0;
@@ -249,14 +271,6 @@ int rc_kalman_update_lin(rc_kalman_t* kf, rc_vector_t u, rc_vector_t y)
 
 int rc_kalman_update_ekf(rc_kalman_t* kf, rc_matrix_t F, rc_matrix_t H, rc_vector_t x_pre, rc_vector_t y, rc_vector_t h)
 {
-	rc_matrix_t L = RC_MATRIX_INITIALIZER;
-	rc_matrix_t newP = RC_MATRIX_INITIALIZER;
-	rc_matrix_t S = RC_MATRIX_INITIALIZER;
-	rc_matrix_t FT = RC_MATRIX_INITIALIZER;
-	rc_vector_t z = RC_VECTOR_INITIALIZER;
-	rc_vector_t tmp1 = RC_VECTOR_INITIALIZER;
-	rc_vector_t tmp2 = RC_VECTOR_INITIALIZER;
-
 	// sanity checks
 	if(unlikely(kf==NULL)){
 		fprintf(stderr, "ERROR in rc_kalman_ekf_update, received NULL pointer\n");
@@ -294,56 +308,53 @@ int rc_kalman_update_ekf(rc_kalman_t* kf, rc_matrix_t F, rc_matrix_t H, rc_vecto
 		fprintf(stderr, "ERROR in rc_kalman_ekf_update y must have same dimension h\n");
 		return -1;
 	}
+	if(unlikely(x_pre.len != kf->P.rows || y.len != kf->R.rows)){
+		fprintf(stderr, "ERROR in rc_kalman_ekf_update dimensions don't match Q & R given to rc_kalman_alloc_ekf\n");
+		return -1;
+	}
 
-	// copy in new jacobians and x prediction
+	// copy in new jacobians and x prediction, after the first step F and H
+	// are already the right size so this is just a memcpy
 	rc_matrix_duplicate(F, &kf->F);
 	rc_vector_duplicate(x_pre, &kf->x_pre);
 	rc_matrix_duplicate(H, &kf->H);
 
 	// F is new now in non-linear case
 	// P[k|k-1] = F*P[k-1|k-1]*F^T + Q
-	rc_matrix_multiply(kf->F, kf->P, &newP);	// P_new = F*P_old
-	rc_matrix_transpose(kf->F, &FT);
-	rc_matrix_right_multiply_inplace(&newP, FT);	// P = F*P*F^T
-	rc_matrix_add(newP, kf->Q, &kf->P);		// P = F*P*F^T + Q
-	rc_matrix_symmetrize(&kf->P);			// Force symmetric P
+	rc_matrix_multiply(kf->F, kf->P, &kf->tmpxx);		// tmp = F*P_old
+	rc_matrix_transpose(kf->F, &kf->FT);
+	rc_matrix_multiply(kf->tmpxx, kf->FT, &kf->newP);	// P_new = F*P*F^T
+	rc_matrix_add(kf->newP, kf->Q, &kf->P);			// P = F*P*F^T + Q
+	rc_matrix_symmetrize(&kf->P);				// Force symmetric P
 
-	// H is constant in the linear case
+	// H is new now in non-linear case
 	// S = H*P*H^T + R
-	// Calculate H^T, borrow S for H^T
-	rc_matrix_transpose(kf->H, &S);			// S = H^T
-	// Calculate a part of L in advance before we modify S = H^T
-	rc_matrix_multiply(kf->P, S, &L);		// K = P*(H^T)
-	rc_matrix_left_multiply_inplace(kf->P, &S);	// S = P*H^T
-	rc_matrix_left_multiply_inplace(kf->H, &S);	// S = H*(P*H^T)
-	rc_matrix_add_inplace(&S, kf->R);		// S = H*P*H^T + R
-
-	// L = P*(H^T)*(S^-1)
-	rc_algebra_invert_matrix_inplace(&S);		// S2^(-1) = S^(-1)
-	rc_matrix_right_multiply_inplace(&L, S);	// L = (P*H^T)*(S^-1)
+	rc_matrix_transpose(kf->H, &kf->HT);
+	rc_matrix_multiply(kf->H, kf->P, &kf->tmpyx);		// tmp = H*P
+	rc_matrix_multiply(kf->tmpyx, kf->HT, &kf->S);		// S = (H*P)*H^T
+	rc_matrix_add_inplace(&kf->S, kf->R);			// S = H*P*H^T + R
+
+	// L = P*(H^T)*(S^-1), S is SPD so rather than inverting it solve
+	// S*L^T = H*P with its Cholesky factor
+	if(unlikely(rc_algebra_cholesky_decomp(kf->S, &kf->S))){
+		fprintf(stderr, "ERROR in rc_kalman_ekf_update, S is not positive-definite\n");
+		return -1;
+	}
+	rc_algebra_cholesky_solve_matrix(kf->S, kf->tmpyx, &kf->LT); // L^T = S^-1*H*P
+	rc_matrix_transpose(kf->LT, &kf->L);
 
 	// x[k|k] = x[k|k-1] + L[k]*(y[k]-h[k])
-	rc_vector_subtract(y,h,&z);			// z = k-h
-	rc_matrix_times_col_vec(L, z, &tmp1);		// temp = L*z
-	rc_vector_sum(kf->x_pre, tmp1, &kf->x_est);	// x_est = x + L*y
-
-	// P[k|k] = (I - L*H)*P = P - L*H*P, reuse the matrix S.
-	rc_matrix_multiply(kf->H, newP, &S);		// S = H*P
-	rc_matrix_left_multiply_inplace(L, &S);		// S = L*(H*P)
-	rc_matrix_subtract_inplace(&newP, S);		// P = P - K*H*P
-	rc_matrix_symmetrize(&newP);			// Force symmetric P
-	rc_matrix_duplicate(newP,&kf->P);
-
-	// cleanup
-	rc_matrix_free(&L);
-	rc_matrix_free(&newP);
-	rc_matrix_free(&S);
-	rc_matrix_free(&FT);
-	rc_vector_free(&z);
-	rc_vector_free(&tmp1);
-	rc_vector_free(&tmp2);
+	rc_vector_subtract(y, h, &kf->z);			// z = y-h
+	rc_matrix_times_col_vec(kf->L, kf->z, &kf->tmp1);	// tmp = L*z
+	rc_vector_sum(kf->x_pre, kf->tmp1, &kf->x_est);		// x_est = x + L*z
+
+	// P[k|k] = (I - L*H)*P = P - L*H*P
+	rc_matrix_multiply(kf->H, kf->newP, &kf->tmpyx);	// tmp = H*P
+	rc_matrix_multiply(kf->L, kf->tmpyx, &kf->tmpxx);	// tmp = L*(H*P)
+	rc_matrix_subtract_inplace(&kf->newP, kf->tmpxx);	// P = P - L*H*P
+	rc_matrix_symmetrize(&kf->newP);			// Force symmetric P
+	rc_matrix_duplicate(kf->newP, &kf->P);
 
 	kf->step++;
 	return 0;
 }
-
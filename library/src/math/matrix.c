@@ -243,8 +243,6 @@ int rc_matrix_times_scalar(rc_matrix_t* A, double s)
 
 int rc_matrix_multiply(rc_matrix_t A, rc_matrix_t B, rc_matrix_t* C)
 {
-	int i,j;
-	double* tmp;
 	if(unlikely(A.initialized!=1 || B.initialized!=1)){
 		fprintf(stderr,"ERROR in rc_matrix_multiply, matrix not initialized\n");
 		return -1;
@@ -258,23 +256,9 @@ int rc_matrix_multiply(rc_matrix_t A, rc_matrix_t B, rc_matrix_t* C)
 		fprintf(stderr,"ERROR in rc_matrix_multiply, can't allocate memory for C\n");
 		return -1;
 	}
-	// allocate memory for a column of B from the stack, this is faster than
-	// malloc and the memory is freed automatically when this function returns
-	// it is faster to put a column in contiguous memory before multiplying
-	tmp = alloca(B.rows*sizeof(double));
-	if(unlikely(tmp==NULL)){
-		fprintf(stderr,"ERROR in rc_matrix_multiply, alloca failed, stack overflow\n");
-		return -1;
-	}
-	// go through columns of B calculating columns of C left to right
-	for(i=0;i<(B.cols);i++){
-		// put column of B in sequential memory slot
-		for(j=0;j<B.rows;j++) tmp[j]=B.d[j][i];
-		// calculate each row in column i
-		for(j=0;j<(A.rows);j++){
-			C->d[j][i]=__vectorized_mult_accumulate(A.d[j],tmp,B.rows);
-		}
-	}
+	// all matrix data is contiguous so hand it straight to the blocked
+	// multiply which uses the SIMD kernel for this architecture
+	__gemm(A.rows, B.cols, A.cols, A.d[0], A.cols, B.d[0], B.cols, C->d[0], C->cols);
 	return 0;
 }
 
@@ -446,7 +446,6 @@ int rc_quaternion_rotate_vector_array(double v[3], double q[4])
 
 int rc_quaternion_to_rotation_matrix(rc_vector_t q, rc_matrix_t* m)
 {
-	double q0s, q1s, q2s, q3s;
 	// sanity checks
 	if(unlikely(!q.initialized)){
 		fprintf(stderr, "ERROR in rc_quaternion_to_rotation_matrix, vector uninitialized\n");
@@ -460,22 +459,35 @@ int rc_quaternion_to_rotation_matrix(rc_vector_t q, rc_matrix_t* m)
 		fprintf(stderr, "ERROR in rc_quaternion_to_rotation_matrix, failed to alloc matrix\n");
 		return -1;
 	}
+	// m's data is contiguous so fill it in directly as a rc_mat3_t
+	return rc_quaternion_to_rotation_mat3(q.d, rc_mat3_from_matrix(*m));
+}
+
+
+int rc_quaternion_to_rotation_mat3(double q[4], rc_mat3_t* m)
+{
+	double q0s, q1s, q2s, q3s;
+	// sanity checks
+	if(unlikely(q==NULL || m==NULL)){
+		fprintf(stderr, "ERROR in rc_quaternion_to_rotation_mat3, received NULL pointer\n");
+		return -1;
+	}
 	// compute squares which will be used multiple times
-	q0s = q.d[0]*q.d[0];
-	q1s = q.d[1]*q.d[1];
-	q2s = q.d[2]*q.d[2];
-	q3s = q.d[3]*q.d[3];
+	q0s = q[0]*q[0];
+	q1s = q[1]*q[1];
+	q2s = q[2]*q[2];
+	q3s = q[3]*q[3];
 	// diagonal entries
 	m->d[0][0] = q0s+q1s-q2s-q3s;
 	m->d[1][1] = q0s-q1s+q2s-q3s;
 	m->d[2][2] = q0s-q1s-q2s+q3s;
 	// upper triangle
-	m->d[0][1] = 2.0 * (q.d[1]*q.d[2] - q.d[0]*q.d[3]);
-	m->d[0][2] = 2.0 * (q.d[1]*q.d[3] + q.d[0]*q.d[2]);
-	m->d[1][2] = 2.0 * (q.d[2]*q.d[3] - q.d[0]*q.d[1]);
+	m->d[0][1] = 2.0 * (q[1]*q[2] - q[0]*q[3]);
+	m->d[0][2] = 2.0 * (q[1]*q[3] + q[0]*q[2]);
+	m->d[1][2] = 2.0 * (q[2]*q[3] - q[0]*q[1]);
 	// lower triangle
-	m->d[1][0] = 2.0 * (q.d[1]*q.d[2] + q.d[0]*q.d[3]);
-	m->d[2][0] = 2.0 * (q.d[1]*q.d[3] - q.d[0]*q.d[2]);
-	m->d[2][1] = 2.0 * (q.d[2]*q.d[3] + q.d[0]*q.d[1]);
+	m->d[1][0] = 2.0 * (q[1]*q[2] + q[0]*q[3]);
+	m->d[2][0] = 2.0 * (q[1]*q[3] - q[0]*q[2]);
+	m->d[2][1] = 2.0 * (q[2]*q[3] + q[0]*q[1]);
 	return 0;
 }
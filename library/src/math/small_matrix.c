@@ -0,0 +1,553 @@
+/**
+ * @file math/small_matrix.c
+ *
+ * @brief      Fixed-size stack-allocated matrices, see small_matrix.h
+ *
+ * All the fixed and generic sizes share the same static kernels below which
+ * work on contiguous row-major data. Since the dimension is a compile time
+ * constant for rc_mat3_t and rc_mat4_t, the compiler can fully unroll them.
+ */
+
+#include <stdio.h>
+#include <string.h>	// for memcpy
+#include <math.h>	// for fabs, sqrt
+
+#include <rc/math/small_matrix.h>
+#include "algebra_common.h"
+
+#define MAX_DIM RC_SMALL_MATRIX_MAX_DIM
+
+// the kernels below work in fixed MAX_DIM sized buffers so every generic
+// matrix must be checked with this before it reaches them
+#define BAD_DIMS(rows,cols) ((rows)<1 || (cols)<1 || (rows)>MAX_DIM || (cols)>MAX_DIM)
+
+
+// C=A*B where A is nxm and B is mxp. C may alias A or B.
+static inline void __mult(const double* A, const double* B, double* C, int n, int m, int p)
+{
+	int i,j,k;
+	double tmp[MAX_DIM*MAX_DIM];
+	for(i=0;i<n;i++){
+		for(j=0;j<p;j++) tmp[i*p+j]=0.0;
+		for(k=0;k<m;k++){
+			for(j=0;j<p;j++) tmp[i*p+j] += A[i*m+k]*B[k*p+j];
+		}
+	}
+	memcpy(C, tmp, n*p*sizeof(double));
+}
+
+
+// T=A' where A is rows x cols. T may alias A.
+static inline void __transpose(const double* A, double* T, int rows, int cols)
+{
+	int i,j;
+	double tmp[MAX_DIM*MAX_DIM];
+	for(i=0;i<rows;i++){
+		for(j=0;j<cols;j++) tmp[j*rows+i]=A[i*cols+j];
+	}
+	memcpy(T, tmp, rows*cols*sizeof(double));
+}
+
+
+// c=A*v where A is nxm. c may alias v.
+static inline void __times_vec(const double* A, const double* v, double* c, int n, int m)
+{
+	int i,k;
+	double tmp[MAX_DIM];
+	for(i=0;i<n;i++){
+		tmp[i]=0.0;
+		for(k=0;k<m;k++) tmp[i] += A[i*m+k]*v[k];
+	}
+	memcpy(c, tmp, n*sizeof(double));
+}
+
+
+// Gauss-Jordan elimination with partial pivoting on an nxn matrix.
+static inline int __invert(const double* A, double* Ainv, int n)
+{
+	int i,j,k,p;
+	double a[MAX_DIM*MAX_DIM];
+	double inv[MAX_DIM*MAX_DIM];
+	double ratio, tmp;
+
+	memcpy(a, A, n*n*sizeof(double));
+	for(i=0;i<n*n;i++) inv[i]=0.0;
+	for(i=0;i<n;i++) inv[i*n+i]=1.0;
+
+	for(i=0;i<n;i++){
+		// find pivot row
+		p=i;
+		for(j=i+1;j<n;j++){
+			if(fabs(a[j*n+i])>fabs(a[p*n+i])) p=j;
+		}
+		if(unlikely(fabs(a[p*n+i])<zero_tolerance)) return -1;
+		if(p!=i){
+			for(k=0;k<n;k++){
+				tmp=a[i*n+k]; a[i*n+k]=a[p*n+k]; a[p*n+k]=tmp;
+				tmp=inv[i*n+k]; inv[i*n+k]=inv[p*n+k]; inv[p*n+k]=tmp;
+			}
+		}
+		// normalize pivot row
+		ratio = 1.0/a[i*n+i];
+		for(k=0;k<n;k++){
+			a[i*n+k] *= ratio;
+			inv[i*n+k] *= ratio;
+		}
+		// eliminate column i from all other rows
+		for(j=0;j<n;j++){
+			if(j==i) continue;
+			ratio = a[j*n+i];
+			for(k=0;k<n;k++){
+				a[j*n+k] -= ratio*a[i*n+k];
+				inv[j*n+k] -= ratio*inv[i*n+k];
+			}
+		}
+	}
+	memcpy(Ainv, inv, n*n*sizeof(double));
+	return 0;
+}
+
+
+// Cholesky-Banachiewicz decomposition of an nxn SPD matrix, L may alias A.
+static inline int __cholesky(const double* A, double* L, int n)
+{
+	int i,j,k;
+	double l[MAX_DIM*MAX_DIM];
+	double sum;
+
+	for(i=0;i<n*n;i++) l[i]=0.0;
+	for(i=0;i<n;i++){
+		for(j=0;j<=i;j++){
+			sum = A[i*n+j];
+			for(k=0;k<j;k++) sum -= l[i*n+k]*l[j*n+k];
+			if(i==j){
+				if(unlikely(sum<zero_tolerance)) return -1;
+				l[i*n+i] = sqrt(sum);
+			}
+			else l[i*n+j] = sum/l[j*n+j];
+		}
+	}
+	memcpy(L, l, n*n*sizeof(double));
+	return 0;
+}
+
+
+static void __fill_row_pointers(double* data, double* rows[], int nrows, int ncols, rc_matrix_t* view)
+{
+	int i;
+	for(i=0;i<nrows;i++) rows[i]=data+(i*ncols);
+	view->rows = nrows;
+	view->cols = ncols;
+	view->d = rows;
+	view->initialized = 1;
+}
+
+
+int rc_mat3_identity(rc_mat3_t* A)
+{
+	rc_mat3_t I = {{{1.0,0.0,0.0},{0.0,1.0,0.0},{0.0,0.0,1.0}}};
+	if(unlikely(A==NULL)){
+		fprintf(stderr,"ERROR in rc_mat3_identity, received NULL pointer\n");
+		return -1;
+	}
+	*A = I;
+	return 0;
+}
+
+
+int rc_mat3_multiply(const rc_mat3_t* A, const rc_mat3_t* B, rc_mat3_t* C)
+{
+	if(unlikely(A==NULL || B==NULL || C==NULL)){
+		fprintf(stderr,"ERROR in rc_mat3_multiply, received NULL pointer\n");
+		return -1;
+	}
+	__mult((const double*)A->d, (const double*)B->d, (double*)C->d, 3, 3, 3);
+	return 0;
+}
+
+
+int rc_mat3_transpose(const rc_mat3_t* A, rc_mat3_t* T)
+{
+	if(unlikely(A==NULL || T==NULL)){
+		fprintf(stderr,"ERROR in rc_mat3_transpose, received NULL pointer\n");
+		return -1;
+	}
+	__transpose((const double*)A->d, (double*)T->d, 3, 3);
+	return 0;
+}
+
+
+int rc_mat3_invert(const rc_mat3_t* A, rc_mat3_t* Ainv)
+{
+	int i,j;
+	rc_mat3_t adj;
+	double det;
+	if(unlikely(A==NULL || Ainv==NULL)){
+		fprintf(stderr,"ERROR in rc_mat3_invert, received NULL pointer\n");
+		return -1;
+	}
+	// cofactors, arranged as the transposed cofactor matrix (adjugate)
+	adj.d[0][0] = A->d[1][1]*A->d[2][2] - A->d[1][2]*A->d[2][1];
+	adj.d[0][1] = A->d[0][2]*A->d[2][1] - A->d[0][1]*A->d[2][2];
+	adj.d[0][2] = A->d[0][1]*A->d[1][2] - A->d[0][2]*A->d[1][1];
+	adj.d[1][0] = A->d[1][2]*A->d[2][0] - A->d[1][0]*A->d[2][2];
+	adj.d[1][1] = A->d[0][0]*A->d[2][2] - A->d[0][2]*A->d[2][0];
+	adj.d[1][2] = A->d[0][2]*A->d[1][0] - A->d[0][0]*A->d[1][2];
+	adj.d[2][0] = A->d[1][0]*A->d[2][1] - A->d[1][1]*A->d[2][0];
+	adj.d[2][1] = A->d[0][1]*A->d[2][0] - A->d[0][0]*A->d[2][1];
+	adj.d[2][2] = A->d[0][0]*A->d[1][1] - A->d[0][1]*A->d[1][0];
+	// expand determinant along the first row
+	det = A->d[0][0]*adj.d[0][0] + A->d[0][1]*adj.d[1][0] + A->d[0][2]*adj.d[2][0];
+	if(unlikely(fabs(det)<zero_tolerance)){
+		fprintf(stderr,"ERROR in rc_mat3_invert, matrix is singular\n");
+		return -1;
+	}
+	det = 1.0/det;
+	for(i=0;i<3;i++){
+		for(j=0;j<3;j++) Ainv->d[i][j] = adj.d[i][j]*det;
+	}
+	return 0;
+}
+
+
+int rc_mat3_cholesky(const rc_mat3_t* A, rc_mat3_t* L)
+{
+	if(unlikely(A==NULL || L==NULL)){
+		fprintf(stderr,"ERROR in rc_mat3_cholesky, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(__cholesky((const double*)A->d, (double*)L->d, 3))){
+		fprintf(stderr,"ERROR in rc_mat3_cholesky, matrix not positive definite\n");
+		return -1;
+	}
+	return 0;
+}
+
+
+int rc_mat3_times_vec(const rc_mat3_t* A, const rc_vec3_t* v, rc_vec3_t* c)
+{
+	if(unlikely(A==NULL || v==NULL || c==NULL)){
+		fprintf(stderr,"ERROR in rc_mat3_times_vec, received NULL pointer\n");
+		return -1;
+	}
+	__times_vec((const double*)A->d, v->d, c->d, 3, 3);
+	return 0;
+}
+
+
+int rc_mat3_as_matrix(rc_mat3_t* A, double* rows[3], rc_matrix_t* view)
+{
+	if(unlikely(A==NULL || rows==NULL || view==NULL)){
+		fprintf(stderr,"ERROR in rc_mat3_as_matrix, received NULL pointer\n");
+		return -1;
+	}
+	__fill_row_pointers((double*)A->d, rows, 3, 3, view);
+	return 0;
+}
+
+
+rc_mat3_t* rc_mat3_from_matrix(rc_matrix_t A)
+{
+	if(unlikely(A.initialized!=1 || A.rows!=3 || A.cols!=3)){
+		fprintf(stderr,"ERROR in rc_mat3_from_matrix, expected initialized 3x3 matrix\n");
+		return NULL;
+	}
+	return (rc_mat3_t*)A.d[0];
+}
+
+
+int rc_mat4_identity(rc_mat4_t* A)
+{
+	rc_mat4_t I = {{{1.0,0.0,0.0,0.0},{0.0,1.0,0.0,0.0},{0.0,0.0,1.0,0.0},{0.0,0.0,0.0,1.0}}};
+	if(unlikely(A==NULL)){
+		fprintf(stderr,"ERROR in rc_mat4_identity, received NULL pointer\n");
+		return -1;
+	}
+	*A = I;
+	return 0;
+}
+
+
+int rc_mat4_multiply(const rc_mat4_t* A, const rc_mat4_t* B, rc_mat4_t* C)
+{
+	if(unlikely(A==NULL || B==NULL || C==NULL)){
+		fprintf(stderr,"ERROR in rc_mat4_multiply, received NULL pointer\n");
+		return -1;
+	}
+	__mult((const double*)A->d, (const double*)B->d, (double*)C->d, 4, 4, 4);
+	return 0;
+}
+
+
+int rc_mat4_transpose(const rc_mat4_t* A, rc_mat4_t* T)
+{
+	if(unlikely(A==NULL || T==NULL)){
+		fprintf(stderr,"ERROR in rc_mat4_transpose, received NULL pointer\n");
+		return -1;
+	}
+	__transpose((const double*)A->d, (double*)T->d, 4, 4);
+	return 0;
+}
+
+
+int rc_mat4_invert(const rc_mat4_t* A, rc_mat4_t* Ainv)
+{
+	if(unlikely(A==NULL || Ainv==NULL)){
+		fprintf(stderr,"ERROR in rc_mat4_invert, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(__invert((const double*)A->d, (double*)Ainv->d, 4))){
+		fprintf(stderr,"ERROR in rc_mat4_invert, matrix is singular\n");
+		return -1;
+	}
+	return 0;
+}
+
+
+int rc_mat4_cholesky(const rc_mat4_t* A, rc_mat4_t* L)
+{
+	if(unlikely(A==NULL || L==NULL)){
+		fprintf(stderr,"ERROR in rc_mat4_cholesky, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(__cholesky((const double*)A->d, (double*)L->d, 4))){
+		fprintf(stderr,"ERROR in rc_mat4_cholesky, matrix not positive definite\n");
+		return -1;
+	}
+	return 0;
+}
+
+
+int rc_mat4_times_vec(const rc_mat4_t* A, const rc_vec4_t* v, rc_vec4_t* c)
+{
+	if(unlikely(A==NULL || v==NULL || c==NULL)){
+		fprintf(stderr,"ERROR in rc_mat4_times_vec, received NULL pointer\n");
+		return -1;
+	}
+	__times_vec((const double*)A->d, v->d, c->d, 4, 4);
+	return 0;
+}
+
+
+int rc_mat4_as_matrix(rc_mat4_t* A, double* rows[4], rc_matrix_t* view)
+{
+	if(unlikely(A==NULL || rows==NULL || view==NULL)){
+		fprintf(stderr,"ERROR in rc_mat4_as_matrix, received NULL pointer\n");
+		return -1;
+	}
+	__fill_row_pointers((double*)A->d, rows, 4, 4, view);
+	return 0;
+}
+
+
+rc_mat4_t* rc_mat4_from_matrix(rc_matrix_t A)
+{
+	if(unlikely(A.initialized!=1 || A.rows!=4 || A.cols!=4)){
+		fprintf(stderr,"ERROR in rc_mat4_from_matrix, expected initialized 4x4 matrix\n");
+		return NULL;
+	}
+	return (rc_mat4_t*)A.d[0];
+}
+
+
+int rc_small_matrix_zeros(rc_small_matrix_t* A, int rows, int cols)
+{
+	int i;
+	if(unlikely(A==NULL)){
+		fprintf(stderr,"ERROR in rc_small_matrix_zeros, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(BAD_DIMS(rows,cols))){
+		fprintf(stderr,"ERROR in rc_small_matrix_zeros, rows and cols must be between 1 and %d\n", MAX_DIM);
+		return -1;
+	}
+	A->rows = rows;
+	A->cols = cols;
+	for(i=0;i<rows*cols;i++) A->d[i]=0.0;
+	return 0;
+}
+
+
+int rc_small_matrix_identity(rc_small_matrix_t* A, int dim)
+{
+	int i;
+	if(unlikely(rc_small_matrix_zeros(A,dim,dim))){
+		fprintf(stderr,"ERROR in rc_small_matrix_identity, failed to set up matrix\n");
+		return -1;
+	}
+	for(i=0;i<dim;i++) A->d[i*dim+i]=1.0;
+	return 0;
+}
+
+
+int rc_small_matrix_multiply(const rc_small_matrix_t* A, const rc_small_matrix_t* B, rc_small_matrix_t* C)
+{
+	int rows, cols;
+	if(unlikely(A==NULL || B==NULL || C==NULL)){
+		fprintf(stderr,"ERROR in rc_small_matrix_multiply, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(BAD_DIMS(A->rows,A->cols) || BAD_DIMS(B->rows,B->cols))){
+		fprintf(stderr,"ERROR in rc_small_matrix_multiply, rows and cols must be between 1 and %d\n", MAX_DIM);
+		return -1;
+	}
+	if(unlikely(A->cols!=B->rows)){
+		fprintf(stderr,"ERROR in rc_small_matrix_multiply, dimension mismatch\n");
+		return -1;
+	}
+	// save dimensions in case C is the same as A or B
+	rows = A->rows;
+	cols = B->cols;
+	__mult(A->d, B->d, C->d, rows, A->cols, cols);
+	C->rows = rows;
+	C->cols = cols;
+	return 0;
+}
+
+
+int rc_small_matrix_transpose(const rc_small_matrix_t* A, rc_small_matrix_t* T)
+{
+	int rows, cols;
+	if(unlikely(A==NULL || T==NULL)){
+		fprintf(stderr,"ERROR in rc_small_matrix_transpose, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(BAD_DIMS(A->rows,A->cols))){
+		fprintf(stderr,"ERROR in rc_small_matrix_transpose, rows and cols must be between 1 and %d\n", MAX_DIM);
+		return -1;
+	}
+	rows = A->rows;
+	cols = A->cols;
+	__transpose(A->d, T->d, rows, cols);
+	T->rows = cols;
+	T->cols = rows;
+	return 0;
+}
+
+
+int rc_small_matrix_invert(const rc_small_matrix_t* A, rc_small_matrix_t* Ainv)
+{
+	int n;
+	if(unlikely(A==NULL || Ainv==NULL)){
+		fprintf(stderr,"ERROR in rc_small_matrix_invert, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(BAD_DIMS(A->rows,A->cols))){
+		fprintf(stderr,"ERROR in rc_small_matrix_invert, rows and cols must be between 1 and %d\n", MAX_DIM);
+		return -1;
+	}
+	if(unlikely(A->rows!=A->cols)){
+		fprintf(stderr,"ERROR in rc_small_matrix_invert, nonsquare matrix\n");
+		return -1;
+	}
+	n = A->rows;
+	if(unlikely(__invert(A->d, Ainv->d, n))){
+		fprintf(stderr,"ERROR in rc_small_matrix_invert, matrix is singular\n");
+		return -1;
+	}
+	Ainv->rows = n;
+	Ainv->cols = n;
+	return 0;
+}
+
+
+int rc_small_matrix_cholesky(const rc_small_matrix_t* A, rc_small_matrix_t* L)
+{
+	int n;
+	if(unlikely(A==NULL || L==NULL)){
+		fprintf(stderr,"ERROR in rc_small_matrix_cholesky, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(BAD_DIMS(A->rows,A->cols))){
+		fprintf(stderr,"ERROR in rc_small_matrix_cholesky, rows and cols must be between 1 and %d\n", MAX_DIM);
+		return -1;
+	}
+	if(unlikely(A->rows!=A->cols)){
+		fprintf(stderr,"ERROR in rc_small_matrix_cholesky, nonsquare matrix\n");
+		return -1;
+	}
+	n = A->rows;
+	if(unlikely(__cholesky(A->d, L->d, n))){
+		fprintf(stderr,"ERROR in rc_small_matrix_cholesky, matrix not positive definite\n");
+		return -1;
+	}
+	L->rows = n;
+	L->cols = n;
+	return 0;
+}
+
+
+int rc_small_matrix_times_vec(const rc_small_matrix_t* A, const rc_small_vector_t* v, rc_small_vector_t* c)
+{
+	if(unlikely(A==NULL || v==NULL || c==NULL)){
+		fprintf(stderr,"ERROR in rc_small_matrix_times_vec, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(BAD_DIMS(A->rows,A->cols))){
+		fprintf(stderr,"ERROR in rc_small_matrix_times_vec, rows and cols must be between 1 and %d\n", MAX_DIM);
+		return -1;
+	}
+	if(unlikely(A->cols!=v->len)){
+		fprintf(stderr,"ERROR in rc_small_matrix_times_vec, dimension mismatch\n");
+		return -1;
+	}
+	__times_vec(A->d, v->d, c->d, A->rows, A->cols);
+	c->len = A->rows;
+	return 0;
+}
+
+
+int rc_small_matrix_as_matrix(rc_small_matrix_t* A, double* rows[], rc_matrix_t* view)
+{
+	if(unlikely(A==NULL || rows==NULL || view==NULL)){
+		fprintf(stderr,"ERROR in rc_small_matrix_as_matrix, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(BAD_DIMS(A->rows,A->cols))){
+		fprintf(stderr,"ERROR in rc_small_matrix_as_matrix, invalid dimensions\n");
+		return -1;
+	}
+	__fill_row_pointers(A->d, rows, A->rows, A->cols, view);
+	return 0;
+}
+
+
+int rc_small_matrix_from_matrix(rc_matrix_t A, rc_small_matrix_t* S)
+{
+	if(unlikely(S==NULL)){
+		fprintf(stderr,"ERROR in rc_small_matrix_from_matrix, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(A.initialized!=1)){
+		fprintf(stderr,"ERROR in rc_small_matrix_from_matrix, matrix not initialized\n");
+		return -1;
+	}
+	if(unlikely(A.rows>MAX_DIM || A.cols>MAX_DIM)){
+		fprintf(stderr,"ERROR in rc_small_matrix_from_matrix, matrix larger than %dx%d\n", MAX_DIM, MAX_DIM);
+		return -1;
+	}
+	// all matrix data is stored contiguously so one memcpy is sufficient
+	memcpy(S->d, A.d[0], A.rows*A.cols*sizeof(double));
+	S->rows = A.rows;
+	S->cols = A.cols;
+	return 0;
+}
+
+
+int rc_small_matrix_to_matrix(const rc_small_matrix_t* S, rc_matrix_t* A)
+{
+	if(unlikely(S==NULL || A==NULL)){
+		fprintf(stderr,"ERROR in rc_small_matrix_to_matrix, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(BAD_DIMS(S->rows,S->cols))){
+		fprintf(stderr,"ERROR in rc_small_matrix_to_matrix, rows and cols must be between 1 and %d\n", MAX_DIM);
+		return -1;
+	}
+	if(unlikely(rc_matrix_alloc(A,S->rows,S->cols))){
+		fprintf(stderr,"ERROR in rc_small_matrix_to_matrix, failed to allocate matrix\n");
+		return -1;
+	}
+	memcpy(A->d[0], S->d, S->rows*S->cols*sizeof(double));
+	return 0;
+}
@@ -46,6 +46,10 @@
 
 #define CHANNELS		4
 #define CHANNELS_POCKET		2
+#define ALL_MOTORS		((1<<channels)-1)	// bitmask of every motor
+
+// direction and standby pins are spread over at most 3 gpio chips
+#define PIN_CHIPS_MAX		3
 
 
 // polarity of the motor connections
@@ -61,6 +65,147 @@ static int pwmss[CHANNELS];
 static int pwmch[CHANNELS];
 static int channels = 0;
 
+// All motor pins on one gpio chip share one gpio group so they can be written
+// with a single ioctl. values holds the last state written to each line, each
+// pin is found by chip slot and line index.
+typedef struct pin_chip_t{
+	rc_gpio_group_t group;
+	int chip;
+	int lines;
+	int pins[RC_GPIO_GROUP_MAX];
+	int values[RC_GPIO_GROUP_MAX];
+} pin_chip_t;
+static pin_chip_t pin_chips[PIN_CHIPS_MAX];
+static int n_pin_chips = 0;
+static int dirA_slot[CHANNELS], dirA_line[CHANNELS];
+static int dirB_slot[CHANNELS], dirB_line[CHANNELS];
+static int stby_slot, stby_line;
+
+
+/**
+ * @brief      adds a pin to the line list for its chip
+ *
+ * @param[in]  chip  gpio chip
+ * @param[in]  pin   gpio pin
+ * @param[out] slot  index of the chip in pin_chips
+ * @param[out] line  index of the line in that chip's group
+ *
+ * @return     0 on success, -1 on failure
+ */
+static int __add_pin(int chip, int pin, int* slot, int* line)
+{
+	int i;
+	for(i=0;i<n_pin_chips;i++){
+		if(pin_chips[i].chip==chip) break;
+	}
+	if(i==n_pin_chips){
+		if(unlikely(n_pin_chips==PIN_CHIPS_MAX)) return -1;
+		pin_chips[i].group = rc_gpio_group_empty();
+		pin_chips[i].chip = chip;
+		pin_chips[i].lines = 0;
+		n_pin_chips++;
+	}
+	*slot = i;
+	*line = pin_chips[i].lines;
+	pin_chips[i].values[pin_chips[i].lines] = 0;
+	pin_chips[i].pins[pin_chips[i].lines++] = pin;
+	return 0;
+}
+
+
+static void __release_pins(void)
+{
+	int i;
+	for(i=0;i<n_pin_chips;i++) rc_gpio_group_cleanup(&pin_chips[i].group);
+	n_pin_chips = 0;
+	return;
+}
+
+
+/**
+ * @brief      Sets the direction pins of every motor in mask with one ioctl
+ * per gpio chip touched, then writes their PWM compares back to back.
+ *
+ * @param[in]  mask  bitmask of motors to update, bit 0 is motor 1
+ * @param[in]  a     direction A pin state for each motor
+ * @param[in]  b     direction B pin state for each motor
+ * @param[in]  duty  unsigned duty cycle for each motor
+ * @param[in]  func  caller name for error messages
+ *
+ * @return     0 on success, -1 on failure
+ */
+static int __write_motors(int mask, const int* a, const int* b, const double* duty, const char* func)
+{
+	int i, dirty = 0;
+
+	for(i=0;i<channels;i++){
+		if(!(mask&(1<<i))) continue;
+		pin_chips[dirA_slot[i]].values[dirA_line[i]] = a[i];
+		pin_chips[dirB_slot[i]].values[dirB_line[i]] = b[i];
+		dirty |= (1<<dirA_slot[i]) | (1<<dirB_slot[i]);
+	}
+	for(i=0;i<n_pin_chips;i++){
+		if(!(dirty&(1<<i))) continue;
+		if(unlikely(rc_gpio_group_set_values(&pin_chips[i].group, pin_chips[i].values))){
+			fprintf(stderr,"ERROR in %s, failed to write to direction pins on gpiochip%d\n", func, pin_chips[i].chip);
+			return -1;
+		}
+	}
+	for(i=0;i<channels;i++){
+		if(!(mask&(1<<i))) continue;
+		if(unlikely(rc_pwm_set_duty(pwmss[i], pwmch[i], duty[i]))){
+			fprintf(stderr,"ERROR in %s, failed to write to pwm %d%c\n", func, pwmss[i], pwmch[i]);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+
+/**
+ * @brief      writes the standby pin along with the cached state of the other
+ * pins on its chip
+ *
+ * @param[in]  val   0 for standby, 1 to run
+ *
+ * @return     0 on success, -1 on failure
+ */
+static int __set_standby_pin(int val)
+{
+	pin_chips[stby_slot].values[stby_line] = val;
+	return rc_gpio_group_set_values(&pin_chips[stby_slot].group, pin_chips[stby_slot].values);
+}
+
+
+/**
+ * @brief      Converts signed duty cycles to direction pin states and
+ * magnitudes then writes them for every motor in mask.
+ *
+ * @param[in]  mask  bitmask of motors to update, bit 0 is motor 1
+ * @param[in]  duty  signed duty cycle for each motor, clamped to +-1
+ * @param[in]  func  caller name for error messages
+ *
+ * @return     0 on success, -1 on failure
+ */
+static int __set_duties(int mask, const double* duty, const char* func)
+{
+	int i, a[CHANNELS], b[CHANNELS];
+	double d[CHANNELS];
+
+	for(i=0;i<channels;i++){
+		if(!(mask&(1<<i))) continue;
+		// check that the duty cycle is within +-1
+		d[i] = duty[i];
+		if	(d[i] > 1.0)	d[i] = 1.0;
+		else if	(d[i] <-1.0)	d[i] =-1.0;
+		// determine the direction pins to H-bridge
+		d[i] = d[i]*polarity[i];
+		if(d[i]>=0.0){	a[i]=1; b[i]=0;}
+		else{		a[i]=0; b[i]=1; d[i]=-d[i];}
+	}
+	return __write_motors(mask, a, b, d, func);
+}
+
 
 
 int rc_motor_init(void)
@@ -154,18 +299,24 @@ int rc_motor_init_freq(int pwm_frequency_hz)
 		return -1;
 	}
 
-	// set up gpio pins
-	if(unlikely(rc_gpio_init(MOT_STBY, GPIOHANDLE_REQUEST_OUTPUT))){
-		fprintf(stderr,"ERROR in rc_motor_init, failed to set up gpio %d,%d\n", MOT_STBY);
+	// set up gpio pins, one group per chip, all start low
+	__release_pins();
+	if(unlikely(__add_pin(MOT_STBY, &stby_slot, &stby_line))){
+		fprintf(stderr,"ERROR in rc_motor_init, too many gpio chips\n");
 		return -1;
 	}
 	for(i=0;i<channels;i++){
-		if(unlikely(rc_gpio_init(dirA_chip[i],dirA_pin[i], GPIOHANDLE_REQUEST_OUTPUT))){
-			fprintf(stderr,"ERROR in rc_motor_init, failed to set up gpio %d,%d\n", dirA_chip[i],dirA_pin[i]);
+		if(unlikely(__add_pin(dirA_chip[i], dirA_pin[i], &dirA_slot[i], &dirA_line[i]) ||
+			__add_pin(dirB_chip[i], dirB_pin[i], &dirB_slot[i], &dirB_line[i]))){
+			fprintf(stderr,"ERROR in rc_motor_init, too many gpio chips\n");
 			return -1;
 		}
-		if(unlikely(rc_gpio_init(dirB_chip[i],dirB_pin[i], GPIOHANDLE_REQUEST_OUTPUT))){
-			fprintf(stderr,"ERROR in rc_motor_init, failed to set up gpio %d,%d\n", dirB_chip[i],dirB_pin[i]);
+	}
+	for(i=0;i<n_pin_chips;i++){
+		if(unlikely(rc_gpio_group_init(&pin_chips[i].group, pin_chips[i].chip,
+				pin_chips[i].pins, pin_chips[i].lines, GPIOHANDLE_REQUEST_OUTPUT))){
+			fprintf(stderr,"ERROR in rc_motor_init, failed to set up gpio chip %d\n", pin_chips[i].chip);
+			__release_pins();
 			return -1;
 		}
 	}
@@ -180,7 +331,7 @@ int rc_motor_init_freq(int pwm_frequency_hz)
 	}
 
 	// make sure standby is off since most users won't use it
-	if(unlikely(rc_gpio_set_value(MOT_STBY,1))){
+	if(unlikely(__set_standby_pin(1))){
 		fprintf(stderr,"ERROR in rc_motor_init, can't write to gpio %d,%d\n",MOT_STBY);
 		return -1;
 	}
@@ -193,17 +344,13 @@ int rc_motor_init_freq(int pwm_frequency_hz)
 
 int rc_motor_cleanup(void)
 {
-	int i;
 	if(!init_flag) return 0;
 	rc_motor_free_spin(0);
 	rc_pwm_cleanup(0);
 	rc_pwm_cleanup(1);
 	rc_pwm_cleanup(2);
-	rc_gpio_cleanup(MOT_STBY);
-	for(i=0;i<channels;i++){
-		rc_gpio_cleanup(dirA_chip[i],dirA_pin[i]);
-		rc_gpio_cleanup(dirB_chip[i],dirB_pin[i]);
-	}
+	__release_pins();
+	init_flag = 0;
 	return 0;
 }
 
@@ -226,7 +373,7 @@ int rc_motor_standby(int standby_en)
 		if(!stby_state) return 0;
 		val=1;
 	}
-	if(unlikely(rc_gpio_set_value(MOT_STBY,val))){
+	if(unlikely(__set_standby_pin(val))){
 		fprintf(stderr,"ERROR in rc_motor_standby, unable to write to gpio %d,%d\n", MOT_STBY);
 		return -1;
 	}
@@ -237,7 +384,8 @@ int rc_motor_standby(int standby_en)
 
 int rc_motor_set(int motor, double duty)
 {
-	int a,b,i;
+	int i;
+	double d[CHANNELS];
 
 	// sanity checks
 	if(unlikely(motor<0 || motor>channels)){
@@ -249,42 +397,35 @@ int rc_motor_set(int motor, double duty)
 		return -1;
 	}
 
-	// check that the duty cycle is within +-1
-	if	(duty > 1.0)	duty = 1.0;
-	else if	(duty <-1.0)	duty =-1.0;
-
+	// case for all channels
 	if(motor==0){
-		for(i=1;i<=channels;i++){
-			if(rc_motor_set(i,duty)==-1) return -1;
-		}
-		return 0;
+		for(i=0;i<channels;i++) d[i]=duty;
+		return rc_motor_set_all(d);
 	}
+	d[motor-1] = duty;
+	return __set_duties(1<<(motor-1), d, "rc_motor_set");
+}
 
-	// determine the direction pins to H-bridge
-	duty=duty*polarity[motor-1];
-	if(duty>=0.0){	a=1; b=0;}
-	else{		a=0; b=1; duty=-duty;}
 
-	// set gpio and pwm for that motor
-	if(unlikely(rc_gpio_set_value(dirA_chip[motor-1],dirA_pin[motor-1], a))){
-		fprintf(stderr,"ERROR in rc_motor_set, failed to write to gpio pin %d,%d\n",dirA_chip[motor-1],dirA_pin[motor-1]);
-		return -1;
-	}
-	if(unlikely(rc_gpio_set_value(dirB_chip[motor-1],dirB_pin[motor-1], b))){
-		fprintf(stderr,"ERROR in rc_motor_set, failed to write to gpio pin %d,%d\n",dirB_chip[motor-1],dirB_pin[motor-1]);
+int rc_motor_set_all(const double duty[])
+{
+	// sanity checks
+	if(unlikely(init_flag==0)){
+		fprintf(stderr, "ERROR in rc_motor_set_all, call rc_motor_init first\n");
 		return -1;
 	}
-	if(unlikely(rc_pwm_set_duty(pwmss[motor-1], pwmch[motor-1], duty))){
-		fprintf(stderr,"ERROR in rc_motor_set, failed to write to pwm %d%c\n",pwmss[motor-1], pwmch[motor-1]);
+	if(unlikely(duty==NULL)){
+		fprintf(stderr, "ERROR in rc_motor_set_all, received NULL pointer\n");
 		return -1;
 	}
-	return 0;
+	return __set_duties(ALL_MOTORS, duty, "rc_motor_set_all");
 }
 
 
 int rc_motor_free_spin(int motor)
 {
-	int i;
+	int a[CHANNELS] = {0}, b[CHANNELS] = {0};
+	double d[CHANNELS] = {0.0};
 
 	// sanity checks
 	if(unlikely(motor<0 || motor>channels)){
@@ -296,34 +437,15 @@ int rc_motor_free_spin(int motor)
 		return -1;
 	}
 
-	// case for all channels
-	if(motor==0){
-		for(i=1;i<=channels;i++){
-			if(rc_motor_free_spin(i)==-1) return -1;
-		}
-		return 0;
-	}
-
-	// set gpio and pwm for that motor
-	if(unlikely(rc_gpio_set_value(dirA_chip[motor-1],dirA_pin[motor-1], 0))){
-		fprintf(stderr,"ERROR in rc_motor_free_spin, failed to write to gpio pin %d,%d\n",dirA_chip[motor-1],dirA_pin[motor-1]);
-		return -1;
-	}
-	if(unlikely(rc_gpio_set_value(dirB_chip[motor-1],dirB_pin[motor-1], 0))){
-		fprintf(stderr,"ERROR in rc_motor_free_spin, failed to write to gpio pin %d,%d\n",dirB_chip[motor-1],dirB_pin[motor-1]);
-		return -1;
-	}
-	if(unlikely(rc_pwm_set_duty(pwmss[motor-1], pwmch[motor-1], 0.0))){
-		fprintf(stderr,"ERROR in rc_motor_free_spin, failed to write to pwm %d%c\n",pwmss[motor-1], pwmch[motor-1]);
-		return -1;
-	}
-	return 0;
+	// both direction pins low and no pwm
+	return __write_motors(motor ? 1<<(motor-1) : ALL_MOTORS, a, b, d, "rc_motor_free_spin");
 }
 
 
 int rc_motor_brake(int motor)
 {
-	int i;
+	int a[CHANNELS] = {1,1,1,1}, b[CHANNELS] = {1,1,1,1};
+	double d[CHANNELS] = {0.0};
 
 	// sanity checks
 	if(unlikely(motor<0 || motor>channels)){
@@ -335,26 +457,6 @@ int rc_motor_brake(int motor)
 		return -1;
 	}
 
-	// case for all channels
-	if(motor==0){
-		for(i=1;i<=channels;i++){
-			if(rc_motor_brake(i)==-1) return -1;
-		}
-		return 0;
-	}
-
-	// set gpio and pwm for that motor
-	if(unlikely(rc_gpio_set_value(dirA_chip[motor-1],dirA_pin[motor-1], 1))){
-		fprintf(stderr,"ERROR in rc_motor_brake, failed to write to gpio pin %d,%d\n",dirA_chip[motor-1],dirA_pin[motor-1]);
-		return -1;
-	}
-	if(unlikely(rc_gpio_set_value(dirB_chip[motor-1],dirB_pin[motor-1], 1))){
-		fprintf(stderr,"ERROR in rc_motor_brake, failed to write to gpio pin %d,%d\n",dirB_chip[motor-1],dirB_pin[motor-1]);
-		return -1;
-	}
-	if(unlikely(rc_pwm_set_duty(pwmss[motor-1], pwmch[motor-1], 0.0))){
-		fprintf(stderr,"ERROR in rc_motor_brake, failed to write to pwm %d%c\n",pwmss[motor-1], pwmch[motor-1]);
-		return -1;
-	}
-	return 0;
+	// both direction pins high shorts the motor terminals together
+	return __write_motors(motor ? 1<<(motor-1) : ALL_MOTORS, a, b, d, "rc_motor_brake");
 }
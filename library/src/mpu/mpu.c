@@ -18,6 +18,9 @@
 #include <sys/stat.h>
 #include <stdint.h>
 #include <errno.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>	// for mkdir and chmod
 #include <sys/types.h>	// for mkdir and chmod
 
@@ -30,11 +33,13 @@
 #include <rc/time.h>
 #include <rc/gpio.h>
 #include <rc/i2c.h>
+#include <rc/spi.h>
 #include <rc/pthread.h>
 
 #include "mpu_defs.h"
 #include "dmp_firmware.h"
 #include "dmpKey.h"
+#include "../seqlock.h"
 #include "dmpmap.h"
 #include "../common.h"
 
@@ -64,6 +69,7 @@
 #define FIFO_LEN_QUAT_TAP 20 // 16 for quat, 4 for tap
 #define FIFO_LEN_QUAT_ACCEL_GYRO_TAP 32 // 16 quat, 6 accel, 6 gyro, 4 tap
 #define MAX_FIFO_BUFFER	(FIFO_LEN_QUAT_ACCEL_GYRO_TAP*5)
+#define MPU_FIFO_SIZE	512 // hardware fifo size in bytes
 
 
 // error threshold checks
@@ -86,10 +92,18 @@ static pthread_cond_t  tap_condition	= PTHREAD_COND_INITIALIZER;
 **/
 static rc_mpu_config_t config;
 static int bypass_en;
+static int mag_ext_sens_en = 0; // MPU's I2C master copies mag data to EXT_SENS_DATA
 static int dmp_en=0;
 static int packet_len;
 static pthread_t imu_interrupt_thread;
 static int thread_running_flag;
+static unsigned char burst_raw[MPU_FIFO_SIZE]; // backlog read by burst drain
+static int raw_fifo_en = 0;
+static void (*raw_fifo_callback_func)(const rc_mpu_raw_sample_t* samples, int n)=NULL;
+static _Atomic uint64_t raw_fifo_overflows = 0;
+static unsigned char raw_fifo_buf[RAW_FIFO_SIZE];
+static rc_mpu_raw_sample_t raw_fifo_samples[RAW_FIFO_SIZE/RAW_FIFO_PACKET_LEN];
+static int raw_fifo_decim = 1; // FIFO packets averaged into each sample
 static void (*dmp_callback_func)()=NULL;
 static void (*tap_callback_func)(int dir, int cnt)=NULL;
 static double mag_factory_adjust[3];
@@ -105,6 +119,33 @@ static rc_filter_t low_pass, high_pass; // for magnetometer Yaw filtering
 static int was_last_steady = 0;
 static double startMagYaw = 0.0;
 
+// lock-free sample ring, written only by the interrupt thread. Each slot is
+// guarded by its own seqlock so readers can detect it changing underneath them.
+typedef struct ring_slot_t{
+	_Atomic uint64_t lock;
+	rc_mpu_sample_t sample;
+} ring_slot_t;
+static ring_slot_t* ring = NULL;
+static uint64_t ring_mask;
+static _Atomic uint64_t ring_head = 0; // sequence number of newest sample
+
+// register access goes through one of these so the rest of the driver doesn't
+// care if the MPU is on I2C or SPI. Reads return the number of bytes read and
+// writes return 0, both return -1 on failure. The mag functions talk to the
+// AK8963 behind the MPU, through bypass on I2C or the I2C master on SPI.
+typedef struct mpu_transport_t{
+	int (*init)(void);
+	int (*lock)(void);
+	int (*unlock)(void);
+	int (*read_bytes)(uint8_t reg, size_t count, uint8_t* data);
+	int (*write_bytes)(uint8_t reg, size_t count, uint8_t* data);
+	int (*mag_read_bytes)(uint8_t reg, size_t count, uint8_t* data);
+	int (*mag_write_byte)(uint8_t reg, uint8_t data);
+} mpu_transport_t;
+static int spi_fd = -1;
+static pthread_mutex_t spi_mutex;
+static pthread_once_t spi_mutex_once = PTHREAD_ONCE_INIT;
+
 /**
 * functions for internal use only
 **/
@@ -148,8 +189,71 @@ static int __write_mag_cal_to_disk(double offsets[3], double scale[3]);
 static int __write_accel_cal_to_disk(double* center, double* lengths);
 static void* __dmp_interrupt_handler(void* ptr);
 static int __read_dmp_fifo(rc_mpu_data_t* data);
+static int __read_dmp_fifo_burst(unsigned char* raw);
+static int __decode_dmp_packet(unsigned char* raw, rc_mpu_data_t* data);
+static int __dispatch_dmp_burst(int packets, int quiet);
 static int __data_fusion(rc_mpu_data_t* data);
 static int __mag_correct_orientation(double mag_vec[3]);
+static int __mag_ext_sens_setup(void);
+static int __decode_mag(uint8_t* raw, rc_mpu_data_t* data);
+static int __ring_alloc(int len);
+static void __ring_free(void);
+static void __ring_publish(uint64_t timestamp_ns);
+static int __ring_copy(uint64_t n, rc_mpu_sample_t* sample);
+static int __raw_fifo_reset(void);
+static int __read_raw_fifo(void);
+static void* __raw_fifo_handler(void* ptr);
+static int __transport_select(void);
+static int __transport_init(void);
+static int __mpu_lock(void);
+static int __mpu_unlock(void);
+static int __mpu_read_bytes(uint8_t reg, size_t count, uint8_t* data);
+static int __mpu_read_byte(uint8_t reg, uint8_t* data);
+static int __mpu_read_word(uint8_t reg, uint16_t* data);
+static int __mpu_write_bytes(uint8_t reg, size_t count, uint8_t* data);
+static int __mpu_write_byte(uint8_t reg, uint8_t data);
+static int __mag_read_bytes(uint8_t reg, size_t count, uint8_t* data);
+static int __mag_write_byte(uint8_t reg, uint8_t data);
+static int __i2c_init(void);
+static int __i2c_lock(void);
+static int __i2c_unlock(void);
+static int __i2c_read_bytes(uint8_t reg, size_t count, uint8_t* data);
+static int __i2c_write_bytes(uint8_t reg, size_t count, uint8_t* data);
+static int __i2c_mag_read_bytes(uint8_t reg, size_t count, uint8_t* data);
+static int __i2c_mag_write_byte(uint8_t reg, uint8_t data);
+static void __spi_init_mutex(void);
+static int __spi_init(void);
+static int __spi_lock(void);
+static int __spi_unlock(void);
+static int __spi_xfer(uint8_t* buf, size_t len, uint32_t speed_hz);
+static int __spi_read_bytes(uint8_t reg, size_t count, uint8_t* data);
+static int __spi_write_bytes(uint8_t reg, size_t count, uint8_t* data);
+static int __slv4_transfer(uint8_t reg, uint8_t* data, int read);
+static int __spi_mag_read_bytes(uint8_t reg, size_t count, uint8_t* data);
+static int __spi_mag_write_byte(uint8_t reg, uint8_t data);
+
+static const mpu_transport_t i2c_transport = {
+	.init		= __i2c_init,
+	.lock		= __i2c_lock,
+	.unlock		= __i2c_unlock,
+	.read_bytes	= __i2c_read_bytes,
+	.write_bytes	= __i2c_write_bytes,
+	.mag_read_bytes	= __i2c_mag_read_bytes,
+	.mag_write_byte	= __i2c_mag_write_byte
+};
+
+static const mpu_transport_t spi_transport = {
+	.init		= __spi_init,
+	.lock		= __spi_lock,
+	.unlock		= __spi_unlock,
+	.read_bytes	= __spi_read_bytes,
+	.write_bytes	= __spi_write_bytes,
+	.mag_read_bytes	= __spi_mag_read_bytes,
+	.mag_write_byte	= __spi_mag_write_byte
+};
+
+// I2C until a config says otherwise
+static const mpu_transport_t* transport = &i2c_transport;
 
 
 rc_mpu_config_t rc_mpu_default_config(void)
@@ -162,6 +266,10 @@ rc_mpu_config_t rc_mpu_default_config(void)
 	conf.i2c_bus = RC_IMU_BUS;
 	conf.i2c_addr = RC_MPU_DEFAULT_I2C_ADDR;
 	conf.show_warnings = 0;
+	conf.transport = MPU_TRANSPORT_I2C;
+	conf.spi_bus = 1;
+	conf.spi_slave = 0;
+	conf.spi_speed_hz = MPU_SPI_MAX_SPEED;
 
 	// general stuff
 	conf.accel_fsr	= ACCEL_FSR_8G;
@@ -169,6 +277,7 @@ rc_mpu_config_t rc_mpu_default_config(void)
 	conf.accel_dlpf	= ACCEL_DLPF_184;
 	conf.gyro_dlpf	= GYRO_DLPF_184;
 	conf.enable_magnetometer = 0;
+	conf.mag_ext_sens_read = 0;
 
 	// DMP stuff
 	conf.dmp_sample_rate = 100;
@@ -181,6 +290,12 @@ rc_mpu_config_t rc_mpu_default_config(void)
 	conf.read_mag_after_callback = 1;
 	conf.mag_sample_rate_div = 4;
 	conf.tap_threshold=210;
+	conf.dmp_sample_ring_len = 0;
+	conf.dmp_fifo_burst_drain = 0;
+
+	// raw FIFO stuff
+	conf.raw_fifo_sample_rate = 1000;
+	conf.raw_fifo_batch_len = 10;
 
 	return conf;
 }
@@ -198,73 +313,68 @@ int rc_mpu_initialize(rc_mpu_data_t *data, rc_mpu_config_t conf)
 	// update local copy of config struct with new values
 	config=conf;
 
-	// make sure the bus is not currently in use by another thread
-	// do not proceed to prevent interfering with that process
-	if(rc_i2c_get_lock(config.i2c_bus)){
-		printf("i2c bus claimed by another process\n");
-		printf("Continuing with rc_mpu_initialize() anyway.\n");
-	}
+	// claim the bus for the whole setup sequence, this waits for any other
+	// thread using it to finish first
+	__transport_select();
+	__mpu_lock();
 
-	// if it is not claimed, start the i2c bus
-	if(rc_i2c_init(config.i2c_bus, config.i2c_addr)<0){
+	// start the i2c or spi bus
+	if(__transport_init()<0){
 		fprintf(stderr,"failed to initialize i2c bus\n");
+		__mpu_unlock();
 		return -1;
 	}
-	// claiming the bus does no guarantee other code will not interfere
-	// with this process, but best to claim it so other code can check
-	// like we did above
-	rc_i2c_lock_bus(config.i2c_bus);
 
 	// restart the device so we start with clean registers
 	if(__reset_mpu()<0){
 		fprintf(stderr,"ERROR: failed to reset_mpu9250\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 	if(__check_who_am_i()){
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 
 	// load in gyro calibration offsets from disk
 	if(__load_gyro_calibration()<0){
 		fprintf(stderr,"ERROR: failed to load gyro calibration offsets\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 	if(__load_accel_calibration()<0){
 		fprintf(stderr,"ERROR: failed to load accel calibration offsets\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 
 	// Set sample rate = 1000/(1 + SMPLRT_DIV)
 	// here we use a divider of 0 for 1khz sample
-	if(rc_i2c_write_byte(config.i2c_bus, SMPLRT_DIV, 0x00)){
+	if(__mpu_write_byte(SMPLRT_DIV, 0x00)){
 		fprintf(stderr,"I2C bus write error\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 
 	// set full scale ranges and filter constants
 	if(__set_gyro_fsr(conf.gyro_fsr, data)){
 		fprintf(stderr,"failed to set gyro fsr\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 	if(__set_accel_fsr(conf.accel_fsr, data)){
 		fprintf(stderr,"failed to set accel fsr\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 	if(__set_gyro_dlpf(conf.gyro_dlpf)){
 		fprintf(stderr,"failed to set gyro dlpf\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 	if(__set_accel_dlpf(conf.accel_dlpf)){
 		fprintf(stderr,"failed to set accel_dlpf\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 
@@ -273,14 +383,21 @@ int rc_mpu_initialize(rc_mpu_data_t *data, rc_mpu_config_t conf)
 		// start magnetometer NOT in cal mode (0)
 		if(__init_magnetometer(0)){
 			fprintf(stderr,"failed to initialize magnetometer\n");
-			rc_i2c_unlock_bus(config.i2c_bus);
+			__mpu_unlock();
+			return -1;
+		}
+		// optionally let the MPU fetch the magnetometer itself, over spi
+		// this was already done by __init_magnetometer
+		if(conf.mag_ext_sens_read && !mag_ext_sens_en && __mag_ext_sens_setup()){
+			fprintf(stderr,"failed to set up magnetometer external sensor read\n");
+			__mpu_unlock();
 			return -1;
 		}
 	}
 	else __power_off_magnetometer();
 
 	// all done!!
-	rc_i2c_unlock_bus(config.i2c_bus);
+	__mpu_unlock();
 	return 0;
 }
 
@@ -289,10 +406,8 @@ int rc_mpu_read_accel(rc_mpu_data_t *data)
 {
 	// new register data stored here
 	uint8_t raw[6];
-	// set the device address
-	rc_i2c_set_device_address(config.i2c_bus, config.i2c_addr);
 	// Read the six raw data registers into data array
-	if(rc_i2c_read_bytes(config.i2c_bus, ACCEL_XOUT_H, 6, &raw[0])<0){
+	if(__mpu_read_bytes(ACCEL_XOUT_H, 6, &raw[0])<0){
 		return -1;
 	}
 	// Turn the MSB and LSB into a signed 16-bit value
@@ -311,10 +426,8 @@ int rc_mpu_read_gyro(rc_mpu_data_t *data)
 {
 	// new register data stored here
 	uint8_t raw[6];
-	// set the device address
-	rc_i2c_set_device_address(config.i2c_bus, config.i2c_addr);
 	// Read the six raw data registers into data array
-	if(rc_i2c_read_bytes(config.i2c_bus, GYRO_XOUT_H, 6, &raw[0])<0){
+	if(__mpu_read_bytes(GYRO_XOUT_H, 6, &raw[0])<0){
 		return -1;
 	}
 	// Turn the MSB and LSB into a signed 16-bit value
@@ -331,25 +444,34 @@ int rc_mpu_read_gyro(rc_mpu_data_t *data)
 
 int rc_mpu_read_mag(rc_mpu_data_t* data)
 {
-	uint8_t raw[7];
-	int16_t adc[3];
-	double factory_cal_data[3];
+	uint8_t raw[MAG_EXT_SENS_LEN];
 	if(!config.enable_magnetometer){
 		fprintf(stderr,"ERROR: can't read magnetometer unless it is enabled in \n");
 		fprintf(stderr,"rc_mpu_config_t struct before calling rc_mpu_initialize\n");
 		return -1;
 	}
+	// the MPU's own I2C master has already copied ST1 through ST2 into its
+	// external sensor registers, read them all at once from the MPU itself
+	if(mag_ext_sens_en){
+		if(unlikely(__mpu_read_bytes(EXT_SENS_DATA_00, MAG_EXT_SENS_LEN, raw)<0)){
+			fprintf(stderr,"ERROR: rc_mpu_read_mag failed to read external sensor registers\n");
+			return -1;
+		}
+		if(!(raw[0]&MAG_DATA_READY)){
+			if(config.show_warnings){
+				printf("no new magnetometer data ready, skipping read\n");
+			}
+			return 0;
+		}
+		return __decode_mag(&raw[1], data);
+	}
 	// magnetometer is actually a separate device with its
 	// own address inside the mpu9250
-	// MPU9250 was put into passthrough mode
-	if(unlikely(rc_i2c_set_device_address(config.i2c_bus, AK8963_ADDR))){
-		fprintf(stderr,"ERROR: in rc_mpu_read_mag, failed to set i2c address\n");
-		return -1;
-	}
-	// don't worry about checking data ready bit, not worth thet time
+	// MPU9250 was put into passthrough mode. Address it per transfer so the
+	// bus stays pointed at the MPU and no address change ioctls are needed
 	// read the data ready bit to see if there is new data
 	uint8_t st1;
-	if(unlikely(rc_i2c_read_byte(config.i2c_bus, AK8963_ST1, &st1)<0)){
+	if(unlikely(__mag_read_bytes(AK8963_ST1, 1, &st1)<0)){
 		fprintf(stderr,"ERROR reading Magnetometer, i2c_bypass is probably not set\n");
 		return -1;
 	}
@@ -363,10 +485,23 @@ int rc_mpu_read_mag(rc_mpu_data_t* data)
 		return 0;
 	}
 	// Read the six raw data regs into data array
-	if(unlikely(rc_i2c_read_bytes(config.i2c_bus,AK8963_XOUT_L,7,&raw[0])<0)){
+	if(unlikely(__mag_read_bytes(AK8963_XOUT_L, 7, &raw[0])<0)){
 		fprintf(stderr,"ERROR: rc_mpu_read_mag failed to read data register\n");
 		return -1;
 	}
+	return __decode_mag(raw, data);
+}
+
+
+/**
+ * converts the 7 bytes from AK8963_XOUT_L through AK8963_ST2 to calibrated
+ * field strength in data->mag. Returns -1 and leaves data->mag alone if the
+ * reading saturated.
+ */
+int __decode_mag(uint8_t* raw, rc_mpu_data_t* data)
+{
+	int16_t adc[3];
+	double factory_cal_data[3];
 	// check if the readings saturated such as because
 	// of a local field source, discard data if so
 	if(raw[6]&MAGNETOMETER_SATURATION){
@@ -401,18 +536,50 @@ int rc_mpu_read_mag(rc_mpu_data_t* data)
 }
 
 
+int rc_mpu_read_all(rc_mpu_data_t* data)
+{
+	uint8_t raw[SENSOR_BURST_LEN+MAG_EXT_SENS_LEN];
+	size_t len = SENSOR_BURST_LEN;
+	// the external sensor registers directly follow GYRO_ZOUT_L so the
+	// magnetometer comes along in the same burst when the MPU fetches it
+	if(mag_ext_sens_en) len += MAG_EXT_SENS_LEN;
+	if(unlikely(__mpu_read_bytes(ACCEL_XOUT_H, len, raw)<0)){
+		fprintf(stderr,"ERROR: rc_mpu_read_all failed to read sensor registers\n");
+		return -1;
+	}
+	// Turn the MSB and LSB into a signed 16-bit value
+	data->raw_accel[0] = (int16_t)(((uint16_t)raw[0]<<8)|raw[1]);
+	data->raw_accel[1] = (int16_t)(((uint16_t)raw[2]<<8)|raw[3]);
+	data->raw_accel[2] = (int16_t)(((uint16_t)raw[4]<<8)|raw[5]);
+	data->raw_gyro[0] = (int16_t)(((uint16_t)raw[8]<<8)|raw[9]);
+	data->raw_gyro[1] = (int16_t)(((uint16_t)raw[10]<<8)|raw[11]);
+	data->raw_gyro[2] = (int16_t)(((uint16_t)raw[12]<<8)|raw[13]);
+	// Fill in real unit values and apply calibration
+	data->accel[0] = data->raw_accel[0] * data->accel_to_ms2 / accel_lengths[0];
+	data->accel[1] = data->raw_accel[1] * data->accel_to_ms2 / accel_lengths[1];
+	data->accel[2] = data->raw_accel[2] * data->accel_to_ms2 / accel_lengths[2];
+	data->gyro[0] = data->raw_gyro[0] * data->gyro_to_degs;
+	data->gyro[1] = data->raw_gyro[1] * data->gyro_to_degs;
+	data->gyro[2] = data->raw_gyro[2] * data->gyro_to_degs;
+	data->temp = 21.0 + (int16_t)(((uint16_t)raw[6]<<8)|raw[7])/TEMP_SENSITIVITY;
+	// keep the last magnetometer reading if there is no new one
+	if(mag_ext_sens_en && (raw[SENSOR_BURST_LEN]&MAG_DATA_READY)){
+		__decode_mag(&raw[SENSOR_BURST_LEN+1], data);
+	}
+	return 0;
+}
+
+
 int rc_mpu_read_temp(rc_mpu_data_t* data)
 {
 	uint16_t adc;
-	// set device address
-	rc_i2c_set_device_address(config.i2c_bus, config.i2c_addr);
 	// Read the two raw data registers
-	if(rc_i2c_read_word(config.i2c_bus, TEMP_OUT_H, &adc)<0){
+	if(__mpu_read_word(TEMP_OUT_H, &adc)<0){
 		fprintf(stderr,"failed to read IMU temperature registers\n");
 		return -1;
 	}
 	// convert to real units
-	data->temp = 21.0 + adc/TEMP_SENSITIVITY;
+	data->temp = 21.0 + (int16_t)adc/TEMP_SENSITIVITY;
 	return 0;
 }
 
@@ -421,16 +588,13 @@ int __reset_mpu(void)
 {
 	// disable the interrupt to prevent it from doing things while we reset
 	imu_shutdown_flag = 1;
-	// set the device address
-	if(rc_i2c_set_device_address(config.i2c_bus, config.i2c_addr)==-1){
-		fprintf(stderr,"ERROR resetting MPU, failed to set i2c device adddress\n");
-		return -1;
-	}
+	// a reset turns the I2C master off too
+	mag_ext_sens_en = 0;
 	// write the reset bit
-	if(rc_i2c_write_byte(config.i2c_bus, PWR_MGMT_1, H_RESET)==-1){
+	if(__mpu_write_byte(PWR_MGMT_1, H_RESET)==-1){
 		// wait and try again
 		rc_usleep(10000);
-		if(rc_i2c_write_byte(config.i2c_bus, PWR_MGMT_1, H_RESET)==-1){
+		if(__mpu_write_byte(PWR_MGMT_1, H_RESET)==-1){
 			fprintf(stderr,"ERROR resetting MPU, I2C write to reset bit failed\n");
 			return -1;
 		}
@@ -444,7 +608,7 @@ int __check_who_am_i(void)
 {
 	uint8_t c;
 	//check the who am i register to make sure the chip is alive
-	if(rc_i2c_read_byte(config.i2c_bus, WHO_AM_I_MPU9250, &c)<0){
+	if(__mpu_read_byte(WHO_AM_I_MPU9250, &c)<0){
 		fprintf(stderr,"i2c_read_byte failed reading who_am_i register\n");
 		return -1;
 	}
@@ -484,7 +648,7 @@ int __set_accel_fsr(rc_mpu_accel_fsr_t fsr, rc_mpu_data_t* data)
 		fprintf(stderr,"invalid accel fsr\n");
 		return -1;
 	}
-	return rc_i2c_write_byte(config.i2c_bus, ACCEL_CONFIG, c);
+	return __mpu_write_byte(ACCEL_CONFIG, c);
 }
 
 
@@ -513,7 +677,7 @@ int __set_gyro_fsr(rc_mpu_gyro_fsr_t fsr, rc_mpu_data_t* data)
 		fprintf(stderr,"invalid gyro fsr\n");
 		return -1;
 	}
-	return rc_i2c_write_byte(config.i2c_bus, GYRO_CONFIG, c);
+	return __mpu_write_byte(GYRO_CONFIG, c);
 }
 
 
@@ -549,7 +713,7 @@ int __set_accel_dlpf(rc_mpu_accel_dlpf_t dlpf)
 		fprintf(stderr,"invalid config.accel_dlpf\n");
 		return -1;
 	}
-	return rc_i2c_write_byte(config.i2c_bus, ACCEL_CONFIG_2, c);
+	return __mpu_write_byte(ACCEL_CONFIG_2, c);
 }
 
 
@@ -585,7 +749,7 @@ int __set_gyro_dlpf(rc_mpu_gyro_dlpf_t dlpf)
 		fprintf(stderr,"invalid gyro_dlpf\n");
 		return -1;
 	}
-	return rc_i2c_write_byte(config.i2c_bus, CONFIG, c);
+	return __mpu_write_byte(CONFIG, c);
 }
 
 
@@ -600,27 +764,21 @@ int __init_magnetometer(int cal_mode)
 	}
 	// magnetometer is actually a separate device with its
 	// own address inside the mpu9250
-	if(rc_i2c_set_device_address(config.i2c_bus, AK8963_ADDR)){
-		fprintf(stderr, "ERROR: in __init_magnetometer, failed to set i2c device address\n");
-		return -1;
-	}
 	// Power down magnetometer
-	if(rc_i2c_write_byte(config.i2c_bus, AK8963_CNTL, MAG_POWER_DN)<0){
+	if(__mag_write_byte(AK8963_CNTL, MAG_POWER_DN)<0){
 		fprintf(stderr, "ERROR: in __init_magnetometer, failed to write to AK8963_CNTL register to power down\n");
 		return -1;
 	}
 	rc_usleep(1000);
 	// Enter Fuse ROM access mode
-	if(rc_i2c_write_byte(config.i2c_bus, AK8963_CNTL, MAG_FUSE_ROM)){
+	if(__mag_write_byte(AK8963_CNTL, MAG_FUSE_ROM)){
 		fprintf(stderr, "ERROR: in __init_magnetometer, failed to write to AK8963_CNTL register\n");
 		return -1;
 	}
 	rc_usleep(1000);
 	// Read the xyz sensitivity adjustment values
-	if(rc_i2c_read_bytes(config.i2c_bus, AK8963_ASAX, 3, &raw[0])<0){
+	if(__mag_read_bytes(AK8963_ASAX, 3, &raw[0])<0){
 		fprintf(stderr,"failed to read magnetometer adjustment register\n");
-		rc_i2c_set_device_address(config.i2c_bus, config.i2c_addr);
-		//__mpu_set_bypass(0);
 		return -1;
 	}
 	// Return sensitivity adjustment values
@@ -628,7 +786,7 @@ int __init_magnetometer(int cal_mode)
 	mag_factory_adjust[1] = (raw[1]-128)/256.0 + 1.0;
 	mag_factory_adjust[2] = (raw[2]-128)/256.0 + 1.0;
 	// Power down magnetometer again
-	if(rc_i2c_write_byte(config.i2c_bus, AK8963_CNTL, MAG_POWER_DN)){
+	if(__mag_write_byte(AK8963_CNTL, MAG_POWER_DN)){
 		fprintf(stderr, "ERROR: in __init_magnetometer, failed to write to AK8963_CNTL register to power on\n");
 		return -1;
 	}
@@ -636,13 +794,16 @@ int __init_magnetometer(int cal_mode)
 	// Configure the magnetometer for 16 bit resolution
 	// and continuous sampling mode 2 (100hz)
 	uint8_t c = MSCALE_16|MAG_CONT_MES_2;
-	if(rc_i2c_write_byte(config.i2c_bus, AK8963_CNTL, c)){
+	if(__mag_write_byte(AK8963_CNTL, c)){
 		fprintf(stderr, "ERROR: in __init_magnetometer, failed to write to AK8963_CNTL register to set sampling mode\n");
 		return -1;
 	}
 	rc_usleep(100);
-	// go back to configuring the IMU, leave bypass on
-	rc_i2c_set_device_address(config.i2c_bus,config.i2c_addr);
+	// over SPI there is no bypass so the MPU's I2C master has to fetch the
+	// data, otherwise leave bypass on
+	if(config.transport==MPU_TRANSPORT_SPI && __mag_ext_sens_setup()){
+		return -1;
+	}
 	// load in magnetometer calibration
 	if(!cal_mode){
 		__load_mag_calibration();
@@ -651,9 +812,46 @@ int __init_magnetometer(int cal_mode)
 }
 
 
+/**
+ * Configures slave 0 of the MPU's I2C master to copy the AK8963 ST1 through
+ * ST2 registers into EXT_SENS_DATA_00 every sample, then turns bypass off so
+ * the master owns the auxiliary bus. Call after __init_magnetometer.
+ */
+int __mag_ext_sens_setup(void)
+{
+	// 400khz master clock, hold data ready until external data is loaded
+	if(__mpu_write_byte(I2C_MST_CTRL, WAIT_FOR_ES|I2C_MST_CLK_400KHZ)){
+		fprintf(stderr,"ERROR: in __mag_ext_sens_setup, failed to write I2C_MST_CTRL\n");
+		return -1;
+	}
+	if(__mpu_write_byte(I2C_SLV0_ADDR, BIT_I2C_READ|AK8963_ADDR)){
+		fprintf(stderr,"ERROR: in __mag_ext_sens_setup, failed to write I2C_SLV0_ADDR\n");
+		return -1;
+	}
+	if(__mpu_write_byte(I2C_SLV0_REG, AK8963_ST1)){
+		fprintf(stderr,"ERROR: in __mag_ext_sens_setup, failed to write I2C_SLV0_REG\n");
+		return -1;
+	}
+	if(__mpu_write_byte(I2C_SLV0_CTRL, BIT_SLAVE_EN|MAG_EXT_SENS_LEN)){
+		fprintf(stderr,"ERROR: in __mag_ext_sens_setup, failed to write I2C_SLV0_CTRL\n");
+		return -1;
+	}
+	// turning bypass off enables the I2C master
+	if(__mpu_set_bypass(0)){
+		fprintf(stderr,"ERROR: in __mag_ext_sens_setup, failed to disable bypass\n");
+		return -1;
+	}
+	mag_ext_sens_en = 1;
+	// give the master time to complete the first read
+	rc_usleep(10000);
+	return 0;
+}
+
+
 int __power_off_magnetometer(void)
 {
-	rc_i2c_set_device_address(config.i2c_bus, config.i2c_addr);
+	// bypass is turned back on below which stops the I2C master
+	mag_ext_sens_en = 0;
 	// Enable i2c bypass to allow talking to magnetometer
 	if(__mpu_set_bypass(1)){
 		fprintf(stderr,"failed to set mpu9250 into bypass i2c mode\n");
@@ -661,13 +859,11 @@ int __power_off_magnetometer(void)
 	}
 	// magnetometer is actually a separate device with its
 	// own address inside the mpu9250
-	rc_i2c_set_device_address(config.i2c_bus, AK8963_ADDR);
 	// Power down magnetometer
-	if(rc_i2c_write_byte(config.i2c_bus, AK8963_CNTL, MAG_POWER_DN)<0){
+	if(__mag_write_byte(AK8963_CNTL, MAG_POWER_DN)<0){
 		fprintf(stderr,"failed to write to magnetometer\n");
 		return -1;
 	}
-	rc_i2c_set_device_address(config.i2c_bus, config.i2c_addr);
 	return 0;
 }
 
@@ -682,40 +878,47 @@ int rc_mpu_power_off(void)
 		if(rc_pthread_timed_join(imu_interrupt_thread, NULL, 1.0)==1){
 			fprintf(stderr,"WARNING: mpu interrupt thread exit timeout\n");
 		}
+		// safe to free now the only writer is gone
+		else __ring_free();
 		// cleanup mutexes
 		pthread_cond_destroy(&read_condition);
 		pthread_mutex_destroy(&read_mutex);
 		pthread_cond_destroy(&tap_condition);
 		pthread_mutex_destroy(&tap_mutex);
 	}
+	else __ring_free();
+	// hold the bus for the whole shutdown sequence
+	__mpu_lock();
 	// shutdown magnetometer first if on since that requires
 	// the imu to the on for bypass to work
 	if(config.enable_magnetometer) __power_off_magnetometer();
-	// set the device address to write the shutdown register
-	rc_i2c_set_device_address(config.i2c_bus, config.i2c_addr);
 	// write the reset bit
-	if(rc_i2c_write_byte(config.i2c_bus, PWR_MGMT_1, H_RESET)){
+	if(__mpu_write_byte(PWR_MGMT_1, H_RESET)){
 		//wait and try again
 		rc_usleep(1000);
-		if(rc_i2c_write_byte(config.i2c_bus, PWR_MGMT_1, H_RESET)){
+		if(__mpu_write_byte(PWR_MGMT_1, H_RESET)){
 			fprintf(stderr,"I2C write to MPU9250 Failed\n");
+			__mpu_unlock();
 			return -1;
 		}
 	}
 	// write the sleep bit
-	if(rc_i2c_write_byte(config.i2c_bus, PWR_MGMT_1, MPU_SLEEP)){
+	if(__mpu_write_byte(PWR_MGMT_1, MPU_SLEEP)){
 		//wait and try again
 		rc_usleep(1000);
-		if(rc_i2c_write_byte(config.i2c_bus, PWR_MGMT_1, MPU_SLEEP)){
+		if(__mpu_write_byte(PWR_MGMT_1, MPU_SLEEP)){
 			fprintf(stderr,"I2C write to MPU9250 Failed\n");
+			__mpu_unlock();
 			return -1;
 		}
 	}
+	__mpu_unlock();
 
-	// if in dmp mode, also unexport the interrupt pin
-	if(dmp_en){
+	// if in dmp or raw fifo mode, also unexport the interrupt pin
+	if(dmp_en || raw_fifo_en){
 		rc_gpio_cleanup(config.gpio_interrupt_pin_chip ,config.gpio_interrupt_pin);
 	}
+	raw_fifo_en = 0;
 
 	return 0;
 }
@@ -770,49 +973,52 @@ int rc_mpu_initialize_dmp(rc_mpu_data_t *data, rc_mpu_config_t conf)
 		config.accel_fsr = ACCEL_FSR_8G;
 	}
 
-	// start the i2c bus
-	if(rc_i2c_init(config.i2c_bus, config.i2c_addr)){
-		fprintf(stderr,"rc_mpu_initialize_dmp failed at rc_i2c_init\n");
+	// claim the bus for the whole setup sequence, this waits for any other
+	// thread using it to finish first
+	__transport_select();
+	__mpu_lock();
+
+	// start the i2c or spi bus
+	if(__transport_init()){
+		fprintf(stderr,"rc_mpu_initialize_dmp failed to initialize bus\n");
+		__mpu_unlock();
 		return -1;
 	}
 	// configure the gpio interrupt pin
 	if(rc_gpio_init_event(config.gpio_interrupt_pin_chip, config.gpio_interrupt_pin, 0, GPIOEVENT_REQUEST_FALLING_EDGE)==-1){
 		fprintf(stderr,"ERROR: in rc_mpu_initialize_dmp, failed to initialize GPIO\n");
 		fprintf(stderr,"probably insufficient privileges\n");
+		__mpu_unlock();
 		return -1;
 	}
-
-	// claiming the bus does no guarantee other code will not interfere
-	// with this process, but best to claim it so other code can check
-	rc_i2c_lock_bus(config.i2c_bus);
 	// restart the device so we start with clean registers
 	if(__reset_mpu()<0){
 		fprintf(stderr,"failed to __reset_mpu()\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 	if(__check_who_am_i()){
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 	// MPU6500 shares 4kB of memory between the DMP and the FIFO. Since the
 	//first 3kB are needed by the DMP, we'll use the last 1kB for the FIFO.
 	// this is also set in set_accel_dlpf but we set here early on
 	tmp = BIT_FIFO_SIZE_1024 | 0x8;
-	if(rc_i2c_write_byte(config.i2c_bus, ACCEL_CONFIG_2, tmp)){
+	if(__mpu_write_byte(ACCEL_CONFIG_2, tmp)){
 		fprintf(stderr,"ERROR: in rc_mpu_initialize_dmp, failed to write to ACCEL_CONFIG_2 register\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 	// load in calibration offsets from disk
 	if(__load_gyro_calibration()<0){
 		fprintf(stderr,"ERROR: failed to load gyro calibration offsets\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 	if(__load_accel_calibration()<0){
 		fprintf(stderr,"ERROR: failed to load accel calibration offsets\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 
@@ -821,24 +1027,24 @@ int rc_mpu_initialize_dmp(rc_mpu_data_t *data, rc_mpu_config_t conf)
 	// example
 	if(__set_gyro_fsr(config.gyro_fsr, data_ptr)==-1){
 		fprintf(stderr, "ERROR in rc_mpu_initialize_dmp, failed to set gyro_fsr register\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 	if(__set_accel_fsr(config.accel_fsr, data_ptr)==-1){
 		fprintf(stderr, "ERROR in rc_mpu_initialize_dmp, failed to set accel_fsr register\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 
 	// set dlpf, these values already checked for bounds above
 	if(__set_gyro_dlpf(conf.gyro_dlpf)){
 		fprintf(stderr,"failed to set gyro dlpf\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 	if(__set_accel_dlpf(conf.accel_dlpf)){
 		fprintf(stderr,"failed to set accel_dlpf\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 
@@ -847,14 +1053,14 @@ int rc_mpu_initialize_dmp(rc_mpu_data_t *data, rc_mpu_config_t conf)
 	if(__mpu_set_sample_rate(200)<0){
 	//if(__mpu_set_sample_rate(config.dmp_sample_rate)<0){
 		fprintf(stderr,"ERROR: setting IMU sample rate\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 
 	// enable bypass, more importantly this also configures the interrupt pin behavior
 	if(__mpu_set_bypass(1)){
 		fprintf(stderr, "failed to run __mpu_set_bypass\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 
@@ -862,12 +1068,12 @@ int rc_mpu_initialize_dmp(rc_mpu_data_t *data, rc_mpu_config_t conf)
 	if(conf.enable_magnetometer){
 		if(__init_magnetometer(0)){
 			fprintf(stderr,"ERROR: failed to initialize_magnetometer\n");
-			rc_i2c_unlock_bus(config.i2c_bus);
+			__mpu_unlock();
 			return -1;
 		}
 		if(rc_mpu_read_mag(data)==-1){
 			fprintf(stderr,"ERROR: failed to initialize_magnetometer\n");
-			rc_i2c_unlock_bus(config.i2c_bus);
+			__mpu_unlock();
 			return -1;
 		}
 		// collect some mag data to get a starting heading
@@ -877,7 +1083,10 @@ int rc_mpu_initialize_dmp(rc_mpu_data_t *data, rc_mpu_config_t conf)
 		for(i=0;i<20;i++){
 			rc_mpu_read_mag(data);
 			// correct for orientation and put data into mag_vec
-			if(__mag_correct_orientation(mag_vec)) return -1;
+			if(__mag_correct_orientation(mag_vec)){
+				__mpu_unlock();
+				return -1;
+			}
 			x_sum += mag_vec[0];
 			y_sum += mag_vec[1];
 			rc_usleep(10000);
@@ -898,14 +1107,14 @@ int rc_mpu_initialize_dmp(rc_mpu_data_t *data, rc_mpu_config_t conf)
 	dmp_en = 1; // log locally that the dmp will be running
 	if(__dmp_load_motion_driver_firmware()<0){
 		fprintf(stderr,"failed to load DMP motion driver\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 
 	// set the orientation of dmp quaternion
 	if(__dmp_set_orientation((unsigned short)conf.orient)<0){
 		fprintf(stderr,"ERROR: failed to set dmp orientation\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 
@@ -924,7 +1133,7 @@ int rc_mpu_initialize_dmp(rc_mpu_data_t *data, rc_mpu_config_t conf)
 	}
 	if(__dmp_enable_feature(feature_mask)<0){
 		fprintf(stderr,"ERROR: failed to enable DMP features\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 
@@ -932,28 +1141,32 @@ int rc_mpu_initialize_dmp(rc_mpu_data_t *data, rc_mpu_config_t conf)
 	// fixing at 200 causes gyro scaling issues at lower mpu sample rates
 	if(__dmp_set_fifo_rate(config.dmp_sample_rate)<0){
 		fprintf(stderr,"ERROR: failed to set DMP fifo rate\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 
 	// turn the dmp on
 	if(__mpu_set_dmp_state(1)<0) {
 		fprintf(stderr,"ERROR: __mpu_set_dmp_state(1) failed\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 
 	// set interrupt mode to continuous as opposed to GESTURE
 	if(__dmp_set_interrupt_mode(DMP_INT_CONTINUOUS)<0){
 		fprintf(stderr,"ERROR: failed to set DMP interrupt mode to continuous\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 
 	// done writing to bus for now
-	rc_i2c_unlock_bus(config.i2c_bus);
+	__mpu_unlock();
 
 	// get ready to start the interrupt handler thread
+	if(__ring_alloc(config.dmp_sample_ring_len)){
+		fprintf(stderr,"ERROR in rc_mpu_initialize_dmp, failed to allocate sample ring\n");
+		return -1;
+	}
 	data_ptr->tap_detected=0;
 	imu_shutdown_flag = 0;
 	dmp_callback_func=NULL;
@@ -996,9 +1209,9 @@ int __mpu_write_mem(unsigned short mem_addr, unsigned short length, unsigned cha
 		fprintf(stderr,"mpu_write_mem exceeds bank size\n");
 		return -1;
 	}
-	if (rc_i2c_write_bytes(config.i2c_bus,MPU6500_BANK_SEL, 2, tmp))
+	if (__mpu_write_bytes(MPU6500_BANK_SEL, 2, tmp))
 		return -1;
-	if (rc_i2c_write_bytes(config.i2c_bus,MPU6500_MEM_R_W, length, data))
+	if (__mpu_write_bytes(MPU6500_MEM_R_W, length, data))
 		return -1;
 	return 0;
 }
@@ -1026,9 +1239,9 @@ int __mpu_read_mem(unsigned short mem_addr, unsigned short length, unsigned char
 		printf("mpu_read_mem exceeds bank size\n");
 		return -1;
 	}
-	if (rc_i2c_write_bytes(config.i2c_bus,MPU6500_BANK_SEL, 2, tmp))
+	if (__mpu_write_bytes(MPU6500_BANK_SEL, 2, tmp))
 		return -1;
-	if (rc_i2c_read_bytes(config.i2c_bus,MPU6500_MEM_R_W, length, data)!=length)
+	if (__mpu_read_bytes(MPU6500_MEM_R_W, length, data)!=length)
 		return -1;
 	return 0;
 }
@@ -1044,8 +1257,6 @@ int __dmp_load_motion_driver_firmware(void)
 	unsigned short this_write;
 	// Must divide evenly into st.hw->bank_size to avoid bank crossings.
 	unsigned char cur[DMP_LOAD_CHUNK], tmp[2];
-	// make sure the address is set correctly
-	rc_i2c_set_device_address(config.i2c_bus, config.i2c_addr);
 	// loop through 16 bytes at a time and check each write for corruption
 	for (ii=0; ii<DMP_CODE_SIZE; ii+=this_write) {
 		this_write = min(DMP_LOAD_CHUNK, DMP_CODE_SIZE - ii);
@@ -1065,7 +1276,7 @@ int __dmp_load_motion_driver_firmware(void)
 	// Set program start address.
 	tmp[0] = dmp_start_addr >> 8;
 	tmp[1] = dmp_start_addr & 0xFF;
-	if (rc_i2c_write_bytes(config.i2c_bus, MPU6500_PRGM_START_H, 2, tmp)){
+	if (__mpu_write_bytes(MPU6500_PRGM_START_H, 2, tmp)){
 		fprintf(stderr,"ERROR writing to MPU6500_PRGM_START register\n");
 		return -1;
 	}
@@ -1165,23 +1376,38 @@ int __dmp_set_fifo_rate(unsigned short rate)
 * i2c bypass mode for talking to the magnetometer. In random read mode this
 * is used to turn on the bypass and left as is. In DMP mode bypass is turned
 * off after configuration and the MPU fetches magnetometer data automatically.
+* Over SPI the auxiliary bus can't be bypassed so the I2C master is always left
+* on and clocked at 400khz instead.
 * USER_CTRL - based on global variable dsp_en
 * INT_PIN_CFG based on requested bypass state
 **/
 int __mpu_set_bypass(uint8_t bypass_on)
 {
 	uint8_t tmp = 0;
-	rc_i2c_set_device_address(config.i2c_bus, config.i2c_addr);
+	if(config.transport==MPU_TRANSPORT_SPI){
+		bypass_on = 0;
+		// only touch the clock, __mag_ext_sens_setup may have set WAIT_FOR_ES
+		if(__mpu_read_byte(I2C_MST_CTRL, &tmp)<0){
+			fprintf(stderr,"ERROR in mpu_set_bypass, failed to read I2C_MST_CTRL register\n");
+			return -1;
+		}
+		tmp = (tmp & ~I2C_MST_CLK_MASK) | I2C_MST_CLK_400KHZ;
+		if(__mpu_write_byte(I2C_MST_CTRL, tmp)){
+			fprintf(stderr,"ERROR in mpu_set_bypass, failed to write I2C_MST_CTRL register\n");
+			return -1;
+		}
+		tmp = 0;
+	}
 	// set up USER_CTRL first
 	// DONT USE FIFO_EN_BIT in DMP mode, or the MPU will generate lots of
 	// unwanted interruptss
-	if(dmp_en){
-		tmp |= FIFO_EN_BIT; // enable fifo for dsp mode
+	if(dmp_en || raw_fifo_en){
+		tmp |= FIFO_EN_BIT; // enable fifo for dsp and raw fifo mode
 	}
 	if(!bypass_on){
 		tmp |= I2C_MST_EN; // i2c master mode when not in bypass
 	}
-	if (rc_i2c_write_byte(config.i2c_bus, USER_CTRL, tmp)){
+	if (__mpu_write_byte(USER_CTRL, tmp)){
 		fprintf(stderr,"ERROR in mpu_set_bypass, failed to write USER_CTRL register\n");
 		return -1;
 	}
@@ -1191,7 +1417,7 @@ int __mpu_set_bypass(uint8_t bypass_on)
 	//tmp =  ACTL_ACTIVE_LOW;	// non-latching
 	if(bypass_on)
 		tmp |= BYPASS_EN;
-	if (rc_i2c_write_byte(config.i2c_bus, INT_PIN_CFG, tmp)){
+	if (__mpu_write_byte(INT_PIN_CFG, tmp)){
 		fprintf(stderr,"ERROR in mpu_set_bypass, failed to write INT_PIN_CFG register\n");
 		return -1;
 	}
@@ -1279,18 +1505,15 @@ int __dmp_enable_lp_quat(unsigned char enable)
 int __mpu_reset_fifo(void)
 {
 	uint8_t data;
-	// make sure the i2c address is set correctly.
-	// this shouldn't take any time at all if already set
-	rc_i2c_set_device_address(config.i2c_bus, config.i2c_addr);
 	// turn off interrupts, fifo, and usr_ctrl which is where the dmp fifo is enabled
 	data = 0;
-	if (rc_i2c_write_byte(config.i2c_bus, INT_ENABLE, data)) return -1;
-	if (rc_i2c_write_byte(config.i2c_bus, FIFO_EN, data)) return -1;
-	if (rc_i2c_write_byte(config.i2c_bus, USER_CTRL, data)) return -1;
+	if (__mpu_write_byte(INT_ENABLE, data)) return -1;
+	if (__mpu_write_byte(FIFO_EN, data)) return -1;
+	if (__mpu_write_byte(USER_CTRL, data)) return -1;
 
 	// reset fifo and wait
 	data = BIT_FIFO_RST | BIT_DMP_RST;
-	if (rc_i2c_write_byte(config.i2c_bus, USER_CTRL, data)) return -1;
+	if (__mpu_write_byte(USER_CTRL, data)) return -1;
 	//rc_usleep(1000); // how I had it
 	rc_usleep(50000); // invensense standard
 
@@ -1298,15 +1521,15 @@ int __mpu_reset_fifo(void)
 	// enabling DMP but NOT BIT_FIFO_EN gives quat out of bounds
 	// but also no empty interrupts
 	data = BIT_DMP_EN | BIT_FIFO_EN;
-	if(rc_i2c_write_byte(config.i2c_bus, USER_CTRL, data)){
+	if(__mpu_write_byte(USER_CTRL, data)){
 		return -1;
 	}
 
 	// turn on dmp interrupt enable bit again
 	data = BIT_DMP_INT_EN;
-	if (rc_i2c_write_byte(config.i2c_bus, INT_ENABLE, data)) return -1;
+	if (__mpu_write_byte(INT_ENABLE, data)) return -1;
 	data = 0;
-	if (rc_i2c_write_byte(config.i2c_bus, FIFO_EN, data)) return -1;
+	if (__mpu_write_byte(FIFO_EN, data)) return -1;
 
 	return 0;
 }
@@ -1681,12 +1904,12 @@ int __set_int_enable(unsigned char enable)
 	else{
 		tmp = 0x00;
 	}
-	if(rc_i2c_write_byte(config.i2c_bus, INT_ENABLE, tmp)){
+	if(__mpu_write_byte(INT_ENABLE, tmp)){
 		fprintf(stderr, "ERROR: in set_int_enable, failed to write INT_ENABLE register\n");
 		return -1;
 	}
 	// disable all other FIFO features leaving just DMP
-	if (rc_i2c_write_byte(config.i2c_bus, FIFO_EN, 0)){
+	if (__mpu_write_byte(FIFO_EN, 0)){
 		fprintf(stderr, "ERROR: in set_int_enable, failed to write FIFO_EN register\n");
 		return -1;
 	}
@@ -1711,7 +1934,7 @@ int __mpu_set_sample_rate(int rate)
 	#ifdef DEBUG
 	printf("setting divider to %d\n", div);
 	#endif
-	if(rc_i2c_write_byte(config.i2c_bus, SMPLRT_DIV, div)){
+	if(__mpu_write_byte(SMPLRT_DIV, div)){
 		fprintf(stderr,"ERROR: in mpu_set_sample_rate, failed to write SMPLRT_DIV register\n");
 		return -1;
 	}
@@ -1735,7 +1958,7 @@ int __mpu_set_dmp_state(unsigned char enable)
 		// make sure bypass mode is enabled
 		__mpu_set_bypass(1);
 		// Remove FIFO elements.
-		rc_i2c_write_byte(config.i2c_bus, FIFO_EN , 0);
+		__mpu_write_byte(FIFO_EN , 0);
 		// Enable DMP interrupt.
 		__set_int_enable(1);
 		__mpu_reset_fifo();
@@ -1744,7 +1967,7 @@ int __mpu_set_dmp_state(unsigned char enable)
 		// Disable DMP interrupt.
 		__set_int_enable(0);
 		// Restore FIFO settings.
-		rc_i2c_write_byte(config.i2c_bus, FIFO_EN , 0);
+		__mpu_write_byte(FIFO_EN , 0);
 		__mpu_reset_fifo();
 	}
 	return 0;
@@ -1768,6 +1991,7 @@ void* __dmp_interrupt_handler(__attribute__ ((unused)) void* ptr)
 	int mag_div_step = config.mag_sample_rate_div;
 	//char buf[64];
 	int first_run = 1;
+	int burst_packets = 0;
 	__mpu_reset_fifo();
 
 	while(!imu_shutdown_flag){
@@ -1789,23 +2013,22 @@ void* __dmp_interrupt_handler(__attribute__ ((unused)) void* ptr)
 			continue;
 		}
 
-		// try to load fifo no matter the claim bus state
-		if(rc_i2c_get_lock(config.i2c_bus)){
-			fprintf(stderr,"WARNING: Something has claimed the I2C bus when an\n");
-			fprintf(stderr,"IMU interrupt was received. Reading IMU anyway.\n");
-		}
-		// aquires bus
-		rc_i2c_lock_bus(config.i2c_bus);
+		// aquires bus, if another thread has it this thread runs at the
+		// higher priority so it's next in line and the holder gets boosted
+		__mpu_lock();
 		// aquires mutex
 		pthread_mutex_lock( &read_mutex );
 		pthread_mutex_lock( &tap_mutex );
-		// read data
-		ret = __read_dmp_fifo(data_ptr);
-		rc_i2c_unlock_bus(config.i2c_bus);
+		// read data, burst mode only reads here and decodes further down
+		if(config.dmp_fifo_burst_drain){
+			burst_packets = __read_dmp_fifo_burst(burst_raw);
+			ret = (burst_packets>0) ? 0 : -1;
+		}
+		else ret = __read_dmp_fifo(data_ptr);
 		// record if it was successful or not
 		if(ret==0){
 			last_read_successful=1;
-			if(data_ptr->tap_detected){
+			if(!config.dmp_fifo_burst_drain && data_ptr->tap_detected){
 				last_tap_timestamp_nanos = last_interrupt_timestamp_nanos;
 			}
 		}
@@ -1819,19 +2042,30 @@ void* __dmp_interrupt_handler(__attribute__ ((unused)) void* ptr)
 				printf("reading mag before callback\n");
 				#endif
 				rc_mpu_read_mag(data_ptr);
-				// reset address back for next read
-				rc_i2c_set_device_address(config.i2c_bus,config.i2c_addr);
 				mag_div_step=1;
 			}
 			else mag_div_step++;
 		}
-		// releases bus
-		rc_i2c_unlock_bus(config.i2c_bus);
+		// releases bus, held through the mag read so nothing gets in between
+		__mpu_unlock();
+		// in burst mode decode and hand out every packet in order, data
+		// from the first run only primes the data struct like below
+		if(config.dmp_fifo_burst_drain && last_read_successful){
+			if(__dispatch_dmp_burst(burst_packets, first_run)){
+				last_read_successful=0;
+				__mpu_lock();
+				__mpu_reset_fifo();
+				__mpu_unlock();
+			}
+			first_run = 0;
+		}
 		// call the user function if not the first run
-		if(first_run == 1){
+		else if(first_run == 1){
 			first_run = 0;
 		}
 		else if(last_read_successful){
+			// publish to the ring first so the callback can read it too
+			if(ring!=NULL) __ring_publish(last_interrupt_timestamp_nanos);
 			if(dmp_callback_func!=NULL) dmp_callback_func();
 			// signals that a measurement is available to blocking function
 			pthread_cond_broadcast(&read_condition);
@@ -1852,11 +2086,9 @@ void* __dmp_interrupt_handler(__attribute__ ((unused)) void* ptr)
 				#ifdef DEBUG
 				printf("reading mag after ISR\n");
 				#endif
-				rc_i2c_lock_bus(config.i2c_bus);
+				__mpu_lock();
 				rc_mpu_read_mag(data_ptr);
-				rc_i2c_unlock_bus(config.i2c_bus);
-				// reset address back for next read
-				rc_i2c_set_device_address(config.i2c_bus,config.i2c_addr);
+				__mpu_unlock();
 				mag_div_step=1;
 			}
 			else mag_div_step++;
@@ -1874,6 +2106,47 @@ void* __dmp_interrupt_handler(__attribute__ ((unused)) void* ptr)
 	return 0;
 }
 
+/**
+ * Decodes the packets read by __read_dmp_fifo_burst one at a time into the
+ * user's data struct and after each one publishes it to the sample ring and
+ * calls the callbacks, exactly like a single packet read. The newest packet
+ * triggered the interrupt so older ones are timestamped backwards from it at
+ * the DMP sample period. Called with read_mutex and tap_mutex held but not the
+ * I2C bus so callbacks are free to use it.
+ *
+ * @param[in]  packets  number of packets in burst_raw
+ * @param[in]  quiet    set to 1 to only decode without calling anything
+ *
+ * @return     0 on success, -1 if a packet was invalid and the fifo needs a
+ * reset
+ */
+int __dispatch_dmp_burst(int packets, int quiet)
+{
+	int k;
+	uint64_t ts;
+	uint64_t period_ns = 1000000000/config.dmp_sample_rate;
+
+	for(k=0;k<packets;k++){
+		if(__decode_dmp_packet(&burst_raw[k*packet_len], data_ptr)){
+			if(config.show_warnings){
+				printf("warning: Quaternion out of bounds in packet %d of %d\n", k+1, packets);
+			}
+			return -1;
+		}
+		ts = last_interrupt_timestamp_nanos - (uint64_t)(packets-1-k)*period_ns;
+		if(data_ptr->tap_detected) last_tap_timestamp_nanos = ts;
+		if(quiet) continue;
+		if(ring!=NULL) __ring_publish(ts);
+		if(dmp_callback_func!=NULL) dmp_callback_func();
+		pthread_cond_broadcast(&read_condition);
+		if(data_ptr->tap_detected){
+			if(tap_callback_func!=NULL) tap_callback_func(data_ptr->last_tap_direction, data_ptr->last_tap_count);
+			pthread_cond_broadcast(&tap_condition);
+		}
+	}
+	return 0;
+}
+
 /**
  * sets a user function to be called when new data is read
  *
@@ -1917,14 +2190,10 @@ int rc_mpu_set_tap_callback(void (*func)(int dir, int cnt))
 int __read_dmp_fifo(rc_mpu_data_t* data)
 {
 	unsigned char raw[MAX_FIFO_BUFFER];
-	int32_t quat_q14[4], quat[4], quat_mag_sq;
 	uint16_t fifo_count;
 	int ret;
 	int i = 0; // position of beginning of quaternion
-	int j = 0; // position of beginning of accel/gyro data
 	static int first_run = 1; // set to 0 after first call
-	double q_tmp[4];
-	double sum,qlen;
 
 	if(!dmp_en){
 		printf("only use mpu_read_fifo in dmp mode\n");
@@ -1938,13 +2207,9 @@ int __read_dmp_fifo(rc_mpu_data_t* data)
 		return -1;
 	}
 
-	// make sure the i2c address is set correctly.
-	// this shouldn't take any time at all if already set
-	rc_i2c_set_device_address(config.i2c_bus, config.i2c_addr);
-	int is_new_dmp_data = 0;
 
 	// check fifo count register to make sure new data is there
-	if(rc_i2c_read_word(config.i2c_bus, FIFO_COUNTH, &fifo_count)<0){
+	if(__mpu_read_word(FIFO_COUNTH, &fifo_count)<0){
 		if(config.show_warnings){
 			printf("fifo_count i2c error: %s\n",strerror(errno));
 		}
@@ -2010,10 +2275,10 @@ int __read_dmp_fifo(rc_mpu_data_t* data)
 	******************\\\**************************************************/
 	memset(raw,0,MAX_FIFO_BUFFER);
 	// read it in!
-	ret = rc_i2c_read_bytes(config.i2c_bus, FIFO_R_W, fifo_count, &raw[0]);
+	ret = __mpu_read_bytes(FIFO_R_W, fifo_count, &raw[0]);
 	if(ret<0){
 		// if i2c_read returned -1 there was an error, try again
-		ret = rc_i2c_read_bytes(config.i2c_bus, FIFO_R_W, fifo_count, &raw[0]);
+		ret = __mpu_read_bytes(FIFO_R_W, fifo_count, &raw[0]);
 	}
 	if(ret!=fifo_count){
 		if(config.show_warnings){
@@ -2024,6 +2289,99 @@ int __read_dmp_fifo(rc_mpu_data_t* data)
 	}
 
 
+	// decode the selected packet, a bad quaternion means the fifo is out of
+	// sync so reset it
+	if(__decode_dmp_packet(&raw[i], data)){
+		if(config.show_warnings){
+			printf("warning: Quaternion out of bounds, fifo_count: %d\n", fifo_count);
+		}
+		__mpu_reset_fifo();
+		return -1;
+	}
+	// if we finally got dmp data, turn off the first run flag
+	first_run=0;
+	return 0;
+}
+
+/**
+ * Reads every packet waiting in the FIFO in one I2C burst without decoding
+ * them. Used instead of __read_dmp_fifo when dmp_fifo_burst_drain is enabled
+ * so a late wakeup doesn't throw away the backlog. If the FIFO has filled up
+ * completely it may have overflowed and lost alignment so it is reset instead.
+ *
+ * @param      raw   buffer of at least MPU_FIFO_SIZE bytes to read into
+ *
+ * @return     number of packets read, or -1 on failure
+ */
+int __read_dmp_fifo_burst(unsigned char* raw)
+{
+	uint16_t fifo_count;
+	int ret;
+	static int first_run = 1; // set to 0 after first successful call
+
+	if(!dmp_en){
+		printf("only use mpu_read_fifo in dmp mode\n");
+		return -1;
+	}
+	if(packet_len!=FIFO_LEN_QUAT_ACCEL_GYRO_TAP && packet_len!=FIFO_LEN_QUAT_TAP){
+		fprintf(stderr,"ERROR: packet_len is set incorrectly for read_dmp_fifo\n");
+		return -1;
+	}
+	if(__mpu_read_word(FIFO_COUNTH, &fifo_count)<0){
+		if(config.show_warnings){
+			printf("fifo_count i2c error: %s\n",strerror(errno));
+		}
+		return -1;
+	}
+	if(fifo_count==0){
+		if(config.show_warnings && first_run!=1){
+			printf("WARNING: empty fifo\n");
+		}
+		return -1;
+	}
+	if(fifo_count>=MPU_FIFO_SIZE || fifo_count%packet_len){
+		if(config.show_warnings && first_run!=1){
+			printf("warning: %d bytes in FIFO, expected a multiple of %d\n", fifo_count,packet_len);
+		}
+		__mpu_reset_fifo();
+		return -1;
+	}
+	if(config.show_warnings && first_run!=1 && fifo_count>packet_len){
+		printf("warning: draining %d packets from imu fifo\n", fifo_count/packet_len);
+	}
+	// one burst for the whole backlog, try again once on error
+	ret = __mpu_read_bytes(FIFO_R_W, fifo_count, raw);
+	if(ret<0){
+		ret = __mpu_read_bytes(FIFO_R_W, fifo_count, raw);
+	}
+	if(ret!=fifo_count){
+		if(config.show_warnings){
+			fprintf(stderr,"ERROR: failed to read fifo buffer register\n");
+			printf("read %d bytes, expected %d\n", ret, fifo_count);
+		}
+		return -1;
+	}
+	first_run = 0;
+	return fifo_count/packet_len;
+}
+
+/**
+ * Decodes one DMP packet into the data struct and runs the magnetometer data
+ * fusion if enabled. Shared by the normal and burst FIFO reads.
+ *
+ * @param      raw   pointer to the start of the packet
+ * @param      data  The data pointer
+ *
+ * @return     0 on success, -1 if the quaternion is invalid
+ */
+int __decode_dmp_packet(unsigned char* raw, rc_mpu_data_t* data)
+{
+	int32_t quat_q14[4], quat[4], quat_mag_sq;
+	int i = 0; // position in the packet
+	int j;
+	double q_tmp[4];
+	double sum,qlen;
+
 	// now we can read the quaternion which is always first
 	// parse the quaternion data from the buffer
 	quat[0] = ((int32_t)raw[i+0] << 24) | ((int32_t)raw[i+1] << 16) |
@@ -2046,10 +2404,6 @@ int __read_dmp_fifo(rc_mpu_data_t* data)
 	quat_mag_sq = quat_q14[0] * quat_q14[0] + quat_q14[1] * quat_q14[1] + \
 		quat_q14[2] * quat_q14[2] + quat_q14[3] * quat_q14[3];
 	if ((quat_mag_sq < QUAT_MAG_SQ_MIN)||(quat_mag_sq > QUAT_MAG_SQ_MAX)){
-		if(config.show_warnings){
-			printf("warning: Quaternion out of bounds, fifo_count: %d\n", fifo_count);
-		}
-		__mpu_reset_fifo();
 		return -1;
 	}
 
@@ -2065,7 +2419,6 @@ int __read_dmp_fifo(rc_mpu_data_t* data)
 
 	// fill in tait-bryan angles to the data struct
 	rc_quaternion_to_tb_array(data->dmp_quat, data->dmp_TaitBryan);
-	is_new_dmp_data=1;
 
 
 	if(packet_len==FIFO_LEN_QUAT_ACCEL_GYRO_TAP){
@@ -2102,28 +2455,20 @@ int __read_dmp_fifo(rc_mpu_data_t* data)
 		unsigned char direction, count;
 		direction = tap >> 3;
 		count = (tap % 8) + 1;
-		data_ptr->last_tap_direction = direction;
-		data_ptr->last_tap_count = count;
-		data_ptr->tap_detected=1;
+		data->last_tap_direction = direction;
+		data->last_tap_count = count;
+		data->tap_detected=1;
 	}
-	else data_ptr->tap_detected=0;
+	else data->tap_detected=0;
 
 	// run data_fusion to filter yaw with compass
-	if(is_new_dmp_data && config.enable_magnetometer){
+	if(config.enable_magnetometer){
 		#ifdef DEBUG
 		printf("running data_fusion\n");
 		#endif
 		__data_fusion(data);
 	}
-
-	// if we finally got dmp data, turn off the first run flag
-	if(is_new_dmp_data) first_run=0;
-
-	// finally, our return value is based on the presence of DMP data only
-	// even if new magnetometer data was read, the expected timing must come
-	// from the DMP samples only
-	if(is_new_dmp_data) return 0;
-	else return -1;
+	return 0;
 }
 
 /**
@@ -2283,7 +2628,7 @@ int __load_gyro_calibration(void)
 	data[5] = (-z/4)       & 0xFF;
 
 	// Push gyro biases to hardware registers
-	if(rc_i2c_write_bytes(config.i2c_bus, XG_OFFSET_H, 6, &data[0])){
+	if(__mpu_write_bytes(XG_OFFSET_H, 6, &data[0])){
 		fprintf(stderr,"ERROR: failed to load gyro offsets into IMU register\n");
 		return -1;
 	}
@@ -2393,13 +2738,13 @@ int __load_accel_calibration(void)
 	accel_lengths[2]=sz;
 
 	// read factory bias
-	if(rc_i2c_read_bytes(config.i2c_bus, XA_OFFSET_H, 2, &raw[0])<0){
+	if(__mpu_read_bytes(XA_OFFSET_H, 2, &raw[0])<0){
 		return -1;
 	}
-	if(rc_i2c_read_bytes(config.i2c_bus, YA_OFFSET_H, 2, &raw[2])<0){
+	if(__mpu_read_bytes(YA_OFFSET_H, 2, &raw[2])<0){
 		return -1;
 	}
-	if(rc_i2c_read_bytes(config.i2c_bus, ZA_OFFSET_H, 2, &raw[4])<0){
+	if(__mpu_read_bytes(ZA_OFFSET_H, 2, &raw[4])<0){
 		return -1;
 	}
 	// Turn the MSB and LSB into a signed 16-bit value
@@ -2421,15 +2766,15 @@ int __load_accel_calibration(void)
 	raw[5] = (bias[2] << 1) & 0xFF;
 
 	// Push accel biases to hardware registers
-	if(rc_i2c_write_bytes(config.i2c_bus, XA_OFFSET_H, 2, &raw[0])<0){
+	if(__mpu_write_bytes(XA_OFFSET_H, 2, &raw[0])<0){
 		fprintf(stderr,"ERROR: failed to write X accel offsets into IMU register\n");
 		return -1;
 	}
-	if(rc_i2c_write_bytes(config.i2c_bus, YA_OFFSET_H, 2, &raw[2])<0){
+	if(__mpu_write_bytes(YA_OFFSET_H, 2, &raw[2])<0){
 		fprintf(stderr,"ERROR: failed to write Y accel offsets into IMU register\n");
 		return -1;
 	}
-	if(rc_i2c_write_bytes(config.i2c_bus, ZA_OFFSET_H, 2, &raw[4])<0){
+	if(__mpu_write_bytes(ZA_OFFSET_H, 2, &raw[4])<0){
 		fprintf(stderr,"ERROR: failed to write Z accel offsets into IMU register\n");
 		return -1;
 	}
@@ -2624,75 +2969,73 @@ int rc_mpu_calibrate_gyro_routine(rc_mpu_config_t conf)
 	// save bus and address globally for other functions to use
 	config.i2c_bus = conf.i2c_bus;
 	config.i2c_addr = conf.i2c_addr;
+	config.transport = conf.transport;
+	config.spi_bus = conf.spi_bus;
+	config.spi_slave = conf.spi_slave;
+	config.spi_speed_hz = conf.spi_speed_hz;
 
-	// make sure the bus is not currently in use by another thread
-	// do not proceed to prevent interfering with that process
-	if(rc_i2c_get_lock(conf.i2c_bus)){
-		fprintf(stderr,"i2c bus claimed by another process\n");
-		fprintf(stderr,"aborting gyro calibration()\n");
-		return -1;
-	}
+	// claim the bus for the whole calibration, this waits for any other
+	// thread using it to finish first
+	__transport_select();
+	__mpu_lock();
 
-	// if it is not claimed, start the i2c bus
-	if(rc_i2c_init(conf.i2c_bus, conf.i2c_addr)==-1){
-		fprintf(stderr,"ERROR in rc_mpu_calibrate_gyro_routine, failed to init i2c bus\n");
+	// start the i2c or spi bus
+	if(__transport_init()==-1){
+		fprintf(stderr,"ERROR in rc_mpu_calibrate_gyro_routine, failed to init bus\n");
+		__mpu_unlock();
 		return -1;
 	}
 
-	// claiming the bus does no guarantee other code will not interfere
-	// with this process, but best to claim it so other code can check
-	// like we did above
-	rc_i2c_lock_bus(conf.i2c_bus);
-
 	// reset device, reset all registers
 	if(__reset_mpu()==-1){
 		fprintf(stderr,"ERROR in rc_mpu_calibrate_gyro_routine, failed to reset MPU9250\n");
+		__mpu_unlock();
 		return -1;
 	}
 
 	// set up the IMU specifically for calibration.
-	rc_i2c_write_byte(conf.i2c_bus, PWR_MGMT_1, 0x01);
-	rc_i2c_write_byte(conf.i2c_bus, PWR_MGMT_2, 0x00);
+	__mpu_write_byte(PWR_MGMT_1, 0x01);
+	__mpu_write_byte(PWR_MGMT_2, 0x00);
 	rc_usleep(200000);
 
 	// // set bias registers to 0
 	// // Push gyro biases to hardware registers
 	// uint8_t zeros[] = {0,0,0,0,0,0};
-	// if(rc_i2c_write_bytes(conf.i2c_bus, XG_OFFSET_H, 6, zeros)){
+	// if(__mpu_write_bytes(XG_OFFSET_H, 6, zeros)){
 		// fprintf(stderr,"ERROR: failed to load gyro offsets into IMU register\n");
 		// return -1;
 	// }
 
-	rc_i2c_write_byte(conf.i2c_bus, INT_ENABLE, 0x00);  // Disable all interrupts
-	rc_i2c_write_byte(conf.i2c_bus, FIFO_EN, 0x00);     // Disable FIFO
-	rc_i2c_write_byte(conf.i2c_bus, PWR_MGMT_1, 0x00);  // Turn on internal clock source
-	rc_i2c_write_byte(conf.i2c_bus, I2C_MST_CTRL, 0x00);// Disable I2C master
-	rc_i2c_write_byte(conf.i2c_bus, USER_CTRL, 0x00);   // Disable FIFO and I2C master
-	rc_i2c_write_byte(conf.i2c_bus, USER_CTRL, 0x0C);   // Reset FIFO and DMP
+	__mpu_write_byte(INT_ENABLE, 0x00);  // Disable all interrupts
+	__mpu_write_byte(FIFO_EN, 0x00);     // Disable FIFO
+	__mpu_write_byte(PWR_MGMT_1, 0x00);  // Turn on internal clock source
+	__mpu_write_byte(I2C_MST_CTRL, 0x00);// Disable I2C master
+	__mpu_write_byte(USER_CTRL, 0x00);   // Disable FIFO and I2C master
+	__mpu_write_byte(USER_CTRL, 0x0C);   // Reset FIFO and DMP
 	rc_usleep(15000);
 
 	// Configure MPU9250 gyro and accelerometer for bias calculation
-	rc_i2c_write_byte(conf.i2c_bus, CONFIG, 0x01);      // Set low-pass filter to 188 Hz
-	rc_i2c_write_byte(conf.i2c_bus, SMPLRT_DIV, 0x04);  // Set sample rate to 200hz
+	__mpu_write_byte(CONFIG, 0x01);      // Set low-pass filter to 188 Hz
+	__mpu_write_byte(SMPLRT_DIV, 0x04);  // Set sample rate to 200hz
 	// Set gyro full-scale to 250 degrees per second, maximum sensitivity
-	rc_i2c_write_byte(conf.i2c_bus, GYRO_CONFIG, 0x00);
+	__mpu_write_byte(GYRO_CONFIG, 0x00);
 	// Set accelerometer full-scale to 2 g, maximum sensitivity
-	rc_i2c_write_byte(conf.i2c_bus, ACCEL_CONFIG, 0x00);
+	__mpu_write_byte(ACCEL_CONFIG, 0x00);
 
 COLLECT_DATA:
 
 	// Configure FIFO to capture gyro data for bias calculation
-	rc_i2c_write_byte(conf.i2c_bus, USER_CTRL, 0x40);   // Enable FIFO
+	__mpu_write_byte(USER_CTRL, 0x40);   // Enable FIFO
 	// Enable gyro sensors for FIFO (max size 512 bytes in MPU-9250)
 	c = FIFO_GYRO_X_EN|FIFO_GYRO_Y_EN|FIFO_GYRO_Z_EN;
-	rc_i2c_write_byte(conf.i2c_bus, FIFO_EN, c);
+	__mpu_write_byte(FIFO_EN, c);
 	// 6 bytes per sample. 200hz. wait 0.4 seconds
 	rc_usleep(400000);
 
 	// At end of sample accumulation, turn off FIFO sensor read
-	rc_i2c_write_byte(conf.i2c_bus, FIFO_EN, 0x00);
+	__mpu_write_byte(FIFO_EN, 0x00);
 	// read FIFO sample count and log number of samples
-	rc_i2c_read_bytes(conf.i2c_bus, FIFO_COUNTH, 2, &data[0]);
+	__mpu_read_bytes(FIFO_COUNTH, 2, &data[0]);
 	int16_t fifo_count = ((uint16_t)data[0] << 8) | data[1];
 	int samples = fifo_count/6;
 
@@ -2714,8 +3057,9 @@ COLLECT_DATA:
 	gyro_sum[2] = 0;
 	for (i=0; i<samples; i++) {
 		// read data for averaging
-		if(rc_i2c_read_bytes(conf.i2c_bus, FIFO_R_W, 6, data)<0){
+		if(__mpu_read_bytes(FIFO_R_W, 6, data)<0){
 			fprintf(stderr,"ERROR: failed to read FIFO\n");
+			__mpu_unlock();
 			return -1;
 		}
 		x = (int16_t)(((int16_t)data[0] << 8) | data[1]) ;
@@ -2766,7 +3110,7 @@ COLLECT_DATA:
 		goto COLLECT_DATA;
 	}
 	// done with I2C for now
-	rc_i2c_unlock_bus(conf.i2c_bus);
+	__mpu_unlock();
 	#ifdef DEBUG
 	printf("offsets: %d %d %d\n", offsets[0], offsets[1], offsets[2]);
 	#endif
@@ -2797,39 +3141,37 @@ int rc_mpu_calibrate_mag_routine(rc_mpu_config_t conf)
 	config.enable_magnetometer = 1;
 	config.i2c_bus = conf.i2c_bus;
 	config.i2c_addr = conf.i2c_addr;
+	config.transport = conf.transport;
+	config.spi_bus = conf.spi_bus;
+	config.spi_slave = conf.spi_slave;
+	config.spi_speed_hz = conf.spi_speed_hz;
 
-	// make sure the bus is not currently in use by another thread
-	// do not proceed to prevent interfering with that process
-	if(rc_i2c_get_lock(config.i2c_bus)){
-		fprintf(stderr,"i2c bus claimed by another process\n");
-		fprintf(stderr,"aborting magnetometer calibration()\n");
-		return -1;
-	}
+	// claim the bus for the whole calibration, this waits for any other
+	// thread using it to finish first
+	__transport_select();
+	__mpu_lock();
 
-	// if it is not claimed, start the i2c bus
-	if(rc_i2c_init(config.i2c_bus, config.i2c_addr)){
-		fprintf(stderr,"ERROR rc_calibrate_mag_routine failed at rc_i2c_init\n");
+	// start the i2c or spi bus
+	if(__transport_init()){
+		fprintf(stderr,"ERROR rc_calibrate_mag_routine failed to initialize bus\n");
+		__mpu_unlock();
 		return -1;
 	}
 
-	// claiming the bus does no guarantee other code will not interfere
-	// with this process, but best to claim it so other code can check
-	// like we did above
-	rc_i2c_lock_bus(config.i2c_bus);
-
 	// reset device, reset all registers
 	if(__reset_mpu()<0){
 		fprintf(stderr,"ERROR: failed to reset MPU9250\n");
+		__mpu_unlock();
 		return -1;
 	}
 	//check the who am i register to make sure the chip is alive
 	if(__check_who_am_i()){
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 	if(__init_magnetometer(1)){
 		fprintf(stderr,"ERROR: failed to initialize_magnetometer\n");
-		rc_i2c_unlock_bus(config.i2c_bus);
+		__mpu_unlock();
 		return -1;
 	}
 
@@ -2842,6 +3184,7 @@ int rc_mpu_calibrate_mag_routine(rc_mpu_config_t conf)
 	mag_scales[2]  = 1.0;
 	if(rc_matrix_alloc(&A,samples,3)){
 		fprintf(stderr,"ERROR: in rc_calibrate_mag_routine, failed to alloc data matrix\n");
+		__mpu_unlock();
 		return -1;
 	}
 
@@ -2878,7 +3221,7 @@ int rc_mpu_calibrate_mag_routine(rc_mpu_config_t conf)
 	}
 	// done with I2C for now
 	rc_mpu_power_off();
-	rc_i2c_unlock_bus(config.i2c_bus);
+	__mpu_unlock();
 
 	printf("\n\nOkay Stop!\n");
 	printf("Calculating calibration constants.....\n");
@@ -2956,16 +3299,16 @@ int __collect_accel_samples(int* avg_raw)
 	rc_vector_t vz = rc_vector_empty();
 
 	// Configure FIFO to capture gyro data for bias calculation
-	rc_i2c_write_byte(config.i2c_bus, USER_CTRL, 0x40);   // Enable FIFO
+	__mpu_write_byte(USER_CTRL, 0x40);   // Enable FIFO
 	// Enable accel sensors for FIFO (max size 512 bytes in MPU-9250)
-	rc_i2c_write_byte(config.i2c_bus, FIFO_EN, FIFO_ACCEL_EN);
+	__mpu_write_byte(FIFO_EN, FIFO_ACCEL_EN);
 	// 6 bytes per sample. 200hz. wait 0.4 seconds
 	rc_usleep(400000);
 
 	// At end of sample accumulation, turn off FIFO sensor read
-	rc_i2c_write_byte(config.i2c_bus, FIFO_EN, 0x00);
+	__mpu_write_byte(FIFO_EN, 0x00);
 	// read FIFO sample count and log number of samples
-	rc_i2c_read_bytes(config.i2c_bus, FIFO_COUNTH, 2, &data[0]);
+	__mpu_read_bytes(FIFO_COUNTH, 2, &data[0]);
 	fifo_count = ((uint16_t)data[0] << 8) | data[1];
 	samples = fifo_count/6;
 
@@ -2982,7 +3325,7 @@ int __collect_accel_samples(int* avg_raw)
 	sum[2] = 0;
 	for (i=0; i<samples; i++) {
 		// read data for averaging
-		if(rc_i2c_read_bytes(config.i2c_bus, FIFO_R_W, 6, data)<0){
+		if(__mpu_read_bytes(FIFO_R_W, 6, data)<0){
 			fprintf(stderr,"ERROR in rc_mpu_calibrate_accel_routine, failed to read FIFO\n");
 			return -1;
 		}
@@ -3040,49 +3383,48 @@ int rc_mpu_calibrate_accel_routine(rc_mpu_config_t conf)
 	// save bus and address globally for other functions to use
 	config.i2c_bus = conf.i2c_bus;
 	config.i2c_addr = conf.i2c_addr;
+	config.transport = conf.transport;
+	config.spi_bus = conf.spi_bus;
+	config.spi_slave = conf.spi_slave;
+	config.spi_speed_hz = conf.spi_speed_hz;
 
-	// make sure the bus is not currently in use by another thread
-	// do not proceed to prevent interfering with that process
-	if(rc_i2c_get_lock(config.i2c_bus)){
-		fprintf(stderr,"ERROR in rc_mpu_calibrate_accel_routine, i2c bus claimed by another process\n");
-		return -1;
-	}
+	// claim the bus for the whole calibration, this waits for any other
+	// thread using it to finish first
+	__transport_select();
+	__mpu_lock();
 
-	// if it is not claimed, start the i2c bus
-	if(rc_i2c_init(config.i2c_bus, config.i2c_addr)){
-		fprintf(stderr,"ERROR in rc_mpu_calibrate_accel_routine, failed at rc_i2c_init\n");
+	// start the i2c or spi bus
+	if(__transport_init()){
+		fprintf(stderr,"ERROR in rc_mpu_calibrate_accel_routine, failed to initialize bus\n");
+		__mpu_unlock();
 		return -1;
 	}
 
-	// claiming the bus does no guarantee other code will not interfere
-	// with this process, but best to claim it so other code can check
-	// like we did above
-	rc_i2c_lock_bus(config.i2c_bus);
-
 	// reset device, reset all registers
 	if(__reset_mpu()<0){
 		fprintf(stderr,"ERROR in rc_mpu_calibrate_accel_routine failed to reset MPU9250\n");
+		__mpu_unlock();
 		return -1;
 	}
 
 	// set up the IMU specifically for calibration.
-	rc_i2c_write_byte(config.i2c_bus, PWR_MGMT_1, 0x01);
-	rc_i2c_write_byte(config.i2c_bus, PWR_MGMT_2, 0x00);
+	__mpu_write_byte(PWR_MGMT_1, 0x01);
+	__mpu_write_byte(PWR_MGMT_2, 0x00);
 	rc_usleep(200000);
 
-	rc_i2c_write_byte(config.i2c_bus, INT_ENABLE, 0x00);	// Disable all interrupts
-	rc_i2c_write_byte(config.i2c_bus, FIFO_EN, 0x00);	// Disable FIFO
-	rc_i2c_write_byte(config.i2c_bus, PWR_MGMT_1, 0x00);	// Turn on internal clock source
-	rc_i2c_write_byte(config.i2c_bus, I2C_MST_CTRL, 0x00);	// Disable I2C master
-	rc_i2c_write_byte(config.i2c_bus, USER_CTRL, 0x00);	// Disable FIFO and I2C master
-	rc_i2c_write_byte(config.i2c_bus, USER_CTRL, 0x0C);	// Reset FIFO and DMP
+	__mpu_write_byte(INT_ENABLE, 0x00);	// Disable all interrupts
+	__mpu_write_byte(FIFO_EN, 0x00);	// Disable FIFO
+	__mpu_write_byte(PWR_MGMT_1, 0x00);	// Turn on internal clock source
+	__mpu_write_byte(I2C_MST_CTRL, 0x00);	// Disable I2C master
+	__mpu_write_byte(USER_CTRL, 0x00);	// Disable FIFO and I2C master
+	__mpu_write_byte(USER_CTRL, 0x0C);	// Reset FIFO and DMP
 	rc_usleep(15000);
 
 	// Configure MPU9250 gyro and accelerometer for bias calculation
-	rc_i2c_write_byte(config.i2c_bus, CONFIG, 0x01);	// Set low-pass filter to 188 Hz
-	rc_i2c_write_byte(config.i2c_bus, SMPLRT_DIV, 0x04);	// Set sample rate to 200hz
-	rc_i2c_write_byte(config.i2c_bus, GYRO_CONFIG, 0x00);	// set G FSR to 250dps
-	rc_i2c_write_byte(config.i2c_bus, ACCEL_CONFIG, 0x00);	// set A FSR to 2G
+	__mpu_write_byte(CONFIG, 0x01);	// Set low-pass filter to 188 Hz
+	__mpu_write_byte(SMPLRT_DIV, 0x04);	// Set sample rate to 200hz
+	__mpu_write_byte(GYRO_CONFIG, 0x00);	// set G FSR to 250dps
+	__mpu_write_byte(ACCEL_CONFIG, 0x00);	// set A FSR to 2G
 
 
 	// collect an orientation
@@ -3093,7 +3435,10 @@ int rc_mpu_calibrate_accel_routine(rc_mpu_config_t conf)
 	was_last_steady=0;
 	while(ret){
 		ret=__collect_accel_samples(avg_raw[0]);
-		if(ret==-1) return -1;
+		if(ret==-1){
+			__mpu_unlock();
+			return -1;
+		}
 	}
 	printf("success\n");
 	// collect an orientation
@@ -3104,7 +3449,10 @@ int rc_mpu_calibrate_accel_routine(rc_mpu_config_t conf)
 	was_last_steady=0;
 	while(ret){
 		ret=__collect_accel_samples(avg_raw[1]);
-		if(ret==-1) return -1;
+		if(ret==-1){
+			__mpu_unlock();
+			return -1;
+		}
 	}
 	printf("success\n");
 	// collect an orientation
@@ -3115,7 +3463,10 @@ int rc_mpu_calibrate_accel_routine(rc_mpu_config_t conf)
 	was_last_steady=0;
 	while(ret){
 		ret=__collect_accel_samples(avg_raw[2]);
-		if(ret==-1) return -1;
+		if(ret==-1){
+			__mpu_unlock();
+			return -1;
+		}
 	}
 	printf("success\n");
 	// collect an orientation
@@ -3126,7 +3477,10 @@ int rc_mpu_calibrate_accel_routine(rc_mpu_config_t conf)
 	was_last_steady=0;
 	while(ret){
 		ret=__collect_accel_samples(avg_raw[3]);
-		if(ret==-1) return -1;
+		if(ret==-1){
+			__mpu_unlock();
+			return -1;
+		}
 	}
 	printf("success\n");
 	// collect an orientation
@@ -3137,7 +3491,10 @@ int rc_mpu_calibrate_accel_routine(rc_mpu_config_t conf)
 	was_last_steady=0;
 	while(ret){
 		ret=__collect_accel_samples(avg_raw[4]);
-		if(ret==-1) return -1;
+		if(ret==-1){
+			__mpu_unlock();
+			return -1;
+		}
 	}
 	printf("success\n");
 	// collect an orientation
@@ -3148,13 +3505,16 @@ int rc_mpu_calibrate_accel_routine(rc_mpu_config_t conf)
 	was_last_steady=0;
 	while(ret){
 		ret=__collect_accel_samples(avg_raw[5]);
-		if(ret==-1) return -1;
+		if(ret==-1){
+			__mpu_unlock();
+			return -1;
+		}
 	}
 	printf("success\n");
 
 	// done with I2C for now
 	rc_mpu_power_off();
-	rc_i2c_unlock_bus(config.i2c_bus);
+	__mpu_unlock();
 
 	// fit the ellipse
 	rc_matrix_t A = rc_matrix_empty();
@@ -3258,50 +3618,533 @@ int64_t rc_mpu_nanos_since_last_tap(void)
 	return rc_nanos_since_epoch() - last_tap_timestamp_nanos;
 }
 
-int rc_mpu_block_until_dmp_data(void)
+/**
+ * allocates the sample ring with len rounded up to a power of 2, a len of 0
+ * leaves the ring disabled. Only called while the interrupt thread is stopped.
+ *
+ * @param[in]  len   requested number of samples
+ *
+ * @return     0 on success, -1 on failure
+ */
+int __ring_alloc(int len)
 {
-	if(imu_shutdown_flag!=0){
-		fprintf(stderr,"ERROR: call to rc_mpu_block_until_dmp_data after shutting down mpu\n");
+	uint64_t size = 2;
+	__ring_free();
+	if(len<=0) return 0;
+	while(size<(uint64_t)len) size*=2;
+	ring = (ring_slot_t*)calloc(size, sizeof(ring_slot_t));
+	if(ring==NULL){
+		perror("ERROR in __ring_alloc");
 		return -1;
 	}
-	if(!thread_running_flag){
-		fprintf(stderr,"ERROR: call to rc_mpu_block_until_dmp_data when DMP handler not running\n");
+	ring_mask = size-1;
+	atomic_store(&ring_head, 0);
+	return 0;
+}
+
+/**
+ * frees the sample ring. Only called while the interrupt thread is stopped.
+ */
+void __ring_free(void)
+{
+	free(ring);
+	ring = NULL;
+	atomic_store(&ring_head, 0);
+}
+
+/**
+ * copies the user's data struct into the next ring slot. Only ever called by
+ * the interrupt thread so there is exactly one writer per slot lock.
+ */
+void __ring_publish(uint64_t timestamp_ns)
+{
+	uint64_t n = atomic_load_explicit(&ring_head, memory_order_relaxed) + 1;
+	ring_slot_t* slot = &ring[n & ring_mask];
+	__seqlock_write_begin(&slot->lock);
+	slot->sample.seq = n;
+	slot->sample.timestamp_ns = timestamp_ns;
+	slot->sample.data = *data_ptr;
+	__seqlock_write_end(&slot->lock);
+	atomic_store_explicit(&ring_head, n, memory_order_release);
+}
+
+/**
+ * copies sample n out of the ring if it is still there.
+ *
+ * @return     1 if copied, 0 if the slot holds a different sample by now
+ */
+int __ring_copy(uint64_t n, rc_mpu_sample_t* sample)
+{
+	ring_slot_t* slot = &ring[n & ring_mask];
+	if(!__seqlock_read(&slot->lock, sample, &slot->sample, sizeof(*sample))) return 0;
+	return sample->seq==n;
+}
+
+int rc_mpu_ring_reader_init(rc_mpu_ring_reader_t* r)
+{
+	if(unlikely(r==NULL)){
+		fprintf(stderr,"ERROR in rc_mpu_ring_reader_init, received NULL pointer\n");
 		return -1;
 	}
-	// wait for condition signal which unlocks mutex
-	pthread_mutex_lock(&read_mutex);
-	pthread_cond_wait(&read_condition, &read_mutex);
-	pthread_mutex_unlock(&read_mutex);
-	// check if condition was broadcast due to shutdown
-	if(imu_shutdown_flag) return 1;
-	// otherwise return 0 on actual button press
+	r->next = atomic_load_explicit(&ring_head, memory_order_acquire) + 1;
+	r->missed = 0;
 	return 0;
 }
 
-int rc_mpu_block_until_tap(void)
+int rc_mpu_ring_read(rc_mpu_ring_reader_t* r, rc_mpu_sample_t* sample)
 {
-	if(imu_shutdown_flag!=0){
-		fprintf(stderr,"ERROR: call to rc_mpu_block_until_tap after shutting down mpu\n");
+	uint64_t head;
+	if(unlikely(r==NULL || sample==NULL)){
+		fprintf(stderr,"ERROR in rc_mpu_ring_read, received NULL pointer\n");
 		return -1;
 	}
-	if(!thread_running_flag){
-		fprintf(stderr,"ERROR: call to rc_mpu_block_until_tap when DMP handler not running\n");
+	if(unlikely(ring==NULL)){
+		fprintf(stderr,"ERROR in rc_mpu_ring_read, sample ring not enabled\n");
 		return -1;
 	}
-	// wait for condition signal which unlocks mutex
-	pthread_mutex_lock(&tap_mutex);
-	pthread_cond_wait(&tap_condition, &tap_mutex);
-	pthread_mutex_unlock(&tap_mutex);
-	// check if condition was broadcast due to shutdown
-	if(imu_shutdown_flag) return 1;
-	// otherwise return 0 on actual button press
-	return 0;
+	// sequence numbers start at 1
+	if(r->next==0) r->next = 1;
+	while(1){
+		head = atomic_load_explicit(&ring_head, memory_order_acquire);
+		if(r->next>head) return 0;
+		// the slot after head may already be getting overwritten so only
+		// ring_mask samples behind head are safe, skip ahead if lapped
+		if(head-r->next>=ring_mask){
+			r->missed += head - ring_mask + 1 - r->next;
+			r->next = head - ring_mask + 1;
+		}
+		if(__ring_copy(r->next, sample)){
+			r->next++;
+			return 1;
+		}
+		// overwritten while copying, the writer is well ahead so go again
+	}
 }
 
-static int __mag_correct_orientation(double mag_vec[3])
+int rc_mpu_ring_read_latest(rc_mpu_sample_t* sample)
 {
-	// create a quaternion vector from the current magnetic field vector
-	// in IMU body coordinate frame. Since the DMP quaternion is aligned with
+	uint64_t head;
+	if(unlikely(sample==NULL)){
+		fprintf(stderr,"ERROR in rc_mpu_ring_read_latest, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(ring==NULL)){
+		fprintf(stderr,"ERROR in rc_mpu_ring_read_latest, sample ring not enabled\n");
+		return -1;
+	}
+	do{
+		head = atomic_load_explicit(&ring_head, memory_order_acquire);
+		if(head==0) return 0;
+	}while(!__ring_copy(head, sample));
+	return 1;
+}
+
+int rc_mpu_initialize_raw_fifo(rc_mpu_data_t* data, rc_mpu_config_t conf)
+{
+	// range check
+	if(conf.raw_fifo_sample_rate>RAW_FIFO_MAX_RATE || conf.raw_fifo_sample_rate<RAW_FIFO_MIN_RATE){
+		fprintf(stderr,"ERROR: raw_fifo_sample_rate must be between %d & %d\n", \
+						RAW_FIFO_MIN_RATE, RAW_FIFO_MAX_RATE);
+		return -1;
+	}
+	if(conf.raw_fifo_batch_len<1 || conf.raw_fifo_batch_len>RC_MPU_RAW_FIFO_MAX_BATCH){
+		fprintf(stderr,"ERROR: raw_fifo_batch_len must be between 1 & %d\n", RC_MPU_RAW_FIFO_MAX_BATCH);
+		return -1;
+	}
+	if(conf.raw_fifo_sample_rate<=RAW_FIFO_DIV_RATE){
+		// make sure the sample rate is a divisor so we can find a neat rate divider
+		if(RAW_FIFO_DIV_RATE%conf.raw_fifo_sample_rate != 0){
+			fprintf(stderr,"raw FIFO sample rate must be a divisor of 1000\n");
+			fprintf(stderr,"acceptable values: 1000,500,250,200,125,100,50,40,25,20,10,8,5,4 (HZ)\n");
+			fprintf(stderr,"or 4000,2000 (HZ) over SPI\n");
+			return -1;
+		}
+		// the sample rate divider only works with the 1khz internal rate
+		if(conf.gyro_dlpf==GYRO_DLPF_OFF || conf.gyro_dlpf==GYRO_DLPF_250){
+			fprintf(stderr,"WARNING, gyro dlpf bandwidth must be <= 184hz in raw FIFO mode\n");
+			fprintf(stderr,"setting to 184hz automatically\n");
+			conf.gyro_dlpf	= GYRO_DLPF_184;
+		}
+		raw_fifo_decim = 1;
+	}
+	else{
+		// above 1khz the FIFO runs at 8khz with the DLPFs bypassed. Draining
+		// that many bytes is only practical at the fast SPI clock.
+		if(conf.transport!=MPU_TRANSPORT_SPI){
+			fprintf(stderr,"ERROR: raw_fifo_sample_rate above %d requires MPU_TRANSPORT_SPI\n", RAW_FIFO_DIV_RATE);
+			return -1;
+		}
+		if(RAW_FIFO_MAX_RATE%conf.raw_fifo_sample_rate != 0){
+			fprintf(stderr,"raw FIFO sample rate above 1000 must be 4000 or 2000 (HZ)\n");
+			return -1;
+		}
+		raw_fifo_decim = RAW_FIFO_BYPASS_RATE/conf.raw_fifo_sample_rate;
+		// leave half the FIFO free for the handler to be scheduled late
+		if(conf.raw_fifo_batch_len*raw_fifo_decim > RAW_FIFO_SIZE/RAW_FIFO_PACKET_LEN/2){
+			fprintf(stderr,"ERROR: raw_fifo_batch_len must be <= %d at %dhz\n", \
+				RAW_FIFO_SIZE/RAW_FIFO_PACKET_LEN/2/raw_fifo_decim, conf.raw_fifo_sample_rate);
+			return -1;
+		}
+		// both of these give the 8khz gyro rate, the others are 1khz
+		if(conf.gyro_dlpf!=GYRO_DLPF_OFF && conf.gyro_dlpf!=GYRO_DLPF_250){
+			fprintf(stderr,"WARNING, gyro dlpf must be off above 1khz in raw FIFO mode\n");
+			fprintf(stderr,"turning it off automatically\n");
+			conf.gyro_dlpf	= GYRO_DLPF_OFF;
+		}
+		// accel only runs at 4khz with FCHOICE bypass
+		if(conf.accel_dlpf!=ACCEL_DLPF_OFF){
+			fprintf(stderr,"WARNING, accel dlpf must be off above 1khz in raw FIFO mode\n");
+			fprintf(stderr,"turning it off automatically\n");
+			conf.accel_dlpf	= ACCEL_DLPF_OFF;
+		}
+	}
+
+	// update local copy of config and data struct with new values
+	config = conf;
+	data_ptr = data;
+
+	// claim the bus for the whole setup sequence, this waits for any other
+	// thread using it to finish first
+	__transport_select();
+	__mpu_lock();
+
+	// start the i2c or spi bus
+	if(__transport_init()){
+		fprintf(stderr,"rc_mpu_initialize_raw_fifo failed to initialize bus\n");
+		__mpu_unlock();
+		return -1;
+	}
+	// configure the gpio interrupt pin
+	if(rc_gpio_init_event(config.gpio_interrupt_pin_chip, config.gpio_interrupt_pin, 0, GPIOEVENT_REQUEST_FALLING_EDGE)==-1){
+		fprintf(stderr,"ERROR: in rc_mpu_initialize_raw_fifo, failed to initialize GPIO\n");
+		fprintf(stderr,"probably insufficient privileges\n");
+		__mpu_unlock();
+		return -1;
+	}
+	// restart the device so we start with clean registers
+	if(__reset_mpu()<0){
+		fprintf(stderr,"failed to __reset_mpu()\n");
+		__mpu_unlock();
+		return -1;
+	}
+	if(__check_who_am_i()){
+		__mpu_unlock();
+		return -1;
+	}
+	// load in calibration offsets from disk
+	if(__load_gyro_calibration()<0){
+		fprintf(stderr,"ERROR: failed to load gyro calibration offsets\n");
+		__mpu_unlock();
+		return -1;
+	}
+	if(__load_accel_calibration()<0){
+		fprintf(stderr,"ERROR: failed to load accel calibration offsets\n");
+		__mpu_unlock();
+		return -1;
+	}
+	// Set sample rate = 1000/(1 + SMPLRT_DIV), the divider is ignored in bypass
+	if(__mpu_write_byte(SMPLRT_DIV, raw_fifo_decim>1 ? 0 : \
+				RAW_FIFO_DIV_RATE/conf.raw_fifo_sample_rate - 1)){
+		fprintf(stderr,"ERROR: in rc_mpu_initialize_raw_fifo, failed to write SMPLRT_DIV\n");
+		__mpu_unlock();
+		return -1;
+	}
+	// set full scale ranges and filter constants
+	if(__set_gyro_fsr(conf.gyro_fsr, data)){
+		fprintf(stderr,"failed to set gyro fsr\n");
+		__mpu_unlock();
+		return -1;
+	}
+	if(__set_accel_fsr(conf.accel_fsr, data)){
+		fprintf(stderr,"failed to set accel fsr\n");
+		__mpu_unlock();
+		return -1;
+	}
+	if(__set_gyro_dlpf(conf.gyro_dlpf)){
+		fprintf(stderr,"failed to set gyro dlpf\n");
+		__mpu_unlock();
+		return -1;
+	}
+	if(__set_accel_dlpf(conf.accel_dlpf)){
+		fprintf(stderr,"failed to set accel_dlpf\n");
+		__mpu_unlock();
+		return -1;
+	}
+	// log locally that the fifo will be running so USER_CTRL keeps it on
+	dmp_en = 0;
+	raw_fifo_en = 1;
+	// both of these also set up the latching interrupt pin
+	if(conf.enable_magnetometer){
+		if(__init_magnetometer(0)){
+			fprintf(stderr,"failed to initialize magnetometer\n");
+			__mpu_unlock();
+			return -1;
+		}
+	}
+	else if(__power_off_magnetometer()){
+		fprintf(stderr,"failed to power off magnetometer\n");
+		__mpu_unlock();
+		return -1;
+	}
+	// done writing to bus for now, the handler starts the fifo
+	__mpu_unlock();
+
+	// get ready to start the handler thread
+	imu_shutdown_flag = 0;
+	raw_fifo_callback_func = NULL;
+	raw_fifo_overflows = 0;
+
+	// start the thread
+	if(rc_pthread_create(&imu_interrupt_thread, __raw_fifo_handler, NULL,
+					config.dmp_interrupt_sched_policy,
+					config.dmp_interrupt_priority)<0){
+		fprintf(stderr,"ERROR failed to start raw fifo handler thread\n");
+		return -1;
+	}
+	thread_running_flag = 1;
+
+	// sleep for a ms so the thread can start predictably
+	rc_usleep(1000);
+	return 0;
+}
+
+
+int rc_mpu_set_raw_fifo_callback(void (*func)(const rc_mpu_raw_sample_t* samples, int n))
+{
+	if(func==NULL){
+		fprintf(stderr,"ERROR: trying to assign NULL pointer to raw_fifo_callback_func\n");
+		return -1;
+	}
+	raw_fifo_callback_func = func;
+	return 0;
+}
+
+
+uint64_t rc_mpu_raw_fifo_overflows(void)
+{
+	return raw_fifo_overflows;
+}
+
+
+/**
+ * Empties the FIFO and starts it collecting accel and gyro samples again with
+ * the data ready and overflow interrupts on. Call with the bus held.
+ *
+ * @return     0 on success, -1 on failure
+ */
+int __raw_fifo_reset(void)
+{
+	// leave the i2c master running when not in bypass, like __mpu_set_bypass
+	uint8_t user_ctrl = bypass_en ? 0 : I2C_MST_EN;
+	if(__mpu_write_byte(INT_ENABLE, 0)) return -1;
+	if(__mpu_write_byte(FIFO_EN, 0)) return -1;
+	if(__mpu_write_byte(USER_CTRL, user_ctrl|BIT_FIFO_RST)) return -1;
+	rc_usleep(1000);
+	if(__mpu_write_byte(USER_CTRL, user_ctrl|BIT_FIFO_EN)) return -1;
+	if(__mpu_write_byte(FIFO_EN, FIFO_ACCEL_EN|FIFO_GYRO_X_EN|FIFO_GYRO_Y_EN|FIFO_GYRO_Z_EN)) return -1;
+	if(__mpu_write_byte(INT_ENABLE, RAW_RDY_EN|FIFO_OVERFLOW_EN)) return -1;
+	return 0;
+}
+
+
+/**
+ * Reads every whole sample in the FIFO in one burst and converts them into
+ * raw_fifo_samples, oldest first. Above 1khz each sample is the average of
+ * raw_fifo_decim packets and any leftover packets stay in the FIFO for next
+ * time. The newest packet is timestamped with the time the FIFO count was read
+ * and older ones backwards from it at the FIFO period, each sample takes the
+ * time of its last packet. An overflow or a count that isn't a whole number of
+ * packets means alignment was lost so the FIFO is reset instead. Call with the
+ * bus held.
+ *
+ * @return     number of samples read, or -1 on failure
+ */
+int __read_raw_fifo(void)
+{
+	int i, j, k, n, m, len;
+	int32_t sum[6];
+	uint8_t status;
+	uint16_t fifo_count;
+	uint64_t now, period_ns;
+	unsigned char* p;
+	rc_mpu_raw_sample_t* s;
+
+	// reading the status also clears the latched interrupt
+	if(__mpu_read_byte(INT_STATUS, &status)<0){
+		if(config.show_warnings){
+			printf("int_status i2c error: %s\n",strerror(errno));
+		}
+		return -1;
+	}
+	now = rc_nanos_since_epoch();
+	if(__mpu_read_word(FIFO_COUNTH, &fifo_count)<0){
+		if(config.show_warnings){
+			printf("fifo_count i2c error: %s\n",strerror(errno));
+		}
+		return -1;
+	}
+	if((status&BIT_FIFO_OVERFLOW) || fifo_count%RAW_FIFO_PACKET_LEN){
+		if(config.show_warnings){
+			printf("warning: raw fifo overflow, %d bytes in FIFO\n", fifo_count);
+		}
+		raw_fifo_overflows++;
+		__raw_fifo_reset();
+		return -1;
+	}
+	// n packets in the FIFO make m whole samples
+	n = fifo_count/RAW_FIFO_PACKET_LEN;
+	m = n/raw_fifo_decim;
+	if(m==0) return 0;
+	len = m*raw_fifo_decim*RAW_FIFO_PACKET_LEN;
+	if(__mpu_read_bytes(FIFO_R_W, len, raw_fifo_buf)!=len){
+		if(config.show_warnings){
+			fprintf(stderr,"ERROR: failed to read fifo buffer register\n");
+		}
+		return -1;
+	}
+	period_ns = 1000000000/((uint64_t)config.raw_fifo_sample_rate*raw_fifo_decim);
+	for(i=0;i<m;i++){
+		for(j=0;j<6;j++) sum[j]=0;
+		for(k=0;k<raw_fifo_decim;k++){
+			p = &raw_fifo_buf[(i*raw_fifo_decim+k)*RAW_FIFO_PACKET_LEN];
+			for(j=0;j<6;j++) sum[j] += (int16_t)(((uint16_t)p[2*j]<<8)|p[2*j+1]);
+		}
+		s = &raw_fifo_samples[i];
+		s->raw_accel[0] = sum[0]/raw_fifo_decim;
+		s->raw_accel[1] = sum[1]/raw_fifo_decim;
+		s->raw_accel[2] = sum[2]/raw_fifo_decim;
+		s->raw_gyro[0]  = sum[3]/raw_fifo_decim;
+		s->raw_gyro[1]  = sum[4]/raw_fifo_decim;
+		s->raw_gyro[2]  = sum[5]/raw_fifo_decim;
+		s->accel[0] = s->raw_accel[0] * data_ptr->accel_to_ms2 / accel_lengths[0];
+		s->accel[1] = s->raw_accel[1] * data_ptr->accel_to_ms2 / accel_lengths[1];
+		s->accel[2] = s->raw_accel[2] * data_ptr->accel_to_ms2 / accel_lengths[2];
+		s->gyro[0] = s->raw_gyro[0] * data_ptr->gyro_to_degs;
+		s->gyro[1] = s->raw_gyro[1] * data_ptr->gyro_to_degs;
+		s->gyro[2] = s->raw_gyro[2] * data_ptr->gyro_to_degs;
+		s->timestamp_ns = now - (uint64_t)(n-(i+1)*raw_fifo_decim)*period_ns;
+	}
+	return m;
+}
+
+
+/**
+ * Handler thread for raw FIFO mode. There is no FIFO watermark interrupt so
+ * it waits for the data ready interrupt of the first sample in a batch. That
+ * interrupt stays latched until the FIFO is read so no more edges arrive while
+ * it sleeps for the rest of the batch, then everything is drained at once.
+ *
+ * @return     NULL
+ */
+void* __raw_fifo_handler(__attribute__ ((unused)) void* ptr)
+{
+	int ret, n, i;
+	uint64_t batch_wait_us;
+
+	// the interrupt comes with the first FIFO packet of the batch
+	batch_wait_us = (uint64_t)(config.raw_fifo_batch_len*raw_fifo_decim-1)*1000000 \
+			/((uint64_t)config.raw_fifo_sample_rate*raw_fifo_decim);
+	__mpu_lock();
+	__raw_fifo_reset();
+	__mpu_unlock();
+
+	while(!imu_shutdown_flag){
+		// system hangs here until the first sample of a batch arrives
+		ret = rc_gpio_poll(	config.gpio_interrupt_pin_chip,
+					config.gpio_interrupt_pin,
+					IMU_POLL_TIMEOUT,
+					&last_interrupt_timestamp_nanos);
+		// check for bad things that may have happened
+		if(imu_shutdown_flag) break;
+		if(ret == RC_GPIOEVENT_ERROR){
+			fprintf(stderr, "ERROR in IMU interrupt handler calling poll\n");
+			continue;
+		}
+		if(ret == RC_GPIOEVENT_TIMEOUT){
+			if(config.show_warnings){
+				fprintf(stderr, "WARNING, gpio poll timeout\n");
+			}
+			continue;
+		}
+		// let the rest of the batch arrive
+		if(batch_wait_us) rc_usleep(batch_wait_us);
+		if(imu_shutdown_flag) break;
+
+		__mpu_lock();
+		n = __read_raw_fifo();
+		__mpu_unlock();
+		if(n<=0){
+			last_read_successful=0;
+			continue;
+		}
+		last_read_successful=1;
+
+		pthread_mutex_lock(&read_mutex);
+		// newest sample also goes in the user's data struct
+		for(i=0;i<3;i++){
+			data_ptr->raw_accel[i] = raw_fifo_samples[n-1].raw_accel[i];
+			data_ptr->raw_gyro[i] = raw_fifo_samples[n-1].raw_gyro[i];
+			data_ptr->accel[i] = raw_fifo_samples[n-1].accel[i];
+			data_ptr->gyro[i] = raw_fifo_samples[n-1].gyro[i];
+		}
+		if(raw_fifo_callback_func!=NULL) raw_fifo_callback_func(raw_fifo_samples, n);
+		// signals that a batch is available to blocking function
+		pthread_cond_broadcast(&read_condition);
+		pthread_mutex_unlock(&read_mutex);
+	}
+
+	// shutting down now, release any threads still waiting
+	pthread_mutex_lock(&read_mutex);
+	pthread_cond_broadcast(&read_condition);
+	pthread_mutex_unlock(&read_mutex);
+	thread_running_flag = 0;
+	return NULL;
+}
+
+int rc_mpu_block_until_dmp_data(void)
+{
+	if(imu_shutdown_flag!=0){
+		fprintf(stderr,"ERROR: call to rc_mpu_block_until_dmp_data after shutting down mpu\n");
+		return -1;
+	}
+	if(!thread_running_flag){
+		fprintf(stderr,"ERROR: call to rc_mpu_block_until_dmp_data when DMP handler not running\n");
+		return -1;
+	}
+	// wait for condition signal which unlocks mutex
+	pthread_mutex_lock(&read_mutex);
+	pthread_cond_wait(&read_condition, &read_mutex);
+	pthread_mutex_unlock(&read_mutex);
+	// check if condition was broadcast due to shutdown
+	if(imu_shutdown_flag) return 1;
+	// otherwise return 0 on actual button press
+	return 0;
+}
+
+int rc_mpu_block_until_tap(void)
+{
+	if(imu_shutdown_flag!=0){
+		fprintf(stderr,"ERROR: call to rc_mpu_block_until_tap after shutting down mpu\n");
+		return -1;
+	}
+	if(!thread_running_flag){
+		fprintf(stderr,"ERROR: call to rc_mpu_block_until_tap when DMP handler not running\n");
+		return -1;
+	}
+	// wait for condition signal which unlocks mutex
+	pthread_mutex_lock(&tap_mutex);
+	pthread_cond_wait(&tap_condition, &tap_mutex);
+	pthread_mutex_unlock(&tap_mutex);
+	// check if condition was broadcast due to shutdown
+	if(imu_shutdown_flag) return 1;
+	// otherwise return 0 on actual button press
+	return 0;
+}
+
+static int __mag_correct_orientation(double mag_vec[3])
+{
+	// create a quaternion vector from the current magnetic field vector
+	// in IMU body coordinate frame. Since the DMP quaternion is aligned with
 	// a particular orientation, we must be careful to orient the magnetometer
 	// data to match.
 	switch(config.orient){
@@ -3351,4 +4194,291 @@ static int __mag_correct_orientation(double mag_vec[3])
 	}
 	return 0;
 }
+
+
+/**
+ * Picks the transport table from the config. Must be called after the config
+ * is saved and before anything else touches the bus.
+ */
+int __transport_select(void)
+{
+	if(config.transport==MPU_TRANSPORT_SPI) transport = &spi_transport;
+	else transport = &i2c_transport;
+	return 0;
+}
+
+int __transport_init(void)
+{
+	return transport->init();
+}
+
+int __mpu_lock(void)
+{
+	return transport->lock();
+}
+
+int __mpu_unlock(void)
+{
+	return transport->unlock();
+}
+
+int __mpu_read_bytes(uint8_t reg, size_t count, uint8_t* data)
+{
+	return transport->read_bytes(reg, count, data);
+}
+
+int __mpu_read_byte(uint8_t reg, uint8_t* data)
+{
+	return transport->read_bytes(reg, 1, data);
+}
+
+/**
+ * reads a big endian 16-bit register pair like TEMP_OUT_H and FIFO_COUNTH
+ */
+int __mpu_read_word(uint8_t reg, uint16_t* data)
+{
+	uint8_t buf[2];
+	if(transport->read_bytes(reg, 2, buf)!=2) return -1;
+	*data = (uint16_t)((buf[0]<<8)|buf[1]);
+	return 2;
+}
+
+int __mpu_write_bytes(uint8_t reg, size_t count, uint8_t* data)
+{
+	return transport->write_bytes(reg, count, data);
+}
+
+int __mpu_write_byte(uint8_t reg, uint8_t data)
+{
+	return transport->write_bytes(reg, 1, &data);
+}
+
+int __mag_read_bytes(uint8_t reg, size_t count, uint8_t* data)
+{
+	return transport->mag_read_bytes(reg, count, data);
+}
+
+int __mag_write_byte(uint8_t reg, uint8_t data)
+{
+	return transport->mag_write_byte(reg, data);
+}
+
+
+/**
+ * I2C transport. The bus is shared with other devices so every access names
+ * its device address instead of relying on whatever was set last.
+ */
+int __i2c_init(void)
+{
+	return rc_i2c_init(config.i2c_bus, config.i2c_addr);
+}
+
+int __i2c_lock(void)
+{
+	return rc_i2c_lock_bus(config.i2c_bus);
+}
+
+int __i2c_unlock(void)
+{
+	return rc_i2c_unlock_bus(config.i2c_bus);
+}
+
+int __i2c_read_bytes(uint8_t reg, size_t count, uint8_t* data)
+{
+	return rc_i2c_read_device_bytes(config.i2c_bus, config.i2c_addr, reg, count, data);
+}
+
+int __i2c_write_bytes(uint8_t reg, size_t count, uint8_t* data)
+{
+	int ret;
+	rc_i2c_lock_bus(config.i2c_bus);
+	ret = rc_i2c_set_device_address(config.i2c_bus, config.i2c_addr);
+	if(ret==0) ret = rc_i2c_write_bytes(config.i2c_bus, reg, count, data);
+	rc_i2c_unlock_bus(config.i2c_bus);
+	return ret;
+}
+
+int __i2c_mag_read_bytes(uint8_t reg, size_t count, uint8_t* data)
+{
+	return rc_i2c_read_device_bytes(config.i2c_bus, AK8963_ADDR, reg, count, data);
+}
+
+int __i2c_mag_write_byte(uint8_t reg, uint8_t data)
+{
+	int ret;
+	rc_i2c_lock_bus(config.i2c_bus);
+	ret = rc_i2c_set_device_address(config.i2c_bus, AK8963_ADDR);
+	if(ret==0) ret = rc_i2c_write_byte(config.i2c_bus, reg, data);
+	// always go back to the MPU address
+	if(rc_i2c_set_device_address(config.i2c_bus, config.i2c_addr)) ret = -1;
+	rc_i2c_unlock_bus(config.i2c_bus);
+	return ret;
+}
+
+
+/**
+ * SPI transport. The MPU9250 only accepts 1mhz for general register access but
+ * the sensor, interrupt status and fifo registers may be read at up to 20mhz,
+ * so each transfer picks its own clock. The lock is recursive like the I2C bus
+ * lock so a setup sequence can hold it across many accesses.
+ */
+void __spi_init_mutex(void)
+{
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+	pthread_mutex_init(&spi_mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+int __spi_init(void)
+{
+	int speed;
+	// already open from a previous initialization
+	if(spi_fd!=-1) return 0;
+	speed = config.spi_speed_hz;
+	if(speed>MPU_SPI_MAX_SPEED) speed = MPU_SPI_MAX_SPEED;
+	if(speed<MPU_SPI_REG_SPEED) speed = MPU_SPI_REG_SPEED;
+	config.spi_speed_hz = speed;
+	if(rc_spi_init_auto_slave(config.spi_bus, config.spi_slave, SPI_MODE_3, speed)){
+		fprintf(stderr,"ERROR in __spi_init, failed to initialize spi bus\n");
+		return -1;
+	}
+	spi_fd = rc_spi_get_fd(config.spi_bus, config.spi_slave);
+	if(spi_fd==-1) return -1;
+	return 0;
+}
+
+int __spi_lock(void)
+{
+	pthread_once(&spi_mutex_once, __spi_init_mutex);
+	return pthread_mutex_lock(&spi_mutex) ? -1 : 0;
+}
+
+int __spi_unlock(void)
+{
+	pthread_once(&spi_mutex_once, __spi_init_mutex);
+	return pthread_mutex_unlock(&spi_mutex) ? -1 : 0;
+}
+
+/**
+ * full duplex transfer of len bytes in place, buf[0] is the command byte
+ */
+int __spi_xfer(uint8_t* buf, size_t len, uint32_t speed_hz)
+{
+	struct spi_ioc_transfer xfer;
+	memset(&xfer, 0, sizeof(xfer));
+	xfer.tx_buf = (unsigned long)buf;
+	xfer.rx_buf = (unsigned long)buf;
+	xfer.len = len;
+	xfer.speed_hz = speed_hz;
+	xfer.bits_per_word = RC_SPI_BITS_PER_WORD;
+	if(unlikely(ioctl(spi_fd, SPI_IOC_MESSAGE(1), &xfer)<0)){
+		perror("ERROR in mpu spi transfer");
+		return -1;
+	}
+	return 0;
+}
+
+int __spi_read_bytes(uint8_t reg, size_t count, uint8_t* data)
+{
+	uint8_t buf[count+1];
+	uint32_t speed = MPU_SPI_REG_SPEED;
+	if(unlikely(spi_fd==-1)){
+		fprintf(stderr,"ERROR in __spi_read_bytes, spi not initialized yet\n");
+		return -1;
+	}
+	// sensor data, interrupt status and fifo may be read at the fast clock
+	if((reg>=INT_STATUS && reg<=EXT_SENS_DATA_23) ||
+	   (reg>=FIFO_COUNTH && reg<=FIFO_R_W)) speed = config.spi_speed_hz;
+	memset(buf, 0, count+1);
+	buf[0] = reg|MPU_SPI_READ;
+	__spi_lock();
+	if(__spi_xfer(buf, count+1, speed)){
+		__spi_unlock();
+		return -1;
+	}
+	__spi_unlock();
+	memcpy(data, buf+1, count);
+	return count;
+}
+
+int __spi_write_bytes(uint8_t reg, size_t count, uint8_t* data)
+{
+	uint8_t buf[count+1];
+	if(unlikely(spi_fd==-1)){
+		fprintf(stderr,"ERROR in __spi_write_bytes, spi not initialized yet\n");
+		return -1;
+	}
+	buf[0] = reg;
+	memcpy(buf+1, data, count);
+	// the rest of the driver writes USER_CTRL as if on I2C, keep the I2C
+	// interface off so it can't glitch the SPI bus and keep the I2C master
+	// running while it feeds the magnetometer into EXT_SENS_DATA
+	if(reg==USER_CTRL){
+		buf[1] |= I2C_IF_DIS;
+		if(mag_ext_sens_en) buf[1] |= I2C_MST_EN;
+	}
+	__spi_lock();
+	if(__spi_xfer(buf, count+1, MPU_SPI_REG_SPEED)){
+		__spi_unlock();
+		return -1;
+	}
+	__spi_unlock();
+	return 0;
+}
+
+/**
+ * Single byte read or write of an AK8963 register through slave 4 of the
+ * MPU's I2C master, which must already be enabled. Polls I2C_MST_STATUS until
+ * the transaction completes.
+ */
+int __slv4_transfer(uint8_t reg, uint8_t* data, int read)
+{
+	int i;
+	uint8_t status;
+	if(__mpu_write_byte(I2C_SLV4_ADDR, AK8963_ADDR|(read?BIT_I2C_READ:0))) return -1;
+	if(__mpu_write_byte(I2C_SLV4_REG, reg)) return -1;
+	if(!read && __mpu_write_byte(I2C_SLV4_DO, *data)) return -1;
+	if(__mpu_write_byte(I2C_SLV4_CTRL, BIT_SLAVE_EN)) return -1;
+	for(i=0;i<SLV4_TIMEOUT_POLLS;i++){
+		rc_usleep(100);
+		if(__mpu_read_byte(I2C_MST_STATUS, &status)<0) return -1;
+		if(status&I2C_SLV4_NACK){
+			fprintf(stderr,"ERROR in __slv4_transfer, magnetometer did not acknowledge\n");
+			return -1;
+		}
+		if(status&I2C_SLV4_DONE){
+			if(read && __mpu_read_byte(I2C_SLV4_DI, data)<0) return -1;
+			return 0;
+		}
+	}
+	fprintf(stderr,"ERROR in __slv4_transfer, timeout waiting for magnetometer\n");
+	return -1;
+}
+
+int __spi_mag_read_bytes(uint8_t reg, size_t count, uint8_t* data)
+{
+	size_t i;
+	__spi_lock();
+	for(i=0;i<count;i++){
+		if(__slv4_transfer(reg+i, &data[i], 1)){
+			__spi_unlock();
+			return -1;
+		}
+	}
+	__spi_unlock();
+	return count;
+}
+
+int __spi_mag_write_byte(uint8_t reg, uint8_t data)
+{
+	int ret;
+	__spi_lock();
+	ret = __slv4_transfer(reg, &data, 0);
+	__spi_unlock();
+	return ret;
+}
+
 // Phew, that was a lot of code....
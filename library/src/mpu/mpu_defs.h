@@ -12,6 +12,16 @@ identical but the latter has a different register map
 // internal DMP sample rate limits
 #define DMP_MAX_RATE		200
 #define DMP_MIN_RATE		4
+// raw FIFO mode sample rate limits. Up to 1khz the sample rate divider runs
+// off the 1khz internal rate with the DLPF on. Faster rates are SPI only and
+// bypass the DLPFs, the FIFO then fills at 8khz and is decimated down. The
+// accel only updates at 4khz in bypass so that is the fastest useful rate.
+#define RAW_FIFO_DIV_RATE	1000
+#define RAW_FIFO_BYPASS_RATE	8000
+#define RAW_FIFO_MAX_RATE	4000
+#define RAW_FIFO_MIN_RATE	4
+#define RAW_FIFO_PACKET_LEN	12	// 6 accel then 6 gyro, big endian
+#define RAW_FIFO_SIZE		1024	// set with BIT_FIFO_SIZE_1024
 #define IMU_POLL_TIMEOUT	300 // milliseconds
 
 
@@ -241,6 +251,35 @@ identical but the latter has a different register map
 #define I2C_MST_RST		0x01<<1
 #define SIG_COND_RST		0x01
 
+/*******************************************************************
+* I2C_MST_CTRL settings bits
+*******************************************************************/
+#define WAIT_FOR_ES		0x01<<6
+#define I2C_MST_CLK_400KHZ	0x0D
+#define I2C_MST_CLK_MASK	0x0F
+
+/*******************************************************************
+* I2C_MST_STATUS settings bits
+*******************************************************************/
+#define I2C_SLV4_DONE		0x01<<6
+#define I2C_SLV4_NACK		0x01<<4
+#define SLV4_TIMEOUT_POLLS	100	// 100 polls of 100us is 10ms
+
+/*******************************************************************
+* SPI interface, registers may only be accessed at up to 1mhz while
+* the sensor and interrupt registers can be read at up to 20mhz
+*******************************************************************/
+#define MPU_SPI_READ		0x80
+#define MPU_SPI_REG_SPEED	1000000
+#define MPU_SPI_MAX_SPEED	20000000
+
+/*******************************************************************
+* burst read of ACCEL_XOUT_H through GYRO_ZOUT_L, and the AK8963 ST1
+* through ST2 registers when copied into EXT_SENS_DATA_00 onwards
+*******************************************************************/
+#define SENSOR_BURST_LEN	14
+#define MAG_EXT_SENS_LEN	8
+
 /******************************************************************
 * Magnetometer Registers
 ******************************************************************/
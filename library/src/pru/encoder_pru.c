@@ -8,13 +8,23 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdatomic.h>
 #include <rc/pru.h>
 #include <rc/time.h>
 #include <rc/encoder_pru.h>
 
 #define ENCODER_PRU_CH		0 // PRU0
 #define ENCODER_PRU_FW		"am335x-pru0-rc-encoder-fw"
-#define ENCODER_MEM_OFFSET	16
+// status and command block, must match pru0-encoder.asm. Each status bank is
+// the count followed by the PRU timestamp of the last change.
+#define GEN_MEM_OFFSET		16	// status generation, low bit picks the bank
+#define CMD_MEM_OFFSET		17	// command generation written by the ARM
+#define ACK_MEM_OFFSET		18	// last command generation handled by the PRU
+#define VAL_MEM_OFFSET		19	// new count for the PRU to set
+#define BANK_MEM_OFFSET		20	// first of the two status banks
+#define BANK_LEN		2
+#define READ_TRIES		100	// give up if the PRU laps the reader this often
+#define ACK_TIMEOUT_US		100000
 
 // pru shared memory pointer
 static volatile unsigned int* shared_mem_32bit_ptr = NULL;
@@ -30,8 +40,9 @@ int rc_encoder_pru_init(void)
 		init_flag=0;
 		return -1;
 	}
-	// set first channel to be nonzero, PRU binary will zero this out later
-	shared_mem_32bit_ptr[ENCODER_MEM_OFFSET]=42;
+	// set the status generation to be nonzero, PRU binary will zero this out
+	shared_mem_32bit_ptr[GEN_MEM_OFFSET]=42;
+	shared_mem_32bit_ptr[CMD_MEM_OFFSET]=0;
 
 	// start pru
 	if(rc_pru_start(ENCODER_PRU_CH, ENCODER_PRU_FW)){
@@ -41,7 +52,7 @@ int rc_encoder_pru_init(void)
 
 	// make sure memory actually got zero'd out
 	for(i=0;i<40;i++){
-		if(shared_mem_32bit_ptr[ENCODER_MEM_OFFSET]==0){
+		if(shared_mem_32bit_ptr[GEN_MEM_OFFSET]==0){
 			init_flag=1;
 			return 0;
 		}
@@ -58,9 +69,10 @@ int rc_encoder_pru_init(void)
 
 void rc_encoder_pru_cleanup(void)
 {
+	int i;
 	// zero out shared memory
 	if(shared_mem_32bit_ptr != NULL){
-		shared_mem_32bit_ptr[ENCODER_MEM_OFFSET]=0;
+		for(i=0;i<2*BANK_LEN;i++) shared_mem_32bit_ptr[BANK_MEM_OFFSET+i]=0;
 	}
 	rc_pru_stop(ENCODER_PRU_CH);
 	shared_mem_32bit_ptr = NULL;
@@ -71,20 +83,66 @@ void rc_encoder_pru_cleanup(void)
 
 int rc_encoder_pru_read(void)
 {
+	rc_encoder_pru_sample_t s;
 	if(shared_mem_32bit_ptr==NULL || init_flag==0){
 		fprintf(stderr, "ERROR in rc_encoder_pru_read, call rc_encoder_pru_init first\n");
 		return -1;
 	}
-	return (int) shared_mem_32bit_ptr[ENCODER_MEM_OFFSET];
+	if(rc_encoder_pru_read_sample(&s)) return -1;
+	return s.position;
+}
+
+
+int rc_encoder_pru_read_sample(rc_encoder_pru_sample_t* s)
+{
+	int i;
+	uint32_t gen;
+	volatile unsigned int* bank;
+	if(shared_mem_32bit_ptr==NULL || init_flag==0){
+		fprintf(stderr, "ERROR in rc_encoder_pru_read_sample, call rc_encoder_pru_init first\n");
+		return -1;
+	}
+	if(s==NULL){
+		fprintf(stderr, "ERROR in rc_encoder_pru_read_sample, received NULL pointer\n");
+		return -1;
+	}
+	for(i=0;i<READ_TRIES;i++){
+		gen = shared_mem_32bit_ptr[GEN_MEM_OFFSET];
+		atomic_thread_fence(memory_order_acquire);
+		bank = shared_mem_32bit_ptr + BANK_MEM_OFFSET + (gen&1)*BANK_LEN;
+		s->position = (int)bank[0];
+		s->ticks = bank[1];
+		atomic_thread_fence(memory_order_acquire);
+		// the PRU writes the next sample into this bank as soon as it moves
+		// past gen, so only a generation that hasn't moved is a clean copy
+		if(shared_mem_32bit_ptr[GEN_MEM_OFFSET]==gen){
+			s->generation = gen;
+			return 0;
+		}
+	}
+	fprintf(stderr, "ERROR in rc_encoder_pru_read_sample, PRU kept overwriting the sample\n");
+	return -1;
 }
 
 
 int rc_encoder_pru_write(int pos)
 {
+	int i;
+	uint32_t cmd;
 	if(shared_mem_32bit_ptr==NULL || init_flag==0){
 		fprintf(stderr, "ERROR in rc_encoder_pru_write, call rc_encoder_pru_init first\n");
 		return -1;
 	}
-	shared_mem_32bit_ptr[ENCODER_MEM_OFFSET] = pos;
-	return 0;
+	// hand the PRU the new count and wait for it to take it, writing the
+	// counter directly would race with the PRU's own updates
+	cmd = shared_mem_32bit_ptr[CMD_MEM_OFFSET]+1;
+	shared_mem_32bit_ptr[VAL_MEM_OFFSET] = pos;
+	atomic_thread_fence(memory_order_seq_cst);
+	shared_mem_32bit_ptr[CMD_MEM_OFFSET] = cmd;
+	for(i=0;i<ACK_TIMEOUT_US/10;i++){
+		if(shared_mem_32bit_ptr[ACK_MEM_OFFSET]==cmd) return 0;
+		rc_usleep(10);
+	}
+	fprintf(stderr, "ERROR in rc_encoder_pru_write, PRU did not acknowledge the new position\n");
+	return -1;
 }
@@ -8,6 +8,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdatomic.h>
 #include <math.h> //for lround
 #include <rc/pru.h>
 #include <rc/gpio.h>
@@ -18,11 +19,47 @@
 #define GPIO_POWER_PIN	2,16	//gpio2.16 P8.36
 #define SERVO_PRU_CH	1	// PRU1
 #define SERVO_PRU_FW	"am335x-pru1-rc-servo-fw"
-#define PRU_SERVO_LOOP_INSTRUCTIONS 48 // instructions per PRU servo timer loop
+#define PRU_SERVO_LOOP_INSTRUCTIONS 49 // instructions per PRU servo timer loop
+// continuous mode command block, must match pru1-servo.asm. Each bank is the
+// frame period in loops (0 disables continuous mode) then 8 widths in loops.
+#define GEN_MEM_OFFSET		32	// generation written by the ARM, low bit picks the bank
+#define ACK_MEM_OFFSET		33	// last generation latched by the PRU
+#define BANK_MEM_OFFSET		34	// first of the two banks
+#define BANK_LEN		(1+RC_SERVO_CH_MAX)
 
 // pru shared memory pointer
 static volatile unsigned int* shared_mem_32bit_ptr = NULL;
 static int init_flag=0;
+static int frame_hz=0;		// continuous mode frame rate, 0 when disabled
+static int latched_us[RC_SERVO_CH_MAX];
+static uint32_t generation=0;	// last generation handed to the PRU
+
+/**
+ * Copies the frame rate and all latched widths into the bank the PRU isn't
+ * using and then flips the generation so the PRU latches every channel at the
+ * start of the same frame. The PRU never reads the bank of the current
+ * generation while it's being written since the ARM only ever writes the
+ * other one, and it rereads the generation after copying a bank to catch the
+ * ARM lapping it.
+ */
+static void __commit(void)
+{
+	int i;
+	uint32_t next = generation+1;
+	volatile unsigned int* bank;
+	bank = shared_mem_32bit_ptr + BANK_MEM_OFFSET + (next&1)*BANK_LEN;
+	if(frame_hz==0) bank[0] = 0;
+	else bank[0] = (((1000000.0/frame_hz)*200.0)/PRU_SERVO_LOOP_INSTRUCTIONS);
+	for(i=0;i<RC_SERVO_CH_MAX;i++){
+		bank[1+i] = ((latched_us[i]*200.0)/PRU_SERVO_LOOP_INSTRUCTIONS);
+	}
+	atomic_thread_fence(memory_order_seq_cst);
+	shared_mem_32bit_ptr[GEN_MEM_OFFSET] = next;
+	// the flip must land before anything writes the next bank
+	atomic_thread_fence(memory_order_seq_cst);
+	generation = next;
+	return;
+}
 
 static int esc_max_us =  RC_ESC_DEFAULT_MAX_US;
 static int esc_min_us =  RC_ESC_DEFAULT_MIN_US;
@@ -48,6 +85,13 @@ int rc_servo_init(void)
 		// write to PRU shared memory
 		shared_mem_32bit_ptr[i-1] = 42;
 	}
+	// start with continuous mode off and nothing latched
+	for(i=0;i<2*BANK_LEN;i++) shared_mem_32bit_ptr[BANK_MEM_OFFSET+i] = 0;
+	for(i=0;i<RC_SERVO_CH_MAX;i++) latched_us[i] = 0;
+	shared_mem_32bit_ptr[GEN_MEM_OFFSET] = 0;
+	shared_mem_32bit_ptr[ACK_MEM_OFFSET] = 0;
+	generation = 0;
+	frame_hz = 0;
 
 	// start pru
 	if(rc_pru_start(SERVO_PRU_CH, SERVO_PRU_FW)){
@@ -78,7 +122,9 @@ void rc_servo_cleanup(void)
 	// zero out shared memory
 	if(shared_mem_32bit_ptr != NULL){
 		for(i=0;i<RC_SERVO_CH_MAX;i++) shared_mem_32bit_ptr[i]=0;
+		for(i=0;i<2*BANK_LEN;i++) shared_mem_32bit_ptr[BANK_MEM_OFFSET+i]=0;
 	}
+	frame_hz=0;
 	if(init_flag!=0){
 		rc_gpio_set_value(GPIO_POWER_PIN,0);
 		rc_gpio_cleanup(GPIO_POWER_PIN);
@@ -132,6 +178,10 @@ int rc_servo_send_pulse_us(int ch, int us)
 		fprintf(stderr,"ERROR: in rc_servo_send_pulse_us, call rc_servo_init first\n");
 		return -1;
 	}
+	if(frame_hz!=0){
+		fprintf(stderr,"ERROR: in rc_servo_send_pulse_us, continuous mode is running, use rc_servo_set_pulse_us instead\n");
+		return -1;
+	}
 
 
 	// calculate what to write to pru shared memory to set pulse width
@@ -205,3 +255,146 @@ int rc_servo_send_oneshot_pulse_normalized(int ch, double input)
 	us = 125 + lround(input*125.0);
 	return rc_servo_send_pulse_us(ch, us);
 }
+
+
+
+int rc_servo_start_continuous(int hz)
+{
+	int i;
+	if(init_flag==0){
+		fprintf(stderr,"ERROR: in rc_servo_start_continuous, call rc_servo_init first\n");
+		return -1;
+	}
+	if(hz<1 || hz>RC_SERVO_MAX_FRAME_HZ){
+		fprintf(stderr,"ERROR: in rc_servo_start_continuous, frame rate must be between 1 & %d\n", RC_SERVO_MAX_FRAME_HZ);
+		return -1;
+	}
+	// latched pulses must end before the next frame starts
+	for(i=0;i<RC_SERVO_CH_MAX;i++){
+		if(latched_us[i]>=1000000/hz){
+			fprintf(stderr,"ERROR: in rc_servo_start_continuous, %dus pulse on channel %d is longer than a frame\n", latched_us[i], i+1);
+			return -1;
+		}
+	}
+	// PRU picks this up within the next 1000 loops
+	frame_hz = hz;
+	__commit();
+	return 0;
+}
+
+
+int rc_servo_stop_continuous(void)
+{
+	if(init_flag==0){
+		fprintf(stderr,"ERROR: in rc_servo_stop_continuous, call rc_servo_init first\n");
+		return -1;
+	}
+	// latched widths are kept so continuous mode can be started again
+	frame_hz = 0;
+	__commit();
+	return 0;
+}
+
+
+int rc_servo_set_pulse_us(int ch, int us)
+{
+	int i;
+	// Sanity Checks
+	if(ch<0 || ch>RC_SERVO_CH_MAX){
+		fprintf(stderr,"ERROR: in rc_servo_set_pulse_us, channel argument must be between 0&%d\n", RC_SERVO_CH_MAX);
+		return -1;
+	}
+	if(init_flag==0){
+		fprintf(stderr,"ERROR: in rc_servo_set_pulse_us, call rc_servo_init first\n");
+		return -1;
+	}
+	if(us<0){
+		fprintf(stderr,"ERROR: in rc_servo_set_pulse_us, pulse width can't be negative\n");
+		return -1;
+	}
+	if(frame_hz!=0 && us>=1000000/frame_hz){
+		fprintf(stderr,"ERROR: in rc_servo_set_pulse_us, %dus pulse is longer than a %dhz frame\n", us, frame_hz);
+		return -1;
+	}
+
+	for(i=RC_SERVO_CH_MIN;i<=RC_SERVO_CH_MAX;i++){
+		if(ch!=0 && ch!=i) continue;
+		latched_us[i-1] = us;
+	}
+	__commit();
+	return 0;
+}
+
+
+int rc_servo_set_all_pulse_us(const int us[])
+{
+	int i;
+	if(init_flag==0){
+		fprintf(stderr,"ERROR: in rc_servo_set_all_pulse_us, call rc_servo_init first\n");
+		return -1;
+	}
+	if(us==NULL){
+		fprintf(stderr,"ERROR: in rc_servo_set_all_pulse_us, received NULL pointer\n");
+		return -1;
+	}
+	// check everything first so a bad channel doesn't leave a partial update
+	for(i=0;i<RC_SERVO_CH_MAX;i++){
+		if(us[i]<0){
+			fprintf(stderr,"ERROR: in rc_servo_set_all_pulse_us, pulse width on channel %d can't be negative\n", i+1);
+			return -1;
+		}
+		if(frame_hz!=0 && us[i]>=1000000/frame_hz){
+			fprintf(stderr,"ERROR: in rc_servo_set_all_pulse_us, %dus pulse on channel %d is longer than a %dhz frame\n", us[i], i+1, frame_hz);
+			return -1;
+		}
+	}
+	for(i=0;i<RC_SERVO_CH_MAX;i++) latched_us[i] = us[i];
+	__commit();
+	return 0;
+}
+
+
+int rc_servo_is_latched(void)
+{
+	if(init_flag==0){
+		fprintf(stderr,"ERROR: in rc_servo_is_latched, call rc_servo_init first\n");
+		return -1;
+	}
+	return shared_mem_32bit_ptr[ACK_MEM_OFFSET]==generation;
+}
+
+
+int rc_servo_set_pulse_normalized(int ch, double input)
+{
+	int us;
+	if(input<(-1.5-TOL) || input>(1.5+TOL)){
+		fprintf(stderr,"ERROR in rc_servo_set_pulse_normalized, normalized input must be between -1.5 & 1.5\n");
+		return -1;
+	}
+	us = 1500 + lround((input*600.0));
+	return rc_servo_set_pulse_us(ch, us);
+}
+
+
+int rc_servo_set_esc_pulse_normalized(int ch, double input)
+{
+	int us;
+	if(input<(-0.1-TOL) || input>(1.0+TOL)){
+		fprintf(stderr,"ERROR in rc_servo_set_esc_pulse_normalized, normalized input must be between -0.1 & 1.0\n");
+		return -1;
+	}
+	us = esc_min_us + lround((input*(esc_max_us-esc_min_us)));
+	return rc_servo_set_pulse_us(ch, us);
+}
+
+
+int rc_servo_set_oneshot_pulse_normalized(int ch, double input)
+{
+	int us;
+	if(input<(-0.1-TOL) || input>(1.0+TOL)){
+		fprintf(stderr,"ERROR in rc_servo_set_oneshot_pulse_normalized, normalized input must be between -0.1 & 1.0\n");
+		return -1;
+	}
+	us = 125 + lround(input*125.0);
+	return rc_servo_set_pulse_us(ch, us);
+}
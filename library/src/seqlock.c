@@ -0,0 +1,70 @@
+/**
+ * @file seqlock.c
+ */
+
+#include <string.h>
+#include "seqlock.h"
+
+// a reader only retries if a whole new value was published during its copy
+#define LATEST_READ_TRIES	10
+
+uint64_t __seqlock_write_begin(_Atomic uint64_t* seq)
+{
+	uint64_t s = atomic_load_explicit(seq, memory_order_relaxed);
+	atomic_store_explicit(seq, s+1, memory_order_relaxed);
+	// keep the data writes from moving above the odd count
+	atomic_thread_fence(memory_order_release);
+	return s/2 + 1;
+}
+
+void __seqlock_write_end(_Atomic uint64_t* seq)
+{
+	uint64_t s = atomic_load_explicit(seq, memory_order_relaxed);
+	atomic_store_explicit(seq, s+1, memory_order_release);
+}
+
+int __seqlock_read(_Atomic uint64_t* seq, void* dst, const void* src, size_t len)
+{
+	uint64_t s;
+	for(;;){
+		s = atomic_load_explicit(seq, memory_order_acquire);
+		if(s==0) return 0;
+		if(s&1) continue; // writer is mid write, load the count again
+		memcpy(dst, src, len);
+		// the copy must finish before checking the count didn't change
+		atomic_thread_fence(memory_order_acquire);
+		if(atomic_load_explicit(seq, memory_order_relaxed)==s) return 1;
+	}
+}
+
+void* __seqlock_latest_begin(_Atomic uint64_t* count, void* slots, size_t len, uint64_t* n)
+{
+	uint64_t c = atomic_load_explicit(count, memory_order_relaxed);
+	// slot c&1 holds the latest value, fill the other one. Keep these writes
+	// from moving above the store that published the slot last time.
+	atomic_thread_fence(memory_order_release);
+	*n = c+1;
+	return (char*)slots + ((c+1)&1)*len;
+}
+
+void __seqlock_latest_end(_Atomic uint64_t* count)
+{
+	uint64_t c = atomic_load_explicit(count, memory_order_relaxed);
+	atomic_store_explicit(count, c+1, memory_order_release);
+}
+
+int __seqlock_latest_read(_Atomic uint64_t* count, void* dst, const void* slots, size_t len)
+{
+	int i;
+	uint64_t c;
+	for(i=0;i<LATEST_READ_TRIES;i++){
+		c = atomic_load_explicit(count, memory_order_acquire);
+		if(c==0) return 0;
+		memcpy(dst, (const char*)slots + (c&1)*len, len);
+		// the copy must finish before checking the count didn't change. Once
+		// it moves on the writer may be refilling this slot.
+		atomic_thread_fence(memory_order_acquire);
+		if(atomic_load_explicit(count, memory_order_relaxed)==c) return 1;
+	}
+	return -1;
+}
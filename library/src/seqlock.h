@@ -0,0 +1,64 @@
+/**
+ * @file seqlock.h
+ *
+ * single writer sequence lock shared by the background samplers. The counter
+ * is odd while the writer is changing the protected data and even otherwise,
+ * 0 means nothing has been published yet. Readers copy the data and retry if
+ * a write was in progress or finished while they copied.
+ *
+ * The __seqlock_latest functions are a double buffered variant for publishing
+ * a single latest value. The writer fills the slot readers aren't pointed at,
+ * so a reader never waits for a writer that was preempted mid write.
+ */
+
+#ifndef RC_SEQLOCK_H
+#define RC_SEQLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/*
+ * Starts a write, the data may be changed until __seqlock_write_end. Only one
+ * thread may write under a given counter.
+ *
+ * Returns the number of this write, 1 for the first one.
+ */
+uint64_t __seqlock_write_begin(_Atomic uint64_t* seq);
+
+/*
+ * Finishes the write started by __seqlock_write_begin.
+ */
+void __seqlock_write_end(_Atomic uint64_t* seq);
+
+/*
+ * Copies len bytes from src to dst, waiting out any write in progress.
+ *
+ * Returns 1 once an untorn copy was made, 0 if nothing was published yet.
+ */
+int __seqlock_read(_Atomic uint64_t* seq, void* dst, const void* src, size_t len);
+
+/*
+ * Starts publishing a new latest value. slots holds two values of len bytes
+ * each, count is the number of values published so far. Only one thread may
+ * write under a given count.
+ *
+ * Returns the slot to fill in, n is set to the number of this value, 1 for
+ * the first one.
+ */
+void* __seqlock_latest_begin(_Atomic uint64_t* count, void* slots, size_t len, uint64_t* n);
+
+/*
+ * Makes the slot filled in since __seqlock_latest_begin the latest value.
+ */
+void __seqlock_latest_end(_Atomic uint64_t* count);
+
+/*
+ * Copies the latest value into dst without waiting on the writer.
+ *
+ * Returns 1 if copied, 0 if nothing was published yet, -1 if the writer kept
+ * publishing faster than the copy could be made.
+ */
+int __seqlock_latest_read(_Atomic uint64_t* count, void* dst, const void* slots, size_t len);
+
+#endif // RC_SEQLOCK_H
@@ -35,6 +35,7 @@
 
 ; PRU setup definitions
 	; .asg    C4,     CONST_SYSCFG
+	.asg    C26,    CONST_IEP
 	.asg    C28,    CONST_PRUSHAREDRAM
 
 	.asg	0x22000,	PRU0_CTRL
@@ -44,7 +45,19 @@
 	.asg	0x000,	OWN_RAM
 	.asg	0x020,	OTHER_RAM
 	.asg    0x100,	SHARED_RAM       ; This is so prudebug can find it.
-	.asg    64,     CNT_OFFSET
+	.asg	0x00,	IEP_TMR_GLB_CFG
+	.asg	0x0C,	IEP_TMR_CNT	; free running 200MHz timer
+
+; status and command block, see encoder_pru.c for the matching layout. Each
+; status bank is the count followed by the IEP timestamp of the last change.
+; A new count is written to the bank the ARM isn't reading before the
+; generation is bumped, its low bit selects the bank to read.
+	.asg	64,	GEN_OFFSET	; status generation, written by the PRU
+	.asg	68,	CMD_OFFSET	; command generation, written by the ARM
+	.asg	72,	ACK_OFFSET	; last command generation handled by the PRU
+	.asg	76,	VAL_OFFSET	; new count to set
+	.asg	80,	BANK0_OFFSET
+	.asg	88,	BANK1_OFFSET
 
 ; Encoder counting definitions
 ; these pin definitions are specific to SD-101D Robotics Cape
@@ -52,19 +65,20 @@
 	.asg	r1,			EXOR	; place to store the XOR of old with new AB vals
 	.asg	14,			A
 	.asg	15,			B
+	.asg	r2,			COUNT	; counter lives in a register now
+	.asg	r3,			STAMP	; must follow COUNT for the bank write
+	.asg	r4,			GEN		; status generation
+	.asg	r5,			ACKED	; last command generation handled
+	.asg	r7,			CMD		; command generation just read
 
 increment	.macro
-	LBCO	&r2, CONST_PRUSHAREDRAM, CNT_OFFSET, 4	; load existing counter from shared memory
-	ADD	r2, r2, 1		; increment
-	SBCO	&r2, CONST_PRUSHAREDRAM, CNT_OFFSET, 4	; write to shared memory
-	QBA CHECKPINS				; jump back to main CHECKPINS
+	ADD	COUNT, COUNT, 1		; increment
+	QBA PUBLISH				; publish the new count
 	.endm
 
 decrement	.macro
-	LBCO	&r2, CONST_PRUSHAREDRAM, CNT_OFFSET, 4	; load existing counter from shared memory
-	SUB 	r2, r2, 1		; subtract 1
-	SBCO	&r2, CONST_PRUSHAREDRAM, CNT_OFFSET, 4	; write to shared memory
-	QBA CHECKPINS				;/ jump back to main CHECKPINS
+	SUB 	COUNT, COUNT, 1		; subtract 1
+	QBA PUBLISH				; publish the new count
 	.endm
 
 	.clink
@@ -80,14 +94,41 @@ start:
 
 ; initialize by setting current state of two channels
 	MOV 	OLD, r31
-	zero	&r2, 4
-	SBCO	&r2, CONST_PRUSHAREDRAM, CNT_OFFSET, 4	; write 0 to shared memory
+	LDI	COUNT, 0
+	LDI	STAMP, 0
+	LDI	GEN, 0
+	SBCO	&COUNT, CONST_PRUSHAREDRAM, BANK0_OFFSET, 8
+	SBCO	&COUNT, CONST_PRUSHAREDRAM, BANK1_OFFSET, 8
+	LBCO	&ACKED, CONST_PRUSHAREDRAM, CMD_OFFSET, 4	; ignore stale commands
+	SBCO	&ACKED, CONST_PRUSHAREDRAM, ACK_OFFSET, 4
+; start the IEP timer counting up by 1 every cycle to timestamp changes
+	LDI	r6, 0x0111
+	SBCO	&r6, CONST_IEP, IEP_TMR_GLB_CFG, 4
+	SBCO	&GEN, CONST_PRUSHAREDRAM, GEN_OFFSET, 4	; write 0 so the ARM knows we started
 
 ; CHECKPINS here forever looking for pin changes
 CHECKPINS:
 	XOR EXOR, OLD, r31
 	QBBS A_CHANGED, EXOR, A	; Branch if CHA has toggled
 	QBBS B_CHANGED, EXOR, B ; Branch if CHB has toggled
+	LBCO	&CMD, CONST_PRUSHAREDRAM, CMD_OFFSET, 4	; check for a command from the ARM
+	QBEQ CHECKPINS, CMD, ACKED
+	LBCO	&COUNT, CONST_PRUSHAREDRAM, VAL_OFFSET, 4	; set the new count
+	MOV	ACKED, CMD
+	SBCO	&ACKED, CONST_PRUSHAREDRAM, ACK_OFFSET, 4	; acknowledge the command
+
+; write the count and timestamp to the bank the ARM isn't reading, then flip
+; the generation so the ARM never sees half an update
+PUBLISH:
+	LBCO	&STAMP, CONST_IEP, IEP_TMR_CNT, 4	; timestamp the change
+	ADD	GEN, GEN, 1
+	QBBS	PUBLISH_BANK1, GEN, 0		; low bit selects the bank
+	SBCO	&COUNT, CONST_PRUSHAREDRAM, BANK0_OFFSET, 8
+	QBA	PUBLISH_GEN
+PUBLISH_BANK1:
+	SBCO	&COUNT, CONST_PRUSHAREDRAM, BANK1_OFFSET, 8
+PUBLISH_GEN:
+	SBCO	&GEN, CONST_PRUSHAREDRAM, GEN_OFFSET, 4
 	QBA CHECKPINS
 
 
@@ -53,6 +53,16 @@ start:
 	.asg	0x020,	OTHER_RAM
 	.asg    0x100,	SHARED_RAM       ; This is so prudebug can find it.
 
+; latched continuous mode command block, see servo.c for the matching layout.
+; Each bank holds the frame period in loops (0 disables) followed by 8 widths
+; in loops (0 is off). The ARM fills the bank it isn't using, then bumps the
+; generation whose low bit selects the bank to latch.
+	.asg	0x80,	GEN_OFFSET	; generation written by the ARM
+	.asg	0x84,	ACK_OFFSET	; last generation latched by the PRU
+	.asg	0x88,	BANK0_OFFSET
+	.asg	0xAC,	BANK1_OFFSET
+	.asg	1000,	FRAME_POLL	; loops between checks while disabled
+
 	LBCO	&r0, CONST_SYSCFG, 4, 4		; Enable OCP master port
 	CLR 	r0, r0, 4					; Clear SYSCFG[STANDBY_INIT] to enable OCP master port
 	SBCO	&r0, CONST_SYSCFG, 4, 4
@@ -72,10 +82,11 @@ start:
 	LDI 	r5, 0x0
 	LDI 	r6, 0x0
 	LDI32 	r7, 0x0
+	LDI32	r8, FRAME_POLL			; frame counter
 	LDI 	r30, 0x0				; turn off GPIO outputs
 
 
-; Beginning of loop, should always take 48 instructions to complete
+; Beginning of loop, should always take 49 instructions to complete
 CH1:
 	QBEQ	CLR1, r0, 0			; If timer is 0, jump to clear channel
 	SET	r30, CH1BIT			; If non-zero turn on the corresponding channel
@@ -123,9 +134,10 @@ CH8:
 	SET	r30, CH8BIT
 	SUB	r7, r7, 1
 	SBCO	&r9, CONST_PRUSHAREDRAM, 28, 4
-
-	QBA	CH1	; return to beginning of loop
-	; no need to waste a cycle for timing here because of the QBA above
+	SUB	r8, r8, 1			; count down to the next frame
+	QBNE	CH1, r8, 0			; return to beginning of loop
+	QBA	FRAME
+	; no need to waste a cycle for timing here because of the QBNE above
 
 
 CLR1:
@@ -159,4 +171,49 @@ CLR7:
 CLR8:
 	CLR	r30, CH8BIT
 	LBCO	&r7, CONST_PRUSHAREDRAM, 28, 4
-	QBA	CH1	; return to beginning of loop
+	SUB	r8, r8, 1
+	QBNE	CH1, r8, 0	; return to beginning of loop
+
+; Start of a frame, latch the newest command bank and restart every idle
+; channel with its width. This only runs once per frame so the few extra cycles
+; don't upset pulse timing.
+FRAME:
+	LBCO	&r19, CONST_PRUSHAREDRAM, GEN_OFFSET, 4	; generation to latch
+	QBBS	FRAME_BANK1, r19, 0			; low bit selects the bank
+	LBCO	&r10, CONST_PRUSHAREDRAM, BANK0_OFFSET, 36	; period to r10, widths r11-r18
+	QBA	FRAME_CHECK
+FRAME_BANK1:
+	LBCO	&r10, CONST_PRUSHAREDRAM, BANK1_OFFSET, 36
+FRAME_CHECK:
+	LBCO	&r20, CONST_PRUSHAREDRAM, GEN_OFFSET, 4
+	QBNE	FRAME, r19, r20				; bank changed under us, read again
+	SBCO	&r19, CONST_PRUSHAREDRAM, ACK_OFFSET, 4	; acknowledge the generation
+	MOV	r8, r10
+	QBEQ	NOFRAME, r8, 0			; continuous mode is disabled
+	QBNE	FRAME2, r0, 0			; don't interrupt a pulse in progress
+	MOV	r0, r11
+FRAME2:
+	QBNE	FRAME3, r1, 0
+	MOV	r1, r12
+FRAME3:
+	QBNE	FRAME4, r2, 0
+	MOV	r2, r13
+FRAME4:
+	QBNE	FRAME5, r3, 0
+	MOV	r3, r14
+FRAME5:
+	QBNE	FRAME6, r4, 0
+	MOV	r4, r15
+FRAME6:
+	QBNE	FRAME7, r5, 0
+	MOV	r5, r16
+FRAME7:
+	QBNE	FRAME8, r6, 0
+	MOV	r6, r17
+FRAME8:
+	QBNE	CH1, r7, 0
+	MOV	r7, r18
+	QBA	CH1
+NOFRAME:
+	LDI32	r8, FRAME_POLL			; look again for continuous mode later
+	QBA	CH1